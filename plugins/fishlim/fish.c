@@ -31,9 +31,11 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <openssl/crypto.h>
 #include <openssl/evp.h>
 #include <openssl/blowfish.h>
 #include <openssl/rand.h>
+#include <openssl/sha.h>
 
 #include "keystore.h"
 #include "fish.h"
@@ -94,6 +96,29 @@ static OSSL_PROVIDER *default_provider;
 static OSSL_LIB_CTX *ossl_ctx;
 #endif
 
+/**
+ * Setting up a Blowfish key schedule costs far more than running a line
+ * through it, so contexts are kept per key, mode and direction and only
+ * get a new IV for each message. They are found by a digest of the key,
+ * the key itself isn't kept, and live in OpenSSL's secure heap like the
+ * keystore's keys.
+ */
+#define FISH_CTX_CACHE_MAX 32
+
+struct fish_ctx {
+    int mode;
+    int encode;
+    unsigned char digest[SHA256_DIGEST_LENGTH];
+    EVP_CIPHER_CTX *ctx;
+};
+
+static GHashTable *ctx_cache;
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+static EVP_CIPHER *bf_cbc;
+static EVP_CIPHER *bf_ecb;
+#endif
+
 int fish_init(void)
 {
 #if OPENSSL_VERSION_NUMBER >= 0x30000000L
@@ -118,7 +143,12 @@ int fish_init(void)
 
 void fish_deinit(void)
 {
+    g_clear_pointer(&ctx_cache, g_hash_table_destroy);
+
 #if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    g_clear_pointer(&bf_cbc, EVP_CIPHER_free);
+    g_clear_pointer(&bf_ecb, EVP_CIPHER_free);
+
     if (legacy_provider) {
         OSSL_PROVIDER_unload(legacy_provider);
         legacy_provider = NULL;
@@ -184,6 +214,25 @@ char *fish_base64_encode(const char *message, size_t message_len) {
     return encoded;
 }
 
+/**
+ * Decode ECB FiSH Base64 into a buffer of at least (message_len / 12) * 8 bytes
+ */
+static void fish_base64_decode_into(const char *message, char *bytes) {
+    BF_LONG left, right;
+    int i;
+    char *msg = (char *) message;
+    char *byt = bytes;
+
+    while (*msg) {
+        right = 0;
+        left = 0;
+        for (i = 0; i < 6; i++) right |= (uint8_t) fish_unbase64[(int)*msg++] << (i * 6u);
+        for (i = 0; i < 6; i++) left |= (uint8_t) fish_unbase64[(int)*msg++] << (i * 6u);
+        GET_BYTES(byt, left);
+        GET_BYTES(byt, right);
+    }
+}
+
 /**
  * Decode ECB FiSH Base64
  *
@@ -192,11 +241,7 @@ char *fish_base64_encode(const char *message, size_t message_len) {
  * @return Array of char with decoded message
  */
 char *fish_base64_decode(const char *message, size_t *final_len) {
-    BF_LONG left, right;
-    int i;
     char *bytes = NULL;
-    char *msg = NULL;
-    char *byt = NULL;
     size_t message_len;
 
     message_len = strlen(message);
@@ -209,20 +254,155 @@ char *fish_base64_decode(const char *message, size_t *final_len) {
     *final_len = ((message_len - 1) / 12) * 8 + 8 + 1;
     (*final_len)--; /* We support binary data */
     bytes = (char *) g_malloc0(*final_len);
-    byt = bytes;
+    fish_base64_decode_into(message, bytes);
 
-    msg = (char *) message;
+    return bytes;
+}
 
-    while (*msg) {
-        right = 0;
-        left = 0;
-        for (i = 0; i < 6; i++) right |= (uint8_t) fish_unbase64[(int)*msg++] << (i * 6u);
-        for (i = 0; i < 6; i++) left |= (uint8_t) fish_unbase64[(int)*msg++] << (i * 6u);
-        GET_BYTES(byt, left);
-        GET_BYTES(byt, right);
+static guint fish_ctx_hash(gconstpointer data) {
+    const struct fish_ctx *fctx = data;
+    guint hash;
+
+    /* the digest is as good a hash as any */
+    memcpy(&hash, fctx->digest, sizeof(hash));
+    return hash ^ (fctx->mode * 2 + fctx->encode);
+}
+
+static gboolean fish_ctx_equal(gconstpointer a, gconstpointer b) {
+    const struct fish_ctx *x = a, *y = b;
+
+    return x->mode == y->mode && x->encode == y->encode &&
+           memcmp(x->digest, y->digest, sizeof(x->digest)) == 0;
+}
+
+static void fish_ctx_free(gpointer data) {
+    struct fish_ctx *fctx = data;
+
+    EVP_CIPHER_CTX_free(fctx->ctx);
+    OPENSSL_secure_clear_free(fctx, sizeof(*fctx));
+}
+
+static const EVP_CIPHER *fish_get_cipher(int mode) {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    if (mode == EVP_CIPH_CBC_MODE) {
+        if (!bf_cbc)
+            bf_cbc = EVP_CIPHER_fetch(ossl_ctx, "BF-CBC", NULL);
+        return bf_cbc;
+    } else if (mode == EVP_CIPH_ECB_MODE) {
+        if (!bf_ecb)
+            bf_ecb = EVP_CIPHER_fetch(ossl_ctx, "BF-ECB", NULL);
+        return bf_ecb;
     }
+#else
+    if (mode == EVP_CIPH_CBC_MODE)
+        return EVP_bf_cbc();
+    else if (mode == EVP_CIPH_ECB_MODE)
+        return EVP_bf_ecb();
+#endif
+    return NULL;
+}
 
-    return bytes;
+static EVP_CIPHER_CTX *fish_new_ctx(const char *key, size_t keylen, int encode, int mode) {
+    const EVP_CIPHER *cipher = fish_get_cipher(mode);
+    EVP_CIPHER_CTX *ctx;
+
+    if (!cipher)
+        return NULL;
+
+    /* Create and initialise the context */
+    if (!(ctx = EVP_CIPHER_CTX_new()))
+        return NULL;
+
+    /* Initialise the cipher operation only with mode, set custom key length,
+     * then finish the initiation with the key. We will manage padding. */
+    if (!EVP_CipherInit_ex(ctx, cipher, NULL, NULL, NULL, encode) ||
+        !EVP_CIPHER_CTX_set_key_length(ctx, keylen) ||
+        !EVP_CipherInit_ex(ctx, NULL, NULL, (const unsigned char *) key, NULL, encode)) {
+        EVP_CIPHER_CTX_free(ctx);
+        return NULL;
+    }
+
+    EVP_CIPHER_CTX_set_padding(ctx, 0);
+    return ctx;
+}
+
+/**
+ * Returns a context set up with the key, from the cache if possible.
+ * *owned is set if the caller has to free it.
+ */
+static EVP_CIPHER_CTX *fish_get_ctx(const char *key, size_t keylen, int encode, int mode, gboolean *owned) {
+    struct fish_ctx probe, *fctx;
+    EVP_CIPHER_CTX *ctx;
+
+    *owned = FALSE;
+
+    probe.mode = mode;
+    probe.encode = encode;
+    if (!EVP_Digest(key, keylen, probe.digest, NULL, EVP_sha256(), NULL)) {
+        *owned = TRUE;
+        return fish_new_ctx(key, keylen, encode, mode);
+    }
+
+    if (!ctx_cache)
+        ctx_cache = g_hash_table_new_full(fish_ctx_hash, fish_ctx_equal, fish_ctx_free, NULL);
+
+    fctx = g_hash_table_lookup(ctx_cache, &probe);
+    if (fctx) {
+        OPENSSL_cleanse(&probe, sizeof(probe));
+        return fctx->ctx;
+    }
+
+    ctx = fish_new_ctx(key, keylen, encode, mode);
+    if (!ctx || !(fctx = OPENSSL_secure_malloc(sizeof(*fctx)))) {
+        OPENSSL_cleanse(&probe, sizeof(probe));
+        *owned = TRUE;
+        return ctx;
+    }
+
+    if (g_hash_table_size(ctx_cache) >= FISH_CTX_CACHE_MAX)
+        g_hash_table_remove_all(ctx_cache);
+
+    memcpy(fctx, &probe, sizeof(probe));
+    OPENSSL_cleanse(&probe, sizeof(probe));
+    fctx->ctx = ctx;
+    g_hash_table_add(ctx_cache, fctx);
+    return ctx;
+}
+
+/**
+ * Runs whole blocks through a context in place. Passing no key keeps the
+ * key schedule, only the IV (CBC) is set again.
+ */
+static gboolean fish_run_ctx(EVP_CIPHER_CTX *ctx, unsigned char *data, size_t len, const unsigned char *iv, int encode) {
+    int bytes_written = 0, final_written = 0;
+
+    if (1 != EVP_CipherInit_ex(ctx, NULL, NULL, NULL, iv, encode))
+        return FALSE;
+
+    /* Do cipher operation */
+    if (1 != EVP_CipherUpdate(ctx, data, &bytes_written, data, len))
+        return FALSE;
+
+    /* Finalise the cipher. Further ciphertext bytes may be written at this stage */
+    if (1 != EVP_CipherFinal_ex(ctx, data + bytes_written, &final_written))
+        return FALSE;
+
+    return (size_t) (bytes_written + final_written) == len;
+}
+
+static gboolean fish_cipher_inplace(unsigned char *data, size_t len, const char *key, size_t keylen, int encode, int mode, const unsigned char *iv) {
+    EVP_CIPHER_CTX *ctx;
+    gboolean owned, ok;
+
+    ctx = fish_get_ctx(key, keylen, encode, mode, &owned);
+    if (!ctx)
+        return FALSE;
+
+    ok = fish_run_ctx(ctx, data, len, iv, encode);
+
+    if (owned)
+        EVP_CIPHER_CTX_free(ctx);
+    return ok;
 }
 
 /**
@@ -248,12 +428,9 @@ char *fish_base64_decode(const char *message, size_t *final_len) {
  * @return Array of char with data encrypted or decrypted
  */
 char *fish_cipher(const char *plaintext, size_t plaintext_len, const char *key, size_t keylen, int encode, int mode, size_t *ciphertext_len) {
-    EVP_CIPHER_CTX *ctx;
-    EVP_CIPHER *cipher = NULL;
-    int bytes_written = 0;
     unsigned char *ciphertext = NULL;
-    unsigned char *iv_ciphertext = NULL;
     unsigned char *iv = NULL;
+    size_t iv_len = 0;
     size_t block_size = 0;
 
     *ciphertext_len = 0;
@@ -261,95 +438,41 @@ char *fish_cipher(const char *plaintext, size_t plaintext_len, const char *key,
     if (plaintext_len == 0 || keylen == 0 || encode < 0 || encode > 1)
         return NULL;
 
-    block_size = plaintext_len;
-
     if (mode == EVP_CIPH_CBC_MODE) {
         if (encode == 1) {
-            iv = (unsigned char *) g_malloc0(8);
-            RAND_bytes(iv, 8);
+            iv_len = 8;
         } else {
             if (plaintext_len <= 8) /* IV + DATA */
                 return NULL;
 
             iv = (unsigned char *) plaintext;
-            block_size -= 8;
             plaintext += 8;
             plaintext_len -= 8;
         }
-
-#if OPENSSL_VERSION_NUMBER >= 0x30000000L
-        cipher = EVP_CIPHER_fetch(ossl_ctx, "BF-CBC", NULL);
-#else
-        cipher = (EVP_CIPHER *) EVP_bf_cbc();
-#endif
-
-    } else if (mode == EVP_CIPH_ECB_MODE) {
-
-#if OPENSSL_VERSION_NUMBER >= 0x30000000L
-        cipher = EVP_CIPHER_fetch(ossl_ctx, "BF-ECB", NULL);
-#else
-        cipher = (EVP_CIPHER *) EVP_bf_ecb();
-#endif
     }
 
     /* Zero Padding */
+    block_size = plaintext_len;
     if (block_size % 8 != 0) {
         block_size = block_size + 8 - (block_size % 8);
     }
 
-    ciphertext = (unsigned char *) g_malloc0(block_size);
-    memcpy(ciphertext, plaintext, plaintext_len);
-
-    /* Create and initialise the context */
-    if (!(ctx = EVP_CIPHER_CTX_new()))
-        return NULL;
-
-    /* Initialise the cipher operation only with mode */
-    if (!EVP_CipherInit_ex(ctx, cipher, NULL, NULL, NULL, encode))
-        return NULL;
-
-    /* Set custom key length */
-    if (!EVP_CIPHER_CTX_set_key_length(ctx, keylen))
-        return NULL;
-
-    /* Finish the initiation the cipher operation */
-    if (1 != EVP_CipherInit_ex(ctx, NULL, NULL, (const unsigned char *) key, iv, encode))
-        return NULL;
-
-    /* We will manage this */
-    EVP_CIPHER_CTX_set_padding(ctx, 0);
-
-    /* Do cipher operation */
-    if (1 != EVP_CipherUpdate(ctx, ciphertext, &bytes_written, ciphertext, block_size))
-        return NULL;
-
-    *ciphertext_len = bytes_written;
-
-    /* Finalise the cipher. Further ciphertext bytes may be written at this stage */
-    if (1 != EVP_CipherFinal_ex(ctx, ciphertext + bytes_written, &bytes_written))
-        return NULL;
-
-    *ciphertext_len += bytes_written;
-
-    /* Clean up */
-    EVP_CIPHER_CTX_free(ctx);
+    /* The IV goes in front of the data when encrypting */
+    ciphertext = (unsigned char *) g_malloc0(iv_len + block_size);
+    memcpy(ciphertext + iv_len, plaintext, plaintext_len);
 
+    if (iv_len) {
+        RAND_bytes(ciphertext, iv_len);
+        iv = ciphertext;
+    }
 
-    if (mode == EVP_CIPH_CBC_MODE && encode == 1) {
-        /* Join IV + DATA */
-        iv_ciphertext = g_malloc0(8 + *ciphertext_len);
-
-        memcpy(iv_ciphertext, iv, 8);
-        memcpy(&iv_ciphertext[8], ciphertext, *ciphertext_len);
-        *ciphertext_len += 8;
-
+    if (!fish_cipher_inplace(ciphertext + iv_len, block_size, key, keylen, encode, mode, iv)) {
         g_free(ciphertext);
-        g_free(iv);
-
-        return (char *) iv_ciphertext;
-    } else {
-        return (char *) ciphertext;
+        return NULL;
     }
+
+    *ciphertext_len = iv_len + block_size;
+    return (char *) ciphertext;
 }
 
 /**
@@ -393,6 +516,70 @@ char *fish_encrypt(const char *key, size_t keylen, const char *message, size_t m
     return b64;
 }
 
+/**
+ * Decrypts with a context from fish_get_ctx. The base64 is decoded straight
+ * into the buffer that gets decrypted in place and returned, with room for
+ * a trailing zero.
+ */
+static char *fish_decrypt_ctx(EVP_CIPHER_CTX *ctx, const char *data, enum fish_mode mode, size_t *final_len) {
+    size_t data_len = strlen(data);
+    size_t decoded_len = 0, block_size;
+    unsigned char *buf = NULL;
+    const unsigned char *iv = NULL;
+    gint state = 0;
+    guint save = 0;
+
+    *final_len = 0;
+
+    if (data_len == 0)
+        return NULL;
+
+    switch (mode) {
+        case FISH_CBC_MODE:
+            if (strspn(data, base64_chars) != data_len)
+                return NULL;
+            buf = g_malloc0((data_len / 4) * 3 + 3 + 8 + 1);
+            decoded_len = g_base64_decode_step(data, data_len, buf, &state, &save);
+
+            /* IV + DATA */
+            if (decoded_len <= 8) {
+                g_free(buf);
+                return NULL;
+            }
+            iv = buf;
+            break;
+
+        case FISH_ECB_MODE:
+            /* Ensure blocks of 12 bytes each one and valid characters */
+            if (data_len % 12 != 0 || strspn(data, fish_base64) != data_len)
+                return NULL;
+            decoded_len = (data_len / 12) * 8;
+            buf = g_malloc0(decoded_len + 1);
+            fish_base64_decode_into(data, (char *) buf);
+            break;
+
+        default:
+            return NULL;
+    }
+
+    block_size = decoded_len - (iv ? 8 : 0);
+    /* Zero Padding */
+    if (block_size % 8 != 0)
+        block_size = block_size + 8 - (block_size % 8);
+
+    if (!fish_run_ctx(ctx, buf + (iv ? 8 : 0), block_size, iv, 0)) {
+        g_free(buf);
+        return NULL;
+    }
+
+    if (iv)
+        memmove(buf, buf + 8, block_size);
+    buf[block_size] = '\0';
+
+    *final_len = block_size;
+    return (char *) buf;
+}
+
 /**
  * Return an array of bytes with data decrypted
  * is binary safe
@@ -405,35 +592,23 @@ char *fish_encrypt(const char *key, size_t keylen, const char *message, size_t m
  * @return Array of char with data decrypted
  */
 char *fish_decrypt(const char *key, size_t keylen, const char *data, enum fish_mode mode, size_t *final_len) {
-    size_t ciphertext_len = 0;
-    char *ciphertext = NULL;
-    char *plaintext = NULL;
+    EVP_CIPHER_CTX *ctx;
+    gboolean owned;
+    char *plaintext;
 
     *final_len = 0;
 
     if (keylen == 0 || strlen(data) == 0)
         return NULL;
 
-    switch (mode) {
-        case FISH_CBC_MODE:
-            if (strspn(data, base64_chars) != strlen(data))
-                return NULL;
-            ciphertext = (char *) g_base64_decode(data, &ciphertext_len);
-            break;
-
-        case FISH_ECB_MODE:
-            ciphertext = fish_base64_decode(data, &ciphertext_len);
-    }
-
-    if (ciphertext == NULL || ciphertext_len == 0)
+    ctx = fish_get_ctx(key, keylen, 0, mode, &owned);
+    if (!ctx)
         return NULL;
 
-    plaintext = fish_cipher(ciphertext, ciphertext_len, key, keylen, 0, mode, final_len);
-    g_free(ciphertext);
-
-    if (*final_len == 0)
-        return NULL;
+    plaintext = fish_decrypt_ctx(ctx, data, mode, final_len);
 
+    if (owned)
+        EVP_CIPHER_CTX_free(ctx);
     return plaintext;
 }
 
@@ -447,19 +622,48 @@ char *fish_decrypt(const char *key, size_t keylen, const char *data, enum fish_m
  * @return Array of char with data decrypted
  */
 char *fish_decrypt_str(const char *key, size_t keylen, const char *data, enum fish_mode mode) {
-    char *decrypted = NULL;
-    char *plaintext_str = NULL;
     size_t decrypted_len = 0;
 
-    decrypted = fish_decrypt(key, strlen(key), data, mode, &decrypted_len);
+    /* fish_decrypt zero terminates, the string ends at the first zero */
+    return fish_decrypt(key, keylen, data, mode, &decrypted_len);
+}
 
-    if (decrypted == NULL || decrypted_len == 0)
-        return NULL;
+/**
+ * Decrypts many messages with one key, e.g. a playback of a channel's
+ * history, setting up the cipher only once (see fish_decrypt_str)
+ *
+ * @param [in] key         Bytes of key
+ * @param [in] keylen      Size of key
+ * @param [in] data        Fish or standard Base64 encoded strings
+ * @param [out] plaintext  Array of char with data decrypted for each, NULL for those that failed
+ * @param [in] count       Number of messages
+ * @param [in] mode        Chiper mode
+ * @return Number of messages decrypted
+ */
+size_t fish_decrypt_str_batch(const char *key, size_t keylen, const char *const *data, char **plaintext, size_t count, enum fish_mode mode) {
+    EVP_CIPHER_CTX *ctx;
+    gboolean owned;
+    size_t i, len, decrypted = 0;
+
+    for (i = 0; i < count; i++)
+        plaintext[i] = NULL;
+
+    if (keylen == 0)
+        return 0;
 
-    plaintext_str = g_strndup(decrypted, decrypted_len);
-    g_free(decrypted);
+    ctx = fish_get_ctx(key, keylen, 0, mode, &owned);
+    if (!ctx)
+        return 0;
+
+    for (i = 0; i < count; i++) {
+        plaintext[i] = fish_decrypt_ctx(ctx, data[i], mode, &len);
+        if (plaintext[i])
+            decrypted++;
+    }
 
-    return plaintext_str;
+    if (owned)
+        EVP_CIPHER_CTX_free(ctx);
+    return decrypted;
 }
 
 /**
@@ -469,17 +673,9 @@ char *fish_decrypt_str(const char *key, size_t keylen, const char *data, enum fi
  * @return TRUE if have a key or FALSE if not
  */
 gboolean fish_nick_has_key(const char *nick) {
-    gboolean has_key = FALSE;
-    char *key;
     enum fish_mode mode;
 
-    key = keystore_get_key(nick, &mode);
-    if (key) {
-        has_key = TRUE;
-        g_free(key);
-    };
-
-    return has_key;
+    return keystore_get_key(nick, &mode) != NULL;
 }
 
 /**
@@ -492,7 +688,7 @@ gboolean fish_nick_has_key(const char *nick) {
  * @return A list of encoded strings with the message encrypted or NULL if any error occurred
  */
 GSList *fish_encrypt_for_nick(const char *nick, const char *data, enum fish_mode *omode, size_t command_len) {
-    char *key;
+    const char *key;
     GSList *encrypted_list = NULL;
     char *encrypted = NULL;
     enum fish_mode mode;
@@ -540,7 +736,7 @@ GSList *fish_encrypt_for_nick(const char *nick, const char *data, enum fish_mode
  * @return Plaintext message or NULL if any error occurred
  */
 char *fish_decrypt_from_nick(const char *nick, const char *data, enum fish_mode *omode) {
-    char *key;
+    const char *key;
     char *decrypted;
     enum fish_mode mode;
 
@@ -555,7 +751,6 @@ char *fish_decrypt_from_nick(const char *nick, const char *data, enum fish_mode
 
     /* Decrypt */
     decrypted = fish_decrypt_str(key, strlen(key), data, mode);
-    g_free(key);
 
     return decrypted;
 }
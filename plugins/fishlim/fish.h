@@ -42,6 +42,7 @@ char *fish_base64_decode(const char *message, size_t *final_len);
 char *fish_encrypt(const char *key, size_t keylen, const char *message, size_t message_len, enum fish_mode mode);
 char *fish_decrypt(const char *key, size_t keylen, const char *data, enum fish_mode mode, size_t *final_len);
 char *fish_decrypt_str(const char *key, size_t keylen, const char *data, enum fish_mode mode);
+size_t fish_decrypt_str_batch(const char *key, size_t keylen, const char *const *data, char **plaintext, size_t count, enum fish_mode mode);
 gboolean fish_nick_has_key(const char *nick);
 GSList *fish_encrypt_for_nick(const char *nick, const char *data, enum fish_mode *omode, size_t command_len);
 char *fish_decrypt_from_nick(const char *nick, const char *data, enum fish_mode *omode);
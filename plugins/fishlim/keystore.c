@@ -25,8 +25,11 @@
 #include "config.h"
 
 #include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <openssl/crypto.h>
 #include "irc.h"
 #include "fish.h"
 #include "keystore.h"
@@ -35,20 +38,208 @@
 
 static char *keystore_password = NULL;
 
+/**
+ * The key store file stays loaded. Entries are indexed by their folded
+ * group name and their keys are decrypted on first use, into memory that
+ * is locked where OpenSSL's secure heap is available.
+ *
+ * The secure heap belongs to the whole process: once we set it up, the
+ * core's TLS gets its OPENSSL_secure_malloc() memory from there as well,
+ * and it can only be released again if nothing is left in it, so it
+ * usually stays around after the plugin is unloaded.
+ */
+struct keystore_entry {
+    char *group;
+    char *key;
+    enum fish_mode mode;
+    gboolean loaded;
+};
+
+static GKeyFile *keyfile = NULL;
+static GHashTable *entries = NULL;
+static GFileMonitor *monitor = NULL;
+static gboolean stale = TRUE;
+static gint64 loaded_mtime = 0;
+static gchar *file_digest = NULL;	/* of what we last read or wrote */
+static gboolean secure_heap = FALSE;
+
+
+static char *secure_strdup(const char *str) {
+    size_t len = strlen(str) + 1;
+    char *copy;
+
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+    if (!secure_heap && !CRYPTO_secure_malloc_initialized())
+        secure_heap = CRYPTO_secure_malloc_init(65536, 32) != 0;
+    copy = OPENSSL_secure_malloc(len);
+    /* The secure heap is full, OPENSSL_secure_clear_free() copes with this */
+    if (!copy)
+        copy = OPENSSL_malloc(len);
+#else
+    copy = OPENSSL_malloc(len);
+#endif
+    memcpy(copy, str, len);
+    return copy;
+}
+
+static void secure_free(char *str) {
+    if (!str)
+        return;
+
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+    OPENSSL_secure_clear_free(str, strlen(str) + 1);
+#else
+    OPENSSL_cleanse(str, strlen(str));
+    OPENSSL_free(str);
+#endif
+}
+
+static void entry_free(struct keystore_entry *entry) {
+    g_free(entry->group);
+    secure_free(entry->key);
+    g_free(entry);
+}
+
+/**
+ * Case folds an (escaped) nick with rfc1459 rules. Servers with ascii
+ * casemapping are handled by checking the match with irc_nick_cmp.
+ */
+static char *fold_nick(const char *nick) {
+    char *folded = g_strdup(nick);
+    char *p;
+
+    for (p = folded; *p; p++) {
+        if (*p == '[')
+            *p = '{';
+        else if (*p == ']')
+            *p = '}';
+        else if (*p == '\\')
+            *p = '|';
+        else if (*p == '^')
+            *p = '~';
+        else
+            *p = g_ascii_tolower(*p);
+    }
+
+    return folded;
+}
+
+static void set_file_digest(const gchar *data, gsize len) {
+    g_free(file_digest);
+    file_digest = data ? g_compute_checksum_for_data(G_CHECKSUM_SHA256, (const guchar *) data, len) : NULL;
+}
+
+/**
+ * Our own saves show up here too, those are no reason to read it again.
+ */
+static void keyfile_changed(GFileMonitor *file_monitor, GFile *file, GFile *other,
+                            GFileMonitorEvent event, gpointer userdata) {
+    gchar *filename, *data, *digest = NULL;
+    gsize len;
+
+    if (stale)
+        return;
+
+    filename = get_config_filename();
+    if (g_file_get_contents(filename, &data, &len, NULL)) {
+        digest = g_compute_checksum_for_data(G_CHECKSUM_SHA256, (const guchar *) data, len);
+        OPENSSL_cleanse(data, len);
+        g_free(data);
+    }
+    g_free(filename);
+
+    if (!digest || g_strcmp0(digest, file_digest) != 0)
+        stale = TRUE;
+    g_free(digest);
+}
+
+static gint64 get_mtime(const char *filename) {
+    GStatBuf st;
+
+    if (g_stat(filename, &st) != 0)
+        return 0;
+    return st.st_mtime;
+}
+
+/**
+ * Has the file changed since it was loaded? Without a file monitor this
+ * falls back to comparing its mtime.
+ */
+static gboolean keystore_is_stale(void) {
+    gchar *filename;
+    gboolean changed;
+
+    if (stale || monitor)
+        return stale;
+
+    filename = get_config_filename();
+    changed = get_mtime(filename) != loaded_mtime;
+    g_free(filename);
+    return changed;
+}
 
 /**
  * Opens the key store file: ~/.config/hexchat/addon_fishlim.conf
  */
-static GKeyFile *getConfigFile(void) {
-    gchar *filename = get_config_filename();
-    
-    GKeyFile *keyfile = g_key_file_new();
-    g_key_file_load_from_file(keyfile, filename,
-                              G_KEY_FILE_KEEP_COMMENTS |
-                              G_KEY_FILE_KEEP_TRANSLATIONS, NULL);
-    
+static void keystore_load(void) {
+    gchar *filename, *data;
+    gchar **group;
+    gchar **groups;
+    GFile *file;
+    gsize len;
+
+    if (!keystore_is_stale())
+        return;
+
+    if (entries)
+        g_hash_table_remove_all(entries);
+    else
+        entries = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                        (GDestroyNotify) entry_free);
+    if (keyfile)
+        g_key_file_free(keyfile);
+
+    filename = get_config_filename();
+
+    if (!monitor) {
+        file = g_file_new_for_path(filename);
+        monitor = g_file_monitor_file(file, G_FILE_MONITOR_NONE, NULL, NULL);
+        if (monitor)
+            g_signal_connect(monitor, "changed", G_CALLBACK(keyfile_changed), NULL);
+        g_object_unref(file);
+    }
+
+    keyfile = g_key_file_new();
+    if (g_file_get_contents(filename, &data, &len, NULL)) {
+        g_key_file_load_from_data(keyfile, data, len,
+                                  G_KEY_FILE_KEEP_COMMENTS |
+                                  G_KEY_FILE_KEEP_TRANSLATIONS, NULL);
+        set_file_digest(data, len);
+        OPENSSL_cleanse(data, len);
+        g_free(data);
+    } else {
+        set_file_digest(NULL, 0);
+    }
+    loaded_mtime = get_mtime(filename);
+    stale = FALSE;
     g_free(filename);
-    return keyfile;
+
+    groups = g_key_file_get_groups(keyfile, NULL);
+    for (group = groups; *group != NULL; group++) {
+        struct keystore_entry *entry;
+        char *folded = fold_nick(*group);
+
+        /* The first of several matching groups wins, like it always did */
+        if (g_hash_table_contains(entries, folded)) {
+            g_free(folded);
+            continue;
+        }
+
+        entry = g_new0(struct keystore_entry, 1);
+        entry->group = g_strdup(*group);
+        g_hash_table_insert(entries, folded, entry);
+    }
+    g_strfreev(groups);
 }
 
 
@@ -80,58 +271,53 @@ static char *escape_nickname(const char *nick) {
 }
 
 /**
- * Gets a value for a nick/channel from addon_fishlim.conf. Unlike
- * g_key_file_get_string, this function is case insensitive.
+ * Finds the entry of a nick/channel. Unlike g_key_file_get_string, this
+ * is case insensitive.
  */
-static gchar *get_nick_value(GKeyFile *keyfile, const char *nick, const char *item) {
-    gchar **group;
-    gchar **groups = g_key_file_get_groups(keyfile, NULL);
-    gchar *result = NULL;
-    
-    for (group = groups; *group != NULL; group++) {
-        if (!irc_nick_cmp(*group, nick)) {
-            result = g_key_file_get_string(keyfile, *group, item, NULL);
-            break;
-        }
-    }
-    
-    g_strfreev(groups);
-    return result;
-}
+static struct keystore_entry *find_entry(const char *escaped_nick) {
+    struct keystore_entry *entry;
+    char *folded;
+
+    keystore_load();
 
+    folded = fold_nick(escaped_nick);
+    entry = g_hash_table_lookup(entries, folded);
+    g_free(folded);
+
+    if (entry && irc_nick_cmp(entry->group, escaped_nick))
+        return NULL;
+    return entry;
+}
 
 /**
- * Extracts a key from the key store file.
+ * Reads and decrypts the key of an entry, once.
  */
-char *keystore_get_key(const char *nick, enum fish_mode *mode) {
-    GKeyFile *keyfile;
-    char *escaped_nick;
+static void load_entry(struct keystore_entry *entry) {
     gchar *value, *key_mode;
     int encrypted_mode;
     char *password;
     char *encrypted;
     char *decrypted;
 
-    /* Get the key */
-    keyfile = getConfigFile();
-    escaped_nick = escape_nickname(nick);
-    value = get_nick_value(keyfile, escaped_nick, "key");
-    key_mode = get_nick_value(keyfile, escaped_nick, "mode");
-    g_key_file_free(keyfile);
-    g_free(escaped_nick);
+    if (entry->loaded)
+        return;
+    entry->loaded = TRUE;
+
+    value = g_key_file_get_string(keyfile, entry->group, "key", NULL);
+    key_mode = g_key_file_get_string(keyfile, entry->group, "mode", NULL);
 
     /* Determine cipher mode */
-    *mode = FISH_ECB_MODE;
+    entry->mode = FISH_ECB_MODE;
     if (key_mode) {
         if (*key_mode == '1')
-            *mode = FISH_ECB_MODE;
+            entry->mode = FISH_ECB_MODE;
         else if (*key_mode == '2')
-            *mode = FISH_CBC_MODE;
+            entry->mode = FISH_CBC_MODE;
         g_free(key_mode);
     }
 
     if (!value)
-        return NULL;
+        return;
 
     if (strncmp(value, "+OK ", 4) == 0) {
         /* Key is encrypted */
@@ -147,68 +333,85 @@ char *keystore_get_key(const char *nick, enum fish_mode *mode) {
 
         password = (char *) get_keystore_password();
         decrypted = fish_decrypt_str((const char *) password, strlen(password), (const char *) encrypted, encrypted_mode);
-        g_free(value);
-        return decrypted;
+        if (decrypted) {
+            entry->key = secure_strdup(decrypted);
+            OPENSSL_cleanse(decrypted, strlen(decrypted));
+            g_free(decrypted);
+        }
     } else {
         /* Key is stored in plaintext */
-        return value;
+        entry->key = secure_strdup(value);
     }
+
+    OPENSSL_cleanse(value, strlen(value));
+    g_free(value);
 }
 
+
 /**
- * Deletes a nick and the associated key in the key store file.
+ * Extracts a key from the key store. The key belongs to the key store and
+ * stays valid until the next change to it.
  */
-static gboolean delete_nick(GKeyFile *keyfile, const char *nick) {
-    gchar **group;
-    gchar **groups = g_key_file_get_groups(keyfile, NULL);
-    gboolean ok = FALSE;
-    
-    for (group = groups; *group != NULL; group++) {
-        if (!irc_nick_cmp(*group, nick)) {
-            ok = g_key_file_remove_group(keyfile, *group, NULL);
-            break;
-        }
-    }
-    
-    g_strfreev(groups);
-    return ok;
+const char *keystore_get_key(const char *nick, enum fish_mode *mode) {
+    struct keystore_entry *entry;
+    char *escaped_nick;
+
+    escaped_nick = escape_nickname(nick);
+    entry = find_entry(escaped_nick);
+    g_free(escaped_nick);
+
+    *mode = FISH_ECB_MODE;
+    if (!entry)
+        return NULL;
+
+    load_entry(entry);
+    *mode = entry->mode;
+    return entry->key;
 }
 
-#if !GLIB_CHECK_VERSION(2,40,0)
 /**
- * Writes the key store file to disk.
+ * Deletes a nick and the associated key in the key store file.
  */
-static gboolean keyfile_save_to_file (GKeyFile *keyfile, char *filename) {
+static gboolean delete_nick(const char *escaped_nick) {
+    struct keystore_entry *entry = find_entry(escaped_nick);
+    char *folded;
     gboolean ok;
 
-    /* Serialize */
-    gsize file_length;
-    gchar *file_data = g_key_file_to_data(keyfile, &file_length, NULL);
-    if (!file_data)
+    if (!entry)
         return FALSE;
 
-    /* Write to file */
-    ok = g_file_set_contents (filename, file_data, file_length, NULL);
-    g_free(file_data);
+    ok = g_key_file_remove_group(keyfile, entry->group, NULL);
+
+    folded = fold_nick(entry->group);
+    g_hash_table_remove(entries, folded);
+    g_free(folded);
     return ok;
 }
-#endif
 
 /**
- * Writes the key store file to disk.
+ * Writes the key store file to disk, through a temporary file that is
+ * renamed over the old one.
  */
-static gboolean save_keystore(GKeyFile *keyfile) {
+static gboolean save_keystore(void) {
     char *filename;
-    gboolean ok;
+    gchar *file_data;
+    gsize file_length;
+    gboolean ok = FALSE;
 
     filename = get_config_filename();
-#if !GLIB_CHECK_VERSION(2,40,0)
-    ok = keyfile_save_to_file (keyfile, filename);
-#else
-G_GNUC_BEGIN_IGNORE_DEPRECATIONS /* Hide false positive */
-    ok = g_key_file_save_to_file (keyfile, filename, NULL);
-G_GNUC_END_IGNORE_DEPRECATIONS
-#endif
+    file_data = g_key_file_to_data(keyfile, &file_length, NULL);
+    if (file_data) {
+        ok = g_file_set_contents(filename, file_data, file_length, NULL);
+        /* so the file monitor can tell this write from others */
+        if (ok)
+            set_file_digest(file_data, file_length);
+        OPENSSL_cleanse(file_data, file_length);
+        g_free(file_data);
+    }
+
+    /* What's in memory is what's on disk, unless the write failed */
+    loaded_mtime = get_mtime (filename);
+    stale = !ok;
     g_free (filename);
 
     return ok;
@@ -222,18 +425,22 @@ gboolean keystore_store_key(const char *nick, const char *key, enum fish_mode mo
     char *encrypted;
     char *wrapped;
     gboolean ok = FALSE;
-    GKeyFile *keyfile = getConfigFile();
+    struct keystore_entry *entry;
     char *escaped_nick = escape_nickname(nick);
 
     /* Remove old key */
-    delete_nick(keyfile, escaped_nick);
+    delete_nick(escaped_nick);
     
     /* Add new key */
     password = get_keystore_password();
     if (password) {
         /* Encrypt the password */
         encrypted = fish_encrypt(password, strlen(password), key, strlen(key), FISH_CBC_MODE);
-        if (!encrypted) goto end;
+        if (!encrypted) {
+            /* The old key is gone from memory, but not from the file */
+            stale = TRUE;
+            goto end;
+        }
         
         /* Prepend "+OK " */
         wrapped = g_strconcat("+OK *", encrypted, NULL);
@@ -249,12 +456,18 @@ gboolean keystore_store_key(const char *nick, const char *key, enum fish_mode mo
 
     /* Store cipher mode */
     g_key_file_set_integer(keyfile, escaped_nick, "mode", mode);
+
+    entry = g_new0(struct keystore_entry, 1);
+    entry->group = g_strdup(escaped_nick);
+    entry->key = secure_strdup(key);
+    entry->mode = mode;
+    entry->loaded = TRUE;
+    g_hash_table_insert(entries, fold_nick(escaped_nick), entry);
     
     /* Save key store file */
-    ok = save_keystore(keyfile);
+    ok = save_keystore();
     
   end:
-    g_key_file_free(keyfile);
     g_free(escaped_nick);
     return ok;
 }
@@ -263,16 +476,33 @@ gboolean keystore_store_key(const char *nick, const char *key, enum fish_mode mo
  * Deletes a nick from the key store.
  */
 gboolean keystore_delete_nick(const char *nick) {
-    GKeyFile *keyfile = getConfigFile();
     char *escaped_nick = escape_nickname(nick);
     
     /* Delete entry */
-    gboolean ok = delete_nick(keyfile, escaped_nick);
+    gboolean ok = delete_nick(escaped_nick);
     
     /* Save */
-    if (ok) save_keystore(keyfile);
+    if (ok) save_keystore();
     
-    g_key_file_free(keyfile);
     g_free(escaped_nick);
     return ok;
 }
+
+/**
+ * Drops the cached key store, wiping the keys.
+ */
+void keystore_deinit(void) {
+    g_clear_pointer(&entries, g_hash_table_destroy);
+    g_clear_pointer(&keyfile, g_key_file_free);
+    g_clear_object(&monitor);
+    g_clear_pointer(&file_digest, g_free);
+    stale = TRUE;
+
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+    /* fails while anybody, the core included, still has memory in it */
+    if (secure_heap) {
+        CRYPTO_secure_malloc_done();
+        secure_heap = FALSE;
+    }
+#endif
+}
@@ -0,0 +1,132 @@
+/*
+  Copyright (c) 2026 BirdChat contributors
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+
+*/
+
+/* Decrypts a playback of encrypted channel history: once line by line with
+   a new key for every line (what each line used to cost), once line by line
+   with one key and once as a batch. */
+
+#include <string.h>
+#include <glib.h>
+
+#include "fish.h"
+
+#define LINES 500
+#define LINE_LEN 300
+#define ROUNDS 10
+
+static char *encrypted[LINES];
+static char *decrypted[LINES];
+
+static void
+fill_lines(const char *key, size_t keylen, enum fish_mode mode)
+{
+    char line[LINE_LEN + 1];
+    int i, j;
+
+    for (i = 0; i < LINES; ++i) {
+        for (j = 0; j < LINE_LEN; ++j)
+            line[j] = 'a' + (i + j) % 26;
+        line[LINE_LEN] = 0;
+
+        encrypted[i] = fish_encrypt(key, keylen, line, LINE_LEN, mode);
+        g_assert_nonnull(encrypted[i]);
+    }
+}
+
+static void
+free_lines(char **lines)
+{
+    int i;
+
+    for (i = 0; i < LINES; ++i)
+        g_clear_pointer(&lines[i], g_free);
+}
+
+static void
+report(const char *what, enum fish_mode mode, GTimer *timer)
+{
+    double seconds = g_timer_elapsed(timer, NULL);
+
+    g_print("%s %-24s %8.0f lines/s\n", mode == FISH_CBC_MODE ? "CBC" : "ECB", what,
+            (LINES * ROUNDS) / seconds);
+}
+
+static void
+run(enum fish_mode mode)
+{
+    char key[] = "a fairly long shared channel key";
+    size_t keylen = strlen(key);
+    GTimer *timer = g_timer_new();
+    int i, round;
+
+    fill_lines(key, keylen, mode);
+
+    /* Every line with another key, nothing can be reused */
+    g_timer_start(timer);
+    for (round = 0; round < ROUNDS; ++round) {
+        for (i = 0; i < LINES; ++i) {
+            key[0] = 'A' + (round * LINES + i) % 58;
+            decrypted[i] = fish_decrypt_str(key, keylen, encrypted[i], mode);
+        }
+        free_lines(decrypted);
+    }
+    g_timer_stop(timer);
+    report("new key per line", mode, timer);
+    key[0] = 'a';
+
+    g_timer_start(timer);
+    for (round = 0; round < ROUNDS; ++round) {
+        for (i = 0; i < LINES; ++i) {
+            decrypted[i] = fish_decrypt_str(key, keylen, encrypted[i], mode);
+            g_assert_nonnull(decrypted[i]);
+        }
+        free_lines(decrypted);
+    }
+    g_timer_stop(timer);
+    report("line by line", mode, timer);
+
+    g_timer_start(timer);
+    for (round = 0; round < ROUNDS; ++round) {
+        g_assert_cmpuint(fish_decrypt_str_batch(key, keylen, (const char *const *) encrypted,
+                                                decrypted, LINES, mode), == , LINES);
+        free_lines(decrypted);
+    }
+    g_timer_stop(timer);
+    report("batch", mode, timer);
+
+    free_lines(encrypted);
+    g_timer_destroy(timer);
+}
+
+int
+main(int argc, char *argv[]) {
+
+    if (!fish_init())
+        return 1;
+
+    run(FISH_ECB_MODE);
+    run(FISH_CBC_MODE);
+
+    fish_deinit();
+    return 0;
+}
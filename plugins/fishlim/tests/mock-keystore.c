@@ -26,7 +26,7 @@
 /**
  * Extracts a key from the key store file.
  */
-char *
+const char *
 keystore_get_key(const char *nick, enum fish_mode *mode)
 {
     return NULL;
@@ -123,6 +123,44 @@ test_cbc(void)
     }
 }
 
+/**
+ * Check that decrypting in a batch gives what decrypting one by one does
+ */
+static void
+test_batch(void)
+{
+    char *b64[100];
+    char *de[100];
+    char key[57];
+    char message[100][300];
+    enum fish_mode mode;
+    int i;
+
+    random_string(key, 56);
+
+    for (mode = FISH_ECB_MODE; mode <= FISH_CBC_MODE; ++mode) {
+        for (i = 0; i < 100; ++i) {
+            random_string(message[i], i * 2 + 1);
+            b64[i] = fish_encrypt(key, 56, message[i], i * 2 + 1, mode);
+            g_assert_nonnull(b64[i]);
+        }
+
+        /* A broken one in between */
+        b64[50][0] = '\0';
+
+        g_assert_cmpuint(fish_decrypt_str_batch(key, 56, (const char *const *) b64, de, 100, mode), == , 99);
+
+        for (i = 0; i < 100; ++i) {
+            if (i == 50)
+                g_assert_null(de[i]);
+            else
+                g_assert_cmpstr(de[i], == , message[i]);
+            g_free(de[i]);
+            g_free(b64[i]);
+        }
+    }
+}
+
 /**
  * Check the calculation of final length from an encoded string in Base64
  */
@@ -271,6 +309,7 @@ main(int argc, char *argv[]) {
 
     g_test_add_func("/fishlim/ecb", test_ecb);
     g_test_add_func("/fishlim/cbc", test_cbc);
+    g_test_add_func("/fishlim/batch", test_batch);
     g_test_add_func("/fishlim/base64_len", test_base64_len);
     g_test_add_func("/fishlim/base64_fish_len", test_base64_fish_len);
     g_test_add_func("/fishlim/base64_ecb_len", test_base64_ecb_len);
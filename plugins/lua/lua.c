@@ -61,11 +61,28 @@ static hexchat_plugin *ph;
 #define luaL_setfuncs(L, r, n) luaL_register(L, NULL, r)
 #endif
 
+typedef struct
+{
+	char **word;	/* NULL once the hook returned */
+	int count;
+}
+word_proxy;
+
 typedef struct
 {
 	hexchat_hook *hook;
 	lua_State *state;
 	int ref;
+	/* what the hook's options table asked for: word tables, or word_proxy
+	   userdata, and attrs passed again on every call. LUA_NOREF for new
+	   ones each time. */
+	int words_ref[2];
+	word_proxy *proxies[2];
+	guint32 wanted;	/* bit i for word[i], none for all of them */
+	int filled[2];
+	int attrs_ref;
+	int depth;	/* calls in progress */
+	int dead;	/* unhooked by its own callback */
 }
 hook_info;
 
@@ -79,6 +96,7 @@ typedef struct
 	lua_State *state;
 	GPtrArray *hooks;
 	GPtrArray *unload_hooks;
+	GPtrArray *jobs;
 	int traceback;
 	int status;
 }
@@ -90,6 +108,33 @@ script_info;
 
 static void check_deferred(script_info *info);
 
+/* a value passed between the states of a script and of its thread jobs */
+typedef struct
+{
+	int type;	/* LUA_TNIL, LUA_TBOOLEAN, LUA_TNUMBER or LUA_TSTRING */
+	lua_Number number;
+#if LUA_VERSION_NUM >= 503
+	lua_Integer integer;
+	int is_integer;	/* numbers keep their subtype */
+#endif
+	char *string;
+	size_t len;
+}
+job_value;
+
+typedef struct
+{
+	script_info *script;	/* NULL once it's unloaded */
+	hexchat_job *job;
+	int id;
+	int ref;	/* the callback */
+	GString *code;
+	job_value arg;
+	job_value result;
+	char *error;
+}
+job_info;
+
 static inline script_info *get_info(lua_State *L)
 {
 	script_info *info;
@@ -244,13 +289,219 @@ static void register_hook(hook_info *hook)
 	g_ptr_array_add(info->hooks, hook);
 }
 
+static void free_hook_data(hook_info *hook)
+{
+	if(hook->state)
+	{
+		luaL_unref(hook->state, LUA_REGISTRYINDEX, hook->words_ref[0]);
+		luaL_unref(hook->state, LUA_REGISTRYINDEX, hook->words_ref[1]);
+		luaL_unref(hook->state, LUA_REGISTRYINDEX, hook->attrs_ref);
+	}
+	g_free(hook);
+}
+
 static void free_hook(hook_info *hook)
 {
 	if(hook->state)
 		luaL_unref(hook->state, LUA_REGISTRYINDEX, hook->ref);
 	if(hook->hook)
 		hexchat_unhook(ph, hook->hook);
-	g_free(hook);
+	if(hook->depth)
+	{
+		/* call_hook() finishes this once the callback returns */
+		hook->hook = NULL;
+		hook->dead = 1;
+		return;
+	}
+	free_hook_data(hook);
+}
+
+/* the callback is referenced already when new_hook() checks the options */
+static int hook_option_error(lua_State *L, int ref, int arg, char const *message)
+{
+	luaL_unref(L, LUA_REGISTRYINDEX, ref);
+	return luaL_argerror(L, arg, message);
+}
+
+/* Takes the options table at arg (0 for none) of a hook passing tables word
+ * tables, and attrs if has_attrs:
+ *   words = {2, 4}  fill in only these words, into the same tables every call
+ *   lazy = true     pass userdata making words into strings when indexed
+ * Any options table makes the word tables be reused, so scripts that keep
+ * them around past the callback have to copy them. */
+static hook_info *new_hook(lua_State *L, int ref, int arg, int tables, int has_attrs)
+{
+	hook_info *info;
+	guint32 wanted = 0;
+	int i, n, lazy = 0;
+
+	if(arg && !lua_isnoneornil(L, arg))
+	{
+		if(!lua_istable(L, arg))
+			hook_option_error(L, ref, arg, "options must be a table");
+		lua_getfield(L, arg, "lazy");
+		lazy = lua_toboolean(L, -1);
+		lua_pop(L, 1);
+
+		lua_getfield(L, arg, "words");
+		if(!lua_isnil(L, -1))
+		{
+			if(!lua_istable(L, -1))
+				hook_option_error(L, ref, arg, "words must be a table");
+			n = lua_rawlen(L, -1);
+			for(i = 1; i <= n; i++)
+			{
+				lua_Integer w;
+				lua_rawgeti(L, -1, i);
+				w = lua_tointeger(L, -1);
+				lua_pop(L, 1);
+				if(w < 1 || w >= WORD_ARRAY_LEN)
+					hook_option_error(L, ref, arg, "words are numbered 1 to 31");
+				wanted |= 1u << w;
+			}
+		}
+		lua_pop(L, 1);
+	}
+	else
+		tables = has_attrs = 0;
+
+	info = g_new0(hook_info, 1);
+	info->state = L;
+	info->ref = ref;
+	info->wanted = wanted;
+	info->words_ref[0] = info->words_ref[1] = info->attrs_ref = LUA_NOREF;
+
+	for(i = 0; i < tables; i++)
+	{
+		if(lazy)
+		{
+			info->proxies[i] = lua_newuserdata(L, sizeof(word_proxy));
+			info->proxies[i]->word = NULL;
+			info->proxies[i]->count = 0;
+			luaL_newmetatable(L, "words");
+			lua_setmetatable(L, -2);
+		}
+		else
+			lua_createtable(L, WORD_ARRAY_LEN - 1, 0);
+		info->words_ref[i] = luaL_ref(L, LUA_REGISTRYINDEX);
+	}
+
+	if(has_attrs)
+	{
+		hexchat_event_attrs **u = lua_newuserdata(L, sizeof(hexchat_event_attrs *));
+		*u = hexchat_event_attrs_create(ph);
+		luaL_newmetatable(L, "attrs");
+		lua_setmetatable(L, -2);
+		info->attrs_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+	}
+
+	return info;
+}
+
+/* pushes word[1] to word[count] as the hook's table-th argument */
+static void push_words(lua_State *L, hook_info *info, int table, char *word[], int count)
+{
+	int i, last;
+
+	/* a hook running again from its own callback gets tables of its own */
+	if(!info->depth && info->proxies[table])
+	{
+		info->proxies[table]->word = word;
+		info->proxies[table]->count = count;
+		lua_rawgeti(L, LUA_REGISTRYINDEX, info->words_ref[table]);
+		return;
+	}
+
+	if(!info->depth && info->words_ref[table] != LUA_NOREF)
+	{
+		lua_rawgeti(L, LUA_REGISTRYINDEX, info->words_ref[table]);
+		last = MAX(count, info->filled[table]);
+		for(i = 1; i <= last; i++)
+		{
+			if(info->wanted && !(info->wanted & (1u << i)))
+				continue;
+			if(i <= count)
+				lua_pushstring(L, word[i]);
+			else
+				lua_pushnil(L);
+			lua_rawseti(L, -2, i);
+		}
+		info->filled[table] = count;
+		return;
+	}
+
+	lua_createtable(L, count, 0);
+	for(i = 1; i <= count; i++)
+	{
+		lua_pushstring(L, word[i]);
+		lua_rawseti(L, -2, i);
+	}
+}
+
+static hexchat_event_attrs *event_attrs_copy(const hexchat_event_attrs *attrs)
+{
+	hexchat_event_attrs *copy = hexchat_event_attrs_create(ph);
+	copy->server_time_utc = attrs->server_time_utc;
+	return copy;
+}
+
+static void push_attrs(lua_State *L, hook_info *info, hexchat_event_attrs *attrs)
+{
+	hexchat_event_attrs **u;
+
+	if(!info->depth && info->attrs_ref != LUA_NOREF)
+	{
+		lua_rawgeti(L, LUA_REGISTRYINDEX, info->attrs_ref);
+		u = lua_touserdata(L, -1);
+		(*u)->server_time_utc = attrs->server_time_utc;
+		return;
+	}
+
+	u = lua_newuserdata(L, sizeof(hexchat_event_attrs *));
+	*u = event_attrs_copy(attrs);
+	luaL_newmetatable(L, "attrs");
+	lua_setmetatable(L, -2);
+}
+
+/* runs the callback with the nargs pushed after it, info is not to be used
+ * afterwards as the callback may have unhooked itself */
+static int call_hook(lua_State *L, hook_info *info, int nargs, int base)
+{
+	int error;
+
+	info->depth++;
+	error = lua_pcall(L, nargs, 1, base);
+	if(--info->depth == 0)
+	{
+		if(info->proxies[0])
+			info->proxies[0]->word = NULL;
+		if(info->proxies[1])
+			info->proxies[1]->word = NULL;
+		if(info->dead)
+			free_hook_data(info);
+	}
+	return error;
+}
+
+static inline int count_words(char *word_eol[])
+{
+	int i;
+
+	for(i = 1; i < WORD_ARRAY_LEN && *word_eol[i]; i++)
+		;
+	return i - 1;
+}
+
+static inline int count_print_words(char *word[])
+{
+	int j;
+
+	for(j = 31; j >= 1; j--)
+	{
+		if(*word[j])
+			break;
+	}
+	return j;
 }
 
 static int unregister_hook(hook_info *hook)
@@ -268,7 +519,7 @@ static int unregister_hook(hook_info *hook)
 
 static int api_command_closure(char *word[], char *word_eol[], void *udata)
 {
-	int base, i, ret;
+	int base, count, ret;
 	hook_info *info = udata;
 	lua_State *L = info->state;
 	script_info *script = get_info(L);
@@ -276,20 +527,11 @@ static int api_command_closure(char *word[], char *word_eol[], void *udata)
 	lua_rawgeti(L, LUA_REGISTRYINDEX, script->traceback);
 	base = lua_gettop(L);
 	lua_rawgeti(L, LUA_REGISTRYINDEX, info->ref);
-	lua_newtable(L);
-	for(i = 1; i < WORD_ARRAY_LEN && *word_eol[i]; i++)
-	{
-		lua_pushstring(L, word[i]);
-		lua_rawseti(L, -2, i);
-	}
-	lua_newtable(L);
-	for(i = 1; i < WORD_ARRAY_LEN && *word_eol[i]; i++)
-	{
-		lua_pushstring(L, word_eol[i]);
-		lua_rawseti(L, -2, i);
-	}
+	count = count_words(word_eol);
+	push_words(L, info, 0, word, count);
+	push_words(L, info, 1, word_eol, count);
 	script->status |= STATUS_ACTIVE;
-	if(lua_pcall(L, 2, 1, base))
+	if(call_hook(L, info, 2, base))
 	{
 		char const *error = lua_tostring(L, -1);
 		lua_pop(L, 2);
@@ -314,9 +556,7 @@ static int api_hexchat_hook_command(lua_State *L)
 	ref = luaL_ref(L, LUA_REGISTRYINDEX);
 	help = luaL_optstring(L, 3, NULL);
 	pri = luaL_optinteger(L, 4, HEXCHAT_PRI_NORM);
-	info = g_new(hook_info, 1);
-	info->state = L;
-	info->ref = ref;
+	info = new_hook(L, ref, 5, 2, 0);
 	info->hook = hexchat_hook_command(ph, command, pri, api_command_closure, help, info);
 	u = lua_newuserdata(L, sizeof(hook_info *));
 	*u = info;
@@ -331,25 +571,14 @@ static int api_print_closure(char *word[], void *udata)
 	hook_info *info = udata;
 	lua_State *L = info->state;
 	script_info *script = get_info(L);
-	int i, j, base, ret;
+	int base, ret;
 
 	lua_rawgeti(L, LUA_REGISTRYINDEX, script->traceback);
 	base = lua_gettop(L);
 	lua_rawgeti(L, LUA_REGISTRYINDEX, info->ref);
-
-	for(j = 31; j >= 1; j--)
-	{
-		if(*word[j])
-			break;
-	}
-	lua_newtable(L);
-	for(i = 1; i <= j; i++)
-	{
-		lua_pushstring(L, word[i]);
-		lua_rawseti(L, -2, i);
-	}
+	push_words(L, info, 0, word, count_print_words(word));
 	script->status |= STATUS_ACTIVE;
-	if(lua_pcall(L, 1, 1, base))
+	if(call_hook(L, info, 1, base))
 	{
 		char const *error = lua_tostring(L, -1);
 		lua_pop(L, 2);
@@ -372,9 +601,7 @@ static int api_hexchat_hook_print(lua_State *L)
 	lua_pushvalue(L, 2);
 	ref = luaL_ref(L, LUA_REGISTRYINDEX);
 	pri = luaL_optinteger(L, 3, HEXCHAT_PRI_NORM);
-	info = g_new(hook_info, 1);
-	info->state = L;
-	info->ref = ref;
+	info = new_hook(L, ref, 4, 1, 0);
 	info->hook = hexchat_hook_print(ph, event, pri, api_print_closure, info);
 	u = lua_newuserdata(L, sizeof(hook_info *));
 	*u = info;
@@ -384,41 +611,20 @@ static int api_hexchat_hook_print(lua_State *L)
 	return 1;
 }
 
-static hexchat_event_attrs *event_attrs_copy(const hexchat_event_attrs *attrs)
-{
-	hexchat_event_attrs *copy = hexchat_event_attrs_create(ph);
-	copy->server_time_utc = attrs->server_time_utc;
-	return copy;
-}
-
 static int api_print_attrs_closure(char *word[], hexchat_event_attrs *attrs, void *udata)
 {
 	hook_info *info = udata;
 	lua_State *L = info->state;
 	script_info *script = get_info(L);
-	int base, i, j, ret;
-	hexchat_event_attrs **u;
+	int base, ret;
 
 	lua_rawgeti(L, LUA_REGISTRYINDEX, script->traceback);
 	base = lua_gettop(L);
 	lua_rawgeti(L, LUA_REGISTRYINDEX, info->ref);
-	for(j = 31; j >= 1; j--)
-	{
-		if(*word[j])
-			break;
-	}
-	lua_newtable(L);
-	for(i = 1; i <= j; i++)
-	{
-		lua_pushstring(L, word[i]);
-		lua_rawseti(L, -2, i);
-	}
-	u = lua_newuserdata(L, sizeof(hexchat_event_attrs *));
-	*u = event_attrs_copy(attrs);
-	luaL_newmetatable(L, "attrs");
-	lua_setmetatable(L, -2);
+	push_words(L, info, 0, word, count_print_words(word));
+	push_attrs(L, info, attrs);
 	script->status |= STATUS_ACTIVE;
-	if(lua_pcall(L, 2, 1, base))
+	if(call_hook(L, info, 2, base))
 	{
 		char const *error = lua_tostring(L, -1);
 		lua_pop(L, 2);
@@ -441,9 +647,7 @@ static int api_hexchat_hook_print_attrs(lua_State *L)
 	lua_pushvalue(L, 2);
 	ref = luaL_ref(L, LUA_REGISTRYINDEX);
 	pri = luaL_optinteger(L, 3, HEXCHAT_PRI_NORM);
-	info = g_new(hook_info, 1);
-	info->state = L;
-	info->ref = ref;
+	info = new_hook(L, ref, 4, 1, 1);
 	info->hook = hexchat_hook_print_attrs(ph, event, pri, api_print_attrs_closure, info);
 	u = lua_newuserdata(L, sizeof(hook_info *));
 	*u = info;
@@ -458,25 +662,16 @@ static int api_server_closure(char *word[], char *word_eol[], void *udata)
 	hook_info *info = udata;
 	lua_State *L = info->state;
 	script_info *script = get_info(L);
-	int base, i, ret;
+	int base, count, ret;
 
 	lua_rawgeti(L, LUA_REGISTRYINDEX, script->traceback);
 	base = lua_gettop(L);
 	lua_rawgeti(L, LUA_REGISTRYINDEX, info->ref);
-	lua_newtable(L);
-	for(i = 1; i < WORD_ARRAY_LEN && *word_eol[i]; i++)
-	{
-		lua_pushstring(L, word[i]);
-		lua_rawseti(L, -2, i);
-	}
-	lua_newtable(L);
-	for(i = 1; i < WORD_ARRAY_LEN && *word_eol[i]; i++)
-	{
-		lua_pushstring(L, word_eol[i]);
-		lua_rawseti(L, -2, i);
-	}
+	count = count_words(word_eol);
+	push_words(L, info, 0, word, count);
+	push_words(L, info, 1, word_eol, count);
 	script->status |= STATUS_ACTIVE;
-	if(lua_pcall(L, 2, 1, base))
+	if(call_hook(L, info, 2, base))
 	{
 		char const *error = lua_tostring(L, -1);
 		lua_pop(L, 2);
@@ -499,9 +694,7 @@ static int api_hexchat_hook_server(lua_State *L)
 	lua_pushvalue(L, 2);
 	ref = luaL_ref(L, LUA_REGISTRYINDEX);
 	pri = luaL_optinteger(L, 3, HEXCHAT_PRI_NORM);
-	info = g_new(hook_info, 1);
-	info->state = L;
-	info->ref = ref;
+	info = new_hook(L, ref, 4, 2, 0);
 	info->hook = hexchat_hook_server(ph, command, pri, api_server_closure, info);
 	u = lua_newuserdata(L, sizeof(hook_info *));
 	*u = info;
@@ -516,31 +709,17 @@ static int api_server_attrs_closure(char *word[], char *word_eol[], hexchat_even
 	hook_info *info = udata;
 	lua_State *L = info->state;
 	script_info *script = get_info(L);
-	int base, i, ret;
-	hexchat_event_attrs **u;
+	int base, count, ret;
 
 	lua_rawgeti(L, LUA_REGISTRYINDEX, script->traceback);
 	base = lua_gettop(L);
 	lua_rawgeti(L, LUA_REGISTRYINDEX, info->ref);
-	lua_newtable(L);
-	for(i = 1; i < WORD_ARRAY_LEN && *word_eol[i]; i++)
-	{
-		lua_pushstring(L, word[i]);
-		lua_rawseti(L, -2, i);
-	}
-	lua_newtable(L);
-	for(i = 1; i < WORD_ARRAY_LEN && *word_eol[i]; i++)
-	{
-		lua_pushstring(L, word_eol[i]);
-		lua_rawseti(L, -2, i);
-	}
-
-	u = lua_newuserdata(L, sizeof(hexchat_event_attrs *));
-	*u = event_attrs_copy(attrs);
-	luaL_newmetatable(L, "attrs");
-	lua_setmetatable(L, -2);
+	count = count_words(word_eol);
+	push_words(L, info, 0, word, count);
+	push_words(L, info, 1, word_eol, count);
+	push_attrs(L, info, attrs);
 	script->status |= STATUS_ACTIVE;
-	if(lua_pcall(L, 3, 1, base))
+	if(call_hook(L, info, 3, base))
 	{
 		char const *error = lua_tostring(L, -1);
 		lua_pop(L, 2);
@@ -563,9 +742,7 @@ static int api_hexchat_hook_server_attrs(lua_State *L)
 	lua_pushvalue(L, 2);
 	ref = luaL_ref(L, LUA_REGISTRYINDEX);
 	pri = luaL_optinteger(L, 3, HEXCHAT_PRI_NORM);
-	info = g_new(hook_info, 1);
-	info->state = L;
-	info->ref = ref;
+	info = new_hook(L, ref, 4, 2, 1);
 	info->hook = hexchat_hook_server_attrs(ph, command, pri, api_server_attrs_closure, info);
 	u = lua_newuserdata(L, sizeof(hook_info *));
 	*u = info;
@@ -607,9 +784,7 @@ static int api_hexchat_hook_timer(lua_State *L)
 
 	lua_pushvalue(L, 2);
 	ref = luaL_ref(L, LUA_REGISTRYINDEX);
-	info = g_new(hook_info, 1);
-	info->state = L;
-	info->ref = ref;
+	info = new_hook(L, ref, 0, 0, 0);
 	info->hook = hexchat_hook_timer(ph, timeout, api_timer_closure, info);
 	u = lua_newuserdata(L, sizeof(hook_info *));
 	*u = info;
@@ -627,10 +802,7 @@ static int api_hexchat_hook_unload(lua_State *L)
 
 	lua_pushvalue(L, 1);
 	ref = luaL_ref(L, LUA_REGISTRYINDEX);
-	info = g_new(hook_info, 1);
-	info->state = L;
-	info->ref = ref;
-	info->hook = NULL;
+	info = new_hook(L, ref, 0, 0, 0);
 	u = lua_newuserdata(L, sizeof(hook_info *));
 	*u = info;
 	luaL_newmetatable(L, "hook");
@@ -761,16 +933,51 @@ static int api_iterate_closure(lua_State *L)
 		return 0;
 }
 
+/* the optional array of field names at arg, NULL terminated, or NULL for all of them */
+static char const **list_fields_arg(lua_State *L, int arg)
+{
+	size_t i, n;
+	char const **fields;
+
+	if(lua_isnoneornil(L, arg))
+		return NULL;
+	luaL_checktype(L, arg, LUA_TTABLE);
+	n = lua_rawlen(L, arg);
+	fields = g_new(char const *, n + 1);
+
+	for(i = 0; i < n; i++)
+	{
+		lua_rawgeti(L, arg, i + 1);
+		if(lua_type(L, -1) != LUA_TSTRING)
+		{
+			g_free(fields);
+			luaL_argerror(L, arg, "expected an array of strings");
+			return NULL;
+		}
+		fields[i] = lua_tostring(L, -1);
+		lua_pop(L, 1);
+	}
+	fields[n] = NULL;
+	return fields;
+}
+
+static void push_list(lua_State *L, hexchat_list *list)
+{
+	hexchat_list **u = lua_newuserdata(L, sizeof(hexchat_list *));
+	*u = list;
+	luaL_newmetatable(L, "list");
+	lua_setmetatable(L, -2);
+}
+
 static int api_hexchat_iterate(lua_State *L)
 {
 	char const *name = luaL_checkstring(L, 1);
-	hexchat_list *list = hexchat_list_get(ph, name);
+	char const **fields = list_fields_arg(L, 2);
+	hexchat_list *list = hexchat_list_cursor(ph, name, fields);
+	g_free(fields);
 	if(list)
 	{
-		hexchat_list **u = lua_newuserdata(L, sizeof(hexchat_list *));
-		*u = list;
-		luaL_newmetatable(L, "list");
-		lua_setmetatable(L, -2);
+		push_list(L, list);
 		lua_pushcclosure(L, api_iterate_closure, 1);
 		return 1;
 	}
@@ -778,6 +985,275 @@ static int api_hexchat_iterate(lua_State *L)
 		return luaL_argerror(L, 1, "invalid list name");
 }
 
+static int job_value_get(lua_State *L, int index, job_value *value)
+{
+	char const *string;
+
+	value->type = lua_type(L, index);
+	switch(value->type)
+	{
+		case LUA_TNIL:
+			return 1;
+		case LUA_TBOOLEAN:
+			value->number = lua_toboolean(L, index);
+			return 1;
+		case LUA_TNUMBER:
+#if LUA_VERSION_NUM >= 503
+			value->is_integer = lua_isinteger(L, index);
+			if(value->is_integer)
+			{
+				value->integer = lua_tointeger(L, index);
+				return 1;
+			}
+#endif
+			value->number = lua_tonumber(L, index);
+			return 1;
+		case LUA_TSTRING:
+			string = lua_tolstring(L, index, &value->len);
+			value->string = g_malloc(value->len);
+			memcpy(value->string, string, value->len);
+			return 1;
+		default:
+			value->type = LUA_TNIL;
+			return 0;
+	}
+}
+
+static void job_value_push(lua_State *L, job_value const *value)
+{
+	switch(value->type)
+	{
+		case LUA_TBOOLEAN:
+			lua_pushboolean(L, (int)value->number);
+			break;
+		case LUA_TNUMBER:
+#if LUA_VERSION_NUM >= 503
+			if(value->is_integer)
+			{
+				lua_pushinteger(L, value->integer);
+				break;
+			}
+#endif
+			lua_pushnumber(L, value->number);
+			break;
+		case LUA_TSTRING:
+			lua_pushlstring(L, value->string, value->len);
+			break;
+		default:
+			lua_pushnil(L);
+	}
+}
+
+static int dump_writer(lua_State *L, void const *p, size_t size, void *code)
+{
+	g_string_append_len(code, p, size);
+	return 0;
+}
+
+static int job_meta_cancelled(lua_State *L)
+{
+	lua_pushboolean(L, hexchat_job_cancelled(ph, lua_touserdata(L, lua_upvalueindex(1))));
+	return 1;
+}
+
+/* runs in a worker thread, in a state of its own */
+static void *lua_job_work(hexchat_job *job, void *udata)
+{
+	job_info *info = udata;
+	lua_State *L = luaL_newstate();
+
+	if(!L)
+	{
+		info->error = g_strdup("could not allocate memory");
+		return NULL;
+	}
+	luaL_openlibs(L);
+	lua_pushlightuserdata(L, job);
+	lua_pushcclosure(L, job_meta_cancelled, 1);
+	lua_setglobal(L, "cancelled");
+
+	if(luaL_loadbuffer(L, info->code->str, info->code->len, "=run_in_thread"))
+		info->error = g_strdup(lua_tostring(L, -1));
+	else
+	{
+		job_value_push(L, &info->arg);
+		if(lua_pcall(L, 1, 1, 0))
+			info->error = g_strdup(lua_tostring(L, -1) ? lua_tostring(L, -1) : "(non-string error)");
+		else if(!job_value_get(L, -1, &info->result))
+			info->error = g_strdup("only nil, booleans, numbers and strings can be returned");
+	}
+	lua_close(L);
+	return NULL;
+}
+
+static void free_job(job_info *info)
+{
+	g_string_free(info->code, TRUE);
+	g_free(info->arg.string);
+	g_free(info->result.string);
+	g_free(info->error);
+	g_free(info);
+}
+
+/* set while hexchat_plugin_deinit drops the jobs the core already stopped */
+static gboolean jobs_stopped = FALSE;
+
+/* the free function of script_info.jobs */
+static void forget_job(job_info *info)
+{
+	if(jobs_stopped)
+	{
+		/* lua_job_done won't come for it */
+		luaL_unref(info->script->state, LUA_REGISTRYINDEX, info->ref);
+		free_job(info);
+		return;
+	}
+	info->script = NULL;
+	hexchat_job_cancel(ph, info->job);
+}
+
+static void drop_jobs(script_info *script)
+{
+	g_ptr_array_set_size(script->jobs, 0);
+}
+
+static void lua_job_done(void *result, void *udata)
+{
+	job_info *info = udata;
+	script_info *script = info->script;
+	lua_State *L;
+	int base, call;
+
+	if(!script)
+	{
+		free_job(info);
+		return;
+	}
+
+	call = !hexchat_job_cancelled(ph, info->job);
+	g_ptr_array_remove_fast(script->jobs, info);
+
+	L = script->state;
+	lua_rawgeti(L, LUA_REGISTRYINDEX, script->traceback);
+	base = lua_gettop(L);
+	lua_rawgeti(L, LUA_REGISTRYINDEX, info->ref);
+	luaL_unref(L, LUA_REGISTRYINDEX, info->ref);
+	if(call && !lua_isnil(L, -1))
+	{
+		job_value_push(L, &info->result);
+		if(info->error)
+			lua_pushstring(L, info->error);
+		else
+			lua_pushnil(L);
+		script->status |= STATUS_ACTIVE;
+		if(lua_pcall(L, 2, 0, base))
+		{
+			char const *error = lua_tostring(L, -1);
+			hexchat_printf(ph, "Lua error in thread job callback: %s", error ? error : "(non-string error)");
+		}
+		lua_settop(L, base - 1);
+		free_job(info);
+		check_deferred(script);
+		return;
+	}
+	if(call && info->error)
+		hexchat_printf(ph, "Lua error in thread job: %s", info->error);
+	lua_settop(L, base - 1);
+	free_job(info);
+}
+
+/* hexchat.run_in_thread(work, arg, callback): work, a function without
+ * upvalues or its source, is called with arg in a state of its own where
+ * only the standard libraries and cancelled() are available. callback gets
+ * what it returned, or nil and the error, back in the current context. */
+static int api_hexchat_run_in_thread(lua_State *L)
+{
+	static int last_id;
+	script_info *script = get_info(L);
+	job_info *info;
+	int ret;
+
+	info = g_new0(job_info, 1);
+	info->code = g_string_new(NULL);
+	if(lua_type(L, 1) == LUA_TSTRING)
+	{
+		size_t len;
+		char const *code = lua_tolstring(L, 1, &len);
+		g_string_append_len(info->code, code, len);
+		ret = 0;
+	}
+	else
+	{
+		luaL_checktype(L, 1, LUA_TFUNCTION);
+		lua_pushvalue(L, 1);
+#if LUA_VERSION_NUM >= 503
+		ret = lua_dump(L, dump_writer, info->code, 0);
+#else
+		ret = lua_dump(L, dump_writer, info->code);
+#endif
+		lua_pop(L, 1);
+	}
+	if(ret || !job_value_get(L, 2, &info->arg))
+	{
+		free_job(info);
+		return luaL_argerror(L, ret ? 1 : 2, ret ? "function can't be dumped" : "expected nil, boolean, number or string");
+	}
+
+	lua_pushvalue(L, 3);
+	info->ref = luaL_ref(L, LUA_REGISTRYINDEX);
+	info->script = script;
+	info->id = ++last_id;
+	info->job = hexchat_job_submit(ph, lua_job_work, lua_job_done, info);
+	if(!info->job)
+	{
+		luaL_unref(L, LUA_REGISTRYINDEX, info->ref);
+		free_job(info);
+		return luaL_error(L, "too many thread jobs pending");
+	}
+	g_ptr_array_add(script->jobs, info);
+
+	lua_pushinteger(L, info->id);
+	return 1;
+}
+
+static int api_hexchat_cancel_job(lua_State *L)
+{
+	script_info *script = get_info(L);
+	int id = luaL_checkinteger(L, 1);
+	guint i;
+
+	for(i = 0; i < script->jobs->len; i++)
+	{
+		job_info *info = script->jobs->pdata[i];
+		if(info->id == id)
+		{
+			hexchat_job_cancel(ph, info->job);
+			lua_pushboolean(L, 1);
+			return 1;
+		}
+	}
+	lua_pushboolean(L, 0);
+	return 1;
+}
+
+static int api_hexchat_find(lua_State *L)
+{
+	char const *name = luaL_checkstring(L, 1);
+	char const *key = luaL_checkstring(L, 2);
+	char const **fields = list_fields_arg(L, 3);
+	hexchat_list *list = hexchat_list_find(ph, name, key, fields);
+	g_free(fields);
+	if(list && hexchat_list_next(ph, list))
+	{
+		push_list(L, list);
+		return 1;
+	}
+	if(list)
+		hexchat_list_free(ph, list);
+	lua_pushnil(L);
+	return 1;
+}
+
 static int api_hexchat_prefs_meta_index(lua_State *L)
 {
 	char const *key = luaL_checkstring(L, 2);
@@ -917,61 +1393,54 @@ static int api_hexchat_pluginprefs_meta_newindex(lua_State *L)
 
 static int api_hexchat_pluginprefs_meta_pairs_closure(lua_State *L)
 {
-	char *dest = lua_touserdata(L, lua_upvalueindex(1));
 	hexchat_plugin *h = get_info(L)->handle;
+	int i = lua_tointeger(L, lua_upvalueindex(2)) + 1;
+	char const *key;
+	int r;
+	char str[512];
 
-	if(dest && *dest)
+	lua_rawgeti(L, lua_upvalueindex(1), i);
+	if(lua_isnil(L, -1))
+		return 0;
+	lua_pushinteger(L, i);
+	lua_replace(L, lua_upvalueindex(2));
+	key = lua_tostring(L, -1);
+	r = hexchat_pluginpref_get_int(h, key);
+	if(r != -1)
 	{
-		int r;
-		char str[512];
-		char *key = dest;
-
-		dest = strchr(dest, ',');
-		if(dest)
-			*(dest++) = 0;
-		lua_pushlightuserdata(L, dest);
-		lua_replace(L, lua_upvalueindex(1));
-		lua_pushstring(L, key);
-		r = hexchat_pluginpref_get_int(h, key);
-		if(r != -1)
-		{
-			lua_pushinteger(L, r);
-			return 2;
-		}
-		if(hexchat_pluginpref_get_str(h, key, str))
-		{
-			lua_pushstring(L, str);
-			return 2;
-		}
-		lua_pushnil(L);
+		lua_pushinteger(L, r);
 		return 2;
 	}
-	else
-		return 0;
+	if(hexchat_pluginpref_get_str(h, key, str))
+	{
+		lua_pushstring(L, str);
+		return 2;
+	}
+	lua_pushnil(L);
+	return 2;
 }
 
 static int api_hexchat_pluginprefs_meta_pairs(lua_State *L)
 {
 	script_info *script = get_info(L);
-	char *dest;
-	hexchat_plugin *h;
+	char **names;
+	int i;
 
 	if(!script->name)
-
 		return luaL_error(L, "cannot use hexchat.pluginprefs before registering with hexchat.register");
 
-	dest = lua_newuserdata(L, 4096);
-
-	h = script->handle;
-	if(!hexchat_pluginpref_list(h, dest))
-		strcpy(dest, "");
-	lua_pushlightuserdata(L, dest);
-	lua_pushlightuserdata(L, dest);
+	/* the names are taken up front, so prefs can be set while iterating */
+	names = hexchat_pluginpref_list_all(script->handle);
+	lua_newtable(L);
+	for(i = 0; names[i]; i++)
+	{
+		lua_pushstring(L, names[i]);
+		lua_rawseti(L, -2, i + 1);
+	}
+	hexchat_free(ph, names);
+	lua_pushinteger(L, 0);
 	lua_pushcclosure(L, api_hexchat_pluginprefs_meta_pairs_closure, 2);
-	lua_insert(L, -2); // Return the userdata (second return value from pairs),
-						// even though it's not used by the closure (first return
-						// value from pairs), so that Lua knows not to GC it.
-	return 2;
+	return 1;
 }
 
 static int api_attrs_meta_index(lua_State *L)
@@ -1010,6 +1479,41 @@ static int api_attrs_meta_gc(lua_State *L)
 	return 0;
 }
 
+static int api_words_meta_index(lua_State *L)
+{
+	word_proxy *proxy = luaL_checkudata(L, 1, "words");
+	lua_Integer i;
+
+	if(!proxy->word)
+		return luaL_error(L, "lazy word list used after its hook returned");
+	if(lua_type(L, 2) != LUA_TNUMBER)
+	{
+		lua_pushnil(L);
+		return 1;
+	}
+	i = lua_tointeger(L, 2);
+	if(i >= 1 && i <= proxy->count)
+		lua_pushstring(L, proxy->word[i]);
+	else
+		lua_pushnil(L);
+	return 1;
+}
+
+static int api_words_meta_newindex(lua_State *L)
+{
+	return luaL_error(L, "lazy word list is read-only");
+}
+
+static int api_words_meta_len(lua_State *L)
+{
+	word_proxy *proxy = luaL_checkudata(L, 1, "words");
+
+	if(!proxy->word)
+		return luaL_error(L, "lazy word list used after its hook returned");
+	lua_pushinteger(L, proxy->count);
+	return 1;
+}
+
 static int api_list_meta_index(lua_State *L)
 {
 	hexchat_list *list = *(hexchat_list **)luaL_checkudata(L, 1, "list");
@@ -1052,6 +1556,9 @@ static luaL_Reg api_hexchat[] = {
 	{"set_context", api_hexchat_set_context},
 	{"attrs", api_hexchat_attrs},
 	{"iterate", api_hexchat_iterate},
+	{"find", api_hexchat_find},
+	{"run_in_thread", api_hexchat_run_in_thread},
+	{"cancel_job", api_hexchat_cancel_job},
 	{NULL, NULL}
 };
 
@@ -1079,6 +1586,13 @@ static luaL_Reg api_hook_meta_index[] = {
 	{NULL, NULL}
 };
 
+static luaL_Reg api_words_meta[] = {
+	{"__index", api_words_meta_index},
+	{"__newindex", api_words_meta_newindex},
+	{"__len", api_words_meta_len},
+	{NULL, NULL}
+};
+
 static luaL_Reg api_attrs_meta[] = {
 	{"__index", api_attrs_meta_index},
 	{"__newindex", api_attrs_meta_newindex},
@@ -1144,6 +1658,7 @@ static int luaopen_hexchat(lua_State *L)
 	wrap_context(L, "nickcmp", api_hexchat_nickcmp);
 	wrap_context(L, "get_info", api_hexchat_get_info);
 	wrap_context(L, "iterate", api_hexchat_iterate);
+	wrap_context(L, "find", api_hexchat_find);
 	lua_setfield(L, -2, "__index");
 	lua_pushcfunction(L, api_hexchat_context_meta_eq);
 	lua_setfield(L, -2, "__eq");
@@ -1158,6 +1673,10 @@ static int luaopen_hexchat(lua_State *L)
 	luaL_setfuncs(L, api_list_meta, 0);
 	lua_pop(L, 1);
 
+	luaL_newmetatable(L, "words");
+	luaL_setfuncs(L, api_words_meta, 0);
+	lua_pop(L, 1);
+
 	return 1;
 }
 
@@ -1304,6 +1823,7 @@ static void destroy_script(script_info *info)
 	{
 		g_clear_pointer(&info->hooks, g_ptr_array_unref);
 		g_clear_pointer(&info->unload_hooks, g_ptr_array_unref);
+		g_clear_pointer(&info->jobs, g_ptr_array_unref);
 		g_clear_pointer(&info->state, lua_close);
 		if (info->handle)
 			hexchat_plugingui_remove(ph, info->handle);
@@ -1323,6 +1843,7 @@ static script_info *create_script(char const *file)
 	script_info *info = g_new0(script_info, 1);
 	info->hooks = g_ptr_array_new_with_free_func((GDestroyNotify)free_hook);
 	info->unload_hooks = g_ptr_array_new_with_free_func((GDestroyNotify)free_hook);
+	info->jobs = g_ptr_array_new_with_free_func((GDestroyNotify)forget_job);
 	info->filename = g_strdup(expand_path(file));
 	L = luaL_newstate();
 	info->state = L;
@@ -1470,6 +1991,7 @@ static void create_interpreter(void)
 	interp = g_new0(script_info, 1);
 	interp->hooks = g_ptr_array_new_with_free_func((GDestroyNotify)free_hook);
 	interp->unload_hooks = g_ptr_array_new_with_free_func((GDestroyNotify)free_hook);
+	interp->jobs = g_ptr_array_new_with_free_func((GDestroyNotify)forget_job);
 	interp->name = "lua interpreter";
 	interp->description = "";
 	interp->version = "";
@@ -1493,6 +2015,7 @@ static void destroy_interpreter(void)
 	{
 		g_clear_pointer(&interp->hooks, g_ptr_array_unref);
 		g_clear_pointer(&interp->unload_hooks, g_ptr_array_unref);
+		g_clear_pointer(&interp->jobs, g_ptr_array_unref);
 		g_clear_pointer(&interp->state, lua_close);
 		g_clear_pointer(&interp, g_free);
 	}
@@ -1746,6 +2269,14 @@ G_MODULE_EXPORT int hexchat_plugin_deinit(hexchat_plugin *plugin_handle)
 {
 	guint i;
 	gboolean active = FALSE;
+
+	/* the core cancelled our jobs before calling this, even if we refuse */
+	jobs_stopped = TRUE;
+	g_ptr_array_foreach(scripts, (GFunc)drop_jobs, NULL);
+	if(interp)
+		drop_jobs(interp);
+	jobs_stopped = FALSE;
+
 	for(i = 0; i < scripts->len; i++)
 	{
 		if(((script_info*)scripts->pdata[i])->status & STATUS_ACTIVE)
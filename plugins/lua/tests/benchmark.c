@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2026 BirdChat contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+ * associated documentation files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT
+ * LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* Sends a line through Lua hooks that only look at one word, once for each
+ * way a hook can get its words: new tables every call (what every hook used
+ * to cost), reused tables, reused tables with only that word and lazily. */
+
+/* the hook bridge is all static */
+#include "../lua.c"
+
+#include <unistd.h>
+#include <glib/gstdio.h>
+
+#include "mock-hexchat.h"
+
+#define EVENTS 200000
+
+static char const script_source[] =
+	"hexchat.register('benchmark', '1', 'hook bridge benchmark')\n"
+	"local function hook(word, word_eol) local _ = word[2] return hexchat.EAT_NONE end\n"
+	"hexchat.hook_server('RAW LINE', hook)\n"
+	"hexchat.hook_server('RAW LINE', hook, hexchat.PRI_NORM, {})\n"
+	"hexchat.hook_server('RAW LINE', hook, hexchat.PRI_NORM, {words = {2}})\n"
+	"hexchat.hook_server('RAW LINE', hook, hexchat.PRI_NORM, {lazy = true})\n"
+	"hexchat.hook_print('Channel Message', hook)\n"
+	"hexchat.hook_print('Channel Message', hook, hexchat.PRI_NORM, {})\n"
+	"hexchat.hook_print('Channel Message', hook, hexchat.PRI_NORM, {words = {2}})\n"
+	"hexchat.hook_print('Channel Message', hook, hexchat.PRI_NORM, {lazy = true})\n";
+
+static char const *const modes[] = { "new tables", "reused tables", "one word", "lazy" };
+
+static char line[] = ":nick!user@example.com PRIVMSG #channel :just a line of chat, as long as most of them are";
+static char *word[WORD_ARRAY_LEN];
+static char *word_eol[WORD_ARRAY_LEN];
+
+static void split_line(void)
+{
+	static char words[sizeof line];
+	char *p = line, *w = words;
+	int i;
+
+	for(i = 0; i < WORD_ARRAY_LEN; i++)
+		word[i] = word_eol[i] = "";
+
+	for(i = 1; i < WORD_ARRAY_LEN && *p; i++)
+	{
+		word_eol[i] = p;
+		word[i] = w;
+		while(*p && *p != ' ')
+			*w++ = *p++;
+		*w++ = 0;
+		while(*p == ' ')
+			p++;
+	}
+}
+
+static void run(mock_hook *hook, char const *mode)
+{
+	GTimer *timer = g_timer_new();
+	int i;
+
+	for(i = 0; i < EVENTS; i++)
+	{
+		if(hook->server)
+			hook->server(word, word_eol, hook->userdata);
+		else
+			hook->print(word, hook->userdata);
+	}
+	g_timer_stop(timer);
+
+	g_print("%-16s %-14s %10.0f events/s\n", hook->name, mode, EVENTS / g_timer_elapsed(timer, NULL));
+	g_timer_destroy(timer);
+}
+
+int main(int argc, char *argv[])
+{
+	script_info *script;
+	GError *error = NULL;
+	char *filename;
+	int fd, i;
+
+	fd = g_file_open_tmp("hexchat-lua-benchmark-XXXXXX.lua", &filename, &error);
+	g_assert_no_error(error);
+	close(fd);
+	g_file_set_contents(filename, script_source, -1, &error);
+	g_assert_no_error(error);
+
+	scripts = g_ptr_array_new_with_free_func((GDestroyNotify)destroy_script);
+	script = create_script(filename);
+	g_assert_nonnull(script);
+	g_ptr_array_add(scripts, script);
+
+	split_line();
+	g_assert_cmpint(mock_hook_count, ==, 8);
+	for(i = 0; i < mock_hook_count; i++)
+		run(&mock_hooks[i], modes[i % 4]);
+
+	g_ptr_array_unref(scripts);
+	g_unlink(filename);
+	g_free(filename);
+	return 0;
+}
@@ -0,0 +1,284 @@
+/*
+ * Copyright (c) 2026 BirdChat contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+ * associated documentation files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT
+ * LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* Just enough of the plugin API for the Lua plugin to run scripts outside
+ * of HexChat. Hooks are only recorded, for the benchmark to call. */
+
+#include <stdarg.h>
+#include <stdio.h>
+
+#include <glib.h>
+
+#include <hexchat-plugin.h>
+
+#include "mock-hexchat.h"
+
+mock_hook mock_hooks[MOCK_HOOKS_MAX];
+int mock_hook_count;
+
+static hexchat_hook *add_hook(char const *name, void *server, void *print, void *userdata)
+{
+	mock_hook *hook;
+
+	g_assert(mock_hook_count < MOCK_HOOKS_MAX);
+	hook = &mock_hooks[mock_hook_count++];
+	hook->name = name;
+	hook->server = server;
+	hook->print = print;
+	hook->userdata = userdata;
+	return (hexchat_hook *)hook;
+}
+
+hexchat_hook *hexchat_hook_command(hexchat_plugin *ph, const char *name, int pri,
+	int (*callback) (char *word[], char *word_eol[], void *user_data), const char *help_text, void *userdata)
+{
+	return add_hook(name, callback, NULL, userdata);
+}
+
+hexchat_hook *hexchat_hook_server(hexchat_plugin *ph, const char *name, int pri,
+	int (*callback) (char *word[], char *word_eol[], void *user_data), void *userdata)
+{
+	return add_hook(name, callback, NULL, userdata);
+}
+
+hexchat_hook *hexchat_hook_server_attrs(hexchat_plugin *ph, const char *name, int pri,
+	int (*callback) (char *word[], char *word_eol[], hexchat_event_attrs *attrs, void *user_data), void *userdata)
+{
+	return add_hook(name, NULL, NULL, userdata);
+}
+
+hexchat_hook *hexchat_hook_print(hexchat_plugin *ph, const char *name, int pri,
+	int (*callback) (char *word[], void *user_data), void *userdata)
+{
+	return add_hook(name, NULL, callback, userdata);
+}
+
+hexchat_hook *hexchat_hook_print_attrs(hexchat_plugin *ph, const char *name, int pri,
+	int (*callback) (char *word[], hexchat_event_attrs *attrs, void *user_data), void *userdata)
+{
+	return add_hook(name, NULL, NULL, userdata);
+}
+
+hexchat_hook *hexchat_hook_timer(hexchat_plugin *ph, int timeout, int (*callback) (void *user_data), void *userdata)
+{
+	return add_hook("timer", NULL, NULL, userdata);
+}
+
+void *hexchat_unhook(hexchat_plugin *ph, hexchat_hook *hook)
+{
+	((mock_hook *)hook)->userdata = NULL;
+	return NULL;
+}
+
+hexchat_event_attrs *hexchat_event_attrs_create(hexchat_plugin *ph)
+{
+	return g_new0(hexchat_event_attrs, 1);
+}
+
+void hexchat_event_attrs_free(hexchat_plugin *ph, hexchat_event_attrs *attrs)
+{
+	g_free(attrs);
+}
+
+void hexchat_print(hexchat_plugin *ph, const char *text)
+{
+	puts(text);
+}
+
+void hexchat_printf(hexchat_plugin *ph, const char *format, ...)
+{
+	va_list args;
+
+	va_start(args, format);
+	vprintf(format, args);
+	va_end(args);
+	putchar('\n');
+}
+
+void hexchat_command(hexchat_plugin *ph, const char *command)
+{
+}
+
+void hexchat_commandf(hexchat_plugin *ph, const char *format, ...)
+{
+}
+
+int hexchat_nickcmp(hexchat_plugin *ph, const char *s1, const char *s2)
+{
+	return g_ascii_strcasecmp(s1, s2);
+}
+
+int hexchat_set_context(hexchat_plugin *ph, hexchat_context *ctx)
+{
+	return 1;
+}
+
+hexchat_context *hexchat_find_context(hexchat_plugin *ph, const char *servname, const char *channel)
+{
+	return NULL;
+}
+
+hexchat_context *hexchat_get_context(hexchat_plugin *ph)
+{
+	return NULL;
+}
+
+const char *hexchat_get_info(hexchat_plugin *ph, const char *id)
+{
+	return NULL;
+}
+
+int hexchat_get_prefs(hexchat_plugin *ph, const char *name, const char **string, int *integer)
+{
+	return 0;
+}
+
+hexchat_list *hexchat_list_cursor(hexchat_plugin *ph, const char *name, const char * const *fields)
+{
+	return NULL;
+}
+
+hexchat_list *hexchat_list_find(hexchat_plugin *ph, const char *name, const char *key, const char * const *fields)
+{
+	return NULL;
+}
+
+void hexchat_list_free(hexchat_plugin *ph, hexchat_list *xlist)
+{
+}
+
+int hexchat_list_next(hexchat_plugin *ph, hexchat_list *xlist)
+{
+	return 0;
+}
+
+const char *hexchat_list_str(hexchat_plugin *ph, hexchat_list *xlist, const char *name)
+{
+	return NULL;
+}
+
+int hexchat_list_int(hexchat_plugin *ph, hexchat_list *xlist, const char *name)
+{
+	return -1;
+}
+
+time_t hexchat_list_time(hexchat_plugin *ph, hexchat_list *xlist, const char *name)
+{
+	return -1;
+}
+
+void *hexchat_plugingui_add(hexchat_plugin *ph, const char *filename, const char *name,
+	const char *desc, const char *version, char *reserved)
+{
+	return NULL;
+}
+
+void hexchat_plugingui_remove(hexchat_plugin *ph, void *handle)
+{
+}
+
+int hexchat_emit_print(hexchat_plugin *ph, const char *event_name, ...)
+{
+	return 1;
+}
+
+int hexchat_emit_print_attrs(hexchat_plugin *ph, hexchat_event_attrs *attrs, const char *event_name, ...)
+{
+	return 1;
+}
+
+void hexchat_send_modes(hexchat_plugin *ph, const char **targets, int ntargets, int modes_per_line,
+	char sign, char mode)
+{
+}
+
+char *hexchat_strip(hexchat_plugin *ph, const char *str, int len, int flags)
+{
+	return g_strndup(str, len);
+}
+
+void hexchat_free(hexchat_plugin *ph, void *ptr)
+{
+	g_free(ptr);
+}
+
+int hexchat_pluginpref_set_str(hexchat_plugin *ph, const char *var, const char *value)
+{
+	return 0;
+}
+
+int hexchat_pluginpref_get_str(hexchat_plugin *ph, const char *var, char *dest)
+{
+	return 0;
+}
+
+int hexchat_pluginpref_set_int(hexchat_plugin *ph, const char *var, int value)
+{
+	return 0;
+}
+
+int hexchat_pluginpref_get_int(hexchat_plugin *ph, const char *var)
+{
+	return -1;
+}
+
+int hexchat_pluginpref_delete(hexchat_plugin *ph, const char *var)
+{
+	return 0;
+}
+
+int hexchat_pluginpref_list(hexchat_plugin *ph, char *dest)
+{
+	return 0;
+}
+
+int hexchat_pluginpref_get_many(hexchat_plugin *ph, const char * const *vars, char **values, int count)
+{
+	int i;
+
+	for(i = 0; i < count; i++)
+		values[i] = NULL;
+	return 0;
+}
+
+int hexchat_pluginpref_set_many(hexchat_plugin *ph, const char * const *vars, const char * const *values, int count)
+{
+	return 0;
+}
+
+char **hexchat_pluginpref_list_all(hexchat_plugin *ph)
+{
+	return g_new0(char *, 1);
+}
+
+hexchat_job *hexchat_job_submit(hexchat_plugin *ph, void *(*work) (hexchat_job *job, void *user_data),
+	void (*done) (void *result, void *user_data), void *userdata)
+{
+	return NULL;
+}
+
+void hexchat_job_cancel(hexchat_plugin *ph, hexchat_job *job)
+{
+}
+
+int hexchat_job_cancelled(hexchat_plugin *ph, hexchat_job *job)
+{
+	return 0;
+}
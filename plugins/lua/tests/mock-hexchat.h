@@ -0,0 +1,39 @@
+/*
+ * Copyright (c) 2026 BirdChat contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+ * associated documentation files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT
+ * LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef HEXCHAT_LUA_MOCK_HEXCHAT_H
+#define HEXCHAT_LUA_MOCK_HEXCHAT_H
+
+#define MOCK_HOOKS_MAX 16
+
+/* a server, command or print hook a script added */
+typedef struct
+{
+	char const *name;
+	int (*server)(char *word[], char *word_eol[], void *userdata);
+	int (*print)(char *word[], void *userdata);
+	void *userdata;	/* NULL once unhooked */
+}
+mock_hook;
+
+extern mock_hook mock_hooks[MOCK_HOOKS_MAX];
+extern int mock_hook_count;
+
+#endif
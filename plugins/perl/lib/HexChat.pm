@@ -69,6 +69,7 @@ our %EXPORT_TAGS = (
 	],
 	util => [
 		qw(register nickcmp strip_code send_modes), # misc
+		qw(run_in_thread cancel_job), # threads
 		qw(print prnt printf prntf command commandf emit_print), # output
 		qw(find_context get_context set_context), # context
 		qw(get_info get_prefs get_list context_info user_info), # input
@@ -284,6 +285,27 @@ sub hook_timer {
 	return $hook;
 }
 
+# the code runs in an interpreter of its own, with $arg in $ARGV[0]
+sub run_in_thread {
+	return undef unless @_ >= 1;
+	my ($code, $arg, $callback, $data) = @_;
+	my ($package, $calling_package) = HexChat::Embed::find_pkg();
+
+	$callback = HexChat::Embed::fix_callback(
+		$package, $calling_package, $callback
+	) if defined $callback;
+
+	return HexChat::Internal::run_in_thread(
+		$code, $arg, $callback, $data, $package
+	);
+}
+
+sub cancel_job {
+	my $job = shift @_;
+	return undef unless defined $job;
+	return HexChat::Internal::cancel_job( $job );
+}
+
 sub hook_fd {
 	return undef unless @_ >= 2;
 	my ($fd, $callback, $options) = @_;
@@ -487,14 +509,7 @@ sub get_info {
 
 sub user_info {
 	my $nick = HexChat::strip_code(shift @_ || HexChat::get_info( "nick" ));
-	my $user;
-	for (HexChat::get_list( "users" ) ) {
-		if ( HexChat::nickcmp( $_->{nick}, $nick ) == 0 ) {
-			$user = $_;
-			last;
-		}
-	}
-	return $user;
+	return HexChat::Internal::find( "users", $nick );
 }
 
 sub context_info {
@@ -167,6 +167,8 @@ sub unload {
 			}
 		}
 
+		HexChat::Internal::cancel_jobs( $package );
+
 		if( exists $pkg_info->{gui_entry} ) {
 			plugingui_remove( $pkg_info->{gui_entry} );
 		}
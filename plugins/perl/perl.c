@@ -1081,6 +1081,202 @@ XS (XS_HexChat_unhook)
 	XSRETURN_EMPTY;
 }
 
+typedef struct
+{
+	SV *callback;
+	SV *userdata;
+	SV *package;
+	hexchat_context *ctx;
+	hexchat_job *job;
+	char *code;   /* the worker gets copies, SVs belong to my_perl */
+	char *arg;
+	char *result;
+	char *error;
+} JobData;
+
+static GSList *jobs = NULL;
+
+static void
+free_job (JobData *data)
+{
+	jobs = g_slist_remove (jobs, data);
+	SvREFCNT_dec (data->callback);
+	SvREFCNT_dec (data->userdata);
+	SvREFCNT_dec (data->package);
+	g_free (data->code);
+	g_free (data->arg);
+	g_free (data->result);
+	g_free (data->error);
+	g_free (data);
+}
+
+#ifdef MULTIPLICITY
+static void
+job_xs_init (pTHX)
+{
+	newXS ("DynaLoader::boot_DynaLoader", boot_DynaLoader, __FILE__);
+}
+
+/* runs in a pool thread, in an interpreter of its own: the code gets the
+   argument in $ARGV[0] and whatever it evaluates to is passed back as a
+   string */
+static void *
+job_work (hexchat_job *job, void *userdata)
+{
+	JobData *data = userdata;
+	PerlInterpreter *my_perl;
+	char *args[] = { "", "-e", "0" };
+	SV *result;
+
+	my_perl = perl_alloc ();
+	PERL_SET_CONTEXT (my_perl);
+	perl_construct (my_perl);
+	PL_exit_flags |= PERL_EXIT_DESTRUCT_END;
+	perl_parse (my_perl, job_xs_init, 3, args, (char **)NULL);
+	perl_run (my_perl);
+
+	if (data->arg) {
+		av_push (get_av ("ARGV", 1), newSVpv (data->arg, 0));
+	}
+
+	result = eval_pv (data->code, FALSE);
+	if (SvTRUE (ERRSV)) {
+		data->error = g_strdup (SvPV_nolen (ERRSV));
+	} else if (SvOK (result)) {
+		data->result = g_strdup (SvPV_nolen (result));
+	}
+
+	PL_perl_destruct_level = 1;
+	perl_destruct (my_perl);
+	perl_free (my_perl);
+	return NULL;
+}
+#endif
+
+static void
+job_done (void *result, void *userdata)
+{
+	JobData *data = userdata;
+	int cancelled = hexchat_job_cancelled (ph, data->job);
+
+	if (data->error) {
+		hexchat_printf (ph, "Error in thread %s", data->error);
+	} else if (!cancelled && SvOK (data->callback)) {
+		dSP;
+		ENTER;
+		SAVETMPS;
+
+		PUSHMARK (SP);
+		if (data->result) {
+			SV *temp = newSVpv (data->result, 0);
+			SvUTF8_on (temp);
+			XPUSHs (sv_2mortal (temp));
+		} else {
+			XPUSHs (&PL_sv_undef);
+		}
+		XPUSHs (data->userdata);
+		PUTBACK;
+
+		hexchat_set_context (ph, data->ctx);
+		set_current_package (data->package);
+		call_sv (data->callback, G_EVAL | G_DISCARD);
+		set_current_package (&PL_sv_undef);
+		SPAGAIN;
+
+		if (SvTRUE (ERRSV)) {
+			hexchat_printf (ph, "Error in thread callback %s", SvPV_nolen (ERRSV));
+		}
+
+		PUTBACK;
+		FREETMPS;
+		LEAVE;
+	}
+
+	free_job (data);
+}
+
+/* HexChat::Internal::run_in_thread(code, arg, callback, userdata, package) */
+static
+XS (XS_HexChat_run_in_thread)
+{
+	JobData *data;
+
+	dXSARGS;
+
+	if (items != 5) {
+		hexchat_print (ph,
+						 "Usage: HexChat::Internal::run_in_thread(code, arg, callback, userdata, package)");
+		XSRETURN_UNDEF;
+	}
+#ifdef MULTIPLICITY
+	data = g_new0 (JobData, 1);
+	data->code = g_strdup (SvPV_nolen (ST (0)));
+	data->arg = SvOK (ST (1)) ? g_strdup (SvPV_nolen (ST (1))) : NULL;
+	data->callback = newSVsv (ST (2));
+	data->userdata = newSVsv (ST (3));
+	data->package = newSVsv (ST (4));
+	data->ctx = hexchat_get_context (ph);
+	data->job = hexchat_job_submit (ph, job_work, job_done, data);
+
+	if (data->job == NULL) {
+		free_job (data);
+		XSRETURN_UNDEF;
+	}
+
+	jobs = g_slist_prepend (jobs, data);
+	XSRETURN_IV (PTR2IV (data->job));
+#else
+	(void) data;
+	hexchat_print (ph, "run_in_thread needs a Perl built with threads");
+	XSRETURN_UNDEF;
+#endif
+}
+
+/* HexChat::Internal::cancel_job(job) */
+static
+XS (XS_HexChat_cancel_job)
+{
+	GSList *list;
+	JobData *data;
+
+	dXSARGS;
+
+	if (items != 1) {
+		hexchat_print (ph, "Usage: HexChat::Internal::cancel_job(job)");
+	} else {
+		for (list = jobs; list; list = list->next) {
+			data = list->data;
+			if (PTR2IV (data->job) == SvIV (ST (0))) {
+				hexchat_job_cancel (ph, data->job);
+				XSRETURN_YES;
+			}
+		}
+	}
+	XSRETURN_NO;
+}
+
+/* HexChat::Internal::cancel_jobs(package), when a script is unloaded */
+static
+XS (XS_HexChat_cancel_jobs)
+{
+	GSList *list;
+	JobData *data;
+
+	dXSARGS;
+
+	if (items != 1) {
+		hexchat_print (ph, "Usage: HexChat::Internal::cancel_jobs(package)");
+	} else {
+		for (list = jobs; list; list = list->next) {
+			data = list->data;
+			if (sv_eq (data->package, ST (0))) {
+				hexchat_job_cancel (ph, data->job);
+			}
+		}
+	}
+	XSRETURN_EMPTY;
+}
+
 /* HexChat::Internal::command(command) */
 static
 XS (XS_HexChat_command)
@@ -1206,13 +1402,15 @@ XS (XS_HexChat_get_list)
 
 		name = ST (0);
 
-		list = hexchat_list_get (ph, SvPV_nolen (name));
+		if (GIMME_V == G_SCALAR) {
+			/* reading no fields spares working out the selected users */
+			static const char *const no_fields[] = { NULL };
 
-		if (list == NULL) {
-			XSRETURN_EMPTY;
-		}
+			list = hexchat_list_cursor (ph, SvPV_nolen (name), no_fields);
+			if (list == NULL) {
+				XSRETURN_EMPTY;
+			}
 
-		if (GIMME_V == G_SCALAR) {
 			while (hexchat_list_next (ph, list)) {
 				count++;
 			}
@@ -1220,6 +1418,11 @@ XS (XS_HexChat_get_list)
 			XSRETURN_IV ((IV) count);
 		}
 
+		list = hexchat_list_get (ph, SvPV_nolen (name));
+		if (list == NULL) {
+			XSRETURN_EMPTY;
+		}
+
 		fields = hexchat_list_fields (ph, SvPV_nolen (name));
 		while (hexchat_list_next (ph, list)) {
 			XPUSHs (list_item_to_sv (list, fields));
@@ -1231,6 +1434,35 @@ XS (XS_HexChat_get_list)
 	}
 }
 
+/* the entry of a list that key names, without going through the list */
+static
+XS (XS_HexChat_find)
+{
+	char *name;
+	hexchat_list *list;
+	SV *item = &PL_sv_undef;
+	dXSARGS;
+
+	if (items != 2) {
+		hexchat_print (ph, "Usage: HexChat::Internal::find(name, key)");
+	} else {
+		name = SvPV_nolen (ST (0));
+
+		list = hexchat_list_find (ph, name, SvPV_nolen (ST (1)), NULL);
+		if (list == NULL) {
+			XSRETURN_UNDEF;
+		}
+
+		if (hexchat_list_next (ph, list)) {
+			item = list_item_to_sv (list, hexchat_list_fields (ph, name));
+		}
+		hexchat_list_free (ph, list);
+
+		ST (0) = item;
+		XSRETURN (1);
+	}
+}
+
 static
 XS (XS_HexChat_Embed_plugingui_remove)
 {
@@ -1284,30 +1516,39 @@ XS (XS_HexChat_plugin_pref_delete)
 static
 XS (XS_HexChat_plugin_pref_list)
 {
-	char list[4096];
-	char value[512];
-	char *token;
+	char **names;
+	char **values;
+	int count;
+	int i;
 
 	dSP;
 	dMARK;
 	dAX;
 
-	if (!hexchat_pluginpref_list (ph, list))
+	names = hexchat_pluginpref_list_all (ph);
+	for (count = 0; names[count]; count++)
+		;
+
+	if (count == 0) {
+		hexchat_free (ph, names);
 		XSRETURN_EMPTY;
+	}
+
+	values = g_new (char *, count);
+	hexchat_pluginpref_get_many (ph, (const char * const *) names, values, count);
 
 	PUSHMARK (SP);
 
-	token = strtok (list, ",");
-	while (token != NULL)
+	for (i = 0; i < count; i++)
 	{
-		hexchat_pluginpref_get_str (ph, token, value);
-
-		XPUSHs (sv_2mortal (newSVpv (token, 0)));
-		XPUSHs (sv_2mortal (newSVpv (value, 0)));
-
-		token = strtok (NULL, ",");
+		XPUSHs (sv_2mortal (newSVpv (names[i], 0)));
+		XPUSHs (sv_2mortal (newSVpv (values[i] ? values[i] : "", 0)));
+		hexchat_free (ph, values[i]);
 	}
 
+	g_free (values);
+	hexchat_free (ph, names);
+
 	PUTBACK;
 }
 
@@ -1329,12 +1570,16 @@ xs_init (pTHX)
 	newXS ("HexChat::Internal::hook_timer", XS_HexChat_hook_timer, __FILE__);
 	newXS ("HexChat::Internal::hook_fd", XS_HexChat_hook_fd, __FILE__);
 	newXS ("HexChat::Internal::unhook", XS_HexChat_unhook, __FILE__);
+	newXS ("HexChat::Internal::run_in_thread", XS_HexChat_run_in_thread, __FILE__);
+	newXS ("HexChat::Internal::cancel_job", XS_HexChat_cancel_job, __FILE__);
+	newXS ("HexChat::Internal::cancel_jobs", XS_HexChat_cancel_jobs, __FILE__);
 	newXS ("HexChat::Internal::print", XS_HexChat_print, __FILE__);
 	newXS ("HexChat::Internal::command", XS_HexChat_command, __FILE__);
 	newXS ("HexChat::Internal::set_context", XS_HexChat_set_context, __FILE__);
 	newXS ("HexChat::Internal::get_info", XS_HexChat_get_info, __FILE__);
 	newXS ("HexChat::Internal::context_info", XS_HexChat_context_info, __FILE__);
 	newXS ("HexChat::Internal::get_list", XS_HexChat_get_list, __FILE__);
+	newXS ("HexChat::Internal::find", XS_HexChat_find, __FILE__);
 
 	newXS ("HexChat::Internal::plugin_pref_set", XS_HexChat_plugin_pref_set, __FILE__);
 	newXS ("HexChat::Internal::plugin_pref_get", XS_HexChat_plugin_pref_get, __FILE__);
@@ -1495,6 +1740,9 @@ perl_end (void)
 
 	if (my_perl != NULL) {
 		execute_perl (sv_2mortal (newSVpv ("HexChat::Embed::unload_all", 0)), "");
+		/* the core stopped these before deinit, done won't come for them */
+		while (jobs)
+			free_job (jobs->data);
 		PL_perl_destruct_level = 1;
 		perl_destruct (my_perl);
 		perl_free (my_perl);
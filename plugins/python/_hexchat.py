@@ -7,12 +7,12 @@ from _hexchat_embedded import ffi, lib
 __all__ = [
     'EAT_ALL', 'EAT_HEXCHAT', 'EAT_NONE', 'EAT_PLUGIN', 'EAT_XCHAT',
     'PRI_HIGH', 'PRI_HIGHEST', 'PRI_LOW', 'PRI_LOWEST', 'PRI_NORM',
-    '__doc__', '__version__', 'command', 'del_pluginpref', 'emit_print',
-    'find_context', 'get_context', 'get_info',
-    'get_list', 'get_lists', 'get_pluginpref', 'get_prefs', 'hook_command',
-    'hook_print', 'hook_print_attrs', 'hook_server', 'hook_server_attrs',
-    'hook_timer', 'hook_unload', 'list_pluginpref', 'nickcmp', 'prnt',
-    'set_pluginpref', 'strip', 'unhook',
+    '__doc__', '__version__', 'cancel_job', 'command', 'del_pluginpref', 'emit_print',
+    'find_channel', 'find_context', 'find_user', 'get_context', 'get_info',
+    'get_list', 'get_lists', 'get_pluginpref', 'get_pluginprefs', 'get_prefs',
+    'hook_command', 'hook_print', 'hook_print_attrs', 'hook_server', 'hook_server_attrs',
+    'hook_timer', 'hook_unload', 'iter_list', 'list_pluginpref', 'nickcmp', 'prnt',
+    'run_in_thread', 'set_pluginpref', 'set_pluginprefs', 'strip', 'unhook',
 ]
 
 __doc__ = 'HexChat Scripting Interface'
@@ -168,56 +168,164 @@ else:
         return name[0]
 
 
-def get_list(name):
-    # XXX: This function is extremely inefficient and could be interators and
-    # lazily loaded properties, but for API compat we stay slow
-    orig_name = name
-    name = name.encode()
+__typed_fields = (ord('s'), ord('i'), ord('t'), ord('p'))
+
 
+def __cursor_fields(name, fields):
+    """Returns the NULL terminated field names to open a cursor on list name
+    with (all of its fields if None) and a (name, type) pair for each."""
     if name not in __get_fields(b'lists'):
         raise KeyError('list not available')
 
-    list_ = lib.hexchat_list_get(lib.ph, name)
+    typed_fields = [field for field in __get_fields(name) if get_getter(field) in __typed_fields]
+    if fields is not None:
+        by_name = dict((field[1:], field) for field in typed_fields)
+        try:
+            typed_fields = [by_name[field.encode()] for field in fields]
+        except KeyError as e:
+            raise KeyError('no such field {}'.format(e))
+
+    names = [ffi.new('char[]', field[1:]) for field in typed_fields]
+    return (ffi.new('char*[]', names + [ffi.NULL]), names,
+            [(__cached_decoded_str(field[1:]), get_getter(field)) for field in typed_fields])
+
+
+def __open_cursor(name, fields=None):
+    """Returns a hexchat_list reading only the given fields of the list name
+    (all of them if None) and a (name, type) pair for each of those."""
+    c_fields, _, fields = __cursor_fields(name.encode(), fields)
+    return lib.hexchat_list_cursor(lib.ph, name.encode(), c_fields), fields
+
+
+def __field_reader(list_, fields):
+    """Returns a function reading field n of the current entry of list_"""
+
+    def read(n):
+        kind = fields[n][1]
+        if kind == ord('s'):
+            string = lib.hexchat_list_str_at(lib.ph, list_, n)
+            if string != ffi.NULL:
+                return __decode(ffi.string(string))
+
+            return ''
+
+        if kind == ord('i'):
+            return lib.hexchat_list_int_at(lib.ph, list_, n)
+
+        if kind == ord('t'):
+            return lib.hexchat_list_time_at(lib.ph, list_, n)
+
+        # the only pointer is a channel's context
+        ptr = lib.hexchat_list_str_at(lib.ph, list_, n)
+        return Context(ffi.cast('hexchat_context*', ptr))
+
+    return read
+
+
+def __read_item(listname, list_, fields):
+    item = ListItem(listname)
+    read = __field_reader(list_, fields)
+    for n, (field, _) in enumerate(fields):
+        setattr(item, field, read(n))
+
+    return item
+
+
+def get_list(name):
+    list_, fields = __open_cursor(name)
     if list_ == ffi.NULL:
         return None
 
     ret = []
-    fields = __get_fields(name)
+    while lib.hexchat_list_next(lib.ph, list_) == 1:
+        ret.append(__read_item(name, list_, fields))
 
-    def string_getter(field):
-        string = lib.hexchat_list_str(lib.ph, list_, field)
-        if string != ffi.NULL:
-            return __decode(ffi.string(string))
+    lib.hexchat_list_free(lib.ph, list_)
+    return ret
 
-        return ''
 
-    def ptr_getter(field):
-        if field == b'context':
-            ptr = lib.hexchat_list_str(lib.ph, list_, field)
-            ctx = ffi.cast('hexchat_context*', ptr)
-            return Context(ctx)
+class ListRow(object):
+    """An entry of a list being gone through with iter_list(). Its fields are
+    only read when asked for, which has to be before the next entry."""
 
-        return None
+    __slots__ = ('_listname', '_read', '_state', '_row', '_fields', '_values')
 
-    getters = {
-        ord('s'): string_getter,
-        ord('i'): lambda field: lib.hexchat_list_int(lib.ph, list_, field),
-        ord('t'): lambda field: lib.hexchat_list_time(lib.ph, list_, field),
-        ord('p'): ptr_getter,
-    }
+    def __init__(self, listname, read, state, fields):
+        self._listname = listname
+        self._read = read
+        self._state = state
+        self._row = state[0]
+        self._fields = fields
+        self._values = {}
+
+    def __getattr__(self, attr):
+        try:
+            return self._values[attr]
+        except KeyError:
+            pass
+
+        n = self._fields.get(attr)
+        if n is None:
+            raise AttributeError(attr)
+
+        if self._state[0] != self._row:
+            raise RuntimeError('{} list item is no longer current'.format(self._listname))
+
+        value = self._values[attr] = self._read(n)
+        return value
+
+    def __repr__(self):
+        return '<{} list row at {}>'.format(self._listname, id(self))
+
+
+def __iter_cursor(listname, list_, fields):
+    read = __field_reader(list_, fields)
+    state = [0]
+    field_index = dict((field, n) for n, (field, _) in enumerate(fields))
+
+    try:
+        while lib.hexchat_list_next(lib.ph, list_) == 1:
+            state[0] += 1
+            yield ListRow(listname, read, state, field_index)
+    finally:
+        state[0] = -1
+        lib.hexchat_list_free(lib.ph, list_)
 
-    while lib.hexchat_list_next(lib.ph, list_) == 1:
-        item = ListItem(orig_name)
-        for _field in fields:
-            getter = getters.get(get_getter(_field))
-            if getter is not None:
-                field_name = _field[1:]
-                setattr(item, __cached_decoded_str(field_name), getter(field_name))
 
-        ret.append(item)
+def iter_list(name, fields=None):
+    """Goes through the list name without copying it. Only the fields named,
+    or all of them by default, can be read from the rows. The users are
+    those in the channel when it started, less any who left since; a row
+    has to be read before returning to HexChat, which may free it."""
+    list_, fields = __open_cursor(name, fields)
+    if list_ == ffi.NULL:
+        return iter(())
+
+    return __iter_cursor(name, list_, fields)
+
+
+def __find(name, key):
+    c_fields, _, fields = __cursor_fields(name.encode(), None)
+    list_ = lib.hexchat_list_find(lib.ph, name.encode(), key.encode(), c_fields)
+    if list_ == ffi.NULL:
+        return None
+
+    item = None
+    if lib.hexchat_list_next(lib.ph, list_) == 1:
+        item = __read_item(name, list_, fields)
 
     lib.hexchat_list_free(lib.ph, list_)
-    return ret
+    return item
+
+
+def find_user(nick):
+    """The users list item of nick in the current channel, or None"""
+    return __find('users', nick)
+
+
+def find_channel(name):
+    """The channels list item of name on the current server, or None"""
+    return __find('channels', name)
 
 
 # TODO: 'command' here shadows command above, and should be renamed to cmd
@@ -282,6 +390,26 @@ def unhook(handle):
     return plugin.remove_hook(handle)
 
 
+def run_in_thread(work, callback=None, userdata=None):
+    """Calls work(userdata) in a worker thread, then callback(result, userdata)
+    back in the current context. work must not use this module."""
+    plugin = __get_current_plugin()
+    job = plugin.add_job(work, callback, userdata)
+    handle = lib.hexchat_job_submit(lib.ph, lib._on_job_work, lib._on_job_done, job.handle)
+    if handle == ffi.NULL:
+        plugin.remove_job(job)
+        raise RuntimeError('too many jobs pending')
+
+    job.hexchat_job = handle
+    return id(job)
+
+
+def cancel_job(handle):
+    """Keeps the callback of a run_in_thread() job from being called"""
+    plugin = __get_current_plugin()
+    return plugin.cancel_job(handle)
+
+
 def set_pluginpref(name, value):
     if isinstance(value, str):
         return bool(lib.hexchat_pluginpref_set_str(lib.ph, name.encode(), value.encode()))
@@ -312,16 +440,53 @@ def get_pluginpref(name):
     return number
 
 
+def get_pluginprefs(names):
+    """Returns a dict of the given prefs that exist, looked up at once"""
+    names = list(names)
+    c_names = [ffi.new('char[]', name.encode()) for name in names]
+    values = ffi.new('char *[]', len(names))
+    lib.hexchat_pluginpref_get_many(lib.ph, c_names, values, len(names))
+
+    prefs = {}
+    for name, value in zip(names, values):
+        if value != ffi.NULL:
+            string = ffi.string(value)
+            if len(string) <= 12 and string.lstrip(b'-').isdigit():
+                prefs[name] = int(string)
+            else:
+                prefs[name] = __decode(string)
+            lib.hexchat_free(lib.ph, value)
+
+    return prefs
+
+
+def set_pluginprefs(prefs):
+    """Sets every pref of a dict at once, None deletes one"""
+    c_names = []
+    c_values = []
+    for name, value in prefs.items():
+        if value is not None and not isinstance(value, (str, int)):
+            raise TypeError('pluginpref values must be str, int or None')
+        c_names.append(ffi.new('char[]', name.encode()))
+        c_values.append(ffi.NULL if value is None else ffi.new('char[]', str(value).encode()))
+
+    return bool(lib.hexchat_pluginpref_set_many(lib.ph, c_names, c_values, len(c_names)))
+
+
 def del_pluginpref(name):
     return bool(lib.hexchat_pluginpref_delete(lib.ph, name.encode()))
 
 
 def list_pluginpref():
-    prefs_str = ffi.new('char[4096]')
-    if lib.hexchat_pluginpref_list(lib.ph, prefs_str) == 1:
-        return __decode(ffi.string(prefs_str)).split(',')
+    names = lib.hexchat_pluginpref_list_all(lib.ph)
+    prefs = []
+    i = 0
+    while names[i] != ffi.NULL:
+        prefs.append(__decode(ffi.string(names[i])))
+        i += 1
 
-    return []
+    lib.hexchat_free(lib.ph, names)
+    return prefs
 
 
 class Context:
@@ -370,6 +535,19 @@ class Context:
         with self.__change_context():
             return get_list(name)
 
+    def iter_list(self, name, fields=None):
+        # the cursor keeps the context it was opened in
+        with self.__change_context():
+            return iter_list(name, fields)
+
+    def find_user(self, nick):
+        with self.__change_context():
+            return find_user(nick)
+
+    def find_channel(self, name):
+        with self.__change_context():
+            return find_channel(name)
+
 
 def get_context():
     ctx = lib.hexchat_get_context(lib.ph)
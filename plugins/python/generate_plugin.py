@@ -40,6 +40,8 @@ extern "Python" int _on_print_attrs_hook(char **, hexchat_event_attrs *, void *)
 extern "Python" int _on_server_hook(char **, char **, void *);
 extern "Python" int _on_server_attrs_hook(char **, char **, hexchat_event_attrs *, void *);
 extern "Python" int _on_timer_hook(void *);
+extern "Python" void *_on_job_work(hexchat_job *, void *);
+extern "Python" void _on_job_done(void *, void *);
 
 extern "Python" int _on_plugin_init(char **, char **, char **, char *, char *);
 extern "Python" int _on_plugin_deinit(void);
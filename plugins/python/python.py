@@ -29,6 +29,7 @@ hexchat = None
 local_interp = None
 hexchat_stdout = None
 plugins = set()
+pending_jobs = set()  # kept until their done callback, even if their plugin is gone
 
 
 @contextmanager
@@ -96,6 +97,22 @@ class Hook:
             lib.hexchat_unhook(lib.ph, self.hexchat_hook)
 
 
+class Job:
+    def __init__(self, plugin, work, callback, userdata):
+        self.plugin = weakref.proxy(plugin)
+        self.work = work
+        self.callback = callback
+        self.userdata = userdata
+        self.hexchat_job = None
+        self.result = None
+        self.error = None
+        self.handle = ffi.new_handle(self)
+
+    def cancel(self):
+        if self.hexchat_job is not None:
+            lib.hexchat_job_cancel(lib.ph, self.hexchat_job)
+
+
 if sys.version_info[0] == 2:
     def compile_file(data, filename):
         return compile(data, filename, 'exec', dont_inherit=True)
@@ -127,6 +144,7 @@ class Plugin:
         self.version = ''
         self.description = ''
         self.hooks = set()
+        self.jobs = set()
         self.globals = {
             '__plugin': weakref.proxy(self),
             '__name__': '__main__',
@@ -147,6 +165,24 @@ class Plugin:
         log('Hook not found')
         return None
 
+    def add_job(self, work, callback, userdata):
+        job = Job(self, work, callback, userdata)
+        self.jobs.add(job)
+        pending_jobs.add(job)
+        return job
+
+    def remove_job(self, job):
+        self.jobs.discard(job)
+        pending_jobs.discard(job)
+
+    def cancel_job(self, handle):
+        for job in self.jobs:
+            if id(job) == handle:
+                job.cancel()
+                return True
+
+        return False
+
     def loadfile(self, filename):
         try:
             self.filename = filename
@@ -187,6 +223,9 @@ class Plugin:
                     traceback.print_exc()
 
         del self.hooks
+        for job in self.jobs:
+            job.cancel()
+
         if self.ph is not None:
             lib.hexchat_plugingui_remove(lib.ph, self.ph)
 
@@ -308,6 +347,43 @@ def _on_timer_hook(userdata):
     return 0
 
 
+# Runs in a worker thread
+@ffi.def_extern()
+def _on_job_work(hexchat_job, userdata):
+    job = ffi.from_handle(userdata)
+    if lib.hexchat_job_cancelled(lib.ph, hexchat_job):
+        return ffi.NULL
+
+    try:
+        job.result = job.work(job.userdata)
+
+    except Exception:
+        job.error = traceback.format_exc()
+
+    return ffi.NULL
+
+
+@ffi.def_extern()
+def _on_job_done(result, userdata):
+    job = ffi.from_handle(userdata)
+    pending_jobs.discard(job)
+    try:
+        job.plugin.jobs.discard(job)
+
+    except ReferenceError:
+        # its plugin was unloaded
+        return
+
+    if lib.hexchat_job_cancelled(lib.ph, job.hexchat_job):
+        return
+
+    if job.error is not None:
+        print(job.error, end='')
+
+    elif job.callback is not None:
+        job.callback(job.result, job.userdata)
+
+
 @ffi.def_extern(error=3)
 def _on_say_command(word, word_eol, userdata):
     channel = ffi.string(lib.hexchat_get_info(lib.ph, b'channel'))
@@ -548,6 +624,9 @@ def _on_plugin_deinit():
     global hexchat_stdout
     global plugins
 
+    for job in pending_jobs:
+        job.cancel()
+
     plugins = set()
     local_interp = None
     hexchat = None
@@ -29,6 +29,7 @@
 #include "fe.h"
 #include "text.h"
 #include "hexchatc.h"
+#include "server.h"
 #include "typedef.h"
 
 #ifdef WIN32
@@ -174,46 +175,6 @@ list_delentry (GSList ** list, char *name)
 	return 0;
 }
 
-char *
-cfg_get_str (char *cfg, const char *var, char *dest, int dest_len)
-{
-	char buffer[128];	/* should be plenty for a variable name */
-
-	sprintf (buffer, "%s ", var);	/* add one space, this way it works against var - var2 checks too */
-
-	while (1)
-	{
-		if (!g_ascii_strncasecmp (buffer, cfg, strlen (var) + 1))
-		{
-			char *value, t;
-			cfg += strlen (var);
-			while (*cfg == ' ')
-				cfg++;
-			if (*cfg == '=')
-				cfg++;
-			while (*cfg == ' ')
-				cfg++;
-			/*while (*cfg == ' ' || *cfg == '=')
-			   cfg++; */
-			value = cfg;
-			while (*cfg != 0 && *cfg != '\n')
-				cfg++;
-			t = *cfg;
-			*cfg = 0;
-			safe_strcpy (dest, value, dest_len);
-			*cfg = t;
-			return cfg;
-		}
-		while (*cfg != 0 && *cfg != '\n')
-			cfg++;
-		if (*cfg == 0)
-			return NULL;
-		cfg++;
-		if (*cfg == 0)
-			return NULL;
-	}
-}
-
 static int
 cfg_put_str (int fh, char *var, char *value)
 {
@@ -250,44 +211,6 @@ cfg_put_int (int fh, int value, char *var)
 	return (write (fh, buf, len) == len);
 }
 
-int
-cfg_get_color (char *cfg, char *var, guint16 *r, guint16 *g, guint16 *b)
-{
-	char str[128];
-
-	if (!cfg_get_str (cfg, var, str, sizeof (str)))
-		return 0;
-
-	sscanf (str, "%04hx %04hx %04hx", r, g, b);
-	return 1;
-}
-
-int
-cfg_get_int_with_result (char *cfg, char *var, int *result)
-{
-	char str[128];
-
-	if (!cfg_get_str (cfg, var, str, sizeof (str)))
-	{
-		*result = 0;
-		return 0;
-	}
-
-	*result = 1;
-	return atoi (str);
-}
-
-int
-cfg_get_int (char *cfg, char *var)
-{
-	char str[128];
-
-	if (!cfg_get_str (cfg, var, str, sizeof (str)))
-		return 0;
-
-	return atoi (str);
-}
-
 char *xdir = NULL;	/* utf-8 encoding */
 
 #ifdef WIN32
@@ -371,6 +294,7 @@ const struct prefs vars[] =
 	{"dcc_auto_recv", P_OFFINT (hex_dcc_auto_recv), TYPE_INT},
 	{"dcc_auto_resume", P_OFFINT (hex_dcc_auto_resume), TYPE_BOOL},
 	{"dcc_blocksize", P_OFFINT (hex_dcc_blocksize), TYPE_INT},
+	{"dcc_checksum", P_OFFINT (hex_dcc_checksum), TYPE_BOOL},
 	{"dcc_completed_dir", P_OFFSET (hex_dcc_completed_dir), TYPE_STR},
 	{"dcc_dir", P_OFFSET (hex_dcc_dir), TYPE_STR},
 #ifndef WIN32
@@ -382,6 +306,12 @@ const struct prefs vars[] =
 	{"dcc_ip_from_server", P_OFFINT (hex_dcc_ip_from_server), TYPE_BOOL},
 	{"dcc_max_get_cps", P_OFFINT (hex_dcc_max_get_cps), TYPE_INT},
 	{"dcc_max_send_cps", P_OFFINT (hex_dcc_max_send_cps), TYPE_INT},
+	{"dcc_max_sends", P_OFFINT (hex_dcc_max_sends), TYPE_INT},
+	{"dcc_multi_source", P_OFFINT (hex_dcc_multi_source), TYPE_BOOL},
+	{"dcc_network_max_get_cps", P_OFFINT (hex_dcc_network_max_get_cps), TYPE_INT},
+	{"dcc_network_max_send_cps", P_OFFINT (hex_dcc_network_max_send_cps), TYPE_INT},
+	{"dcc_peer_max_get_cps", P_OFFINT (hex_dcc_peer_max_get_cps), TYPE_INT},
+	{"dcc_peer_max_send_cps", P_OFFINT (hex_dcc_peer_max_send_cps), TYPE_INT},
 	{"dcc_permissions", P_OFFINT (hex_dcc_permissions), TYPE_INT},
 	{"dcc_port_first", P_OFFINT (hex_dcc_port_first), TYPE_INT},
 	{"dcc_port_last", P_OFFINT (hex_dcc_port_last), TYPE_INT},
@@ -510,7 +440,9 @@ const struct prefs vars[] =
 	{"irc_invisible", P_OFFINT (hex_irc_invisible), TYPE_BOOL},
 	{"irc_join_delay", P_OFFINT (hex_irc_join_delay), TYPE_INT},
 	{"irc_logging", P_OFFINT (hex_irc_logging), TYPE_BOOL},
-	{"irc_logmask", P_OFFSET (hex_irc_logmask), TYPE_STR},
+	{"irc_logging_compress", P_OFFINT (hex_irc_logging_compress), TYPE_BOOL},
+	{"irc_logging_fsync", P_OFFINT (hex_irc_logging_fsync), TYPE_INT},
+	{"irc_logmask", P_OFFSET (hex_irc_logmask), TYPE_STR, log_update_mask},
 	{"irc_nick1", P_OFFSET (hex_irc_nick1), TYPE_STR},
 	{"irc_nick2", P_OFFSET (hex_irc_nick2), TYPE_STR},
 	{"irc_nick3", P_OFFSET (hex_irc_nick3), TYPE_STR},
@@ -542,6 +474,7 @@ const struct prefs vars[] =
 	{"net_proxy_use", P_OFFINT (hex_net_proxy_use), TYPE_INT},
 	{"net_proxy_user", P_OFFSET (hex_net_proxy_user), TYPE_STR},
 	{"net_reconnect_delay", P_OFFINT (hex_net_reconnect_delay), TYPE_INT},
+	{"net_ssl_session_save", P_OFFINT (hex_net_ssl_session_save), TYPE_BOOL, server_ssl_session_file_update},
 	{"net_throttle", P_OFFINT (hex_net_throttle), TYPE_BOOL},
 
 	{"notify_timeout", P_OFFINT (hex_notify_timeout), TYPE_INT},
@@ -745,6 +678,7 @@ load_default_config(void)
 #ifndef WIN32
 	prefs.hex_dcc_fast_send = 1;
 #endif
+	prefs.hex_dcc_multi_source = 1;
 	prefs.hex_gui_autoopen_chat = 1;
 	prefs.hex_gui_autoopen_dialog = 1;
 	prefs.hex_gui_autoopen_recv = 1;
@@ -957,13 +891,16 @@ make_dcc_dirs (void)
 int
 load_config (void)
 {
-	char *cfg, *sp;
+	cfg_index *cfg;
+	char *data, *sp;
+	const char *value;
 	int res, val, i;
 
 	g_assert(check_config_dir () == 0);
 
-	if (!g_file_get_contents (default_file (), &cfg, NULL, NULL))
+	if (!g_file_get_contents (default_file (), &data, NULL, NULL))
 		return -1;
+	cfg = cfg_index_new (data);
 
 	/* If the config is incomplete we have the default values loaded */
 	load_default_config();
@@ -974,12 +911,13 @@ load_config (void)
 		switch (vars[i].type)
 		{
 		case TYPE_STR:
-			cfg_get_str (cfg, vars[i].name, (char *) &prefs + vars[i].offset,
-				     vars[i].len);
+			value = cfg_index_get (cfg, vars[i].name);
+			if (value)
+				safe_strcpy ((char *) &prefs + vars[i].offset, value, vars[i].len);
 			break;
 		case TYPE_BOOL:
 		case TYPE_INT:
-			val = cfg_get_int_with_result (cfg, vars[i].name, &res);
+			val = cfg_index_get_int (cfg, vars[i].name, &res);
 			if (res)
 				*((int *) &prefs + vars[i].offset) = val;
 			break;
@@ -988,7 +926,7 @@ load_config (void)
 	}
 	while (vars[i].name);
 
-	g_free (cfg);
+	cfg_index_free (cfg);
 
 	if (prefs.hex_gui_win_height < 138)
 		prefs.hex_gui_win_height = 138;
@@ -23,18 +23,15 @@
 #define HEXCHAT_CFGFILES_H
 
 #include "hexchat.h"
+#include "cfgindex.h"
 
 #define LANGUAGES_LENGTH 53
 
 extern char *xdir;
 extern const char * const languages[LANGUAGES_LENGTH];
 
-char *cfg_get_str (char *cfg, const char *var, char *dest, int dest_len);
 int cfg_get_bool (char *var);
-int cfg_get_int_with_result (char *cfg, char *var, int *result);
-int cfg_get_int (char *cfg, char *var);
 int cfg_put_int (int fh, int value, char *var);
-int cfg_get_color (char *cfg, char *var, guint16 *r, guint16 *g, guint16 *b);
 int cfg_put_color (int fh, guint16 r, guint16 g, guint16 b, char *var);
 char *get_xdir (void);
 int check_config_dir (void);
@@ -0,0 +1,152 @@
+/* HexChat
+ * Copyright (C) 1998-2010 Peter Zelezny.
+ * Copyright (C) 2009-2013 Berke Viktor.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/* Loaders used to call cfg_get_str () once per setting, and each call
+   scanned the whole file again from the top. cfg_index splits the file
+   into lines once and hashes their names, so loading is linear in the
+   size of the file. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "cfgindex.h"
+
+static guint
+cfg_name_hash (gconstpointer key)
+{
+	const char *p = key;
+	guint h = 5381;
+
+	for (; *p; p++)
+		h = (h << 5) + h + g_ascii_tolower (*p);
+	return h;
+}
+
+static gboolean
+cfg_name_equal (gconstpointer a, gconstpointer b)
+{
+	return g_ascii_strcasecmp (a, b) == 0;
+}
+
+/* "name = value" or "name value"; the name is what is before the '=', or
+   the first space if there is none, and the value starts after the
+   spaces following either */
+static gboolean
+cfg_split_line (char *line, cfg_entry *entry)
+{
+	char *p, *end;
+
+	while (*line == ' ' || *line == '\t')
+		line++;
+
+	p = strchr (line, '=');
+	if (!p)
+		p = strchr (line, ' ');
+	if (!p || p == line)
+		return FALSE;
+
+	end = p;
+	while (end > line && end[-1] == ' ')
+		end--;
+	if (*p == '=')
+		p++;
+	*end = 0;
+
+	while (*p == ' ')
+		p++;
+
+	entry->name = line;
+	entry->value = p;
+	return *line != 0;
+}
+
+cfg_index *
+cfg_index_new (char *data)
+{
+	cfg_index *cfg;
+	char *line, *next;
+	int lines = 1;
+
+	for (line = data; (line = strchr (line, '\n')); line++)
+		lines++;
+
+	cfg = g_new (cfg_index, 1);
+	cfg->data = data;
+	cfg->entries = g_new (cfg_entry, lines);
+	cfg->count = 0;
+	cfg->index = g_hash_table_new (cfg_name_hash, cfg_name_equal);
+
+	for (line = data; line; line = next)
+	{
+		next = strchr (line, '\n');
+		if (next)
+			*next++ = 0;
+
+		if (cfg_split_line (line, &cfg->entries[cfg->count]))
+		{
+			cfg_entry *entry = &cfg->entries[cfg->count++];
+
+			/* the first one wins, like it did when the file was scanned */
+			if (!g_hash_table_lookup (cfg->index, entry->name))
+				g_hash_table_insert (cfg->index, (char *) entry->name, (char *) entry->value);
+		}
+	}
+
+	return cfg;
+}
+
+void
+cfg_index_free (cfg_index *cfg)
+{
+	if (!cfg)
+		return;
+
+	g_hash_table_destroy (cfg->index);
+	g_free (cfg->entries);
+	g_free (cfg->data);
+	g_free (cfg);
+}
+
+const char *
+cfg_index_get (cfg_index *cfg, const char *name)
+{
+	return g_hash_table_lookup (cfg->index, name);
+}
+
+int
+cfg_index_get_int (cfg_index *cfg, const char *name, int *result)
+{
+	const char *value = cfg_index_get (cfg, name);
+
+	*result = value != NULL;
+	return value ? atoi (value) : 0;
+}
+
+int
+cfg_index_get_color (cfg_index *cfg, const char *name, guint16 *r, guint16 *g, guint16 *b)
+{
+	const char *value = cfg_index_get (cfg, name);
+
+	if (!value)
+		return 0;
+
+	sscanf (value, "%04hx %04hx %04hx", r, g, b);
+	return 1;
+}
@@ -0,0 +1,53 @@
+/* HexChat
+ * Copyright (C) 1998-2010 Peter Zelezny.
+ * Copyright (C) 2009-2013 Berke Viktor.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#ifndef HEXCHAT_CFGINDEX_H
+#define HEXCHAT_CFGINDEX_H
+
+#include <glib.h>
+
+/* A config file read in one pass. Every "name = value" line becomes an
+   entry, in file order, and the first value of each name can be looked up
+   by name, ignoring ASCII case. */
+
+typedef struct
+{
+	const char *name;
+	const char *value;
+} cfg_entry;
+
+typedef struct
+{
+	char *data;				/* the file, cut up into the entries */
+	cfg_entry *entries;
+	int count;
+	GHashTable *index;	/* name -> first value */
+} cfg_index;
+
+/* takes data, which must be NUL terminated and is changed in place */
+cfg_index *cfg_index_new (char *data);
+void cfg_index_free (cfg_index *cfg);
+
+/* NULL if the name is not set */
+const char *cfg_index_get (cfg_index *cfg, const char *name);
+/* the value as a number, and *result TRUE if set */
+int cfg_index_get_int (cfg_index *cfg, const char *name, int *result);
+int cfg_index_get_color (cfg_index *cfg, const char *name, guint16 *r, guint16 *g, guint16 *b);
+
+#endif
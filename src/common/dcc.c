@@ -57,6 +57,11 @@
 #include "text.h"
 #include "url.h"
 #include "hexchatc.h"
+#include "dccio.h"
+#include "dccsched.h"
+#include "dcchash.h"
+#include "dccgroup.h"
+#include "timerwheel.h"
 
 /* Setting _FILE_OFFSET_BITS to 64 doesn't change lseek to use off64_t on Windows, so override lseek to the version that does */
 #if defined(WIN32) && (!defined(__MINGW32__) && !defined(__MINGW64__))
@@ -77,14 +82,10 @@ struct dccstat_info dccstat[] = {
 	{N_("Aborted"), 4 /*red */ },
 };
 
-static int dcc_global_throttle;	/* 0x1 = sends, 0x2 = gets */
-static gint64 dcc_sendcpssum, dcc_getcpssum;
-
 static struct DCC *new_dcc (void);
 static void dcc_close (struct DCC *dcc, enum dcc_state dccstat, int destroy);
-static gboolean dcc_send_data (GIOChannel *, GIOCondition, struct DCC *);
-static gboolean dcc_read (GIOChannel *, GIOCondition, struct DCC *);
-static gboolean dcc_read_ack (GIOChannel *source, GIOCondition condition, struct DCC *dcc);
+static void dcc_start_send (struct DCC *dcc);
+static gboolean dcc_send_offer (struct DCC *dcc, session *sess, int passive);
 static int dcc_check_timeouts (void);
 
 static int new_id(void)
@@ -100,119 +101,69 @@ static int new_id(void)
 	return id++;
 }
 
-static double
-timeval_diff (GTimeVal *greater,
-				 GTimeVal *less)
-{
-	long usecdiff;
-	double result;
-	
-	result = greater->tv_sec - less->tv_sec;
-	usecdiff = (long) greater->tv_usec - less->tv_usec;
-	result += (double) usecdiff / 1000000;
-	
-	return result;
-}
-
+/* takes the speeds from the scheduler's stats */
 static void
-dcc_unthrottle (struct DCC *dcc)
+dcc_update_stats (void)
 {
-	/* don't unthrottle here, but delegate to funcs */
-	if (dcc->type == TYPE_RECV)
-		dcc_read (NULL, 0, dcc);
-	else
-		dcc_send_data (NULL, 0, dcc);
-}
+	struct dcc_sched_stats *stats;
+	GArray *array;
+	guint i;
 
-static void
-dcc_calc_cps (struct DCC *dcc)
-{
-	GTimeVal now;
-	gint64 oldcps;
-	double timediff, startdiff;
-	int glob_throttle_bit, wasthrottled;
-	gint64 *cpssum;
-	int glob_limit;
-	goffset pos, posdiff;
-
-	g_get_current_time (&now);
-
-	/* the pos we use for sends is an average
-		between pos and ack */
-	if (dcc->type == TYPE_SEND)
+	array = dcc_sched_snapshot ();
+	for (i = 0; i < array->len; i++)
 	{
-		/* carefull to avoid 32bit overflow */
-		pos = dcc->pos - ((dcc->pos - dcc->ack) / 2);
-		glob_throttle_bit = 0x1;
-		cpssum = &dcc_sendcpssum;
-		glob_limit = prefs.hex_dcc_global_max_send_cps;
+		stats = &g_array_index (array, struct dcc_sched_stats, i);
+		stats->dcc->cps = stats->cps;
+		stats->dcc->throttled = stats->throttled;
 	}
-	else
-	{
-		pos = dcc->pos;
-		glob_throttle_bit = 0x2;
-		cpssum = &dcc_getcpssum;
-		glob_limit = prefs.hex_dcc_global_max_get_cps;
-	}
-
-	if (!dcc->firstcpstv.tv_sec && !dcc->firstcpstv.tv_usec)
-		dcc->firstcpstv = now;
-	else
-	{
-		startdiff = timeval_diff (&now, &dcc->firstcpstv);
-		if (startdiff < 1)
-			startdiff = 1;
-		else if (startdiff > CPS_AVG_WINDOW)
-			startdiff = CPS_AVG_WINDOW;
-
-		timediff = timeval_diff (&now, &dcc->lastcpstv);
-		if (timediff > startdiff)
-			timediff = startdiff = 1;
-
-		posdiff = pos - dcc->lastcpspos;
-		oldcps = dcc->cps;
-		dcc->cps = (gint64) ((posdiff / timediff) * (timediff / startdiff) + dcc->cps * (1.0 - (timediff / startdiff)));
-
-		*cpssum += dcc->cps - oldcps;
-	}
-
-	dcc->lastcpspos = pos;
-	dcc->lastcpstv = now;
+	g_array_free (array, TRUE);
+}
 
-	/* now check cps against set limits... */
-	wasthrottled = dcc->throttled;
+/* sends that were offered or are running, held ones don't count */
+static int
+dcc_count_sends (struct DCC *except)
+{
+	struct DCC *dcc;
+	GSList *list;
+	int count = 0;
 
-	/* check global limits first */
-	dcc->throttled &= ~0x2;
-	if (glob_limit > 0 && *cpssum >= glob_limit)
+	for (list = dcc_list; list; list = list->next)
 	{
-		dcc_global_throttle |= glob_throttle_bit;
-		if (dcc->maxcps >= 0)
-			dcc->throttled |= 0x2;
+		dcc = list->data;
+		if (dcc != except && dcc->type == TYPE_SEND && !dcc->held &&
+			 (dcc->dccstat == STAT_QUEUED || dcc->dccstat == STAT_CONNECTING ||
+			  dcc->dccstat == STAT_ACTIVE))
+			count++;
 	}
-	else
-		dcc_global_throttle &= ~glob_throttle_bit;
-
-	/* now check per-connection limit */
-	if (dcc->maxcps > 0 && dcc->cps > dcc->maxcps)
-		dcc->throttled |= 0x1;
-	else
-		dcc->throttled &= ~0x1;
-
-	/* take action */
-	if (wasthrottled && !dcc->throttled)
-		dcc_unthrottle (dcc);
+	return count;
 }
 
+/* offers held sends once dcc_max_sends allows it */
 static void
-dcc_remove_from_sum (struct DCC *dcc)
+dcc_send_next (void)
 {
-	if (dcc->dccstat != STAT_ACTIVE)
-		return;
-	if (dcc->type == TYPE_SEND)
-		dcc_sendcpssum -= dcc->cps;
-	else if (dcc->type == TYPE_RECV)
-		dcc_getcpssum -= dcc->cps;
+	struct DCC *dcc, *next;
+	GSList *list;
+
+	while (prefs.hex_dcc_max_sends <= 0 || dcc_count_sends (NULL) < prefs.hex_dcc_max_sends)
+	{
+		/* dcc_list is newest first, the last one has waited longest */
+		next = NULL;
+		for (list = dcc_list; list; list = list->next)
+		{
+			dcc = list->data;
+			if (dcc->held)
+				next = dcc;
+		}
+		if (!next)
+			return;
+
+		next->held = FALSE;
+		if (dcc_send_offer (next, next->serv->front_session, next->held_passive))
+			fe_dcc_update (next);
+		else
+			dcc_close (next, STAT_FAILED, FALSE);
+	}
 }
 
 gboolean
@@ -244,8 +195,13 @@ dcc_check_timeouts (void)
 {
 	struct DCC *dcc;
 	time_t tim = time (0);
-	GSList *next, *list = dcc_list;
+	GSList *next, *list;
+
+	dcc_update_stats ();
+	dcc_send_next ();
+	dcc_group_save_all ();
 
+	list = dcc_list;
 	while (list)
 	{
 		dcc = (struct DCC *) list->data;
@@ -254,8 +210,9 @@ dcc_check_timeouts (void)
 		switch (dcc->dccstat)
 		{
 		case STAT_ACTIVE:
-			dcc_calc_cps (dcc);
-			fe_dcc_update (dcc);
+			if (dcc->io)
+				dcc_io_sync (dcc->io);
+			fe_dcc_update (dcc_group_shown (dcc));
 
 			if (dcc->type == TYPE_SEND || dcc->type == TYPE_RECV)
 			{
@@ -273,7 +230,9 @@ dcc_check_timeouts (void)
 			}
 			break;
 		case STAT_QUEUED:
-			if (dcc->type == TYPE_SEND || dcc->type == TYPE_CHATSEND)
+			/* a part of a multi-source download whose sender never accepted the resume */
+			if ((!dcc->held && (dcc->type == TYPE_SEND || dcc->type == TYPE_CHATSEND)) ||
+				 (dcc->type == TYPE_RECV && dcc->hidden))
 			{
 				if (tim - dcc->offertime > prefs.hex_dcc_timeout)
 				{
@@ -290,7 +249,8 @@ dcc_check_timeouts (void)
 		case STAT_DONE:
 		case STAT_FAILED:
 		case STAT_ABORTED:
-			if (prefs.hex_dcc_remove)
+			/* hidden ones were parts of a download that's shown elsewhere */
+			if (prefs.hex_dcc_remove || dcc->hidden)
 				dcc_close (dcc, 0, TRUE);
 			break;
 		default:
@@ -371,6 +331,22 @@ dcc_connect_sok (struct DCC *dcc)
 static void
 dcc_close (struct DCC *dcc, enum dcc_state dccstat, int destroy)
 {
+	gboolean partial = FALSE;
+
+	if (dcc->io)
+	{
+		dcc_io_stop (dcc->io);
+		dcc->io = NULL;
+	}
+
+	/* a multi-source download is only done once all of its parts are */
+	if (dcc->group)
+	{
+		partial = !dcc_group_remove (dcc);
+		if (partial && dccstat == STAT_DONE && !dcc->hidden)
+			dccstat = STAT_FAILED;
+	}
+
 	if (dcc->wiotag)
 	{
 		fe_input_remove (dcc->wiotag);
@@ -389,8 +365,6 @@ dcc_close (struct DCC *dcc, enum dcc_state dccstat, int destroy)
 		dcc->sok = -1;
 	}
 
-	dcc_remove_from_sum (dcc);
-
 	if (dcc->fp != -1)
 	{
 		close (dcc->fp);
@@ -400,11 +374,16 @@ dcc_close (struct DCC *dcc, enum dcc_state dccstat, int destroy)
 		{
 			/* if we just completed a dcc receive, move the */
 			/* completed file to the completed directory */
-			if(dcc->type == TYPE_RECV)
+			if(dcc->type == TYPE_RECV && !partial)
 			{			
 				/* mgl: change this to handle the case where dccwithnick is set */
-				move_file (prefs.hex_dcc_dir, prefs.hex_dcc_completed_dir, 
+				char *moved = move_file (prefs.hex_dcc_dir, prefs.hex_dcc_completed_dir, 
 									 file_part (dcc->destfile), prefs.hex_dcc_permissions);
+				if (moved)
+				{
+					g_free (dcc->destfile);
+					dcc->destfile = moved;
+				}
 			}
 
 		}
@@ -428,7 +407,7 @@ dcc_close (struct DCC *dcc, enum dcc_state dccstat, int destroy)
 		g_free (dcc);
 		if (dcc_list == NULL && timeout_timer != 0)
 		{
-			fe_timeout_remove (timeout_timer);
+			timer_wheel_remove (timeout_timer);
 			timeout_timer = 0;
 		}
 		return;
@@ -437,6 +416,22 @@ dcc_close (struct DCC *dcc, enum dcc_state dccstat, int destroy)
 	fe_dcc_update (dcc);
 }
 
+/* the row of a multi-source download stands for all of its parts */
+static void
+dcc_abort_parts (struct DCC *dcc)
+{
+	struct DCC *d;
+	GSList *list, *next;
+
+	for (list = dcc_list; list; list = next)
+	{
+		next = list->next;
+		d = list->data;
+		if (d != dcc && d->group && d->group == dcc->group)
+			dcc_close (d, STAT_ABORTED, TRUE);
+	}
+}
+
 void
 dcc_abort (session *sess, struct DCC *dcc)
 {
@@ -447,6 +442,8 @@ dcc_abort (session *sess, struct DCC *dcc)
 		case STAT_QUEUED:
 		case STAT_CONNECTING:
 		case STAT_ACTIVE:
+			if (dcc->group)
+				dcc_abort_parts (dcc);
 			dcc_close (dcc, STAT_ABORTED, FALSE);
 			switch (dcc->type)
 			{
@@ -553,7 +550,7 @@ dcc_chat_line (struct DCC *dcc, char *line)
 		return 0;
 	}
 
-	url_check_line (line);
+	url_check_line (dcc->serv, line);
 
 	if (line[0] == 1 && !g_ascii_strncasecmp (line + 1, "ACTION", 6))
 	{
@@ -647,137 +644,157 @@ dcc_calc_average_cps (struct DCC *dcc)
 		dcc->cps = (dcc->pos - dcc->resumable) / sec;
 }
 
-static void
-dcc_send_ack (struct DCC *dcc)
-{
-	/* send in 32-bit big endian */
-	guint32 pos = htonl (dcc->pos & 0xffffffff);
-	send (dcc->sok, (char *) &pos, 4, 0);
-}
-
 static gboolean
-dcc_read (GIOChannel *source, GIOCondition condition, struct DCC *dcc)
+dcc_open_destfile (struct DCC *dcc)
 {
 	char *old;
 	char buf[4096];
+	gchar *filename_fs;
 	int n;
-	gboolean need_ack = FALSE;
 
-	if (dcc->fp == -1)
-	{
+	/* try to create the download dir (even if it exists, no harm) */
+	g_mkdir (prefs.hex_dcc_dir, 0700);
 
-		/* try to create the download dir (even if it exists, no harm) */
-		g_mkdir (prefs.hex_dcc_dir, 0700);
+	if (dcc->resumable || dcc->group)
+	{
+		/* no O_APPEND, other parts of a multi-source download may be
+		   written past us */
+		filename_fs = g_filename_from_utf8 (dcc->destfile, -1, NULL, NULL, NULL);
+		dcc->fp = g_open (filename_fs, O_WRONLY | O_CREAT | OFLAGS, prefs.hex_dcc_permissions);
+		g_free (filename_fs);
 
-		if (dcc->resumable)
+		if (dcc->fp != -1 && lseek (dcc->fp, dcc->resumable, SEEK_SET) == -1)
 		{
-			gchar *filename_fs = g_filename_from_utf8(dcc->destfile, -1, NULL, NULL, NULL);
-			dcc->fp = g_open(dcc->destfile, O_WRONLY | O_APPEND | OFLAGS, 0);
-			g_free (filename_fs);
-
-			dcc->pos = dcc->resumable;
-			dcc->ack = dcc->resumable;
+			close (dcc->fp);
+			dcc->fp = -1;
 		}
-		else
-		{
-			gchar *filename_fs;
 
-			if (g_access (dcc->destfile, F_OK) == 0)
+		dcc->pos = dcc->resumable;
+		dcc->ack = dcc->resumable;
+	}
+	else
+	{
+		if (g_access (dcc->destfile, F_OK) == 0)
+		{
+			n = 0;
+			do
 			{
-				n = 0;
-				do
-				{
-					n++;
-					g_snprintf (buf, sizeof (buf), "%s.%d", dcc->destfile, n);
-				}
-				while (g_access (buf, F_OK) == 0);
-
-				old = dcc->destfile;
-				dcc->destfile = g_strdup (buf);
-
-				EMIT_SIGNAL (XP_TE_DCCRENAME, dcc->serv->front_session,
-								 old, dcc->destfile, NULL, NULL, 0);
-				g_free (old);
+				n++;
+				g_snprintf (buf, sizeof (buf), "%s.%d", dcc->destfile, n);
 			}
+			while (g_access (buf, F_OK) == 0);
 
-			filename_fs = g_filename_from_utf8 (dcc->destfile, -1, NULL, NULL, NULL);
-			dcc->fp = g_open (filename_fs, OFLAGS | O_TRUNC | O_WRONLY | O_CREAT, prefs.hex_dcc_permissions);
-			g_free (filename_fs);
+			old = dcc->destfile;
+			dcc->destfile = g_strdup (buf);
+
+			EMIT_SIGNAL (XP_TE_DCCRENAME, dcc->serv->front_session,
+							 old, dcc->destfile, NULL, NULL, 0);
+			g_free (old);
 		}
+
+		filename_fs = g_filename_from_utf8 (dcc->destfile, -1, NULL, NULL, NULL);
+		dcc->fp = g_open (filename_fs, OFLAGS | O_TRUNC | O_WRONLY | O_CREAT, prefs.hex_dcc_permissions);
+		g_free (filename_fs);
 	}
+
 	if (dcc->fp == -1)
 	{
 		/* the last executed function is open(), errno should be valid */
 		EMIT_SIGNAL (XP_TE_DCCFILEERR, dcc->serv->front_session, dcc->destfile,
 						 errorstring (errno), NULL, NULL, 0);
 		dcc_close (dcc, STAT_FAILED, FALSE);
-		return TRUE;
+		return FALSE;
 	}
-	while (1)
-	{
-		if (dcc->throttled)
-		{
-			if (need_ack)
-				dcc_send_ack (dcc);
 
-			fe_input_remove (dcc->iotag);
-			dcc->iotag = 0;
-			return FALSE;
-		}
+	return TRUE;
+}
 
-		if (!dcc->iotag)
-			dcc->iotag = fe_input_add (dcc->sok, FIA_READ|FIA_EX, dcc_read, dcc);
+struct dcc_recv_hash
+{
+	server *serv;
+	char *file;
+	char *nick;
+};
 
-		n = recv (dcc->sok, buf, sizeof (buf), 0);
-		if (n < 1)
-		{
-			if (n < 0)
-			{
-				if (would_block ())
-				{
-					if (need_ack)
-						dcc_send_ack (dcc);
-					return TRUE;
-				}
-			}
-			EMIT_SIGNAL (XP_TE_DCCRECVERR, dcc->serv->front_session, dcc->file,
-							 dcc->destfile, dcc->nick,
-							 errorstring ((n < 0) ? sock_error () : 0), 0);
-			/* send ack here? but the socket is dead */
-			/*if (need_ack)
-				dcc_send_ack (dcc);*/
-			dcc_close (dcc, STAT_FAILED, FALSE);
-			return TRUE;
-		}
+static void
+dcc_recv_hashed (const char *sha256, const char *xxh64, gpointer userdata)
+{
+	struct dcc_recv_hash *recv = userdata;
+
+	if (sha256 && is_server (recv->serv))
+		EMIT_SIGNAL (XP_TE_DCCRECVHASH, recv->serv->front_session,
+						 recv->file, recv->nick, (char *) sha256, (char *) xxh64, 0);
+
+	g_free (recv->file);
+	g_free (recv->nick);
+	g_free (recv);
+}
+
+static void
+dcc_recv_done (struct DCC *dcc, int result, int error)
+{
+	struct dcc_recv_hash *recv;
+	char buf[16];
+	char *sha256, *xxh64;
+	gboolean part = dcc->group != NULL;
+
+	if (result == DCC_IO_DONE)
+	{
+		if (!dcc_io_hashes (dcc->io, &sha256, &xxh64))
+			sha256 = xxh64 = NULL;
 
-		if (write (dcc->fp, buf, n) == -1) /* could be out of hdd space */
+		dcc_close (dcc, STAT_DONE, FALSE);
+
+		/* a part of a multi-source download, others are still going */
+		if (dcc->hidden)
+			return;
+		if (dcc->dccstat != STAT_DONE)
 		{
 			EMIT_SIGNAL (XP_TE_DCCRECVERR, dcc->serv->front_session, dcc->file,
-							 dcc->destfile, dcc->nick, errorstring (errno), 0);
-			if (need_ack)
-				dcc_send_ack (dcc);
-			dcc_close (dcc, STAT_FAILED, FALSE);
-			return TRUE;
+							 dcc->destfile, dcc->nick, _("Parts of the file are missing"), 0);
+			return;
 		}
 
-		dcc->lasttime = time (0);
-		dcc->pos += n;
-		need_ack = TRUE;	/* send ack when we're done recv()ing */
+		dcc_calc_average_cps (dcc);	/* this must be done _after_ dcc_close, once the transfer thread has stopped */
+		/* cppcheck-suppress deallocuse */
+		sprintf (buf, "%" G_GINT64_FORMAT, dcc->cps);
+		EMIT_SIGNAL (XP_TE_DCCRECVCOMP, dcc->serv->front_session,
+						 dcc->file, dcc->destfile, dcc->nick, buf, 0);
 
-		if (dcc->pos >= dcc->size)
+		if (sha256)
 		{
-			dcc_send_ack (dcc);
-			dcc_close (dcc, STAT_DONE, FALSE);
-			dcc_calc_average_cps (dcc);	/* this must be done _after_ dcc_close, or dcc_remove_from_sum will see the wrong value in dcc->cps */
-			/* cppcheck-suppress deallocuse */
-			sprintf (buf, "%" G_GINT64_FORMAT, dcc->cps);
-			EMIT_SIGNAL (XP_TE_DCCRECVCOMP, dcc->serv->front_session,
-							 dcc->file, dcc->destfile, dcc->nick, buf, 0);
-			return TRUE;
+			/* destfile is where dcc_close () moved it to */
+			dcc_hash_store (dcc->destfile, sha256, xxh64);
+			EMIT_SIGNAL (XP_TE_DCCRECVHASH, dcc->serv->front_session,
+							 dcc->file, dcc->nick, sha256, xxh64, 0);
+			g_free (sha256);
+			g_free (xxh64);
 		}
+		else if (part && prefs.hex_dcc_checksum)
+		{
+			/* the parts came in out of order, so it's read once now */
+			recv = g_new (struct dcc_recv_hash, 1);
+			recv->serv = dcc->serv;
+			recv->file = g_strdup (dcc->file);
+			recv->nick = g_strdup (dcc->nick);
+			dcc_hash_file (dcc->destfile, dcc_recv_hashed, recv);
+		}
+	}
+	else
+	{
+		EMIT_SIGNAL (XP_TE_DCCRECVERR, dcc->serv->front_session, dcc->file,
+						 dcc->destfile, dcc->nick, errorstring (error), 0);
+		dcc_close (dcc, STAT_FAILED, FALSE);
 	}
 }
 
+static void
+dcc_start_recv (struct DCC *dcc)
+{
+	if (dcc_open_destfile (dcc))
+		dcc->io = dcc_io_recv (dcc, !dcc->group && prefs.hex_dcc_checksum, dcc_recv_done);
+}
+
 static void
 dcc_open_query (server *serv, char *nick)
 {
@@ -853,17 +870,13 @@ dcc_connect_finished (GIOChannel *source, GIOCondition condition, struct DCC *dc
 	switch (dcc->type)
 	{
 	case TYPE_RECV:
-		dcc->iotag = fe_input_add (dcc->sok, FIA_READ|FIA_EX, dcc_read, dcc);
 		EMIT_SIGNAL (XP_TE_DCCCONRECV, dcc->serv->front_session,
 						 dcc->nick, host, dcc->file, NULL, 0);
+		dcc_start_recv (dcc);
 		break;
 	case TYPE_SEND:
 		/* passive send */
-		dcc->fastsend = prefs.hex_dcc_fast_send;
-		if (dcc->fastsend)
-			dcc->wiotag = fe_input_add (dcc->sok, FIA_WRITE, dcc_send_data, dcc);
-		dcc->iotag = fe_input_add (dcc->sok, FIA_READ|FIA_EX, dcc_read_ack, dcc);
-		dcc_send_data (NULL, 0, (gpointer)dcc);
+		dcc_start_send (dcc);
 		EMIT_SIGNAL (XP_TE_DCCCONSEND, dcc->serv->front_session,
 						 dcc->nick, host, dcc->file, NULL, 0);
 		break;
@@ -1412,150 +1425,35 @@ dcc_connect (struct DCC *dcc)
 	fe_dcc_update (dcc);
 }
 
-static gboolean
-dcc_send_data (GIOChannel *source, GIOCondition condition, struct DCC *dcc)
-{
-	char *buf;
-	int len, sent, sok = dcc->sok;
-
-	if (prefs.hex_dcc_blocksize < 1) /* this is too little! */
-		prefs.hex_dcc_blocksize = 1024;
-
-	if (prefs.hex_dcc_blocksize > 102400)	/* this is too much! */
-		prefs.hex_dcc_blocksize = 102400;
-
-	if (dcc->throttled)
-	{
-		fe_input_remove (dcc->wiotag);
-		dcc->wiotag = 0;
-		return FALSE;
-	}
-
-	if (!dcc->fastsend)
-	{
-		if (dcc->ack < (dcc->pos & 0xFFFFFFFF))
-			return TRUE;
-	}
-	else if (!dcc->wiotag)
-		dcc->wiotag = fe_input_add (sok, FIA_WRITE, dcc_send_data, dcc);
-
-	buf = g_malloc (prefs.hex_dcc_blocksize);
-
-	lseek (dcc->fp, dcc->pos, SEEK_SET);
-	len = read (dcc->fp, buf, prefs.hex_dcc_blocksize);
-	if (len < 1)
-		goto abortit;
-	sent = send (sok, buf, len, 0);
-
-	if (sent < 0 && !(would_block ()))
-	{
-abortit:
-		g_free (buf);
-		EMIT_SIGNAL (XP_TE_DCCSENDFAIL, dcc->serv->front_session,
-						 file_part (dcc->file), dcc->nick,
-						 errorstring (sock_error ()), NULL, 0);
-		dcc_close (dcc, STAT_FAILED, FALSE);
-		return TRUE;
-	}
-	if (sent > 0)
-	{
-		dcc->pos += sent;
-		dcc->lasttime = time (0);
-	}
-
-	/* have we sent it all yet? */
-	if (dcc->pos >= dcc->size)
-	{
-		/* it's all sent now, so remove the WRITE/SEND handler */
-		if (dcc->wiotag)
-		{
-			fe_input_remove (dcc->wiotag);
-			dcc->wiotag = 0;
-		}
-	}
-
-	g_free (buf);
-
-	return TRUE;
-}
-
-static gboolean
-dcc_handle_new_ack (struct DCC *dcc)
+static void
+dcc_send_done (struct DCC *dcc, int result, int error)
 {
-	guint32 ack;
 	char buf[16];
-	gboolean done = FALSE;
-
-	memcpy (&ack, dcc->ack_buf, 4);
-	dcc->ack = ntohl (ack);
 
-	/* this could mess up when xfering >32bit files */
-	if (dcc->size <= 0xffffffff)
+	if (result == DCC_IO_DONE)
 	{
-		/* fix for BitchX */
-		if (dcc->ack < dcc->resumable)
-			dcc->ackoffset = TRUE;
-		if (dcc->ackoffset)
-			dcc->ack += dcc->resumable;
-	}
-
-	/* DCC complete check */
-	if (dcc->pos >= dcc->size && dcc->ack >= (dcc->size & 0xffffffff))
-	{
-		dcc->ack = dcc->size;	/* force 100% ack for >4 GB */
 		dcc_close (dcc, STAT_DONE, FALSE);
-		dcc_calc_average_cps (dcc);	/* this must be done _after_ dcc_close, or dcc_remove_from_sum will see the wrong value in dcc->cps */
+		dcc->ack = dcc->size;	/* force 100% ack for >4 GB */
+		dcc_calc_average_cps (dcc);	/* this must be done _after_ dcc_close, once the transfer thread has stopped */
 		/* cppcheck-suppress deallocuse */
 		sprintf (buf, "%" G_GINT64_FORMAT, dcc->cps);
 		EMIT_SIGNAL (XP_TE_DCCSENDCOMP, dcc->serv->front_session,
 						 file_part (dcc->file), dcc->nick, buf, NULL, 0);
-		done = TRUE;
 	}
-	else if ((!dcc->fastsend) && (dcc->ack >= (dcc->pos & 0xffffffff)))
+	else
 	{
-		dcc_send_data (NULL, 0, (gpointer)dcc);
+		EMIT_SIGNAL (XP_TE_DCCSENDFAIL, dcc->serv->front_session,
+						 file_part (dcc->file), dcc->nick,
+						 errorstring (error), NULL, 0);
+		dcc_close (dcc, STAT_FAILED, FALSE);
 	}
-
-	/* take the top 32 of "bytes send" and bottom 32 of "ack" */
-	dcc->ack = (dcc->pos & G_GINT64_CONSTANT (0xffffffff00000000)) |
-					(dcc->ack & 0xffffffff);
-	/* dcc->ack is only used for CPS and PERCENTAGE calcs from now on... */
-
-	return done;
 }
 
-static gboolean
-dcc_read_ack (GIOChannel *source, GIOCondition condition, struct DCC *dcc)
+static void
+dcc_start_send (struct DCC *dcc)
 {
-	int len;
-
-	while (1)
-	{
-		/* try to fill up 4 bytes */
-		len = recv (dcc->sok, dcc->ack_buf, 4 - dcc->ack_pos, 0);
-		if (len < 1)
-		{
-			if (len < 0)
-			{
-				if (would_block ())	/* ok - keep waiting */
-					return TRUE;
-			}
-			EMIT_SIGNAL (XP_TE_DCCSENDFAIL, dcc->serv->front_session,
-							 file_part (dcc->file), dcc->nick,
-							 errorstring ((len < 0) ? sock_error () : 0), NULL, 0);
-			dcc_close (dcc, STAT_FAILED, FALSE);
-			return TRUE;
-		}
-
-		dcc->ack_pos += len;
-		if (dcc->ack_pos >= 4)
-		{
-			dcc->ack_pos = 0;
-			if (dcc_handle_new_ack (dcc))
-				return TRUE;
-		}
-		/* loop again until would_block() returns true */
-	}
+	dcc->fastsend = prefs.hex_dcc_fast_send;
+	dcc->io = dcc_io_send (dcc, dcc_send_done);
 }
 
 static gboolean
@@ -1586,17 +1484,13 @@ dcc_accept (GIOChannel *source, GIOCondition condition, struct DCC *dcc)
 
 	dcc->dccstat = STAT_ACTIVE;
 	dcc->lasttime = dcc->starttime = time (0);
-	dcc->fastsend = prefs.hex_dcc_fast_send;
 
 	g_snprintf (host, sizeof (host), "%s:%d", net_ip (dcc->addr), dcc->port);
 
 	switch (dcc->type)
 	{
 	case TYPE_SEND:
-		if (dcc->fastsend)
-			dcc->wiotag = fe_input_add (sok, FIA_WRITE, dcc_send_data, dcc);
-		dcc->iotag = fe_input_add (sok, FIA_READ|FIA_EX, dcc_read_ack, dcc);
-		dcc_send_data (NULL, 0, (gpointer)dcc);
+		dcc_start_send (dcc);
 		EMIT_SIGNAL (XP_TE_DCCCONSEND, dcc->serv->front_session,
 						 dcc->nick, host, dcc->file, NULL, 0);
 		break;
@@ -1738,10 +1632,103 @@ dcc_send_wild (char *file)
 	dcc_send (dccsess, dccto, file, dccmaxcps, 0);
 }
 
+static void
+dcc_send_show (struct DCC *dcc)
+{
+	if (prefs.hex_gui_autoopen_send)
+	{
+		if (fe_dcc_open_send_win (TRUE))	/* already open? add */
+			fe_dcc_add (dcc);
+	} else
+		fe_dcc_add (dcc);
+}
+
+struct dcc_offer_hash
+{
+	session *sess;
+	char *file;
+	char *nick;
+};
+
+static void
+dcc_send_hashed (const char *sha256, const char *xxh64, gpointer userdata)
+{
+	struct dcc_offer_hash *offer = userdata;
+
+	/* shown where the file was offered, as long as that's still open */
+	if (sha256 && is_session (offer->sess))
+		EMIT_SIGNAL (XP_TE_DCCSENDHASH, offer->sess,
+						 offer->file, offer->nick, (char *) sha256, (char *) xxh64, 0);
+
+	g_free (offer->file);
+	g_free (offer->nick);
+	g_free (offer);
+}
+
+static gboolean
+dcc_send_offer (struct DCC *dcc, session *sess, int passive)
+{
+	struct dcc_offer_hash *offer;
+	char outbuf[512];
+	char havespaces = 0;
+	char *filename, *path;
+
+	if (!passive && !dcc_listen_init (dcc, sess))
+		return FALSE;
+
+	/* before fillspaces gets to it */
+	path = g_strdup (dcc->file);
+
+	for (filename = dcc->file; *filename; filename++)
+	{
+		if (*filename == ' ')
+		{
+			if (prefs.hex_dcc_send_fillspaces)
+				*filename = '_';
+			else
+				havespaces = 1;
+		}
+	}
+
+	if (passive)
+	{
+		dcc->pasvid = new_id();
+		g_snprintf (outbuf, sizeof (outbuf), (havespaces) ?
+				"DCC SEND \"%s\" 199 0 %" G_GUINT64_FORMAT " %d" :
+				"DCC SEND %s 199 0 %" G_GUINT64_FORMAT " %d",
+				file_part (dcc->file),
+				dcc->size, dcc->pasvid);
+	}
+	else
+	{
+		g_snprintf (outbuf, sizeof (outbuf), (havespaces) ?
+				"DCC SEND \"%s\" %u %d %" G_GUINT64_FORMAT :
+				"DCC SEND %s %u %d %" G_GUINT64_FORMAT,
+				file_part (dcc->file), dcc->addr,
+				dcc->port, dcc->size);
+	}
+	dcc->offertime = time (0);
+	sess->server->p_ctcp (sess->server, dcc->nick, outbuf);
+
+	EMIT_SIGNAL (XP_TE_DCCOFFER, sess, file_part (dcc->file),
+						dcc->nick, dcc->file, NULL, 0);
+
+	if (prefs.hex_dcc_checksum)
+	{
+		offer = g_new (struct dcc_offer_hash, 1);
+		offer->sess = sess;
+		offer->file = g_strdup (file_part (dcc->file));
+		offer->nick = g_strdup (dcc->nick);
+		dcc_hash_file (path, dcc_send_hashed, offer);
+	}
+	g_free (path);
+
+	return TRUE;
+}
+
 void
 dcc_send (struct session *sess, char *to, char *filename, gint64 maxcps, int passive)
 {
-	char outbuf[512];
 	GFileInfo *file_info;
 	GFile *file;
 	struct DCC *dcc;
@@ -1858,54 +1845,23 @@ dcc_send (struct session *sess, char *to, char *filename, gint64 maxcps, int pas
 		return;
 	}
 
-	if (passive || dcc_listen_init (dcc, sess))
-	{
-		char havespaces = 0;
-		while (*filename)
-		{
-			if (*filename == ' ')
-			{
-				if (prefs.hex_dcc_send_fillspaces)
-				    *filename = '_';
-				else
-				havespaces = 1;
-			}
-			filename++;
-		}
-		dcc->nick = g_strdup (to);
-		if (prefs.hex_gui_autoopen_send)
-		{
-			if (fe_dcc_open_send_win (TRUE))	/* already open? add */
-				fe_dcc_add (dcc);
-		} else
-			fe_dcc_add (dcc);
-
-		if (passive)
-		{
-			dcc->pasvid = new_id();
-			g_snprintf (outbuf, sizeof (outbuf), (havespaces) ?
-					"DCC SEND \"%s\" 199 0 %" G_GUINT64_FORMAT " %d" :
-					"DCC SEND %s 199 0 %" G_GUINT64_FORMAT " %d",
-					file_part (dcc->file),
-					dcc->size, dcc->pasvid);
-		}
-		else
-		{
-			g_snprintf (outbuf, sizeof (outbuf), (havespaces) ?
-					"DCC SEND \"%s\" %u %d %" G_GUINT64_FORMAT :
-					"DCC SEND %s %u %d %" G_GUINT64_FORMAT,
-					file_part (dcc->file), dcc->addr,
-					dcc->port, dcc->size);
-		}
-		sess->server->p_ctcp (sess->server, to, outbuf);
+	dcc->nick = g_strdup (to);
 
-		EMIT_SIGNAL (XP_TE_DCCOFFER, sess, file_part (dcc->file),
-							to, dcc->file, NULL, 0);
+	/* too many sends going on, offer it once one of them is done */
+	if (prefs.hex_dcc_max_sends > 0 && dcc_count_sends (dcc) >= prefs.hex_dcc_max_sends)
+	{
+		dcc->held = TRUE;
+		dcc->held_passive = passive;
+		dcc_send_show (dcc);
+		PrintTextf (sess, _("Queued %s for %s, %d files are being sent already.\n"),
+						file_part (dcc->file), to, prefs.hex_dcc_max_sends);
+		return;
 	}
+
+	if (dcc_send_offer (dcc, sess, passive))
+		dcc_send_show (dcc);
 	else
-	{
 		dcc_close (dcc, 0, TRUE);
-	}
 }
 
 static struct DCC *
@@ -2088,8 +2044,13 @@ exit:
 static void
 update_is_resumable (struct DCC *dcc)
 {
-	gchar *filename_fs = g_filename_from_utf8 (dcc->destfile, -1, NULL, NULL, NULL);
+	gchar *filename_fs;
+
+	/* where it starts is up to dccgroup.c */
+	if (dcc->group)
+		return;
 
+	filename_fs = g_filename_from_utf8 (dcc->destfile, -1, NULL, NULL, NULL);
 	dcc->resumable = 0;
 
 	/* Check the file size */
@@ -2198,6 +2159,10 @@ dcc_get (struct DCC *dcc)
 void
 dcc_get_with_destfile (struct DCC *dcc, char *file)
 {
+	/* a different file now */
+	if (dcc->group)
+		dcc_group_remove (dcc);
+
 	g_free (dcc->destfile);
 	dcc->destfile = g_strdup (file);	/* utf-8 */
 
@@ -2248,7 +2213,7 @@ new_dcc (void)
 	dcc_list = g_slist_prepend (dcc_list, dcc);
 	if (timeout_timer == 0)
 	{
-		timeout_timer = fe_timeout_add_seconds (1, dcc_check_timeouts, NULL);
+		timeout_timer = timer_wheel_add_seconds (1, (GSourceFunc) dcc_check_timeouts, NULL);
 	}
 	return dcc;
 }
@@ -2436,7 +2401,7 @@ dcc_add_chat (session *sess, char *nick, int port, guint32 addr, int pasvid)
 static struct DCC *
 dcc_add_file (session *sess, char *file, guint64 size, int port, char *nick, guint32 addr, int pasvid)
 {
-	struct DCC *dcc;
+	struct DCC *dcc, *other;
 	char tbuf[512];
 
 	dcc = new_dcc ();
@@ -2480,7 +2445,19 @@ dcc_add_file (session *sess, char *file, guint64 size, int port, char *nick, gui
 		dcc->nick = g_strdup (nick);
 		dcc->maxcps = prefs.hex_dcc_max_get_cps;
 
-		update_is_resumable (dcc);
+		/* the user already took this file from someone else, get part of it
+		   from this one too */
+		other = prefs.hex_dcc_multi_source ? dcc_group_find_source (dcc) : NULL;
+		if (other && dcc_group_join (dcc, other))
+		{
+			dcc->offertime = time (0);
+			if (!dcc_resume (dcc))
+				dcc_connect (dcc);
+			goto offered;
+		}
+
+		if (!dcc_group_restore (dcc))
+			update_is_resumable (dcc);
 
 		if (prefs.hex_dcc_auto_recv == 1)
 		{
@@ -2498,6 +2475,7 @@ dcc_add_file (session *sess, char *file, guint64 size, int port, char *nick, gui
 		} else
 			fe_dcc_add (dcc);
 	}
+offered:
 	sprintf (tbuf, "%" G_GUINT64_FORMAT, size);
 	g_snprintf (tbuf + 24, 300, "%s:%d", net_ip (addr), port);
 	EMIT_SIGNAL (XP_TE_DCCSENDOFFER, sess->server->front_session, nick,
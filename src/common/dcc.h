@@ -41,8 +41,6 @@ enum dcc_type {
 	TYPE_CHATSEND
 };
 
-#define CPS_AVG_WINDOW 10
-
 struct DCC
 {
 	struct server *serv;
@@ -59,17 +57,16 @@ struct DCC
 	int resume_error;
 	int resume_errno;
 
-	GTimeVal lastcpstv, firstcpstv;
-	goffset lastcpspos;
 	gint64 maxcps;
 
-	unsigned char ack_buf[4];	/* buffer for reading 4-byte ack */
-	int ack_pos;
+	struct _dcc_io *io;			/* thread doing the transfer, see dccio.c */
+	struct dcc_group *group;	/* multi-source download, see dccgroup.c */
 
 	guint64 size;
 	guint64 resumable;
 	guint64 ack;
 	guint64 pos;
+	guint64 end;					/* receive up to here, 0 for the whole file */
 	time_t starttime;
 	time_t offertime;
 	time_t lasttime;
@@ -80,10 +77,10 @@ struct DCC
 	enum dcc_state dccstat;
 	unsigned int resume_sent:1;	/* resume request sent */
 	unsigned int fastsend:1;
-	unsigned int ackoffset:1;	/* is receiver sending acks as an offset from */
-										/* the resume point? */
-	unsigned int throttled:2;	/* 0x1 = per send/get throttle
-											0x2 = global throttle */
+	unsigned int throttled:1;	/* had to wait for bandwidth, see dccsched.c */
+	unsigned int held:1;			/* send waiting for a free dcc_max_sends slot */
+	unsigned int held_passive:1;
+	unsigned int hidden:1;		/* part of a download that's shown as another DCC */
 };
 
 #define MAX_PROXY_BUFFER 1024
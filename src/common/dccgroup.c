@@ -0,0 +1,529 @@
+/* HexChat
+ * Copyright (C) 1998-2010 Peter Zelezny.
+ * Copyright (C) 2009-2013 Berke Viktor.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/* Multi-source DCC downloads. When a second sender offers a file we are
+   already receiving, it is asked with DCC RESUME for the second half of
+   what the first one still has to send, and the first one stops receiving
+   there. Each part writes into the same file at its own offset. What has
+   been written is saved next to the file as <file>.parts, so a later offer
+   of the same file picks up the first missing range only, up to where the
+   next one already on disk starts. DCC has no way to tell a sender where
+   to stop: a part that ends before the end of the file is closed by us
+   once it got there, which the sender sees as an aborted transfer. */
+
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <glib/gstdio.h>
+
+#include "hexchat.h"
+#include "hexchatc.h"
+#include "dcc.h"
+#include "dccio.h"
+#include "fe.h"
+#include "util.h"
+#include "dccgroup.h"
+
+#define DCC_GROUP_MIN_SPLIT (8 * 1024 * 1024)	/* don't share less than this */
+#define DCC_GROUP_ALIGN (64 * 1024)
+#define DCC_GROUP_SAVE_INTERVAL 10				/* seconds */
+
+struct dcc_range
+{
+	guint64 start;
+	guint64 end;
+};
+
+struct dcc_group
+{
+	char *destfile;			/* utf8 */
+	char *parts_fs;
+	char *saved;				/* what's in parts_fs */
+	guint64 size;
+	GArray *done;				/* struct dcc_range of members that stopped */
+	GSList *members;
+	struct DCC *shown;
+	guint64 had;				/* what was there when it started */
+	time_t starttime;
+};
+
+static GSList *dcc_groups = NULL;
+
+/* adds [start, end) to a sorted list of ranges that don't touch */
+static void
+dcc_ranges_add (GArray *ranges, guint64 start, guint64 end)
+{
+	struct dcc_range *r, range;
+	guint i = 0;
+
+	if (start >= end)
+		return;
+
+	while (i < ranges->len)
+	{
+		r = &g_array_index (ranges, struct dcc_range, i);
+		if (r->end < start)
+		{
+			i++;
+			continue;
+		}
+		if (r->start > end)
+			break;
+
+		/* overlaps or touches, swallow it */
+		start = MIN (start, r->start);
+		end = MAX (end, r->end);
+		g_array_remove_index (ranges, i);
+	}
+
+	range.start = start;
+	range.end = end;
+	g_array_insert_val (ranges, i, range);
+}
+
+static guint64
+dcc_ranges_total (GArray *ranges)
+{
+	struct dcc_range *r;
+	guint64 total = 0;
+	guint i;
+
+	for (i = 0; i < ranges->len; i++)
+	{
+		r = &g_array_index (ranges, struct dcc_range, i);
+		total += r->end - r->start;
+	}
+	return total;
+}
+
+/* the first range below size that isn't in ranges */
+static gboolean
+dcc_ranges_gap (GArray *ranges, guint64 size, guint64 *start, guint64 *end)
+{
+	struct dcc_range *r;
+	guint64 pos = 0;
+	guint i;
+
+	for (i = 0; i < ranges->len; i++)
+	{
+		r = &g_array_index (ranges, struct dcc_range, i);
+		if (r->start > pos)
+			break;
+		pos = MAX (pos, r->end);
+	}
+
+	if (pos >= size)
+		return FALSE;
+
+	*start = pos;
+	*end = i < ranges->len ? MIN (g_array_index (ranges, struct dcc_range, i).start, size) : size;
+	return TRUE;
+}
+
+static gboolean
+dcc_group_live (struct DCC *dcc)
+{
+	return dcc->dccstat == STAT_QUEUED || dcc->dccstat == STAT_CONNECTING ||
+			 dcc->dccstat == STAT_ACTIVE;
+}
+
+static guint64
+dcc_group_end (struct dcc_group *group, struct DCC *dcc)
+{
+	return dcc->end ? dcc->end : group->size;
+}
+
+/* What is done, plus what the members got so far. With on_disk only what
+   they already wrote out, else what they've got in memory as well. */
+static GArray *
+dcc_group_covered (struct dcc_group *group, gboolean on_disk)
+{
+	struct DCC *dcc;
+	GArray *ranges;
+	GSList *list;
+	guint64 pos;
+
+	ranges = g_array_sized_new (FALSE, FALSE, sizeof (struct dcc_range), group->done->len + 4);
+	g_array_append_vals (ranges, group->done->data, group->done->len);
+
+	for (list = group->members; list; list = list->next)
+	{
+		dcc = list->data;
+		pos = (on_disk && dcc->io) ? dcc_io_written (dcc->io) : dcc->pos;
+		dcc_ranges_add (ranges, dcc->resumable, pos);
+	}
+
+	return ranges;
+}
+
+static void
+dcc_group_save (struct dcc_group *group)
+{
+	struct dcc_range *r;
+	GArray *ranges;
+	GString *str;
+	guint i;
+
+	ranges = dcc_group_covered (group, TRUE);
+	str = g_string_new ("# HexChat multi-source download\n");
+	g_string_append_printf (str, "size %" G_GUINT64_FORMAT "\n", group->size);
+	for (i = 0; i < ranges->len; i++)
+	{
+		r = &g_array_index (ranges, struct dcc_range, i);
+		g_string_append_printf (str, "%" G_GUINT64_FORMAT " %" G_GUINT64_FORMAT "\n", r->start, r->end);
+	}
+	g_array_free (ranges, TRUE);
+
+	if (!group->saved || strcmp (group->saved, str->str) != 0)
+	{
+		g_file_set_contents (group->parts_fs, str->str, str->len, NULL);
+		g_free (group->saved);
+		group->saved = g_string_free (str, FALSE);
+	}
+	else
+	{
+		g_string_free (str, TRUE);
+	}
+}
+
+/* reads a parts file, NULL if there is none for a file of this size */
+static GArray *
+dcc_group_load (const char *parts_fs, guint64 size)
+{
+	GArray *ranges;
+	char *data, **lines, *end;
+	guint64 start, stop;
+	int i;
+
+	if (!g_file_get_contents (parts_fs, &data, NULL, NULL))
+		return NULL;
+
+	lines = g_strsplit (data, "\n", 0);
+	g_free (data);
+
+	ranges = g_array_new (FALSE, FALSE, sizeof (struct dcc_range));
+	for (i = 0; lines[i]; i++)
+	{
+		if (lines[i][0] == '#' || lines[i][0] == 0)
+			continue;
+
+		if (strncmp (lines[i], "size ", 5) == 0)
+		{
+			if (g_ascii_strtoull (lines[i] + 5, NULL, 10) != size)
+				break;
+			continue;
+		}
+
+		start = g_ascii_strtoull (lines[i], &end, 10);
+		stop = g_ascii_strtoull (end, NULL, 10);
+		dcc_ranges_add (ranges, start, MIN (stop, size));
+	}
+
+	/* a different file by the same name */
+	if (lines[i])
+	{
+		g_array_free (ranges, TRUE);
+		ranges = NULL;
+	}
+	g_strfreev (lines);
+
+	return ranges;
+}
+
+static struct dcc_group *
+dcc_group_new (struct DCC *dcc, GArray *done)
+{
+	struct dcc_group *group;
+	char *filename_fs;
+
+	group = g_new0 (struct dcc_group, 1);
+	group->destfile = g_strdup (dcc->destfile);
+	filename_fs = g_filename_from_utf8 (dcc->destfile, -1, NULL, NULL, NULL);
+	group->parts_fs = g_strconcat (filename_fs ? filename_fs : dcc->destfile, ".parts", NULL);
+	g_free (filename_fs);
+	group->size = dcc->size;
+	group->done = done;
+	group->had = dcc_ranges_total (done);
+	group->starttime = time (0);
+
+	group->members = g_slist_append (NULL, dcc);
+	group->shown = dcc;
+	dcc->group = group;
+
+	dcc_groups = g_slist_prepend (dcc_groups, group);
+	return group;
+}
+
+static void
+dcc_group_free (struct dcc_group *group)
+{
+	dcc_groups = g_slist_remove (dcc_groups, group);
+
+	g_slist_free (group->members);
+	g_array_free (group->done, TRUE);
+	g_free (group->destfile);
+	g_free (group->parts_fs);
+	g_free (group->saved);
+	g_free (group);
+}
+
+/* Gives dcc a range nobody has or is getting yet, or else the second half
+   of the biggest one still being received. */
+static gboolean
+dcc_group_claim (struct dcc_group *group, struct DCC *dcc)
+{
+	struct DCC *member, *best = NULL;
+	GArray *taken;
+	GSList *list;
+	guint64 start, end, left, best_left = 0, mid;
+
+	taken = g_array_sized_new (FALSE, FALSE, sizeof (struct dcc_range), group->done->len + 4);
+	g_array_append_vals (taken, group->done->data, group->done->len);
+	for (list = group->members; list; list = list->next)
+	{
+		member = list->data;
+		if (member == dcc || !dcc_group_live (member))
+			continue;
+
+		dcc_ranges_add (taken, member->resumable, dcc_group_end (group, member));
+
+		left = dcc_group_end (group, member) - MAX (member->pos, member->resumable);
+		if (left > best_left)
+		{
+			best = member;
+			best_left = left;
+		}
+	}
+
+	/* stops where the next range somebody has or is getting starts */
+	if (dcc_ranges_gap (taken, group->size, &start, &end))
+	{
+		g_array_free (taken, TRUE);
+		goto claim;
+	}
+	g_array_free (taken, TRUE);
+
+	if (!best || best_left < DCC_GROUP_MIN_SPLIT)
+		return FALSE;
+
+	end = dcc_group_end (group, best);
+	mid = MAX (best->pos, best->resumable) + best_left / 2;
+	mid -= mid % DCC_GROUP_ALIGN;
+	start = best->io ? dcc_io_set_end (best->io, mid) : mid;
+	if (start >= end)
+		return FALSE;
+	best->end = start;
+
+claim:
+	dcc->resumable = dcc->pos = dcc->ack = start;
+	dcc->end = end;
+	return TRUE;
+}
+
+struct DCC *
+dcc_group_find_source (struct DCC *dcc)
+{
+	struct DCC *d;
+	GSList *list;
+
+	for (list = dcc_list; list; list = list->next)
+	{
+		d = list->data;
+		if (d == dcc || d->type != TYPE_RECV || d->size != dcc->size ||
+			 (d->dccstat != STAT_CONNECTING && d->dccstat != STAT_ACTIVE))
+			continue;
+
+		/* the same sender offering it again isn't another source */
+		if (d->serv == dcc->serv && rfc_casecmp (d->nick, dcc->nick) == 0)
+			continue;
+
+		if (strcmp (d->file, dcc->file) == 0)
+			return d;
+	}
+
+	return NULL;
+}
+
+gboolean
+dcc_group_join (struct DCC *dcc, struct DCC *other)
+{
+	struct dcc_group *group = other->group;
+	GArray *done;
+	gboolean created = FALSE;
+
+	if (!group)
+	{
+		done = g_array_new (FALSE, FALSE, sizeof (struct dcc_range));
+		dcc_ranges_add (done, 0, other->resumable);
+		group = dcc_group_new (other, done);
+		created = TRUE;
+	}
+
+	if (!dcc_group_claim (group, dcc))
+	{
+		if (created)
+		{
+			other->group = NULL;
+			dcc_group_free (group);
+		}
+		return FALSE;
+	}
+
+	g_free (dcc->destfile);
+	dcc->destfile = g_strdup (group->destfile);
+	dcc->group = group;
+	dcc->hidden = TRUE;
+	group->members = g_slist_append (group->members, dcc);
+
+	dcc_group_save (group);
+	return TRUE;
+}
+
+gboolean
+dcc_group_restore (struct DCC *dcc)
+{
+	struct dcc_group *group;
+	GArray *done;
+	char *filename_fs, *parts_fs;
+
+	filename_fs = g_filename_from_utf8 (dcc->destfile, -1, NULL, NULL, NULL);
+	if (!filename_fs)
+		return FALSE;
+	parts_fs = g_strconcat (filename_fs, ".parts", NULL);
+	g_free (filename_fs);
+
+	done = dcc_group_load (parts_fs, dcc->size);
+	g_free (parts_fs);
+	if (!done)
+		return FALSE;
+
+	group = dcc_group_new (dcc, done);
+	if (!dcc_group_claim (group, dcc))
+	{
+		/* everything's there already */
+		dcc->group = NULL;
+		dcc_group_free (group);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+gboolean
+dcc_group_remove (struct DCC *dcc)
+{
+	struct dcc_group *group = dcc->group;
+	struct DCC *next = NULL;
+	GSList *list;
+	gboolean complete;
+
+	dcc_ranges_add (group->done, dcc->resumable, dcc->pos);
+	group->members = g_slist_remove (group->members, dcc);
+	dcc->group = NULL;
+	dcc->end = 0;
+
+	if (group->shown == dcc && group->members)
+	{
+		/* hand the row over to one that's still going */
+		for (list = group->members; list; list = list->next)
+		{
+			next = list->data;
+			if (next->dccstat == STAT_ACTIVE)
+				break;
+		}
+		group->shown = next;
+		next->hidden = FALSE;
+		dcc->hidden = TRUE;
+		fe_dcc_remove (dcc);
+		fe_dcc_add (next);
+	}
+
+	if (group->members)
+	{
+		dcc_group_save (group);
+		return FALSE;
+	}
+
+	complete = dcc_ranges_total (group->done) >= group->size;
+	if (complete)
+	{
+		g_unlink (group->parts_fs);
+
+		/* it now stands for the whole file */
+		dcc->resumable = group->had;
+		dcc->pos = dcc->ack = group->size;
+		dcc->starttime = group->starttime;
+	}
+	else
+	{
+		dcc_group_save (group);
+	}
+
+	if (dcc->hidden)
+	{
+		dcc->hidden = FALSE;
+		fe_dcc_add (dcc);
+	}
+
+	dcc_group_free (group);
+	return complete;
+}
+
+struct DCC *
+dcc_group_shown (struct DCC *dcc)
+{
+	return dcc->group ? dcc->group->shown : dcc;
+}
+
+void
+dcc_group_progress (struct DCC *dcc, guint64 *pos, gint64 *cps)
+{
+	struct dcc_group *group = dcc->group;
+	struct DCC *member;
+	GArray *ranges;
+	GSList *list;
+
+	ranges = dcc_group_covered (group, FALSE);
+	*pos = dcc_ranges_total (ranges);
+	g_array_free (ranges, TRUE);
+
+	*cps = 0;
+	for (list = group->members; list; list = list->next)
+	{
+		member = list->data;
+		if (member->dccstat == STAT_ACTIVE)
+			*cps += member->cps;
+	}
+}
+
+void
+dcc_group_save_all (void)
+{
+	static time_t last = 0;
+	time_t now = time (0);
+	GSList *list;
+
+	if (now - last < DCC_GROUP_SAVE_INTERVAL)
+		return;
+	last = now;
+
+	for (list = dcc_groups; list; list = list->next)
+		dcc_group_save (list->data);
+}
@@ -0,0 +1,50 @@
+/* HexChat
+ * Copyright (C) 1998-2010 Peter Zelezny.
+ * Copyright (C) 2009-2013 Berke Viktor.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#ifndef HEXCHAT_DCCGROUP_H
+#define HEXCHAT_DCCGROUP_H
+
+#include <glib.h>
+
+struct DCC;
+
+/* A file received from several senders at once. Every member DCC fetches
+   its own range, [dcc->resumable, dcc->end), into the same file. Only one
+   of them is shown in the DCC window, with the progress of all of them. */
+struct dcc_group;
+
+/* a running receive of the same file from someone else, or NULL */
+struct DCC *dcc_group_find_source (struct DCC *dcc);
+/* makes dcc fetch part of what other is receiving, FALSE if there's not
+   enough left to share */
+gboolean dcc_group_join (struct DCC *dcc, struct DCC *other);
+/* picks up the parts an earlier multi-source download of dcc->destfile
+   left behind, FALSE if there are none */
+gboolean dcc_group_restore (struct DCC *dcc);
+/* takes a member that stopped out of its group. Returns TRUE if the
+   download is complete, which makes dcc a regular finished DCC. */
+gboolean dcc_group_remove (struct DCC *dcc);
+
+/* the member that stands for the whole download */
+struct DCC *dcc_group_shown (struct DCC *dcc);
+void dcc_group_progress (struct DCC *dcc, guint64 *pos, gint64 *cps);
+/* writes out the parts of every download, called once a second */
+void dcc_group_save_all (void);
+
+#endif
@@ -0,0 +1,452 @@
+/* HexChat
+ * Copyright (C) 1998-2010 Peter Zelezny.
+ * Copyright (C) 2009-2013 Berke Viktor.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/* File hashes for DCC transfers. Receives feed what they get into a
+   dcc_hash on the transfer thread, so the hash is ready as soon as the last
+   byte is written. Files we offer are read once and remembered by path,
+   size and mtime, so offering the same file again costs nothing. Next to
+   SHA-256 we do XXH64, which is cheap enough to check large files with. */
+
+#include <string.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#ifdef WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+
+#include "hexchat.h"
+#include "dcchash.h"
+
+#define DCC_HASH_READ_BUF (256 * 1024)
+#define DCC_HASH_CACHE_SIZE 256			/* files remembered */
+
+#define XXH_PRIME64_1 G_GUINT64_CONSTANT (0x9E3779B185EBCA87)
+#define XXH_PRIME64_2 G_GUINT64_CONSTANT (0xC2B2AE3D27D4EB4F)
+#define XXH_PRIME64_3 G_GUINT64_CONSTANT (0x165667B19E3779F9)
+#define XXH_PRIME64_4 G_GUINT64_CONSTANT (0x85EBCA77C2B2AE63)
+#define XXH_PRIME64_5 G_GUINT64_CONSTANT (0x27D4EB2F165667C5)
+
+#define XXH_ROTL64(x, r) (((x) << (r)) | ((x) >> (64 - (r))))
+
+struct _dcc_hash
+{
+	GChecksum *sha256;
+
+	/* XXH64, seed 0 */
+	guint64 v[4];
+	guint64 total;
+	guchar mem[32];
+	gsize memsize;
+};
+
+typedef struct
+{
+	guint64 size;
+	gint64 mtime;
+	char *sha256;
+	char *xxh64;
+} dcc_hash_entry;
+
+typedef struct
+{
+	dcc_hash_cb cb;
+	gpointer userdata;
+} dcc_hash_waiter;
+
+typedef struct
+{
+	char *path;
+	char *filename_fs;
+	guint64 size;
+	gint64 mtime;
+	char *sha256;
+	char *xxh64;
+} dcc_hash_job;
+
+static GHashTable *hash_cache = NULL;		/* path -> dcc_hash_entry */
+static GQueue hash_cache_order = G_QUEUE_INIT;	/* its keys, oldest first */
+static GHashTable *hash_pending = NULL;	/* path -> GSList of dcc_hash_waiter */
+
+static guint64
+xxh_read64 (const guchar *p)
+{
+	guint64 v;
+
+	memcpy (&v, p, 8);
+	return GUINT64_FROM_LE (v);
+}
+
+static guint32
+xxh_read32 (const guchar *p)
+{
+	guint32 v;
+
+	memcpy (&v, p, 4);
+	return GUINT32_FROM_LE (v);
+}
+
+static guint64
+xxh_round (guint64 acc, guint64 input)
+{
+	acc += input * XXH_PRIME64_2;
+	acc = XXH_ROTL64 (acc, 31);
+	return acc * XXH_PRIME64_1;
+}
+
+static guint64
+xxh_merge_round (guint64 acc, guint64 val)
+{
+	acc ^= xxh_round (0, val);
+	return acc * XXH_PRIME64_1 + XXH_PRIME64_4;
+}
+
+static void
+xxh_stripe (dcc_hash *hash, const guchar *p)
+{
+	hash->v[0] = xxh_round (hash->v[0], xxh_read64 (p));
+	hash->v[1] = xxh_round (hash->v[1], xxh_read64 (p + 8));
+	hash->v[2] = xxh_round (hash->v[2], xxh_read64 (p + 16));
+	hash->v[3] = xxh_round (hash->v[3], xxh_read64 (p + 24));
+}
+
+static guint64
+xxh_digest (dcc_hash *hash)
+{
+	const guchar *p = hash->mem;
+	const guchar *end = hash->mem + hash->memsize;
+	guint64 h;
+	int i;
+
+	if (hash->total >= 32)
+	{
+		h = XXH_ROTL64 (hash->v[0], 1) + XXH_ROTL64 (hash->v[1], 7) +
+			 XXH_ROTL64 (hash->v[2], 12) + XXH_ROTL64 (hash->v[3], 18);
+		for (i = 0; i < 4; i++)
+			h = xxh_merge_round (h, hash->v[i]);
+	}
+	else
+	{
+		h = XXH_PRIME64_5;
+	}
+	h += hash->total;
+
+	for (; p + 8 <= end; p += 8)
+	{
+		h ^= xxh_round (0, xxh_read64 (p));
+		h = XXH_ROTL64 (h, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+	}
+	if (p + 4 <= end)
+	{
+		h ^= (guint64) xxh_read32 (p) * XXH_PRIME64_1;
+		h = XXH_ROTL64 (h, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+		p += 4;
+	}
+	for (; p < end; p++)
+	{
+		h ^= *p * XXH_PRIME64_5;
+		h = XXH_ROTL64 (h, 11) * XXH_PRIME64_1;
+	}
+
+	h ^= h >> 33;
+	h *= XXH_PRIME64_2;
+	h ^= h >> 29;
+	h *= XXH_PRIME64_3;
+	h ^= h >> 32;
+	return h;
+}
+
+dcc_hash *
+dcc_hash_new (void)
+{
+	dcc_hash *hash;
+
+	hash = g_new0 (dcc_hash, 1);
+	hash->sha256 = g_checksum_new (G_CHECKSUM_SHA256);
+	hash->v[0] = XXH_PRIME64_1 + XXH_PRIME64_2;
+	hash->v[1] = XXH_PRIME64_2;
+	hash->v[2] = 0;
+	hash->v[3] = -XXH_PRIME64_1;
+
+	return hash;
+}
+
+void
+dcc_hash_update (dcc_hash *hash, const void *data, gsize len)
+{
+	const guchar *p = data;
+	const guchar *end = p + len;
+	gsize fill;
+
+	g_checksum_update (hash->sha256, data, len);
+	hash->total += len;
+
+	/* top up what was left over from last time */
+	if (hash->memsize)
+	{
+		fill = MIN (len, 32 - hash->memsize);
+		memcpy (hash->mem + hash->memsize, p, fill);
+		hash->memsize += fill;
+		p += fill;
+		if (hash->memsize < 32)
+			return;
+		xxh_stripe (hash, hash->mem);
+		hash->memsize = 0;
+	}
+
+	for (; p + 32 <= end; p += 32)
+		xxh_stripe (hash, p);
+
+	hash->memsize = end - p;
+	memcpy (hash->mem, p, hash->memsize);
+}
+
+gboolean
+dcc_hash_read (dcc_hash *hash, const char *filename_fs, guint64 len)
+{
+	char *buf;
+	gssize n;
+	int fd;
+
+	fd = g_open (filename_fs, OFLAGS | O_RDONLY, 0);
+	if (fd == -1)
+		return FALSE;
+
+	buf = g_malloc (DCC_HASH_READ_BUF);
+	while (len > 0)
+	{
+		n = read (fd, buf, MIN (len, DCC_HASH_READ_BUF));
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 1)
+			break;
+
+		dcc_hash_update (hash, buf, n);
+		len -= n;
+	}
+	g_free (buf);
+	close (fd);
+
+	return len == 0;
+}
+
+void
+dcc_hash_finish (dcc_hash *hash, char **sha256, char **xxh64)
+{
+	*sha256 = g_strdup (g_checksum_get_string (hash->sha256));
+	*xxh64 = g_strdup_printf ("%016" G_GINT64_MODIFIER "x", xxh_digest (hash));
+	dcc_hash_free (hash);
+}
+
+void
+dcc_hash_free (dcc_hash *hash)
+{
+	g_checksum_free (hash->sha256);
+	g_free (hash);
+}
+
+static gboolean
+dcc_hash_stat (const char *path, guint64 *size, gint64 *mtime)
+{
+	GStatBuf st;
+	char *filename_fs;
+	int ret;
+
+	filename_fs = g_filename_from_utf8 (path, -1, NULL, NULL, NULL);
+	if (!filename_fs)
+		return FALSE;
+	ret = g_stat (filename_fs, &st);
+	g_free (filename_fs);
+	if (ret != 0)
+		return FALSE;
+
+	*size = st.st_size;
+	*mtime = st.st_mtime;
+	return TRUE;
+}
+
+static void
+dcc_hash_entry_free (gpointer data)
+{
+	dcc_hash_entry *entry = data;
+
+	g_free (entry->sha256);
+	g_free (entry->xxh64);
+	g_free (entry);
+}
+
+static void
+dcc_hash_cache_add (const char *path, guint64 size, gint64 mtime,
+						  const char *sha256, const char *xxh64)
+{
+	dcc_hash_entry *entry;
+	gpointer key;
+
+	if (!hash_cache)
+		hash_cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, dcc_hash_entry_free);
+
+	if (g_hash_table_lookup_extended (hash_cache, path, &key, NULL))
+	{
+		g_queue_remove (&hash_cache_order, key);
+		g_hash_table_remove (hash_cache, path);
+	}
+	else if (g_hash_table_size (hash_cache) >= DCC_HASH_CACHE_SIZE)
+	{
+		g_hash_table_remove (hash_cache, g_queue_pop_head (&hash_cache_order));
+	}
+
+	entry = g_new (dcc_hash_entry, 1);
+	entry->size = size;
+	entry->mtime = mtime;
+	entry->sha256 = g_strdup (sha256);
+	entry->xxh64 = g_strdup (xxh64);
+
+	key = g_strdup (path);
+	g_hash_table_insert (hash_cache, key, entry);
+	g_queue_push_tail (&hash_cache_order, key);
+}
+
+static dcc_hash_entry *
+dcc_hash_cache_find (const char *path, guint64 size, gint64 mtime)
+{
+	dcc_hash_entry *entry;
+
+	if (!hash_cache)
+		return NULL;
+
+	entry = g_hash_table_lookup (hash_cache, path);
+	if (entry && entry->size == size && entry->mtime == mtime)
+		return entry;
+	return NULL;
+}
+
+void
+dcc_hash_store (const char *path, const char *sha256, const char *xxh64)
+{
+	guint64 size;
+	gint64 mtime;
+
+	if (dcc_hash_stat (path, &size, &mtime))
+		dcc_hash_cache_add (path, size, mtime, sha256, xxh64);
+}
+
+static void
+dcc_hash_job_free (gpointer data)
+{
+	dcc_hash_job *job = data;
+
+	g_free (job->path);
+	g_free (job->filename_fs);
+	g_free (job->sha256);
+	g_free (job->xxh64);
+	g_free (job);
+}
+
+static void
+dcc_hash_thread (GTask *task, gpointer source, gpointer task_data, GCancellable *cancellable)
+{
+	dcc_hash_job *job = task_data;
+	dcc_hash *hash;
+
+	hash = dcc_hash_new ();
+	if (dcc_hash_read (hash, job->filename_fs, job->size))
+		dcc_hash_finish (hash, &job->sha256, &job->xxh64);
+	else
+		dcc_hash_free (hash);
+
+	g_task_return_boolean (task, TRUE);
+}
+
+static void
+dcc_hash_job_done (GObject *source, GAsyncResult *result, gpointer data)
+{
+	dcc_hash_job *job = g_task_get_task_data (G_TASK (result));
+	dcc_hash_waiter *waiter;
+	GSList *waiters, *list;
+
+	if (job->sha256)
+		dcc_hash_cache_add (job->path, job->size, job->mtime, job->sha256, job->xxh64);
+
+	waiters = g_hash_table_lookup (hash_pending, job->path);
+	g_hash_table_remove (hash_pending, job->path);
+
+	for (list = waiters; list; list = list->next)
+	{
+		waiter = list->data;
+		waiter->cb (job->sha256, job->xxh64, waiter->userdata);
+		g_free (waiter);
+	}
+	g_slist_free (waiters);
+}
+
+void
+dcc_hash_file (const char *path, dcc_hash_cb cb, gpointer userdata)
+{
+	dcc_hash_entry *entry;
+	dcc_hash_waiter *waiter;
+	dcc_hash_job *job;
+	GSList *waiters;
+	GTask *task;
+	guint64 size;
+	gint64 mtime;
+
+	if (!dcc_hash_stat (path, &size, &mtime))
+	{
+		cb (NULL, NULL, userdata);
+		return;
+	}
+
+	entry = dcc_hash_cache_find (path, size, mtime);
+	if (entry)
+	{
+		cb (entry->sha256, entry->xxh64, userdata);
+		return;
+	}
+
+	waiter = g_new (dcc_hash_waiter, 1);
+	waiter->cb = cb;
+	waiter->userdata = userdata;
+
+	/* the same file offered to several people at once is read only once */
+	if (!hash_pending)
+		hash_pending = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	waiters = g_hash_table_lookup (hash_pending, path);
+	if (waiters)
+	{
+		waiters = g_slist_append (waiters, waiter);
+		return;
+	}
+	g_hash_table_insert (hash_pending, g_strdup (path), g_slist_append (NULL, waiter));
+
+	job = g_new0 (dcc_hash_job, 1);
+	job->path = g_strdup (path);
+	job->filename_fs = g_filename_from_utf8 (path, -1, NULL, NULL, NULL);
+	job->size = size;
+	job->mtime = mtime;
+
+	task = g_task_new (NULL, NULL, dcc_hash_job_done, NULL);
+	g_task_set_task_data (task, job, dcc_hash_job_free);
+	g_task_run_in_thread (task, dcc_hash_thread);
+	g_object_unref (task);
+}
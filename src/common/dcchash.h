@@ -0,0 +1,47 @@
+/* HexChat
+ * Copyright (C) 1998-2010 Peter Zelezny.
+ * Copyright (C) 2009-2013 Berke Viktor.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#ifndef HEXCHAT_DCCHASH_H
+#define HEXCHAT_DCCHASH_H
+
+#include <glib.h>
+
+/* SHA-256 and XXH64 of a file, computed over the bytes as a transfer moves
+   them. Results are hex strings. */
+typedef struct _dcc_hash dcc_hash;
+
+/* any thread */
+dcc_hash *dcc_hash_new (void);
+void dcc_hash_update (dcc_hash *hash, const void *data, gsize len);
+/* feeds the first len bytes of a file, FALSE if they couldn't be read */
+gboolean dcc_hash_read (dcc_hash *hash, const char *filename_fs, guint64 len);
+/* frees hash, the strings are the caller's */
+void dcc_hash_finish (dcc_hash *hash, char **sha256, char **xxh64);
+void dcc_hash_free (dcc_hash *hash);
+
+/* GUI thread only. Paths are UTF-8 like dcc->file, results are cached by
+   path and only used while the file's size and mtime stay the same. */
+typedef void (*dcc_hash_cb) (const char *sha256, const char *xxh64, gpointer userdata);
+
+void dcc_hash_store (const char *path, const char *sha256, const char *xxh64);
+/* calls cb right away if it's cached, else once a thread has read the
+   file. sha256 and xxh64 are NULL if it couldn't. */
+void dcc_hash_file (const char *path, dcc_hash_cb cb, gpointer userdata);
+
+#endif
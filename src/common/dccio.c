@@ -0,0 +1,766 @@
+/* HexChat
+ * Copyright (C) 1998-2010 Peter Zelezny.
+ * Copyright (C) 2009-2013 Berke Viktor.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/* DCC file transfers, one thread per transfer. The thread blocks in poll ()
+   on its socket instead of going through the GUI main loop. Sends go
+   straight from the page cache with sendfile () where we have it and the
+   thread reads the receiver's acks itself. Receives are collected in a
+   large buffer that is written out once it fills up or gets old, and acks
+   go out once per burst instead of once per recv (). How much may be
+   moved at a time is up to the token buckets in dccsched.c. Receives can
+   also be hashed on the way, see dcchash.c. */
+
+/* Required to make off_t 64 bits for sendfile () */
+#define _FILE_OFFSET_BITS 64
+/* for fallocate () */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+
+#define WANTSOCKET
+#define WANTARPA
+#include "inet.h"
+
+#ifdef WIN32
+#include <io.h>
+#ifndef SHUT_RDWR
+#define SHUT_RDWR SD_BOTH
+#endif
+#else
+#include <unistd.h>
+#include <poll.h>
+#endif
+
+#ifdef HAVE_SENDFILE
+#include <sys/sendfile.h>
+#endif
+
+#include "hexchat.h"
+#include "dcc.h"
+#include "dccio.h"
+#include "dccsched.h"
+#include "dcchash.h"
+
+#define DCC_IO_CHUNK (256 * 1024)		/* most we hand the kernel at once */
+#define DCC_IO_SNDBUF (512 * 1024)
+#define DCC_IO_POLL 1000					/* ms, only matters for the stall timeout */
+
+#define DCC_IO_RECV_BUF (1024 * 1024)
+#define DCC_IO_FLUSH_SIZE (512 * 1024)	/* write out once this much is buffered */
+#define DCC_IO_FLUSH_INTERVAL 1000		/* ms, or the oldest buffered byte is this old */
+#define DCC_IO_ACK_BYTES (64 * 1024)	/* ack right away once this much is unacked */
+#define DCC_IO_ACK_DELAY 2					/* ms of silence that end a burst */
+
+struct _dcc_io
+{
+	GThread *thread;
+	GMutex mutex;
+	struct DCC *dcc;			/* only handed back to the GUI thread */
+	dcc_sched_xfer *sched;
+	dcc_io_done_cb done;
+	guint done_tag;
+
+	/* read-only for the thread */
+	int sok;
+	int fd;
+	guint64 size;
+	guint64 resumable;
+	gsize blocksize;
+	gboolean fastsend;
+
+	/* sends: file data read but not sent yet (unused with sendfile ())
+	   receives: data not written to the file yet */
+	char *buf;
+	guint64 buf_start;
+	gsize buf_len;
+
+	/* receives: what we got so far, and where to read what a resumed
+	   transfer got before */
+	dcc_hash *hash;
+	char *hash_prefix;
+	char *sha256;
+	char *xxh64;
+
+	/* shared, guarded by mutex */
+	guint64 pos;
+	guint64 ack;
+	guint64 end;				/* receives stop here */
+	guint64 claimed;			/* how far the current recv () may get */
+	guint64 written;			/* what is in the file */
+	time_t lasttime;
+	gboolean stop;
+	int result;
+	int error;
+};
+
+static void
+dcc_io_set_sndbuf (int sok)
+{
+	int size;
+	socklen_t len = sizeof (size);
+
+	/* leave it alone if the system already gives us more */
+	if (getsockopt (sok, SOL_SOCKET, SO_SNDBUF, (char *) &size, &len) == 0 && size >= DCC_IO_SNDBUF)
+		return;
+
+	size = DCC_IO_SNDBUF;
+	setsockopt (sok, SOL_SOCKET, SO_SNDBUF, (char *) &size, sizeof (size));
+}
+
+/* Waits for data to read and, if want_write, for room in the socket
+   buffer. Returns -1 on error. */
+static int
+dcc_io_wait (int sok, gboolean want_write, int timeout, gboolean *readable, gboolean *writable)
+{
+#ifdef WIN32
+	fd_set rfds, wfds;
+	struct timeval tv;
+	int ret;
+
+	FD_ZERO (&rfds);
+	FD_ZERO (&wfds);
+	FD_SET (sok, &rfds);
+	if (want_write)
+		FD_SET (sok, &wfds);
+	tv.tv_sec = timeout / 1000;
+	tv.tv_usec = (timeout % 1000) * 1000;
+
+	ret = select (sok + 1, &rfds, &wfds, NULL, &tv);
+	*readable = ret > 0 && FD_ISSET (sok, &rfds);
+	*writable = ret > 0 && FD_ISSET (sok, &wfds);
+	return ret;
+#else
+	struct pollfd pfd;
+	int ret;
+
+	pfd.fd = sok;
+	pfd.events = POLLIN | (want_write ? POLLOUT : 0);
+	pfd.revents = 0;
+
+	ret = poll (&pfd, 1, timeout);
+	if (ret < 0 && errno == EINTR)
+		ret = 0;
+	*readable = ret > 0 && (pfd.revents & (POLLIN | POLLERR | POLLHUP));
+	*writable = ret > 0 && (pfd.revents & POLLOUT);
+	return ret;
+#endif
+}
+
+/* Sends up to len bytes of the file from pos on. Returns how much was sent,
+   0 if the socket buffer is full or -1 with error set. */
+static gssize
+dcc_io_send_chunk (dcc_io *io, guint64 pos, gsize len, int *error)
+{
+	gssize n;
+#ifdef HAVE_SENDFILE
+	off_t offset = pos;
+
+	n = sendfile (io->sok, io->fd, &offset, len);
+	if (n > 0)
+		return n;
+	if (n < 0 && would_block ())
+		return 0;
+
+	/* 0 means the file got shorter under us */
+	*error = n < 0 ? errno : EIO;
+	return -1;
+#else
+	gsize off;
+
+	if (pos < io->buf_start || pos >= io->buf_start + io->buf_len)
+	{
+#ifdef WIN32
+		if (_lseeki64 (io->fd, pos, SEEK_SET) == -1)
+			n = -1;
+		else
+			n = read (io->fd, io->buf, DCC_IO_CHUNK);
+#else
+		n = pread (io->fd, io->buf, DCC_IO_CHUNK, pos);
+#endif
+		if (n < 1)
+		{
+			*error = n < 0 ? errno : EIO;
+			return -1;
+		}
+		io->buf_start = pos;
+		io->buf_len = n;
+	}
+
+	off = pos - io->buf_start;
+	if (len > io->buf_len - off)
+		len = io->buf_len - off;
+
+	n = send (io->sok, io->buf + off, len, 0);
+	if (n >= 0)
+		return n;
+	if (would_block ())
+		return 0;
+
+	*error = sock_error ();
+	return -1;
+#endif
+}
+
+/* Turns what the receiver acked into a position in the file. */
+static guint64
+dcc_io_ack (dcc_io *io, guint32 ack32, guint64 pos, gboolean *ackoffset)
+{
+	guint64 ack = ack32;
+
+	if (io->size <= 0xffffffff)
+	{
+		/* fix for BitchX */
+		if (ack < io->resumable)
+			*ackoffset = TRUE;
+		if (*ackoffset)
+			ack += io->resumable;
+		return ack;
+	}
+
+	/* acks only carry the low 32 bits, take the rest from what we sent */
+	ack |= pos & G_GINT64_CONSTANT (0xffffffff00000000);
+	if (ack > pos && ack >= G_GINT64_CONSTANT (0x100000000))
+		ack -= G_GINT64_CONSTANT (0x100000000);
+	return ack;
+}
+
+static gboolean
+dcc_io_done (gpointer data)
+{
+	dcc_io *io = data;
+	dcc_io_done_cb done = io->done;
+	struct DCC *dcc = io->dcc;
+	int result, error;
+
+	g_mutex_lock (&io->mutex);
+	io->done_tag = 0;
+	result = io->result;
+	error = io->error;
+	g_mutex_unlock (&io->mutex);
+
+	g_thread_join (io->thread);
+	io->thread = NULL;
+	dcc_io_sync (io);
+
+	/* this ends in dcc_close () which frees io */
+	done (dcc, result, error);
+
+	return G_SOURCE_REMOVE;
+}
+
+static void
+dcc_io_finish (dcc_io *io, int result, int error)
+{
+	g_mutex_lock (&io->mutex);
+	io->result = result;
+	io->error = error;
+	if (!io->stop)
+		io->done_tag = g_idle_add (dcc_io_done, io);
+	g_mutex_unlock (&io->mutex);
+}
+
+static gpointer
+dcc_io_send_thread (gpointer data)
+{
+	dcc_io *io = data;
+	unsigned char ack_buf[4];
+	int ack_pos = 0;
+	gboolean ackoffset = FALSE;
+	gboolean want_write, readable, writable;
+	guint64 pos, ack;
+	guint32 ack32;
+	gssize n;
+	gsize len = 0;
+	int error, timeout, wait;
+
+	g_mutex_lock (&io->mutex);
+	pos = io->pos;
+	ack = io->ack;
+	g_mutex_unlock (&io->mutex);
+
+	while (1)
+	{
+		g_mutex_lock (&io->mutex);
+		if (io->stop)
+		{
+			g_mutex_unlock (&io->mutex);
+			return NULL;
+		}
+		g_mutex_unlock (&io->mutex);
+
+		/* without fastsend every block waits for the last one to be acked */
+		want_write = pos < io->size && (io->fastsend || ack >= pos);
+		timeout = DCC_IO_POLL;
+		if (want_write)
+		{
+			len = io->fastsend ? DCC_IO_CHUNK : io->blocksize;
+			if (len > io->size - pos)
+				len = io->size - pos;
+
+			len = dcc_sched_quota (io->sched, len, &wait);
+			if (len == 0)
+			{
+				want_write = FALSE;
+				timeout = wait;
+			}
+		}
+
+		if (dcc_io_wait (io->sok, want_write, timeout, &readable, &writable) < 0)
+		{
+			dcc_io_finish (io, DCC_IO_FAILED, sock_error ());
+			return NULL;
+		}
+
+		while (readable)
+		{
+			n = recv (io->sok, (char *) ack_buf + ack_pos, 4 - ack_pos, 0);
+			if (n < 1)
+			{
+				if (n < 0 && would_block ())
+					break;
+				dcc_io_finish (io, DCC_IO_FAILED, (n < 0) ? sock_error () : 0);
+				return NULL;
+			}
+
+			ack_pos += n;
+			if (ack_pos < 4)
+				continue;
+			ack_pos = 0;
+
+			memcpy (&ack32, ack_buf, 4);
+			ack = dcc_io_ack (io, ntohl (ack32), pos, &ackoffset);
+
+			g_mutex_lock (&io->mutex);
+			io->ack = ack;
+			g_mutex_unlock (&io->mutex);
+
+			if (pos >= io->size && ack >= io->size)
+			{
+				dcc_io_finish (io, DCC_IO_DONE, 0);
+				return NULL;
+			}
+		}
+
+		if (want_write && writable)
+		{
+			n = dcc_io_send_chunk (io, pos, len, &error);
+			if (n < 0)
+			{
+				dcc_io_finish (io, DCC_IO_FAILED, error);
+				return NULL;
+			}
+			if (n > 0)
+			{
+				dcc_sched_consume (io->sched, n);
+				pos += n;
+
+				g_mutex_lock (&io->mutex);
+				io->pos = pos;
+				io->lasttime = time (0);
+				g_mutex_unlock (&io->mutex);
+			}
+		}
+	}
+}
+
+/* Writes out everything buffered, returns 0 or the errno of the write.
+   buf_start is where the buffer goes in the file. */
+static int
+dcc_io_flush (dcc_io *io)
+{
+	char *p = io->buf;
+	gssize n;
+	int error = 0;
+
+	while (io->buf_len > 0)
+	{
+		n = write (io->fd, p, io->buf_len);
+		if (n < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			error = errno;	/* could be out of hdd space */
+			break;
+		}
+		p += n;
+		io->buf_len -= n;
+		io->buf_start += n;
+	}
+
+	g_mutex_lock (&io->mutex);
+	io->written = io->buf_start;
+	g_mutex_unlock (&io->mutex);
+
+	return error;
+}
+
+static void
+dcc_io_send_ack (dcc_io *io, guint64 pos)
+{
+	/* send in 32-bit big endian */
+	guint32 ack = htonl (pos & 0xffffffff);
+	send (io->sok, (char *) &ack, 4, 0);
+}
+
+static void
+dcc_io_preallocate (dcc_io *io, guint64 pos)
+{
+#ifdef HAVE_FALLOCATE
+	/* reserves the blocks without growing the file, which resuming goes by */
+	if (io->size > pos)
+		fallocate (io->fd, FALLOC_FL_KEEP_SIZE, pos, io->size - pos);
+#endif
+}
+
+static void
+dcc_io_recv_end (dcc_io *io, int result, int error)
+{
+	int flush_error;
+
+	/* even a failed transfer keeps what it got, for resuming */
+	flush_error = dcc_io_flush (io);
+	if (result == DCC_IO_DONE && flush_error)
+	{
+		result = DCC_IO_FAILED;
+		error = flush_error;
+	}
+
+	/* what couldn't be written wasn't received as far as resuming goes */
+	g_mutex_lock (&io->mutex);
+	io->pos = io->written;
+	g_mutex_unlock (&io->mutex);
+
+	if (io->hash)
+	{
+		if (result == DCC_IO_DONE)
+			dcc_hash_finish (io->hash, &io->sha256, &io->xxh64);
+		else
+			dcc_hash_free (io->hash);
+		io->hash = NULL;
+	}
+
+	dcc_io_finish (io, result, error);
+}
+
+/* everything up to the end is here */
+static void
+dcc_io_recv_complete (dcc_io *io, guint64 pos)
+{
+	int error;
+
+	/* the sender may close as soon as it sees this, so flush first */
+	error = dcc_io_flush (io);
+	if (!error)
+		dcc_io_send_ack (io, pos);
+	dcc_io_recv_end (io, error ? DCC_IO_FAILED : DCC_IO_DONE, error);
+}
+
+static gpointer
+dcc_io_recv_thread (gpointer data)
+{
+	dcc_io *io = data;
+	gboolean readable, writable;
+	gint64 now, dirty_since = 0;
+	guint64 pos, acked, end;
+	gsize quota, len;
+	gssize n;
+	int timeout, error;
+
+	g_mutex_lock (&io->mutex);
+	pos = acked = io->pos;
+	io->buf_start = io->written = pos;
+	g_mutex_unlock (&io->mutex);
+
+	dcc_io_preallocate (io, pos);
+
+	/* a resumed file has to be hashed from the start */
+	if (io->hash && pos > 0 &&
+		 (!io->hash_prefix || !dcc_hash_read (io->hash, io->hash_prefix, pos)))
+	{
+		dcc_hash_free (io->hash);
+		io->hash = NULL;
+	}
+
+	while (1)
+	{
+		g_mutex_lock (&io->mutex);
+		if (io->stop)
+		{
+			g_mutex_unlock (&io->mutex);
+			dcc_io_recv_end (io, DCC_IO_FAILED, 0);
+			return NULL;
+		}
+		g_mutex_unlock (&io->mutex);
+
+		quota = dcc_sched_quota (io->sched, DCC_IO_RECV_BUF, &timeout);
+		if (quota == 0)
+		{
+			/* leave it in the socket until the buckets fill up again */
+			g_usleep (timeout * 1000);
+			readable = FALSE;
+		}
+		else
+		{
+			if (acked != pos)
+				timeout = DCC_IO_ACK_DELAY;
+			else if (dirty_since)
+				timeout = DCC_IO_FLUSH_INTERVAL;
+			else
+				timeout = DCC_IO_POLL;
+
+			if (dcc_io_wait (io->sok, FALSE, timeout, &readable, &writable) < 0)
+			{
+				dcc_io_recv_end (io, DCC_IO_FAILED, sock_error ());
+				return NULL;
+			}
+		}
+
+		while (readable && quota > 0)
+		{
+			if (io->buf_len == DCC_IO_RECV_BUF)
+			{
+				error = dcc_io_flush (io);
+				if (error)
+				{
+					dcc_io_recv_end (io, DCC_IO_FAILED, error);
+					return NULL;
+				}
+				dirty_since = 0;
+			}
+
+			/* a multi-source download may move our end closer while we run */
+			len = MIN (quota, DCC_IO_RECV_BUF - io->buf_len);
+			g_mutex_lock (&io->mutex);
+			end = io->end;
+			if (len > end - pos)
+				len = end - pos;
+			io->claimed = pos + len;
+			g_mutex_unlock (&io->mutex);
+
+			if (len == 0)
+			{
+				dcc_io_recv_complete (io, pos);
+				return NULL;
+			}
+
+			n = recv (io->sok, io->buf + io->buf_len, len, 0);
+			if (n < 1)
+			{
+				if (n < 0 && would_block ())
+					break;
+				dcc_io_recv_end (io, DCC_IO_FAILED, (n < 0) ? sock_error () : 0);
+				return NULL;
+			}
+
+			dcc_sched_consume (io->sched, n);
+			if (io->hash)
+				dcc_hash_update (io->hash, io->buf + io->buf_len, n);
+			quota -= n;
+			io->buf_len += n;
+			pos += n;
+			if (!dirty_since)
+				dirty_since = g_get_monotonic_time ();
+
+			g_mutex_lock (&io->mutex);
+			io->pos = pos;
+			io->lasttime = time (0);
+			g_mutex_unlock (&io->mutex);
+
+			if (pos >= end)
+			{
+				dcc_io_recv_complete (io, pos);
+				return NULL;
+			}
+		}
+
+		/* the burst is over, or has been going on for a while */
+		if (acked != pos && (!readable || pos - acked >= DCC_IO_ACK_BYTES))
+		{
+			dcc_io_send_ack (io, pos);
+			acked = pos;
+		}
+
+		now = g_get_monotonic_time ();
+		if (io->buf_len >= DCC_IO_FLUSH_SIZE ||
+			 (dirty_since && now - dirty_since >= DCC_IO_FLUSH_INTERVAL * 1000))
+		{
+			error = dcc_io_flush (io);
+			if (error)
+			{
+				dcc_io_recv_end (io, DCC_IO_FAILED, error);
+				return NULL;
+			}
+			dirty_since = 0;
+		}
+	}
+}
+
+static dcc_io *
+dcc_io_new (struct DCC *dcc, dcc_io_done_cb done)
+{
+	dcc_io *io;
+
+	io = g_new0 (dcc_io, 1);
+	g_mutex_init (&io->mutex);
+	io->dcc = dcc;
+	io->done = done;
+
+	io->sok = dcc->sok;
+	io->fd = dcc->fp;
+	io->size = dcc->size;
+	io->resumable = dcc->resumable;
+
+	io->pos = dcc->pos;
+	io->ack = dcc->ack;
+	io->end = io->claimed = dcc->end ? dcc->end : dcc->size;
+	io->lasttime = time (0);
+	io->sched = dcc_sched_add (dcc);
+
+	return io;
+}
+
+dcc_io *
+dcc_io_send (struct DCC *dcc, dcc_io_done_cb done)
+{
+	dcc_io *io;
+
+	io = dcc_io_new (dcc, done);
+	io->fastsend = dcc->fastsend;
+	if (prefs.hex_dcc_blocksize < 1) /* this is too little! */
+		io->blocksize = 1024;
+	else
+		io->blocksize = MIN (prefs.hex_dcc_blocksize, 102400);	/* this is too much! */
+#ifndef HAVE_SENDFILE
+	io->buf = g_malloc (DCC_IO_CHUNK);
+#endif
+
+	dcc_io_set_sndbuf (io->sok);
+	io->thread = g_thread_new ("hexchat-dcc", dcc_io_send_thread, io);
+
+	return io;
+}
+
+dcc_io *
+dcc_io_recv (struct DCC *dcc, gboolean hash, dcc_io_done_cb done)
+{
+	dcc_io *io;
+
+	io = dcc_io_new (dcc, done);
+	io->buf = g_malloc (DCC_IO_RECV_BUF);
+	if (hash)
+	{
+		io->hash = dcc_hash_new ();
+		if (dcc->pos > 0)
+			io->hash_prefix = g_filename_from_utf8 (dcc->destfile, -1, NULL, NULL, NULL);
+	}
+
+	io->thread = g_thread_new ("hexchat-dcc", dcc_io_recv_thread, io);
+
+	return io;
+}
+
+void
+dcc_io_sync (dcc_io *io)
+{
+	struct DCC *dcc = io->dcc;
+
+	g_mutex_lock (&io->mutex);
+	dcc->pos = io->pos;
+	dcc->ack = io->ack;
+	dcc->lasttime = io->lasttime;
+	g_mutex_unlock (&io->mutex);
+}
+
+void
+dcc_io_stop (dcc_io *io)
+{
+	guint tag;
+
+	g_mutex_lock (&io->mutex);
+	io->stop = TRUE;
+	tag = io->done_tag;
+	io->done_tag = 0;
+	g_mutex_unlock (&io->mutex);
+
+	if (io->thread)
+	{
+		/* wakes the thread up if it's waiting in poll () */
+		shutdown (io->sok, SHUT_RDWR);
+		g_thread_join (io->thread);
+	}
+	if (tag)
+		g_source_remove (tag);
+
+	dcc_io_sync (io);
+	dcc_sched_remove (io->sched);
+
+	if (io->hash)
+		dcc_hash_free (io->hash);
+
+	g_mutex_clear (&io->mutex);
+	g_free (io->buf);
+	g_free (io->hash_prefix);
+	g_free (io->sha256);
+	g_free (io->xxh64);
+	g_free (io);
+}
+
+guint64
+dcc_io_set_end (dcc_io *io, guint64 end)
+{
+	g_mutex_lock (&io->mutex);
+	/* it can't give back what it's already receiving */
+	if (end < io->claimed)
+		end = io->claimed;
+	if (end < io->end)
+		io->end = end;
+	end = io->end;
+	g_mutex_unlock (&io->mutex);
+
+	return end;
+}
+
+guint64
+dcc_io_written (dcc_io *io)
+{
+	guint64 written;
+
+	g_mutex_lock (&io->mutex);
+	written = io->written;
+	g_mutex_unlock (&io->mutex);
+
+	return written;
+}
+
+gboolean
+dcc_io_hashes (dcc_io *io, char **sha256, char **xxh64)
+{
+	if (!io->sha256)
+		return FALSE;
+
+	*sha256 = io->sha256;
+	*xxh64 = io->xxh64;
+	io->sha256 = io->xxh64 = NULL;
+	return TRUE;
+}
@@ -0,0 +1,62 @@
+/* HexChat
+ * Copyright (C) 1998-2010 Peter Zelezny.
+ * Copyright (C) 2009-2013 Berke Viktor.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#ifndef HEXCHAT_DCCIO_H
+#define HEXCHAT_DCCIO_H
+
+#include <glib.h>
+
+struct DCC;
+
+/* A DCC file transfer running on its own thread. While it runs the thread
+   owns dcc->sok and dcc->fp, the GUI thread only looks at the progress it
+   publishes through dcc_io_sync (). */
+typedef struct _dcc_io dcc_io;
+
+enum
+{
+	DCC_IO_RUNNING,
+	DCC_IO_DONE,
+	DCC_IO_FAILED
+};
+
+/* called on the GUI thread once the transfer finished or failed, error is
+   the errno/socket error of a failure */
+typedef void (*dcc_io_done_cb) (struct DCC *dcc, int result, int error);
+
+/* sends dcc->fp from dcc->pos on and reads the receiver's acks */
+dcc_io *dcc_io_send (struct DCC *dcc, dcc_io_done_cb done);
+/* writes to dcc->fp from dcc->pos on and acks what was received, up to
+   dcc->end or the end of the file. If hash is set the whole file is hashed
+   along the way. */
+dcc_io *dcc_io_recv (struct DCC *dcc, gboolean hash, dcc_io_done_cb done);
+/* copies pos, ack and lasttime into the DCC */
+void dcc_io_sync (dcc_io *io);
+/* stops the thread, syncs a last time and frees io. done won't be called
+   after this. */
+void dcc_io_stop (dcc_io *io);
+/* moves a receive's end closer, but never below what it's already
+   receiving. Returns the end it got. */
+guint64 dcc_io_set_end (dcc_io *io, guint64 end);
+/* how far the file has been written */
+guint64 dcc_io_written (dcc_io *io);
+/* hands over the hashes of a finished receive, FALSE if there are none */
+gboolean dcc_io_hashes (dcc_io *io, char **sha256, char **xxh64);
+
+#endif
@@ -0,0 +1,289 @@
+/* HexChat
+ * Copyright (C) 1998-2010 Peter Zelezny.
+ * Copyright (C) 2009-2013 Berke Viktor.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/* Token buckets for DCC file transfers. A bucket fills up at its rate, up
+   to DCC_SCHED_BURST ms worth of it, and a transfer may only move as many
+   bytes as every bucket in its chain holds. The transfer threads ask
+   before each send ()/recv (), so limits are kept to within a few
+   milliseconds instead of being checked once a second. Peer and network
+   buckets are shared by all transfers going to the same place and live as
+   long as one of them does. */
+
+#include <string.h>
+
+#include "hexchat.h"
+#include "dcc.h"
+#include "server.h"
+#include "util.h"
+#include "dccsched.h"
+
+#define DCC_SCHED_BURST 100			/* ms of rate a bucket can save up */
+#define DCC_SCHED_MIN_CHUNK 4096		/* don't bother waking up for less */
+#define DCC_SCHED_MAX_WAIT 100		/* ms, so changed prefs apply soon */
+
+enum
+{
+	BUCKET_XFER,
+	BUCKET_PEER,
+	BUCKET_NETWORK,
+	BUCKET_GLOBAL,
+	BUCKET_COUNT
+};
+
+typedef struct
+{
+	char *key;						/* in sched_buckets, NULL for a transfer's own */
+	int refs;
+	double tokens;					/* bytes, negative when overdrawn */
+	gint64 last;					/* time of the last refill */
+} dcc_bucket;
+
+struct _dcc_sched_xfer
+{
+	struct DCC *dcc;
+	gboolean send;
+	gint64 maxcps;					/* < 0 exempts it from the shared buckets */
+	dcc_bucket own;
+	dcc_bucket *bucket[BUCKET_COUNT];
+
+	/* for the stats */
+	guint64 bytes;					/* since the last snapshot */
+	gint64 since;
+	gint64 cps;
+	gboolean waited;
+};
+
+static GMutex sched_mutex;
+static GHashTable *sched_buckets = NULL;
+static GSList *sched_xfers = NULL;
+
+static gint64
+dcc_sched_rate (dcc_sched_xfer *xfer, int level)
+{
+	switch (level)
+	{
+	case BUCKET_XFER:
+		return xfer->maxcps;
+	case BUCKET_PEER:
+		return xfer->send ? prefs.hex_dcc_peer_max_send_cps : prefs.hex_dcc_peer_max_get_cps;
+	case BUCKET_NETWORK:
+		return xfer->send ? prefs.hex_dcc_network_max_send_cps : prefs.hex_dcc_network_max_get_cps;
+	default:
+		return xfer->send ? prefs.hex_dcc_global_max_send_cps : prefs.hex_dcc_global_max_get_cps;
+	}
+}
+
+static void
+dcc_bucket_refill (dcc_bucket *b, gint64 rate, gint64 now)
+{
+	double burst;
+	gint64 elapsed;
+
+	burst = MAX (rate * DCC_SCHED_BURST / 1000, DCC_SCHED_MIN_CHUNK);
+	elapsed = MIN (now - b->last, G_USEC_PER_SEC);
+
+	b->tokens += (double) elapsed * rate / G_USEC_PER_SEC;
+	if (b->tokens > burst)
+		b->tokens = burst;
+	b->last = now;
+}
+
+static dcc_bucket *
+dcc_bucket_ref (char *key)
+{
+	dcc_bucket *b;
+
+	if (!sched_buckets)
+		sched_buckets = g_hash_table_new (g_str_hash, g_str_equal);
+
+	b = g_hash_table_lookup (sched_buckets, key);
+	if (b)
+	{
+		g_free (key);
+	}
+	else
+	{
+		b = g_new0 (dcc_bucket, 1);
+		b->key = key;
+		b->last = g_get_monotonic_time ();
+		g_hash_table_insert (sched_buckets, key, b);
+	}
+
+	b->refs++;
+	return b;
+}
+
+static void
+dcc_bucket_unref (dcc_bucket *b)
+{
+	if (--b->refs > 0)
+		return;
+
+	g_hash_table_remove (sched_buckets, b->key);
+	g_free (b->key);
+	g_free (b);
+}
+
+dcc_sched_xfer *
+dcc_sched_add (struct DCC *dcc)
+{
+	dcc_sched_xfer *xfer;
+	char *network, *nick;
+	char dir;
+	int i;
+
+	xfer = g_new0 (dcc_sched_xfer, 1);
+	xfer->dcc = dcc;
+	xfer->send = dcc->type == TYPE_SEND;
+	xfer->maxcps = dcc->maxcps;
+	xfer->own.last = xfer->since = g_get_monotonic_time ();
+
+	network = server_get_network (dcc->serv, TRUE);
+	nick = g_strdup (dcc->nick);
+	for (i = 0; nick[i]; i++)
+		nick[i] = rfc_tolower (nick[i]);
+	dir = xfer->send ? 's' : 'g';
+
+	g_mutex_lock (&sched_mutex);
+	xfer->bucket[BUCKET_XFER] = &xfer->own;
+	xfer->bucket[BUCKET_PEER] = dcc_bucket_ref (g_strdup_printf ("%c:%s:%s", dir, network, nick));
+	xfer->bucket[BUCKET_NETWORK] = dcc_bucket_ref (g_strdup_printf ("%c:%s", dir, network));
+	xfer->bucket[BUCKET_GLOBAL] = dcc_bucket_ref (g_strdup_printf ("%c", dir));
+	sched_xfers = g_slist_prepend (sched_xfers, xfer);
+	g_mutex_unlock (&sched_mutex);
+
+	g_free (nick);
+	return xfer;
+}
+
+void
+dcc_sched_remove (dcc_sched_xfer *xfer)
+{
+	int i;
+
+	g_mutex_lock (&sched_mutex);
+	sched_xfers = g_slist_remove (sched_xfers, xfer);
+	for (i = BUCKET_PEER; i < BUCKET_COUNT; i++)
+		dcc_bucket_unref (xfer->bucket[i]);
+	g_mutex_unlock (&sched_mutex);
+
+	g_free (xfer);
+}
+
+gsize
+dcc_sched_quota (dcc_sched_xfer *xfer, gsize want, int *wait)
+{
+	dcc_bucket *b;
+	gsize allowed = want;
+	double needed;
+	gint64 rate, now;
+	int i, levels, ms;
+
+	/* waking up for a few bytes costs more than it's worth */
+	needed = MIN (want, DCC_SCHED_MIN_CHUNK);
+	levels = xfer->maxcps < 0 ? BUCKET_PEER : BUCKET_COUNT;
+	*wait = 0;
+
+	now = g_get_monotonic_time ();
+	g_mutex_lock (&sched_mutex);
+	for (i = 0; i < levels; i++)
+	{
+		rate = dcc_sched_rate (xfer, i);
+		if (rate <= 0)
+			continue;
+
+		b = xfer->bucket[i];
+		dcc_bucket_refill (b, rate, now);
+		if (b->tokens < needed)
+		{
+			ms = (needed - b->tokens) * 1000 / rate + 1;
+			*wait = MAX (*wait, ms);
+		}
+		else if (b->tokens < allowed)
+		{
+			allowed = b->tokens;
+		}
+	}
+
+	if (*wait)
+	{
+		xfer->waited = TRUE;
+		allowed = 0;
+		*wait = MIN (*wait, DCC_SCHED_MAX_WAIT);
+	}
+	g_mutex_unlock (&sched_mutex);
+
+	return allowed;
+}
+
+void
+dcc_sched_consume (dcc_sched_xfer *xfer, gsize len)
+{
+	int i, levels;
+
+	levels = xfer->maxcps < 0 ? BUCKET_PEER : BUCKET_COUNT;
+
+	g_mutex_lock (&sched_mutex);
+	for (i = 0; i < levels; i++)
+	{
+		/* unlimited buckets don't run up a debt to pay once a limit is set */
+		if (dcc_sched_rate (xfer, i) > 0)
+			xfer->bucket[i]->tokens -= len;
+	}
+	xfer->bytes += len;
+	g_mutex_unlock (&sched_mutex);
+}
+
+GArray *
+dcc_sched_snapshot (void)
+{
+	struct dcc_sched_stats stats;
+	dcc_sched_xfer *xfer;
+	GArray *array;
+	GSList *list;
+	gint64 now, cps;
+
+	array = g_array_sized_new (FALSE, FALSE, sizeof (struct dcc_sched_stats),
+										g_slist_length (sched_xfers));
+	now = g_get_monotonic_time ();
+
+	g_mutex_lock (&sched_mutex);
+	for (list = sched_xfers; list; list = list->next)
+	{
+		xfer = list->data;
+
+		if (now > xfer->since)
+		{
+			cps = xfer->bytes * G_USEC_PER_SEC / (now - xfer->since);
+			/* smooth it out a bit */
+			xfer->cps = xfer->cps ? (xfer->cps + cps) / 2 : cps;
+		}
+		xfer->bytes = 0;
+		xfer->since = now;
+
+		stats.dcc = xfer->dcc;
+		stats.cps = xfer->cps;
+		stats.throttled = xfer->waited;
+		xfer->waited = FALSE;
+		g_array_append_val (array, stats);
+	}
+	g_mutex_unlock (&sched_mutex);
+
+	return array;
+}
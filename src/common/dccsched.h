@@ -0,0 +1,51 @@
+/* HexChat
+ * Copyright (C) 1998-2010 Peter Zelezny.
+ * Copyright (C) 2009-2013 Berke Viktor.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#ifndef HEXCHAT_DCCSCHED_H
+#define HEXCHAT_DCCSCHED_H
+
+#include <glib.h>
+
+struct DCC;
+
+/* Bandwidth shaping for DCC file transfers. Every transfer draws from a
+   chain of token buckets: its own (dcc->maxcps), its peer's, its
+   network's and the global one, each limited by the dcc_*_cps prefs. */
+typedef struct _dcc_sched_xfer dcc_sched_xfer;
+
+struct dcc_sched_stats
+{
+	struct DCC *dcc;
+	gint64 cps;
+	gboolean throttled;		/* had to wait for a bucket since the last snapshot */
+};
+
+/* GUI thread */
+dcc_sched_xfer *dcc_sched_add (struct DCC *dcc);
+void dcc_sched_remove (dcc_sched_xfer *xfer);
+/* an array of struct dcc_sched_stats, one per transfer */
+GArray *dcc_sched_snapshot (void);
+
+/* transfer threads: how much may be moved now, at most want. Returns 0 and
+   sets wait (ms) when the transfer has to wait for tokens. */
+gsize dcc_sched_quota (dcc_sched_xfer *xfer, gsize want, int *wait);
+/* takes what was actually moved out of the buckets */
+void dcc_sched_consume (dcc_sched_xfer *xfer, gsize len);
+
+#endif
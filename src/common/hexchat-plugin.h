@@ -46,6 +46,7 @@ extern "C" {
 typedef struct _hexchat_plugin hexchat_plugin;
 typedef struct _hexchat_list hexchat_list;
 typedef struct _hexchat_hook hexchat_hook;
+typedef struct _hexchat_job hexchat_job;
 #ifndef PLUGIN_C
 typedef struct _hexchat_context hexchat_context;
 #endif
@@ -193,6 +194,39 @@ struct _hexchat_plugin
 	hexchat_event_attrs *(*hexchat_event_attrs_create) (hexchat_plugin *ph);
 	void (*hexchat_event_attrs_free) (hexchat_plugin *ph,
 									  hexchat_event_attrs *attrs);
+	hexchat_list * (*hexchat_list_find) (hexchat_plugin *ph,
+		const char *name,
+		const char *key,
+		const char * const *fields);
+	hexchat_list * (*hexchat_list_cursor) (hexchat_plugin *ph,
+		const char *name,
+		const char * const *fields);
+	const char * (*hexchat_list_str_at) (hexchat_plugin *ph,
+		hexchat_list *xlist,
+		int n);
+	int (*hexchat_list_int_at) (hexchat_plugin *ph,
+		hexchat_list *xlist,
+		int n);
+	time_t (*hexchat_list_time_at) (hexchat_plugin *ph,
+		hexchat_list *xlist,
+		int n);
+	hexchat_job *(*hexchat_job_submit) (hexchat_plugin *ph,
+		void *(*work) (hexchat_job *job, void *user_data),
+		void (*done) (void *result, void *user_data),
+		void *userdata);
+	void (*hexchat_job_cancel) (hexchat_plugin *ph,
+		hexchat_job *job);
+	int (*hexchat_job_cancelled) (hexchat_plugin *ph,
+		hexchat_job *job);
+	int (*hexchat_pluginpref_get_many) (hexchat_plugin *ph,
+		const char * const *vars,
+		char **values,
+		int count);
+	int (*hexchat_pluginpref_set_many) (hexchat_plugin *ph,
+		const char * const *vars,
+		const char * const *values,
+		int count);
+	char **(*hexchat_pluginpref_list_all) (hexchat_plugin *ph);
 };
 #endif
 
@@ -380,6 +414,9 @@ void
 hexchat_free (hexchat_plugin *ph,
 	    void *ptr);
 
+/* The value is kept in memory and written to disk a few seconds later or
+   when the plugin is unloaded, so 1 only means it was set, not that it
+   was saved. A failed write is retried and reported when it's final. */
 int
 hexchat_pluginpref_set_str (hexchat_plugin *ph,
 		const char *var,
@@ -406,6 +443,81 @@ int
 hexchat_pluginpref_list (hexchat_plugin *ph,
 		char *dest);
 
+/* Like hexchat_list_get(), for reading only the NULL terminated fields
+   given, which hexchat_list_*_at() then take by their position. NULL
+   fields are all of them, read by name. */
+hexchat_list *
+hexchat_list_cursor (hexchat_plugin *ph,
+		const char *name,
+		const char * const *fields);
+
+/* A cursor over just the entry of "users", "channels", "notify" or
+   "ignore" that key names, NULL if there's none. */
+hexchat_list *
+hexchat_list_find (hexchat_plugin *ph,
+		const char *name,
+		const char *key,
+		const char * const *fields);
+
+const char *
+hexchat_list_str_at (hexchat_plugin *ph,
+		hexchat_list *xlist,
+		int n);
+
+int
+hexchat_list_int_at (hexchat_plugin *ph,
+		hexchat_list *xlist,
+		int n);
+
+time_t
+hexchat_list_time_at (hexchat_plugin *ph,
+		hexchat_list *xlist,
+		int n);
+
+/* Runs work in a thread of a pool shared by all plugins, then done with
+   what it returned from the main loop, in the context it was submitted
+   in. work must not call the plugin API. done is called for every job,
+   with NULL if it was cancelled before starting, but not once the plugin
+   is unloaded, which cancels its jobs and waits for running work to return
+   before calling hexchat_plugin_deinit, even if that then refuses. NULL if
+   too many jobs are pending already. */
+hexchat_job *
+hexchat_job_submit (hexchat_plugin *ph,
+		void *(*work) (hexchat_job *job, void *user_data),
+		void (*done) (void *result, void *user_data),
+		void *userdata);
+
+/* Asks work to stop, until done is called */
+void
+hexchat_job_cancel (hexchat_plugin *ph,
+		hexchat_job *job);
+
+/* Whether the job was cancelled, for work to check, from any thread */
+int
+hexchat_job_cancelled (hexchat_plugin *ph,
+		hexchat_job *job);
+
+/* Looks up count prefs at once. values[i] gets a copy of the value of
+   vars[i], to free with hexchat_free, or NULL. Returns how many exist. */
+int
+hexchat_pluginpref_get_many (hexchat_plugin *ph,
+		const char * const *vars,
+		char **values,
+		int count);
+
+/* Sets count prefs at once, a NULL value deletes that pref. Written
+   behind like hexchat_pluginpref_set_str(). */
+int
+hexchat_pluginpref_set_many (hexchat_plugin *ph,
+		const char * const *vars,
+		const char * const *values,
+		int count);
+
+/* NULL-terminated array of the names of all prefs, in one block to free
+   with hexchat_free */
+char **
+hexchat_pluginpref_list_all (hexchat_plugin *ph);
+
 #if !defined(PLUGIN_C) && (defined(WIN32) || defined(__CYGWIN__))
 #ifndef HEXCHAT_PLUGIN_HANDLE
 #define HEXCHAT_PLUGIN_HANDLE (ph)
@@ -451,6 +563,17 @@ hexchat_pluginpref_list (hexchat_plugin *ph,
 #define hexchat_pluginpref_get_int ((HEXCHAT_PLUGIN_HANDLE)->hexchat_pluginpref_get_int)
 #define hexchat_pluginpref_delete ((HEXCHAT_PLUGIN_HANDLE)->hexchat_pluginpref_delete)
 #define hexchat_pluginpref_list ((HEXCHAT_PLUGIN_HANDLE)->hexchat_pluginpref_list)
+#define hexchat_list_find ((HEXCHAT_PLUGIN_HANDLE)->hexchat_list_find)
+#define hexchat_list_cursor ((HEXCHAT_PLUGIN_HANDLE)->hexchat_list_cursor)
+#define hexchat_list_str_at ((HEXCHAT_PLUGIN_HANDLE)->hexchat_list_str_at)
+#define hexchat_list_int_at ((HEXCHAT_PLUGIN_HANDLE)->hexchat_list_int_at)
+#define hexchat_list_time_at ((HEXCHAT_PLUGIN_HANDLE)->hexchat_list_time_at)
+#define hexchat_job_submit ((HEXCHAT_PLUGIN_HANDLE)->hexchat_job_submit)
+#define hexchat_job_cancel ((HEXCHAT_PLUGIN_HANDLE)->hexchat_job_cancel)
+#define hexchat_job_cancelled ((HEXCHAT_PLUGIN_HANDLE)->hexchat_job_cancelled)
+#define hexchat_pluginpref_get_many ((HEXCHAT_PLUGIN_HANDLE)->hexchat_pluginpref_get_many)
+#define hexchat_pluginpref_set_many ((HEXCHAT_PLUGIN_HANDLE)->hexchat_pluginpref_set_many)
+#define hexchat_pluginpref_list_all ((HEXCHAT_PLUGIN_HANDLE)->hexchat_pluginpref_list_all)
 #endif
 
 #ifdef __cplusplus
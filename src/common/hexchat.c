@@ -39,9 +39,13 @@
 #include "util.h"
 #include "cfgfiles.h"
 #include "chanopt.h"
+#include "hilight.h"
 #include "ignore.h"
 #include "hexchat-plugin.h"
 #include "inbound.h"
+#include "modes.h"
+#include "logwriter.h"
+#include "timerwheel.h"
 #include "plugin.h"
 #include "plugin-identd.h"
 #include "plugin-timer.h"
@@ -53,6 +57,10 @@
 #include "url.h"
 #include "hexchatc.h"
 
+#ifdef USE_OPENSSL
+#include "ssl.h"
+#endif
+
 #if ! GLIB_CHECK_VERSION (2, 36, 0)
 #include <glib-object.h>			/* for g_type_init() */
 #endif
@@ -372,34 +380,34 @@ hexchat_reinit_timers (void)
 	/* notify timeout */
 	if (prefs.hex_notify_timeout && notify_tag == 0)
 	{
-		notify_tag = fe_timeout_add_seconds (prefs.hex_notify_timeout,
-						     notify_checklist, NULL);
+		notify_tag = timer_wheel_add_seconds (prefs.hex_notify_timeout,
+						      (GSourceFunc) notify_checklist, NULL);
 	}
 	else if (!prefs.hex_notify_timeout && notify_tag != 0)
 	{
-		fe_timeout_remove (notify_tag);
+		timer_wheel_remove (notify_tag);
 		notify_tag = 0;
 	}
 
 	/* away status tracking */
 	if (prefs.hex_away_track && away_tag == 0)
 	{
-		away_tag = fe_timeout_add_seconds (prefs.hex_away_timeout, away_check, NULL);
+		away_tag = timer_wheel_add_seconds (prefs.hex_away_timeout, (GSourceFunc) away_check, NULL);
 	}
 	else if (!prefs.hex_away_track && away_tag != 0)
 	{
-		fe_timeout_remove (away_tag);
+		timer_wheel_remove (away_tag);
 		away_tag = 0;
 	}
 
 	/* lag-o-meter */
 	if (prefs.hex_gui_lagometer && lag_check_update_tag == 0)
 	{
-		lag_check_update_tag = fe_timeout_add (500, hexchat_lag_check_update, NULL);
+		lag_check_update_tag = timer_wheel_add (500, (GSourceFunc) hexchat_lag_check_update, NULL);
 	}
 	else if (!prefs.hex_gui_lagometer && lag_check_update_tag != 0)
 	{
-		fe_timeout_remove (lag_check_update_tag);
+		timer_wheel_remove (lag_check_update_tag);
 		lag_check_update_tag = 0;
 	}
 
@@ -407,12 +415,12 @@ hexchat_reinit_timers (void)
 	if ((prefs.hex_net_ping_timeout != 0 || prefs.hex_gui_lagometer)
 	    && lag_check_tag == 0)
 	{
-		lag_check_tag = fe_timeout_add_seconds (30, hexchat_lag_check, NULL);
+		lag_check_tag = timer_wheel_add_seconds (30, (GSourceFunc) hexchat_lag_check, NULL);
 	}
 	else if ((!prefs.hex_net_ping_timeout && !prefs.hex_gui_lagometer)
 					 && lag_check_tag != 0)
 	{
-		fe_timeout_remove (lag_check_tag);
+		timer_wheel_remove (lag_check_tag);
 		lag_check_tag = 0;
 	}
 }
@@ -482,7 +490,6 @@ session_new (server *serv, char *from, int type, int focus)
 	sess = g_new0 (struct session, 1);
 
 	sess->server = serv;
-	sess->logfd = -1;
 	sess->type = type;
 
 	sess->alert_balloon = SET_DEFAULT;
@@ -678,7 +685,7 @@ session_free (session *killsess)
 
 	history_free (&killsess->history);
 	g_free (killsess->topic);
-	g_free (killsess->current_modes);
+	chanmodes_free (killsess);
 
 	fe_session_callback (killsess);
 
@@ -997,8 +1004,14 @@ hexchat_exit (void)
 	notify_save ();
 	ignore_save ();
 	free_sessions ();
+	logwriter_shutdown ();
 	chanopt_save_all (TRUE);
 	servlist_cleanup ();
+	hilight_cleanup ();
+	url_cleanup ();
+#ifdef USE_OPENSSL
+	_SSL_session_cache_free ();
+#endif
 	fe_exit ();
 }
 
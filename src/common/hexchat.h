@@ -103,8 +103,10 @@ struct hexchatprefs
 	unsigned int hex_completion_auto;
 	unsigned int hex_dcc_auto_chat;
 	unsigned int hex_dcc_auto_resume;
+	unsigned int hex_dcc_checksum;
 	unsigned int hex_dcc_fast_send;
 	unsigned int hex_dcc_ip_from_server;
+	unsigned int hex_dcc_multi_source;
 	unsigned int hex_dcc_remove;
 	unsigned int hex_dcc_save_nick;
 	unsigned int hex_dcc_send_fillspaces;
@@ -179,6 +181,7 @@ struct hexchatprefs
 	unsigned int hex_irc_hide_version;
 	unsigned int hex_irc_invisible;
 	unsigned int hex_irc_logging;
+	unsigned int hex_irc_logging_compress;
 	unsigned int hex_irc_raw_modes;
 	unsigned int hex_irc_servernotice;
 	unsigned int hex_irc_skip_motd;
@@ -189,6 +192,7 @@ struct hexchatprefs
 	unsigned int hex_net_auto_reconnect;
 	unsigned int hex_net_auto_reconnectonfail;
 	unsigned int hex_net_proxy_auth;
+	unsigned int hex_net_ssl_session_save;
 	unsigned int hex_net_throttle;
 	unsigned int hex_notify_whois_online;
 	unsigned int hex_perl_warnings;
@@ -226,6 +230,11 @@ struct hexchatprefs
 	int hex_dcc_global_max_send_cps;
 	int hex_dcc_max_get_cps;
 	int hex_dcc_max_send_cps;
+	int hex_dcc_max_sends;
+	int hex_dcc_network_max_get_cps;
+	int hex_dcc_network_max_send_cps;
+	int hex_dcc_peer_max_get_cps;
+	int hex_dcc_peer_max_send_cps;
 	int hex_dcc_permissions;
 	int hex_dcc_port_first;
 	int hex_dcc_port_last;
@@ -269,6 +278,7 @@ struct hexchatprefs
 	int hex_identd_port;
 	int hex_irc_ban_type;
 	int hex_irc_join_delay;
+	int hex_irc_logging_fsync;			/* seconds between fsync()s of log files, 0 to leave it to the OS */
 	int hex_irc_notice_pos;
 	int hex_net_ping_timeout;
 	int hex_net_proxy_port;
@@ -378,6 +388,7 @@ typedef struct session
 
 	struct server *server;
 	tree *usertree;					/* alphabetical tree */
+	unsigned int users_left;		/* bumped whenever users are removed from it */
 	struct User *me;					/* points to myself in the usertree */
 	char channel[CHANLEN];
 	char waitchannel[CHANLEN];		  /* waiting to join channel (/join sent) */
@@ -385,7 +396,10 @@ typedef struct session
 	char session_name[CHANLEN];		 /* the name of the session, should not modified */
 	char channelkey[64];			  /* XXX correct max length? */
 	int limit;						  /* channel user limit */
-	int logfd;
+	struct _log_file *logfile;		  /* see logwriter.h */
+	char *logmask;						  /* irc_logmask with %c %n %s filled in */
+	char *logpath;						  /* logmask with the date filled in */
+	time_t logrotate;					  /* when the date in logpath may change, 0 for never */
 
 	GFile *scrollfile;							/* scrollback file */
 	int scrollwritten;					/* number of lines written */
@@ -401,7 +415,7 @@ typedef struct session
 
 	char *quitreason;
 	char *topic;
-	char *current_modes;					/* free() me */
+	struct chanmodes *chanmodes;		/* see modes.c */
 
 	int mode_timeout_tag;
 
@@ -495,6 +509,7 @@ typedef struct server
 	SSL_CTX *ctx;
 	SSL *ssl;
 	int ssl_do_connect_tag;
+	gint64 ssl_handshake_start;	/* monotonic, to tell how long it took */
 #else
 	void *ssl;
 #endif
@@ -518,8 +533,14 @@ typedef struct server
 	char *chanmodes;					/* for 005 numeric - free me */
 	char *nick_prefixes;				/* e.g. "*@%+" */
 	char *nick_modes;					/* e.g. "aohv" */
+	signed char chanmode_type[128];	/* of each letter in the two above */
 	char *bad_nick_prefixes;		/* for ircd that doesn't give the modes */
 	int modes_per_line;				/* 6 on undernet, 4 on efnet etc... */
+	int monitor_limit;				/* MONITOR= and WATCH= from 005, 0 if none */
+	int watch_limit;
+	int watch_count;					/* nicks we put on either of those lists */
+	GQueue *ison_queue;				/* names of each ISON still awaiting its 303 */
+	time_t ison_sent;					/* when that round went out */
 
 	void *network;						/* points to entry in servlist.c or NULL! */
 
@@ -0,0 +1,282 @@
+/* HexChat
+ * Copyright (C) 1998-2010 Peter Zelezny.
+ * Copyright (C) 2009-2013 Berke Viktor.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/* compiled alert masks, used by is_hilight () and the Alerts prefs */
+
+#include <string.h>
+#include <ctype.h>
+
+#include "hexchat.h"
+#include "util.h"
+#include "hilight.h"
+
+/* the same cache may be asked for our nick on every server plus the few
+   Alerts prefs, anything beyond this is stale and gets dropped */
+#define HILIGHT_CACHE_MAX 32
+
+struct _hilight_matcher
+{
+	GHashTable *literals;	/* rfc_tolower'ed masks without wildcards */
+	GSList *wild;				/* masks that need match () */
+};
+
+static GHashTable *hilight_cache = NULL;
+
+static gboolean
+hilight_is_wild (const char *mask)
+{
+	for (; *mask; mask++)
+	{
+		if (*mask == '*' || *mask == '?' || *mask == '\\')
+			return TRUE;
+	}
+	return FALSE;
+}
+
+/* Masks can be separated by commas and spaces. */
+
+hilight_matcher *
+hilight_matcher_new (const char *masks)
+{
+	hilight_matcher *hm;
+	const char *start, *p;
+	char *mask;
+	int i;
+
+	hm = g_new0 (hilight_matcher, 1);
+	hm->literals = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+	p = masks;
+	while (1)
+	{
+		while (*p == ' ' || *p == ',')
+			p++;
+		if (*p == 0)
+			break;
+
+		start = p;
+		while (*p && *p != ' ' && *p != ',')
+			p++;
+
+		mask = g_strndup (start, p - start);
+		if (hilight_is_wild (mask))
+		{
+			hm->wild = g_slist_prepend (hm->wild, mask);
+		}
+		else
+		{
+			for (i = 0; mask[i]; i++)
+				mask[i] = rfc_tolower (mask[i]);
+			g_hash_table_replace (hm->literals, mask, mask);
+		}
+	}
+
+	hm->wild = g_slist_reverse (hm->wild);
+	return hm;
+}
+
+void
+hilight_matcher_free (hilight_matcher *hm)
+{
+	g_hash_table_destroy (hm->literals);
+	g_slist_free_full (hm->wild, g_free);
+	g_free (hm);
+}
+
+/* word must already be rfc_tolower'ed */
+static gboolean
+hilight_match_folded (hilight_matcher *hm, const char *word)
+{
+	GSList *list;
+
+	if (g_hash_table_contains (hm->literals, word))
+		return TRUE;
+
+	for (list = hm->wild; list; list = list->next)
+	{
+		if (match (list->data, word))
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+gboolean
+hilight_matcher_word (hilight_matcher *hm, const char *word)
+{
+	GSList *list;
+	char buf[256];
+	int i;
+
+	if (g_hash_table_size (hm->literals) != 0)
+	{
+		for (i = 0; word[i] && i < sizeof (buf) - 1; i++)
+			buf[i] = rfc_tolower (word[i]);
+		buf[i] = 0;
+
+		/* too long to be one of the literals */
+		if (word[i] == 0 && g_hash_table_contains (hm->literals, buf))
+			return TRUE;
+	}
+
+	for (list = hm->wild; list; list = list->next)
+	{
+		if (match (list->data, word))
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+/* Skips the formatting codes strip_color2 (STRIP_ALL) would remove. */
+static const unsigned char *
+hilight_skip_codes (const unsigned char *p)
+{
+	int digits;
+
+	while (1)
+	{
+		switch (*p)
+		{
+		case '\003':			  /*ATTR_COLOR: */
+			p++;
+			for (digits = 0; digits < 2 && isdigit (*p); digits++)
+				p++;
+			if (*p == ',' && isdigit (p[1]))
+			{
+				p++;
+				for (digits = 0; digits < 2 && isdigit (*p); digits++)
+					p++;
+			}
+			break;
+		case HIDDEN_CHAR:
+		case '\007':			  /*ATTR_BEEP: */
+		case '\017':			  /*ATTR_RESET: */
+		case '\026':			  /*ATTR_REVERSE: */
+		case '\002':			  /*ATTR_BOLD: */
+		case '\037':			  /*ATTR_UNDERLINE: */
+		case '\036':			  /*ATTR_STRIKETHROUGH: */
+		case '\035':			  /*ATTR_ITALICS: */
+			p++;
+			break;
+		default:
+			return p;
+		}
+	}
+}
+
+/* Splits text into words the same way alert_match_text always has: digits
+   and RFC1459 <special> can be inside a word, anything else that isn't a
+   letter ends it. Each word is folded into buf as we go, so the whole line
+   is matched in a single pass without stripping it first. */
+
+gboolean
+hilight_matcher_text (hilight_matcher *hm, const char *text)
+{
+	const unsigned char *p = (const unsigned char *) text;
+	char stackbuf[512];
+	char *buf = stackbuf;
+	gsize buflen = sizeof (stackbuf);
+	gsize len = 0;
+	gboolean res = FALSE;
+	int skip, i;
+
+	if (g_hash_table_size (hm->literals) == 0 && hm->wild == NULL)
+		return FALSE;
+
+	while (1)
+	{
+		p = hilight_skip_codes (p);
+
+		if ((*p >= '0' && *p <= '9') || (*p && strchr ("-[]\\`^{}_|", *p)) ||
+			 (*p != 0 && *p != ' ' && *p != ',' &&
+			  g_unichar_isalpha (g_utf8_get_char ((const char *) p))))
+		{
+			skip = g_utf8_skip[*p];
+			if (len + skip >= buflen)
+			{
+				buflen *= 2;
+				if (buf == stackbuf)
+				{
+					buf = g_malloc (buflen);
+					memcpy (buf, stackbuf, len);
+				}
+				else
+					buf = g_realloc (buf, buflen);
+			}
+			for (i = 0; i < skip && p[i]; i++)
+				buf[len++] = rfc_tolower (p[i]);
+			p += i;
+			continue;
+		}
+
+		/* the word has ended */
+		if (len)
+		{
+			buf[len] = 0;
+			if (hilight_match_folded (hm, buf))
+			{
+				res = TRUE;
+				break;
+			}
+			len = 0;
+		}
+
+		if (*p == 0)
+			break;
+		p += g_utf8_skip[*p];
+	}
+
+	if (buf != stackbuf)
+		g_free (buf);
+
+	return res;
+}
+
+hilight_matcher *
+hilight_get (const char *masks)
+{
+	hilight_matcher *hm;
+
+	if (!hilight_cache)
+		hilight_cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+															(GDestroyNotify) hilight_matcher_free);
+
+	hm = g_hash_table_lookup (hilight_cache, masks);
+	if (!hm)
+	{
+		if (g_hash_table_size (hilight_cache) >= HILIGHT_CACHE_MAX)
+			g_hash_table_remove_all (hilight_cache);
+
+		hm = hilight_matcher_new (masks);
+		g_hash_table_insert (hilight_cache, g_strdup (masks), hm);
+	}
+
+	return hm;
+}
+
+void
+hilight_cleanup (void)
+{
+	if (hilight_cache)
+	{
+		g_hash_table_destroy (hilight_cache);
+		hilight_cache = NULL;
+	}
+}
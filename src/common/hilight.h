@@ -0,0 +1,42 @@
+/* HexChat
+ * Copyright (C) 1998-2010 Peter Zelezny.
+ * Copyright (C) 2009-2013 Berke Viktor.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#ifndef HEXCHAT_HILIGHT_H
+#define HEXCHAT_HILIGHT_H
+
+#include <glib.h>
+
+/* A compiled list of alert masks ("nick,word*, other"). Literal masks are
+   kept in a casemapped hash set, masks with wildcards fall back to match(). */
+typedef struct _hilight_matcher hilight_matcher;
+
+hilight_matcher *hilight_matcher_new (const char *masks);
+void hilight_matcher_free (hilight_matcher *hm);
+
+/* does any mask match the whole of word? */
+gboolean hilight_matcher_word (hilight_matcher *hm, const char *word);
+/* does any mask match a word of text? Formatting codes are skipped. */
+gboolean hilight_matcher_text (hilight_matcher *hm, const char *text);
+
+/* returns a shared matcher compiled from masks, recompiling only when
+   the mask string was not seen before */
+hilight_matcher *hilight_get (const char *masks);
+void hilight_cleanup (void);
+
+#endif
@@ -250,35 +250,14 @@ ignore_check (char *host, int type)
 	return FALSE;
 }
 
-static char *
-ignore_read_next_entry (char *my_cfg, struct ignore *ignore)
-{
-	char tbuf[1024];
-
-	/* Casting to char * done below just to satisfy compiler */
-
-	if (my_cfg)
-	{
-		my_cfg = cfg_get_str (my_cfg, "mask", tbuf, sizeof (tbuf));
-		if (!my_cfg)
-			return NULL;
-		ignore->mask = g_strdup (tbuf);
-	}
-	if (my_cfg)
-	{
-		my_cfg = cfg_get_str (my_cfg, "type", tbuf, sizeof (tbuf));
-		ignore->type = atoi (tbuf);
-	}
-	return my_cfg;
-}
-
 void
 ignore_load ()
 {
 	struct ignore *ignore;
 	struct stat st;
-	char *cfg, *my_cfg;
-	int fh;
+	cfg_index *cfg;
+	char *data, *mask = NULL;
+	int fh, i;
 
 	fh = hexchat_open_file ("ignore.conf", O_RDONLY, 0, 0);
 	if (fh != -1)
@@ -286,18 +265,30 @@ ignore_load ()
 		fstat (fh, &st);
 		if (st.st_size)
 		{
-			cfg = g_malloc0 (st.st_size + 1);
-			read (fh, cfg, st.st_size);
-			my_cfg = cfg;
-			while (my_cfg)
+			data = g_malloc0 (st.st_size + 1);
+			read (fh, data, st.st_size);
+			cfg = cfg_index_new (data);
+
+			/* every ignore is a mask line followed by a type line */
+			for (i = 0; i < cfg->count; i++)
 			{
-				ignore = g_new0 (struct ignore, 1);
-				if ((my_cfg = ignore_read_next_entry (my_cfg, ignore)))
+				if (!g_ascii_strcasecmp (cfg->entries[i].name, "mask"))
+				{
+					g_free (mask);
+					mask = g_strdup (cfg->entries[i].value);
+				}
+				else if (mask && !g_ascii_strcasecmp (cfg->entries[i].name, "type"))
+				{
+					ignore = g_new0 (struct ignore, 1);
+					ignore->mask = mask;
+					ignore->type = atoi (cfg->entries[i].value);
 					ignore_list = g_slist_prepend (ignore_list, ignore);
-				else
-					g_free (ignore);
+					mask = NULL;
+				}
 			}
-			g_free (cfg);
+
+			g_free (mask);
+			cfg_index_free (cfg);
 		}
 		close (fh);
 	}
@@ -47,6 +47,8 @@
 #include "ctcp.h"
 #include "hexchatc.h"
 #include "chanopt.h"
+#include "hilight.h"
+#include "logwriter.h"
 
 
 void
@@ -60,11 +62,7 @@ clear_channel (session *sess)
 
 	log_close (sess);
 
-	if (sess->current_modes)
-	{
-		g_free (sess->current_modes);
-		sess->current_modes = NULL;
-	}
+	chanmodes_free (sess);
 
 	if (sess->mode_timeout_tag)
 	{
@@ -83,11 +81,11 @@ set_topic (session *sess, char *topic, char *stripped_topic)
 {
 	/* The topic of dialogs are the users hostname which is logged is new */
 	if (sess->type == SESS_DIALOG && (!sess->topic || strcmp(sess->topic, stripped_topic))
-		&& sess->logfd != -1)
+		&& sess->logfile)
 	{
 		char tbuf[1024];
 		g_snprintf (tbuf, sizeof (tbuf), "[%s has address %s]\n", sess->channel, stripped_topic);
-		write (sess->logfd, tbuf, strlen (tbuf));
+		logwriter_write_raw (sess->logfile, tbuf);
 	}
 
 	g_free (sess->topic);
@@ -224,82 +222,19 @@ inbound_privmsg (server *serv, char *from, char *ip, char *text, int id,
 gboolean
 alert_match_word (char *word, char *masks)
 {
-	char *p = masks;
-	char endchar;
-	int res;
-
 	if (masks[0] == 0)
 		return FALSE;
 
-	while (1)
-	{
-		/* if it's a 0, space or comma, the word has ended. */
-		if (*p == 0 || *p == ' ' || *p == ',')
-		{
-			endchar = *p;
-			*p = 0;
-			res = match (g_strchug (masks), word);
-			*p = endchar;
-
-			if (res)
-				return TRUE;	/* yes, matched! */
-
-			masks = p + 1;
-			if (*p == 0)
-				return FALSE;
-		}
-		p++;
-	}
+	return hilight_matcher_word (hilight_get (masks), word);
 }
 
 gboolean
 alert_match_text (char *text, char *masks)
 {
-	unsigned char *p = text;
-	unsigned char endchar;
-	int res;
-
 	if (masks[0] == 0)
 		return FALSE;
 
-	while (1)
-	{
-		if (*p >= '0' && *p <= '9')
-		{
-			p++;
-			continue;
-		}
-
-		/* if it's RFC1459 <special>, it can be inside a word */
-		switch (*p)
-		{
-		case '-': case '[': case ']': case '\\':
-		case '`': case '^': case '{': case '}':
-		case '_': case '|':
-			p++;
-			continue;
-		}
-
-		/* if it's a 0, space or comma, the word has ended. */
-		if (*p == 0 || *p == ' ' || *p == ',' ||
-			/* if it's anything BUT a letter, the word has ended. */
-			 (!g_unichar_isalpha (g_utf8_get_char (p))))
-		{
-			endchar = *p;
-			*p = 0;
-			res = alert_match_word (text, masks);
-			*p = endchar;
-
-			if (res)
-				return TRUE;	/* yes, matched! */
-
-			text = p + g_utf8_skip [p[0]];
-			if (*p == 0)
-				return FALSE;
-		}
-
-		p += g_utf8_skip [p[0]];
-	}
+	return hilight_matcher_text (hilight_get (masks), text);
 }
 
 static int
@@ -308,13 +243,11 @@ is_hilight (char *from, char *text, session *sess, server *serv)
 	if (alert_match_word (from, prefs.hex_irc_no_hilight))
 		return 0;
 
-	text = strip_color (text, -1, STRIP_ALL);
-
+	/* formatting codes are skipped while matching, no need to strip_color */
 	if (alert_match_text (text, serv->nick) ||
 		 alert_match_text (text, prefs.hex_irc_extra_hilight) ||
 		 alert_match_word (from, prefs.hex_irc_nick_hilight))
 	{
-		g_free (text);
 		if (sess != current_tab)
 		{
 			sess->tab_state |= TAB_STATE_NEW_HILIGHT;
@@ -323,7 +256,6 @@ is_hilight (char *from, char *text, session *sess, server *serv)
 		return 1;
 	}
 
-	g_free (text);
 	return 0;
 }
 
@@ -520,6 +452,7 @@ inbound_newnick (server *serv, char *nick, char *newnick, int quiet,
 			{
 				safe_strcpy (sess->channel, newnick, CHANLEN);
 				fe_set_channel (sess);
+				log_update_path (sess);
 			}
 			fe_set_title (sess);
 		}
@@ -1491,6 +1424,25 @@ inbound_user_info (session *sess, char *chan, char *user, char *host,
 	g_free (uhost);
 }
 
+static char
+inbound_banlist_mode (int rplcode)
+{
+	switch (rplcode)
+	{
+	case 346:
+	case 347:
+		return 'I';
+	case 348:
+	case 349:
+		return 'e';
+	case 728:
+	case 729:
+		return 'q';
+	default:
+		return 'b';
+	}
+}
+
 int
 inbound_banlist (session *sess, time_t stamp, char *chan, char *mask, 
 					  char *banner, int rplcode, const message_tags_data *tags_data)
@@ -1516,6 +1468,9 @@ inbound_banlist (session *sess, time_t stamp, char *chan, char *mask,
 		goto nowindow;
 	}
 
+	chanmodes_list_add (sess, inbound_banlist_mode (rplcode), mask, banner,
+							  stamp > 0 ? stamp : 0);
+
 	if (!fe_add_ban_list (sess, mask, banner, time_str, rplcode))
 	{
 nowindow:
@@ -1528,6 +1483,20 @@ nowindow:
 	return TRUE;
 }
 
+int
+inbound_banlist_end (server *serv, char *chan, int rplcode)
+{
+	session *sess;
+
+	sess = find_channel (serv, chan);
+	if (!sess)
+		return FALSE;
+
+	chanmodes_list_end (sess, inbound_banlist_mode (rplcode));
+
+	return fe_ban_list_end (sess, rplcode);
+}
+
 /* execute 1 end-of-motd command */
 
 static int
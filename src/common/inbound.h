@@ -61,6 +61,7 @@ void inbound_foundip (session *sess, char *ip,
 int inbound_banlist (session *sess, time_t stamp, char *chan, char *mask, 
 							char *banner, int is_exemption,
 							const message_tags_data *tags_data);
+int inbound_banlist_end (server *serv, char *chan, int rplcode);
 void inbound_ping_reply (session *sess, char *timestring, char *from,
 								 const message_tags_data *tags_data);
 void inbound_nameslist (server *serv, char *chan, char *names,
@@ -0,0 +1,663 @@
+/* HexChat
+ * Copyright (C) 1998-2010 Peter Zelezny.
+ * Copyright (C) 2009-2013 Berke Viktor.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/* Chat logs are written by a dedicated thread so the GUI thread never waits
+   on the disk. The GUI thread only pushes messages onto log_queue; the
+   logging thread owns every log_file, buffers its lines and writes them
+   out in one go once LOG_BUFFER_MAX is reached or the oldest buffered line
+   is LOG_FLUSH_INTERVAL old. Compressing logs of past periods can take a
+   while, so it's left to a thread of its own that nothing waits on. */
+
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <errno.h>
+
+#ifdef WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#include "hexchat.h"
+#include "fe.h"
+#include "util.h"
+#include "logwriter.h"
+
+#define LOG_BUFFER_MAX (64 * 1024)
+#define LOG_FLUSH_INTERVAL (G_USEC_PER_SEC / 2)
+
+enum
+{
+	LOG_MSG_OPEN,
+	LOG_MSG_WRITE,
+	LOG_MSG_WRITE_RAW,
+	LOG_MSG_CLOSE,
+	LOG_MSG_COMPRESS_OLD,
+	LOG_MSG_QUIT
+};
+
+struct log_msg
+{
+	int type;
+	log_file *lf;
+	time_t stamp;
+	int stamp_len;		/* LOG_MSG_WRITE: length of the stamp format in data, 0 for none */
+	char data[1];		/* path, stamp format + '\0' + text, or directory + '\0' + patterns */
+};
+
+/* for compress_pool, either a single file or a sweep of dir */
+struct log_compress
+{
+	char *path;
+	char *dir;
+	GRegex *any_period;	/* paths under dir that are logs at all */
+	GRegex *this_period;	/* those of the current period */
+	GHashTable *in_use;	/* paths still open for writing at the time */
+};
+
+/* only ever touched by the logging thread */
+struct _log_file
+{
+	int fd;
+	char *path;
+	GString *buf;
+	gint64 dirty_since;	/* when the oldest unwritten line was buffered, 0 if none */
+	gint64 last_sync;
+};
+
+static GAsyncQueue *log_queue = NULL;
+static GThread *log_thread = NULL;
+static GThreadPool *compress_pool = NULL;
+
+/* logging thread state */
+static GSList *log_files = NULL;
+static GSList *log_dirty = NULL;
+static gboolean log_error_reported = FALSE;
+
+static gboolean
+logwriter_report_error (gpointer data)
+{
+	char *message;
+
+	message = g_strdup_printf (_("* Can't open log file(s) for writing. Check the\npermissions on %s"), (char *) data);
+	fe_message (message, FE_MSG_WAIT | FE_MSG_ERROR);
+	g_free (message);
+	g_free (data);
+
+	return G_SOURCE_REMOVE;
+}
+
+static void
+logwriter_write_all (int fd, const char *buf, gsize len)
+{
+	gssize n;
+
+	while (len > 0)
+	{
+		n = write (fd, buf, len);
+		if (n < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			return;
+		}
+		buf += n;
+		len -= n;
+	}
+}
+
+/* Something like logrotate may have moved or deleted the file since it
+   was opened, writing on would only go to the old one. Checked before
+   each flush, which is at most every LOG_FLUSH_INTERVAL. */
+static void
+logwriter_check_moved (log_file *lf)
+{
+#ifndef WIN32
+	GStatBuf st_path;
+	struct stat st_fd;
+	char *dir;
+
+	if (fstat (lf->fd, &st_fd) != 0)
+		return;
+	if (g_stat (lf->path, &st_path) == 0 &&
+		 st_path.st_ino == st_fd.st_ino && st_path.st_dev == st_fd.st_dev)
+		return;
+
+	close (lf->fd);
+	dir = g_path_get_dirname (lf->path);
+	g_mkdir_with_parents (dir, 0700);
+	g_free (dir);
+	lf->fd = g_open (lf->path, O_CREAT | O_APPEND | O_WRONLY | OFLAGS, 0644);
+#endif
+}
+
+static void
+logwriter_flush (log_file *lf)
+{
+	gint64 now;
+
+	if (lf->buf->len == 0)
+		return;
+
+	if (lf->fd != -1)
+		logwriter_check_moved (lf);
+
+	if (lf->fd != -1)
+	{
+		logwriter_write_all (lf->fd, lf->buf->str, lf->buf->len);
+
+		now = g_get_monotonic_time ();
+		if (prefs.hex_irc_logging_fsync > 0 &&
+			 now - lf->last_sync >= (gint64) prefs.hex_irc_logging_fsync * G_USEC_PER_SEC)
+		{
+#ifdef WIN32
+			_commit (lf->fd);
+#else
+			fsync (lf->fd);
+#endif
+			lf->last_sync = now;
+		}
+	}
+
+	g_string_truncate (lf->buf, 0);
+	lf->dirty_since = 0;
+	log_dirty = g_slist_remove (log_dirty, lf);
+}
+
+static void
+logwriter_flush_due (void)
+{
+	GSList *list, *next;
+	gint64 now;
+
+	now = g_get_monotonic_time ();
+	for (list = log_dirty; list; list = next)
+	{
+		log_file *lf = list->data;
+
+		next = list->next;
+		if (now - lf->dirty_since >= LOG_FLUSH_INTERVAL)
+			logwriter_flush (lf);
+	}
+}
+
+static void
+logwriter_buffered (log_file *lf)
+{
+	if (lf->buf->len >= LOG_BUFFER_MAX)
+	{
+		logwriter_flush (lf);
+	}
+	else if (!lf->dirty_since)
+	{
+		lf->dirty_since = g_get_monotonic_time ();
+		log_dirty = g_slist_prepend (log_dirty, lf);
+	}
+}
+
+static void
+logwriter_close_fd (log_file *lf)
+{
+	logwriter_flush (lf);
+	if (lf->fd != -1)
+	{
+		close (lf->fd);
+		lf->fd = -1;
+	}
+}
+
+/* Compresses a log file of a period that has ended to <path>.gz, streaming
+   it through GIO's zlib converter so it never has to fit in memory. Runs
+   in compress_pool. */
+static void
+logwriter_compress (const char *path)
+{
+	GFile *src, *dst;
+	GFileInputStream *in;
+	GFileOutputStream *out;
+	GConverter *compressor;
+	GOutputStream *zout;
+	char *gz_path;
+	gssize spliced = -1;
+
+	gz_path = g_strconcat (path, ".gz", NULL);
+	src = g_file_new_for_path (path);
+	dst = g_file_new_for_path (gz_path);
+	g_free (gz_path);
+
+	/* don't clobber an earlier period, e.g. after the clock went back */
+	in = g_file_read (src, NULL, NULL);
+	out = in ? g_file_create (dst, G_FILE_CREATE_NONE, NULL, NULL) : NULL;
+	if (out)
+	{
+		compressor = G_CONVERTER (g_zlib_compressor_new (G_ZLIB_COMPRESSOR_FORMAT_GZIP, -1));
+		zout = g_converter_output_stream_new (G_OUTPUT_STREAM (out), compressor);
+
+		spliced = g_output_stream_splice (zout, G_INPUT_STREAM (in),
+													 G_OUTPUT_STREAM_SPLICE_CLOSE_SOURCE |
+													 G_OUTPUT_STREAM_SPLICE_CLOSE_TARGET, NULL, NULL);
+
+		g_object_unref (zout);
+		g_object_unref (compressor);
+		g_object_unref (out);
+
+		if (spliced == -1)
+			g_file_delete (dst, NULL, NULL);
+		else
+			g_file_delete (src, NULL, NULL);
+	}
+
+	if (in)
+		g_object_unref (in);
+	g_object_unref (dst);
+	g_object_unref (src);
+}
+
+/* rel is the path relative to the directory the sweep started in, so it
+   can be matched against the relative logmask */
+static void
+logwriter_sweep (const char *dir, const char *rel, struct log_compress *task)
+{
+	GDir *gdir;
+	const char *name;
+	char *path, *path_rel;
+
+	gdir = g_dir_open (dir, 0, NULL);
+	if (!gdir)
+		return;
+
+	while ((name = g_dir_read_name (gdir)))
+	{
+		path = g_build_filename (dir, name, NULL);
+		path_rel = rel ? g_build_filename (rel, name, NULL) : g_strdup (name);
+
+		if (g_file_test (path, G_FILE_TEST_IS_DIR))
+			logwriter_sweep (path, path_rel, task);
+		else if (g_file_test (path, G_FILE_TEST_IS_REGULAR) &&
+					g_regex_match (task->any_period, path_rel, 0, NULL) &&
+					!g_regex_match (task->this_period, path_rel, 0, NULL) &&
+					!g_hash_table_contains (task->in_use, path))
+			logwriter_compress (path);
+
+		g_free (path_rel);
+		g_free (path);
+	}
+
+	g_dir_close (gdir);
+}
+
+static void
+logwriter_compress_free (struct log_compress *task)
+{
+	g_free (task->path);
+	g_free (task->dir);
+	if (task->any_period)
+		g_regex_unref (task->any_period);
+	if (task->this_period)
+		g_regex_unref (task->this_period);
+	if (task->in_use)
+		g_hash_table_destroy (task->in_use);
+	g_free (task);
+}
+
+static void
+logwriter_compress_thread (gpointer data, gpointer unused)
+{
+	struct log_compress *task = data;
+
+	if (task->path)
+		logwriter_compress (task->path);
+	else
+		logwriter_sweep (task->dir, NULL, task);
+
+	logwriter_compress_free (task);
+}
+
+static void
+logwriter_compress_push (struct log_compress *task)
+{
+	if (!compress_pool)
+		compress_pool = g_thread_pool_new (logwriter_compress_thread, NULL, 1, FALSE, NULL);
+
+	g_thread_pool_push (compress_pool, task, NULL);
+}
+
+static gboolean
+logwriter_path_in_use (log_file *except, const char *path)
+{
+	GSList *list;
+
+	for (list = log_files; list; list = list->next)
+	{
+		log_file *lf = list->data;
+
+		if (lf != except && lf->path && strcmp (lf->path, path) == 0)
+			return TRUE;
+	}
+	return FALSE;
+}
+
+static void
+logwriter_open_fd (log_file *lf, const char *path)
+{
+	logwriter_close_fd (lf);
+
+	/* the file's period has ended, the session moved on to a new one */
+	if (prefs.hex_irc_logging_compress && lf->path && strcmp (lf->path, path) != 0 &&
+		 !logwriter_path_in_use (lf, lf->path))
+	{
+		struct log_compress *task = g_new0 (struct log_compress, 1);
+
+		task->path = g_strdup (lf->path);
+		logwriter_compress_push (task);
+	}
+
+	g_free (lf->path);
+	lf->path = g_strdup (path);
+	lf->fd = g_open (path, O_CREAT | O_APPEND | O_WRONLY | OFLAGS, 0644);
+	lf->last_sync = g_get_monotonic_time ();
+
+	if (lf->fd == -1 && !log_error_reported)
+	{
+		log_error_reported = TRUE;
+		g_idle_add (logwriter_report_error, g_strdup (path));
+	}
+}
+
+/* get_stamp_str (), but without touching anything the GUI thread uses */
+static void
+logwriter_append_stamp (GString *buf, const char *fmt, time_t stamp)
+{
+	static char *last_fmt = NULL, *last_fmt_locale = NULL;
+	struct tm tm;
+	char dest[128];
+	gsize len;
+	char *utf8;
+
+#ifdef WIN32
+	localtime_s (&tm, &stamp);
+#else
+	localtime_r (&stamp, &tm);
+#endif
+
+	/* strftime requires the format string to be in locale encoding. */
+	if (!last_fmt || strcmp (last_fmt, fmt) != 0)
+	{
+		g_free (last_fmt);
+		g_free (last_fmt_locale);
+		last_fmt = g_strdup (fmt);
+		last_fmt_locale = g_locale_from_utf8 (fmt, -1, NULL, NULL, NULL);
+	}
+	if (!last_fmt_locale)
+		return;
+
+	len = strftime_validated (dest, sizeof (dest), last_fmt_locale, &tm);
+	if (len == 0)
+		return;
+
+	if (g_get_charset (NULL))
+	{
+		g_string_append_len (buf, dest, len);
+	}
+	else
+	{
+		utf8 = g_locale_to_utf8 (dest, len, NULL, &len, NULL);
+		if (utf8)
+		{
+			g_string_append_len (buf, utf8, len);
+			g_free (utf8);
+		}
+	}
+}
+
+static void
+logwriter_append_line (log_file *lf, const char *text, time_t stamp, const char *stamp_fmt)
+{
+	gsize start, len;
+	int stripped;
+
+	if (stamp_fmt)
+		logwriter_append_stamp (lf->buf, stamp_fmt, stamp);
+
+	/* strip straight into the buffer */
+	len = strlen (text);
+	start = lf->buf->len;
+	g_string_set_size (lf->buf, start + len + 1);
+	stripped = strip_color2 (text, len, lf->buf->str + start, STRIP_ALL);
+	g_string_truncate (lf->buf, start + stripped);
+
+	/* lots of scripts/plugins print without a \n at the end */
+	if (stripped == 0 || lf->buf->str[lf->buf->len - 1] != '\n')
+		g_string_append_c (lf->buf, '\n');	/* emulate what xtext would display */
+}
+
+/* returns FALSE when it's time to quit */
+static gboolean
+logwriter_handle (struct log_msg *msg)
+{
+	log_file *lf = msg->lf;
+
+	switch (msg->type)
+	{
+	case LOG_MSG_OPEN:
+		if (!g_slist_find (log_files, lf))
+			log_files = g_slist_prepend (log_files, lf);
+		logwriter_open_fd (lf, msg->data);
+		break;
+	case LOG_MSG_WRITE:
+		logwriter_append_line (lf, msg->data + msg->stamp_len + 1, msg->stamp,
+									  msg->stamp_len ? msg->data : NULL);
+		logwriter_buffered (lf);
+		break;
+	case LOG_MSG_WRITE_RAW:
+		g_string_append (lf->buf, msg->data);
+		logwriter_buffered (lf);
+		break;
+	case LOG_MSG_CLOSE:
+		logwriter_close_fd (lf);
+		log_files = g_slist_remove (log_files, lf);
+		g_string_free (lf->buf, TRUE);
+		g_free (lf->path);
+		g_free (lf);
+		break;
+	case LOG_MSG_COMPRESS_OLD:
+		{
+			struct log_compress *task;
+			const char *any_period, *this_period;
+			GSList *list;
+
+			any_period = msg->data + strlen (msg->data) + 1;
+			this_period = any_period + strlen (any_period) + 1;
+
+			task = g_new0 (struct log_compress, 1);
+			task->dir = g_strdup (msg->data);
+			task->any_period = g_regex_new (any_period, G_REGEX_OPTIMIZE, 0, NULL);
+			task->this_period = g_regex_new (this_period, G_REGEX_OPTIMIZE, 0, NULL);
+			if (!task->any_period || !task->this_period)
+			{
+				logwriter_compress_free (task);
+				break;
+			}
+			task->in_use = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+			for (list = log_files; list; list = list->next)
+			{
+				log_file *open_lf = list->data;
+
+				if (open_lf->path)
+					g_hash_table_add (task->in_use, g_strdup (open_lf->path));
+			}
+			logwriter_compress_push (task);
+		}
+		break;
+	case LOG_MSG_QUIT:
+		g_free (msg);
+		return FALSE;
+	}
+
+	g_free (msg);
+	return TRUE;
+}
+
+static gpointer
+logwriter_thread (gpointer data)
+{
+	struct log_msg *msg;
+	GSList *list;
+
+	while (1)
+	{
+		if (log_dirty)
+			msg = g_async_queue_timeout_pop (log_queue, LOG_FLUSH_INTERVAL);
+		else
+			msg = g_async_queue_pop (log_queue);
+
+		if (msg && !logwriter_handle (msg))
+			break;
+
+		logwriter_flush_due ();
+	}
+
+	for (list = log_files; list; list = list->next)
+		logwriter_close_fd (list->data);
+
+	return NULL;
+}
+
+static void
+logwriter_push (int type, log_file *lf, const char *data, gsize len)
+{
+	struct log_msg *msg;
+
+	if (!log_thread)
+	{
+		log_queue = g_async_queue_new ();
+		log_thread = g_thread_new ("hexchat-log", logwriter_thread, NULL);
+	}
+
+	msg = g_malloc (sizeof (struct log_msg) + len);
+	msg->type = type;
+	msg->lf = lf;
+	msg->stamp = 0;
+	msg->stamp_len = 0;
+	if (data)
+		memcpy (msg->data, data, len + 1);
+	else
+		msg->data[0] = 0;
+
+	g_async_queue_push (log_queue, msg);
+}
+
+log_file *
+logwriter_open (const char *path)
+{
+	log_file *lf;
+
+	lf = g_new0 (log_file, 1);
+	lf->fd = -1;
+	lf->buf = g_string_sized_new (1024);
+
+	logwriter_push (LOG_MSG_OPEN, lf, path, strlen (path));
+
+	return lf;
+}
+
+void
+logwriter_reopen (log_file *lf, const char *path)
+{
+	logwriter_push (LOG_MSG_OPEN, lf, path, strlen (path));
+}
+
+void
+logwriter_write (log_file *lf, const char *text, const char *stamp_fmt, time_t stamp)
+{
+	struct log_msg *msg;
+	gsize text_len, fmt_len;
+
+	if (!log_thread)
+		return;
+
+	text_len = strlen (text);
+	fmt_len = stamp_fmt ? strlen (stamp_fmt) : 0;
+
+	/* format and text share one allocation */
+	msg = g_malloc (sizeof (struct log_msg) + fmt_len + 1 + text_len);
+	msg->type = LOG_MSG_WRITE;
+	msg->lf = lf;
+	msg->stamp = stamp;
+	msg->stamp_len = fmt_len;
+	memcpy (msg->data, stamp_fmt ? stamp_fmt : "", fmt_len + 1);
+	memcpy (msg->data + fmt_len + 1, text, text_len + 1);
+
+	g_async_queue_push (log_queue, msg);
+}
+
+void
+logwriter_write_raw (log_file *lf, const char *text)
+{
+	logwriter_push (LOG_MSG_WRITE_RAW, lf, text, strlen (text));
+}
+
+void
+logwriter_close (log_file *lf)
+{
+	logwriter_push (LOG_MSG_CLOSE, lf, NULL, 0);
+}
+
+void
+logwriter_compress_old (const char *dir, const char *any_period, const char *this_period)
+{
+	GString *data;
+
+	data = g_string_new (dir);
+	g_string_append_len (data, "", 1);
+	g_string_append (data, any_period);
+	g_string_append_len (data, "", 1);
+	g_string_append (data, this_period);
+
+	/* the length is of all three, logwriter_push () copies the final '\0' too */
+	logwriter_push (LOG_MSG_COMPRESS_OLD, NULL, data->str, data->len);
+	g_string_free (data, TRUE);
+}
+
+void
+logwriter_shutdown (void)
+{
+	if (!log_thread)
+		return;
+
+	logwriter_push (LOG_MSG_QUIT, NULL, NULL, 0);
+	g_thread_join (log_thread);
+	log_thread = NULL;
+
+	g_async_queue_unref (log_queue);
+	log_queue = NULL;
+
+	/* let a file being compressed finish, the rest waits for next time */
+	if (compress_pool)
+	{
+		g_thread_pool_free (compress_pool, TRUE, TRUE);
+		compress_pool = NULL;
+	}
+}
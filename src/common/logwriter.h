@@ -0,0 +1,46 @@
+/* HexChat
+ * Copyright (C) 1998-2010 Peter Zelezny.
+ * Copyright (C) 2009-2013 Berke Viktor.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#ifndef HEXCHAT_LOGWRITER_H
+#define HEXCHAT_LOGWRITER_H
+
+#include <time.h>
+
+/* A log file written by the logging thread. Everything here only queues
+   work and returns immediately, the handle stays valid until
+   logwriter_close (). */
+typedef struct _log_file log_file;
+
+log_file *logwriter_open (const char *path);
+/* switch to a different file, e.g. when the date in the logmask changed */
+void logwriter_reopen (log_file *lf, const char *path);
+/* text is stripped of colors and gets a newline if it has none. If
+   stamp_fmt is given the line is prefixed with stamp formatted by it. */
+void logwriter_write (log_file *lf, const char *text, const char *stamp_fmt, time_t stamp);
+/* text is written as is */
+void logwriter_write_raw (log_file *lf, const char *text);
+void logwriter_close (log_file *lf);
+/* flushes everything and stops the thread */
+void logwriter_shutdown (void);
+
+/* gzips the files under dir whose path relative to it matches the regex
+   any_period but not this_period, except for those still being written */
+void logwriter_compress_old (const char *dir, const char *any_period, const char *this_period);
+
+#endif
@@ -19,6 +19,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <time.h>
 
 #include "hexchat.h"
 #include "hexchatc.h"
@@ -28,6 +29,7 @@
 #include "fe.h"
 #include "util.h"
 #include "inbound.h"
+#include "userlist.h"
 #ifdef HAVE_STRINGS_H
 #include <strings.h>
 #endif
@@ -43,11 +45,52 @@ typedef struct
 	char *devoice;
 } mode_run;
 
+/* A list mode entry. Every mask that can match a string has to either end
+   or start with the literal bit of it after its last or before its first
+   wildcard, its anchor, so lookups only try the masks anchored on a piece
+   of what they're given. */
+typedef struct
+{
+	chanmode_entry pub;
+	char *folded;						/* key in modelist.index */
+	char *anchor;						/* folded, NULL if there's none */
+	gboolean anchor_head;
+	guint gen;							/* listing it was last seen in */
+} modelist_entry;
+
+/* A list mode's entries, oldest first, indexed by their casemapped mask
+   and by anchor. */
+typedef struct
+{
+	GQueue entries;
+	GHashTable *index;				/* folded mask -> its link in entries */
+	GHashTable *tails;				/* anchor -> GSList of entries */
+	GHashTable *heads;
+	GSList *unanchored;
+	guint gen;
+	gboolean listing;					/* a 367 or such came, the end didn't */
+} modelist;
+
+#define MODE_LETTERS 52				/* A-Z and a-z, see mode_index () */
+#define MODE_PREFIX 127				/* in serv->chanmode_type, like +o */
+
+/* What's set on a channel, by CHANMODES type. Only the flags and their
+   args make up the string plugins and the title bar see. */
+struct chanmodes
+{
+	guint64 set;						/* a bit per mode letter */
+	char *arg[MODE_LETTERS];		/* of the set type B and C modes */
+	modelist *list[MODE_LETTERS];	/* type A */
+	char *str;							/* rendered, NULL when stale */
+};
+
 static int is_prefix_char (server * serv, char c);
-static void record_chan_mode (session *sess, char sign, char mode, char *arg);
+static void record_chan_mode (session *sess, char sign, char mode, char *arg,
+										char *nick);
 static char *mode_cat (char *str, char *addition);
 static void handle_single_mode (mode_run *mr, char sign, char mode, char *nick,
 										  char *chan, char *arg, int quiet, int is_324,
+										  int using_front_tab,
 										  const message_tags_data *tags_data);
 static int mode_has_arg (server *serv, char sign, char mode);
 static void mode_print_grouped (session *sess, char *nick, mode_run *mr,
@@ -236,134 +279,494 @@ mode_access (server * serv, char mode, char *prefix)
 	return -1;
 }
 
+static int
+mode_is_prefix (server *serv, char mode)
+{
+	return (unsigned char) mode < 128 && serv->chanmode_type[(int) mode] == MODE_PREFIX;
+}
+
+static int
+mode_index (char mode)
+{
+	if (mode >= 'A' && mode <= 'Z')
+		return mode - 'A';
+	if (mode >= 'a' && mode <= 'z')
+		return mode - 'a' + 26;
+	return -1;
+}
+
+static char *
+modelist_fold (const char *mask)
+{
+	char *folded;
+	int i;
+
+	folded = g_strdup (mask);
+	for (i = 0; folded[i]; i++)
+		folded[i] = rfc_tolower (folded[i]);
+
+	return folded;
+}
+
+/* type A modes, kept apart from what the title shows */
+static modelist *
+modelist_new (void)
+{
+	modelist *ml;
+
+	ml = g_new0 (modelist, 1);
+	g_queue_init (&ml->entries);
+	ml->index = g_hash_table_new (g_str_hash, g_str_equal);
+	ml->tails = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	ml->heads = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+	return ml;
+}
+
 static void
-record_chan_mode (session *sess, char sign, char mode, char *arg)
+modelist_entry_free (modelist_entry *e)
 {
-	/* Somebody needed to acutally update sess->current_modes, needed to
-		play nice with bouncers, and less mode calls. Also keeps modes up
-		to date for scripts */
-	server *serv = sess->server;
-	GString *current = g_string_new(sess->current_modes);
-	gint mode_pos = -1;
-	gchar *current_char = current->str;
-	gint modes_length;
-	gint argument_num = 0;
-	gint argument_offset = 0;
-	gint argument_length = 0;
-	int i = 0;
-	gchar *arguments_start;
-
-	/* find out if the mode currently exists */
-	arguments_start = g_strstr_len(current->str	, -1, " ");
-	if (arguments_start) {
-		modes_length = arguments_start - current->str;
-	}
-	else {
-		modes_length = current->len;
-		/* set this to the end of the modes */
-		arguments_start = current->str + current->len;
-	}
-
-	while (mode_pos == -1 && i < modes_length)
-	{
-		if (*current_char == mode)
-		{
-			mode_pos = i;
-		}
-		else
-		{
-			i++;
-			current_char++;
-		}
+	g_free (e->pub.mask);
+	g_free (e->pub.from);
+	g_free (e->folded);
+	g_free (e->anchor);
+	g_free (e);
+}
+
+static void
+modelist_free (modelist *ml)
+{
+	GHashTableIter it;
+	gpointer list;
+
+	g_hash_table_iter_init (&it, ml->tails);
+	while (g_hash_table_iter_next (&it, NULL, &list))
+		g_slist_free (list);
+	g_hash_table_iter_init (&it, ml->heads);
+	while (g_hash_table_iter_next (&it, NULL, &list))
+		g_slist_free (list);
+
+	g_hash_table_destroy (ml->tails);
+	g_hash_table_destroy (ml->heads);
+	g_hash_table_destroy (ml->index);
+	g_slist_free (ml->unanchored);
+	g_queue_foreach (&ml->entries, (GFunc) modelist_entry_free, NULL);
+	g_queue_clear (&ml->entries);
+	g_free (ml);
+}
+
+static void
+modelist_entry_anchor (modelist_entry *e)
+{
+	const char *first, *last;
+
+	/* match () takes \* and \? literally, don't second-guess it */
+	if (strchr (e->folded, '\\'))
+		return;
+
+	first = strpbrk (e->folded, "*?");
+	if (!first)
+	{
+		/* it has to match all of it */
+		e->anchor = g_strdup (e->folded);
+		return;
 	}
 
-	/* if the mode currently exists and has an arg, need to know where
-	 * (including leading space) */
-	if (mode_pos != -1 && mode_has_arg(serv, '+', mode))
+	last = e->folded + strlen (e->folded) - 1;
+	while (*last != '*' && *last != '?')
+		last--;
+
+	if (last[1])
 	{
-		current_char = current->str;
+		e->anchor = g_strdup (last + 1);
+	}
+	else if (first > e->folded)
+	{
+		e->anchor = g_strndup (e->folded, first - e->folded);
+		e->anchor_head = TRUE;
+	}
+}
 
-		i = 0;
-		while (i <= mode_pos)
-		{
-			if (mode_has_arg(serv, '+', *current_char))
-				argument_num++;
-			current_char++;
-			i++;
-		}
+static void
+modelist_link (modelist *ml, modelist_entry *e)
+{
+	GHashTable *table;
+	GSList *list;
+
+	if (!e->anchor)
+	{
+		ml->unanchored = g_slist_prepend (ml->unanchored, e);
+		return;
+	}
+
+	table = e->anchor_head ? ml->heads : ml->tails;
+	list = g_hash_table_lookup (table, e->anchor);
+	if (list)
+		list->next = g_slist_prepend (list->next, e);
+	else
+		g_hash_table_insert (table, g_strdup (e->anchor), g_slist_prepend (NULL, e));
+}
 
-		/* check through arguments for where to start */
-		current_char = arguments_start;
-		i = 0;
-		while (i < argument_num && *current_char != '\0')
+static void
+modelist_unlink (modelist *ml, modelist_entry *e)
+{
+	GHashTable *table;
+	GSList *list;
+
+	if (!e->anchor)
+	{
+		ml->unanchored = g_slist_remove (ml->unanchored, e);
+		return;
+	}
+
+	table = e->anchor_head ? ml->heads : ml->tails;
+	list = g_slist_remove (g_hash_table_lookup (table, e->anchor), e);
+	if (list)
+		g_hash_table_insert (table, g_strdup (e->anchor), list);
+	else
+		g_hash_table_remove (table, e->anchor);
+}
+
+static void
+modelist_add (modelist *ml, char mode, const char *mask, const char *from, time_t stamp)
+{
+	modelist_entry *e;
+	GList *link;
+	char *folded;
+
+	folded = modelist_fold (mask);
+	link = g_hash_table_lookup (ml->index, folded);
+	if (link)
+	{
+		g_free (folded);
+		e = link->data;
+
+		/* a listing knows better than what we saw being set */
+		if (from)
 		{
-			if (*current_char == ' ')
-				i++;
-			if (i != argument_num)
-				current_char++;
+			g_free (e->pub.from);
+			e->pub.from = g_strdup (from);
+			e->pub.stamp = stamp;
 		}
-		argument_offset = current_char - current->str;
+	}
+	else
+	{
+		e = g_new0 (modelist_entry, 1);
+		e->pub.mask = g_strdup (mask);
+		e->pub.from = g_strdup (from);
+		e->pub.stamp = stamp;
+		e->pub.mode[0] = mode;
+		e->folded = folded;
+		modelist_entry_anchor (e);
+
+		g_queue_push_tail (&ml->entries, e);
+		g_hash_table_insert (ml->index, e->folded, ml->entries.tail);
+		modelist_link (ml, e);
+	}
+
+	e->gen = ml->gen;
+}
+
+static void
+modelist_remove_link (modelist *ml, GList *link)
+{
+	modelist_entry *e = link->data;
+
+	g_hash_table_remove (ml->index, e->folded);
+	modelist_unlink (ml, e);
+	g_queue_delete_link (&ml->entries, link);
+	modelist_entry_free (e);
+}
 
-		/* how long the existing argument is for this key
-		 * important for malloc and strncpy */
-		if (i == argument_num)
+static void
+modelist_remove (modelist *ml, const char *mask)
+{
+	GList *link;
+	char *folded;
+
+	folded = modelist_fold (mask);
+	link = g_hash_table_lookup (ml->index, folded);
+	g_free (folded);
+
+	if (link)
+		modelist_remove_link (ml, link);
+}
+
+static void
+modelist_try (GSList *list, const char *string, GSList **found)
+{
+	modelist_entry *e;
+
+	for (; list; list = list->next)
+	{
+		e = list->data;
+		if (match (e->pub.mask, string))
+			*found = g_slist_prepend (*found, &e->pub);
+	}
+}
+
+static GSList *
+modelist_find (modelist *ml, const char *string)
+{
+	GSList *found = NULL;
+	char *folded;
+	size_t len, i;
+
+	folded = modelist_fold (string);
+	len = strlen (folded);
+
+	if (g_hash_table_size (ml->tails))
+	{
+		for (i = 0; i < len; i++)
+			modelist_try (g_hash_table_lookup (ml->tails, folded + i), string, &found);
+	}
+
+	if (g_hash_table_size (ml->heads))
+	{
+		for (i = len; i > 0; i--)
 		{
-			argument_length++;
-			current_char++;
-			while (*current_char != '\0' && *current_char != ' ')
-			{
-				argument_length++;
-				current_char++;
-			}
+			folded[i] = 0;
+			modelist_try (g_hash_table_lookup (ml->heads, folded), string, &found);
 		}
 	}
 
-	/* two cases, adding and removing a mode, handled differently */
-	if (sign == '+')
+	modelist_try (ml->unanchored, string, &found);
+
+	g_free (folded);
+	return found;
+}
+
+static modelist *
+chanmodes_list (session *sess, char mode, gboolean create)
+{
+	struct chanmodes *cm;
+	int i;
+
+	i = mode_index (mode);
+	if (i == -1)
+		return NULL;
+
+	if (!sess->chanmodes)
 	{
-		if (mode_pos != -1)
-		{
-			/* if it already exists, only need to do something (change)
-			 * if there should be a param */
-			if (mode_has_arg(serv, sign, mode))
-			{
-				/* leave the old space there */
-				current = g_string_erase(current, argument_offset+1, argument_length-1);
-				current = g_string_insert(current, argument_offset+1, arg);
+		if (!create)
+			return NULL;
+		sess->chanmodes = g_new0 (struct chanmodes, 1);
+	}
+	cm = sess->chanmodes;
 
-				g_free(sess->current_modes);
-				sess->current_modes = g_string_free(current, FALSE);
-			}
-		}
-		/* mode wasn't there before */
+	if (!cm->list[i] && create)
+		cm->list[i] = modelist_new ();
+
+	return cm->list[i];
+}
+
+void
+chanmodes_list_add (session *sess, char mode, char *mask, char *from, time_t stamp)
+{
+	modelist *ml = chanmodes_list (sess, mode, TRUE);
+
+	if (!ml)
+		return;
+
+	/* the first entry of a new listing */
+	if (!ml->listing)
+	{
+		ml->listing = TRUE;
+		ml->gen++;
+	}
+
+	modelist_add (ml, mode, mask, from, stamp);
+}
+
+void
+chanmodes_list_end (session *sess, char mode)
+{
+	modelist *ml = chanmodes_list (sess, mode, TRUE);
+	GList *link, *next;
+
+	if (!ml)
+		return;
+
+	/* an empty listing */
+	if (!ml->listing)
+		ml->gen++;
+	ml->listing = FALSE;
+
+	/* whatever it didn't mention is gone */
+	for (link = ml->entries.head; link; link = next)
+	{
+		next = link->next;
+		if (((modelist_entry *)link->data)->gen != ml->gen)
+			modelist_remove_link (ml, link);
+	}
+}
+
+GSList *
+chanmodes_list_find (session *sess, char mode, const char *string)
+{
+	modelist *ml = chanmodes_list (sess, mode, FALSE);
+
+	if (!ml)
+		return NULL;
+
+	return modelist_find (ml, string);
+}
+
+GSList *
+chanmodes_list_flat (session *sess)
+{
+	GSList *list = NULL;
+	GList *link;
+	int i;
+
+	if (!sess->chanmodes)
+		return NULL;
+
+	for (i = MODE_LETTERS - 1; i >= 0; i--)
+	{
+		if (!sess->chanmodes->list[i])
+			continue;
+		for (link = sess->chanmodes->list[i]->entries.tail; link; link = link->prev)
+			list = g_slist_prepend (list, &((modelist_entry *)link->data)->pub);
+	}
+
+	return list;
+}
+
+GSList *
+chanmodes_mask_hits (session *sess, const char *mask)
+{
+	GSList *users, *list, *hits = NULL;
+	struct User *user;
+	char *full;
+
+	users = userlist_flat_list (sess);
+	for (list = users; list; list = list->next)
+	{
+		user = list->data;
+		if (!user->hostname)
+			continue;
+
+		full = g_strdup_printf ("%s!%s", user->nick, user->hostname);
+		if (match (mask, full))
+			hits = g_slist_prepend (hits, user);
+		g_free (full);
+	}
+	g_slist_free (users);
+
+	return g_slist_reverse (hits);
+}
+
+static void
+record_chan_mode (session *sess, char sign, char mode, char *arg, char *nick)
+{
+	/* Somebody needed to acutally update the channel's modes, needed to
+		play nice with bouncers, and less mode calls. Also keeps modes up
+		to date for scripts */
+	struct chanmodes *cm;
+	guint64 bit;
+	int i;
+
+	i = mode_index (mode);
+	if (i == -1)
+		return;
+	bit = G_GUINT64_CONSTANT (1) << i;
+
+	if (!sess->chanmodes)
+		sess->chanmodes = g_new0 (struct chanmodes, 1);
+	cm = sess->chanmodes;
+
+	switch (mode_chanmode_type (sess->server, mode))
+	{
+	case 0:					  /* type A */
+		if (!*arg)
+			return;	/* the mask went missing, nothing to add or remove */
+		if (!cm->list[i])
+			cm->list[i] = modelist_new ();
+		if (sign == '+')
+			modelist_add (cm->list[i], mode, arg, *nick ? nick : NULL, time (NULL));
 		else
-		{
-			/* insert the new mode character */
-			current = g_string_insert_c(current, modes_length, mode);
+			modelist_remove (cm->list[i], arg);
+		return;
+	case 1:					  /* type B */
+	case 2:					  /* type C */
+		g_free (cm->arg[i]);
+		cm->arg[i] = sign == '+' ? g_strdup (arg) : NULL;
+		break;
+	}
 
-			/* add the argument, with space if there is one */
-			if (mode_has_arg(serv, sign, mode))
-			{
-				current = g_string_append_c(current, ' ');
-				current = g_string_append(current, arg);
-			}
+	if (sign == '+')
+		cm->set |= bit;
+	else
+		cm->set &= ~bit;
 
-			g_free(sess->current_modes);
-			sess->current_modes = g_string_free(current, FALSE);
+	g_clear_pointer (&cm->str, g_free);
+}
+
+/* forgets all but the list modes, a 324 is about to tell us all of them */
+static void
+chanmodes_reset (session *sess)
+{
+	struct chanmodes *cm;
+	int i;
+
+	if (!sess->chanmodes)
+		sess->chanmodes = g_new0 (struct chanmodes, 1);
+	cm = sess->chanmodes;
+
+	for (i = 0; i < MODE_LETTERS; i++)
+		g_clear_pointer (&cm->arg[i], g_free);
+	g_clear_pointer (&cm->str, g_free);
+	cm->set = 0;
+}
+
+const char *
+chanmodes_string (session *sess)
+{
+	struct chanmodes *cm = sess->chanmodes;
+	GString *str;
+	int i;
+
+	if (!cm)
+		return NULL;
+
+	if (!cm->str)
+	{
+		str = g_string_new ("+");
+		for (i = 0; i < MODE_LETTERS; i++)
+		{
+			if (cm->set & (G_GUINT64_CONSTANT (1) << i))
+				g_string_append_c (str, i < 26 ? 'A' + i : 'a' + i - 26);
+		}
+		for (i = 0; i < MODE_LETTERS; i++)
+		{
+			if (cm->arg[i])
+				g_string_append_printf (str, " %s", cm->arg[i]);
 		}
+		cm->str = g_string_free (str, FALSE);
 	}
-	else if (sign == '-' && mode_pos != -1)
-	{
-		/* remove the argument first if it has one*/
-		if (mode_has_arg(serv, '+', mode))
-			current = g_string_erase(current, argument_offset, argument_length);
 
-		/* remove the mode character */
-		current = g_string_erase(current, mode_pos, 1);
+	return cm->str;
+}
+
+void
+chanmodes_free (session *sess)
+{
+	struct chanmodes *cm = sess->chanmodes;
+	int i;
+
+	if (!cm)
+		return;
 
-		g_free(sess->current_modes);
-		sess->current_modes = g_string_free(current, FALSE);
+	for (i = 0; i < MODE_LETTERS; i++)
+	{
+		g_free (cm->arg[i]);
+		if (cm->list[i])
+			modelist_free (cm->list[i]);
 	}
+	g_free (cm->str);
+	g_free (cm);
+	sess->chanmodes = NULL;
 }
 
 static char *
@@ -392,7 +795,7 @@ mode_cat (char *str, char *addition)
 static void
 handle_single_mode (mode_run *mr, char sign, char mode, char *nick,
 						  char *chan, char *arg, int quiet, int is_324,
-						  const message_tags_data *tags_data)
+						  int using_front_tab, const message_tags_data *tags_data)
 {
 	session *sess;
 	server *serv = mr->serv;
@@ -414,14 +817,16 @@ handle_single_mode (mode_run *mr, char sign, char mode, char *nick,
 	}
 
 	/* is this a nick mode? */
-	if (strchr (serv->nick_modes, mode))
+	if (mode_is_prefix (serv, mode))
 	{
 		/* update the user in the userlist */
 		userlist_update_mode (sess, /*nickname */ arg, mode, sign);
 	} else
 	{
-		if (!is_324 && !sess->ignore_mode && mode_chanmode_type(serv, mode) >= 1)
-			record_chan_mode (sess, sign, mode, arg);
+		/* the front tab only shows replies about channels we're not in */
+		if (!using_front_tab && (is_324 || !sess->ignore_mode) &&
+			 mode_chanmode_type(serv, mode) >= 0)
+			record_chan_mode (sess, sign, mode, arg, nick);
 	}
 
 	/* Is q a chanmode on this server? */
@@ -580,7 +985,7 @@ mode_has_arg (server * serv, char sign, char mode)
 	int type;
 
 	/* if it's a nickmode, it must have an arg */
-	if (strchr (serv->nick_modes, mode))
+	if (mode_is_prefix (serv, mode))
 		return 1;
 
 	type = mode_chanmode_type (serv, mode);
@@ -604,27 +1009,43 @@ mode_has_arg (server * serv, char sign, char mode)
 static int
 mode_chanmode_type (server * serv, char mode)
 {
-	/* see what numeric 005 CHANMODES=xxx said */
-	char *cm = serv->chanmodes;
+	int type;
+
+	if ((unsigned char) mode >= 128)
+		return -1;
+
+	type = serv->chanmode_type[(int) mode];
+	return type == MODE_PREFIX ? -1 : type;
+}
+
+/* sorts the letters in numeric 005 CHANMODES and PREFIX by type, so a mode
+   can be looked up without going through them */
+void
+mode_update_types (server *serv)
+{
+	char *cm;
 	int type = 0;
-	int found = 0;
 
-	while (*cm && !found)
+	memset (serv->chanmode_type, -1, sizeof (serv->chanmode_type));
+
+	for (cm = serv->chanmodes; *cm; cm++)
 	{
 		if (*cm == ',')
 		{
-			type++;
-		} else if (*cm == mode)
+			if (type < MODE_PREFIX - 1)
+				type++;
+		}
+		else if ((unsigned char) *cm < 128 && serv->chanmode_type[(int) *cm] == -1)
 		{
-			found = 1;
+			serv->chanmode_type[(int) *cm] = type;
 		}
-		cm++;
 	}
-	if (found)
-		return type;
-	/* not found? -1 */
-	else
-		return -1;
+
+	for (cm = serv->nick_modes; *cm; cm++)
+	{
+		if ((unsigned char) *cm < 128)
+			serv->chanmode_type[(int) *cm] = MODE_PREFIX;
+	}
 }
 
 static void
@@ -717,10 +1138,7 @@ handle_mode (server * serv, char *word[], char *word_eol[],
 									  tags_data->timestamp);
 
 	if (numeric_324 && !using_front_tab)
-	{
-		g_free (sess->current_modes);
-		sess->current_modes = g_strdup (word_eol[offset+1]);
-	}
+		chanmodes_reset (sess);
 
 	sign = *modes;
 	modes++;
@@ -741,12 +1159,10 @@ handle_mode (server * serv, char *word[], char *word_eol[],
 
 	/* count the number of modes (without the -/+ chars */
 	num_modes = 0;
-	i = 0;
-	while (i < strlen (modes))
+	for (i = 0; modes[i]; i++)
 	{
 		if (modes[i] != '+' && modes[i] != '-')
 			num_modes++;
-		i++;
 	}
 
 	if (num_args == num_modes)
@@ -771,7 +1187,7 @@ handle_mode (server * serv, char *word[], char *word_eol[],
 			}
 			handle_single_mode (&mr, sign, *modes, nick, chan,
 									  argstr, numeric_324 || prefs.hex_irc_raw_modes,
-									  numeric_324, tags_data);
+									  numeric_324, using_front_tab, tags_data);
 		}
 
 		modes++;
@@ -871,6 +1287,7 @@ inbound_005 (server * serv, char *word[], const message_tags_data *tags_data)
 		{
 			g_free (serv->chanmodes);
 			serv->chanmodes = g_strdup (tokvalue);
+			mode_update_types (serv);
 		} else if (g_strcmp0 (tokname, "PREFIX") == 0)
 		{
 			pre = strchr (tokvalue, ')');
@@ -881,6 +1298,7 @@ inbound_005 (server * serv, char *word[], const message_tags_data *tags_data)
 				g_free (serv->nick_modes);
 				serv->nick_prefixes = g_strdup (pre + 1);
 				serv->nick_modes = g_strdup (tokvalue + 1);
+				mode_update_types (serv);
 			} else
 			{
 				/* bad! some ircds don't give us the modes. */
@@ -892,15 +1310,18 @@ inbound_005 (server * serv, char *word[], const message_tags_data *tags_data)
 		} else if (g_strcmp0 (tokname, "WATCH") == 0)
 		{
 			serv->supports_watch = tokadding;
+			serv->watch_limit = tokadding ? atoi (tokvalue) : 0;
 		} else if (g_strcmp0 (tokname, "MONITOR") == 0)
 		{
 			serv->supports_monitor = tokadding;
+			serv->monitor_limit = tokadding ? atoi (tokvalue) : 0;
 		} else if (g_strcmp0 (tokname, "NETWORK") == 0)
 		{
 			if (serv->server_session->type == SESS_SERVER && strlen (tokvalue))
 			{
 				safe_strcpy (serv->server_session->channel, tokvalue, CHANLEN);
 				fe_set_channel (serv->server_session);
+				log_update_server (serv);
 			}
 
 		} else if (g_strcmp0 (tokname, "CASEMAPPING") == 0)
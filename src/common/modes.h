@@ -26,9 +26,33 @@ int is_channel (server *serv, char *chan);
 char get_nick_prefix (server *serv, unsigned int access);
 unsigned int nick_access (server *serv, char *nick, int *modechars);
 int mode_access (server *serv, char mode, char *prefix);
+void mode_update_types (server *serv);
 void inbound_005 (server *serv, char *word[], const message_tags_data *tags_data);
 void handle_mode (server *serv, char *word[], char *word_eol[], char *nick,
 						int numeric_324, const message_tags_data *tags_data);
+/* the channel's modes like "+ntk key", NULL until some are known */
+const char *chanmodes_string (session *sess);
+void chanmodes_free (session *sess);
+
+/* an entry of a list mode like +b */
+typedef struct
+{
+	char *mask;
+	char *from;						/* who set it, NULL if unknown */
+	time_t stamp;
+	char mode[2];					/* "b" and such */
+} chanmode_entry;
+
+/* entries from a 367 or such, and the end of such a listing */
+void chanmodes_list_add (session *sess, char mode, char *mask, char *from, time_t stamp);
+void chanmodes_list_end (session *sess, char mode);
+/* the entries whose masks match string, a nick!user@host or another mask
+   to see if it's already covered. Only tries the few masks that could. */
+GSList *chanmodes_list_find (session *sess, char mode, const char *string);
+/* every entry of every list mode */
+GSList *chanmodes_list_flat (session *sess);
+/* the struct User *s whose nick!user@host mask matches */
+GSList *chanmodes_mask_hits (session *sess, const char *mask);
 void send_channel_modes (session *sess, char *tbuf, char *word[], int start, int end, char sign, char mode, int modes_per_line);
 
 #endif
@@ -43,6 +43,13 @@
 GSList *notify_list = 0;
 int notify_tag = 0;
 
+/* notify_list by rfc_tolower'd name, so joins and 303s don't walk it */
+static GHashTable *notify_index = NULL;
+
+/* names per ISON: the 303 repeats the ones that are online, and has to fit
+   its own prefix in 512 bytes as well */
+#define ISON_NAMES_MAX 400
+
 
 static char *
 despacify_dup (char *str)
@@ -63,6 +70,36 @@ despacify_dup (char *str)
 	}
 }
 
+static void
+notify_fold (char *folded, const char *name)
+{
+	while (*name)
+		*folded++ = rfc_tolower (*name++);
+	*folded = 0;
+}
+
+/* serv's casemapping decides, NULL goes by rfc1459 */
+
+struct notify *
+notify_lookup (server *serv, const char *name)
+{
+	struct notify *notify;
+	char folded[NICKLEN];
+
+	/* longer names can't be in the list, notify_adduser() cuts them */
+	if (!notify_index || strlen (name) >= NICKLEN)
+		return NULL;
+
+	notify_fold (folded, name);
+	notify = g_hash_table_lookup (notify_index, folded);
+
+	/* with CASEMAPPING=ascii, [] and {} aren't the same */
+	if (notify && serv && serv->p_cmp (notify->name, name))
+		return NULL;
+
+	return notify;
+}
+
 static int
 notify_netcmp (char *str, void *serv)
 {
@@ -178,30 +215,15 @@ notify_load (void)
 }
 
 static struct notify_per_server *
-notify_find (server *serv, char *nick)
+notify_find (server *serv, const char *nick)
 {
-	GSList *list = notify_list;
-	struct notify_per_server *servnot;
 	struct notify *notify;
 
-	while (list)
-	{
-		notify = (struct notify *) list->data;
-
-		servnot = notify_find_server_entry (notify, serv);
-		if (!servnot)
-		{
-			list = list->next;
-			continue;
-		}
-
-		if (!serv->p_cmp (notify->name, nick))
-			return servnot;
-
-		list = list->next;
-	}
+	notify = notify_lookup (serv, nick);
+	if (!notify)
+		return NULL;
 
-	return NULL;
+	return notify_find_server_entry (notify, serv);
 }
 
 static void
@@ -336,25 +358,74 @@ notify_set_online_list (server * serv, char *users,
 	}
 }
 
+/* is there room for another nick on serv's MONITOR or WATCH list? The
+   ones that don't fit are checked with ISON instead. */
+
+static gboolean
+notify_can_watch (server *serv)
+{
+	int limit;
+
+	if (serv->supports_monitor)
+		limit = serv->monitor_limit;
+	else if (serv->supports_watch)
+		limit = serv->watch_limit;
+	else
+		return FALSE;
+
+	return limit <= 0 || serv->watch_count < limit;
+}
+
 static void
-notify_watch (server * serv, char *nick, int add)
+notify_watch (server * serv, struct notify *notify, int add)
 {
+	struct notify_per_server *servnot;
 	char tbuf[256];
 	char addchar = '+';
 
-	if (!add)
+	servnot = notify_find_server_entry (notify, serv);
+	if (!servnot)
+		return;
+
+	if (add)
+	{
+		if (servnot->watched || !notify_can_watch (serv))
+			return;
+		servnot->watched = TRUE;
+		serv->watch_count++;
+	} else
+	{
+		if (!servnot->watched)
+			return;
+		servnot->watched = FALSE;
+		serv->watch_count--;
 		addchar = '-';
+	}
 
 	if (serv->supports_monitor)
-		g_snprintf (tbuf, sizeof (tbuf), "MONITOR %c %s", addchar, nick);
-	else if (serv->supports_watch)
-		g_snprintf (tbuf, sizeof (tbuf), "WATCH %c%s", addchar, nick);
+		g_snprintf (tbuf, sizeof (tbuf), "MONITOR %c %s", addchar, notify->name);
 	else
-		return;
+		g_snprintf (tbuf, sizeof (tbuf), "WATCH %c%s", addchar, notify->name);
 
 	serv->p_raw (serv, tbuf);
 }
 
+/* a nick left the list, give its place to one that was checked by ISON */
+
+static void
+notify_watch_next (server *serv)
+{
+	struct notify_per_server *servnot;
+	GSList *list;
+
+	for (list = notify_list; list && notify_can_watch (serv); list = list->next)
+	{
+		servnot = notify_find_server_entry (list->data, serv);
+		if (servnot && !servnot->watched)
+			notify_watch (serv, list->data, TRUE);
+	}
+}
+
 static void
 notify_watch_all (struct notify *notify, int add)
 {
@@ -363,12 +434,48 @@ notify_watch_all (struct notify *notify, int add)
 	while (list)
 	{
 		serv = list->data;
-		if (serv->connected && serv->end_of_motd && notify_do_network (notify, serv))
-			notify_watch (serv, notify->name, add);
+		if (serv->connected && serv->end_of_motd)
+		{
+			notify_watch (serv, notify, add);
+			if (!add)
+				notify_watch_next (serv);
+		}
 		list = list->next;
 	}
 }
 
+/* the server's list was full after all (734 or 512), leave these to ISON */
+
+void
+notify_watch_full (server *serv, const char *nicks)
+{
+	struct notify_per_server *servnot;
+	char **names, *chr;
+	int i;
+
+	names = g_strsplit (nicks, ",", 0);
+	for (i = 0; names[i]; i++)
+	{
+		chr = strchr (names[i], '!');
+		if (chr != NULL)
+			*chr = '\0';
+
+		servnot = notify_find (serv, names[i]);
+		if (servnot && servnot->watched)
+		{
+			servnot->watched = FALSE;
+			serv->watch_count--;
+		}
+	}
+	g_strfreev (names);
+
+	/* whatever it advertised, that's as many as it takes */
+	if (serv->supports_monitor)
+		serv->monitor_limit = MAX (serv->watch_count, 1);
+	else
+		serv->watch_limit = MAX (serv->watch_count, 1);
+}
+
 static void
 notify_flush_watches (server * serv, GSList *from, GSList *end)
 {
@@ -398,25 +505,35 @@ void
 notify_send_watches (server * serv)
 {
 	struct notify *notify;
+	struct notify_per_server *servnot;
 	const int format_len = serv->supports_monitor ? 1 : 2; /* just , for monitor or + and space for watch */
 	GSList *list;
 	GSList *point;
 	GSList *send_list = NULL;
 	int len = 0;
 
-	/* Only get the list for this network */
+	/* Only get the list for this network, as much of it as the server
+	   takes. The rest is left to ISON. */
+	serv->watch_count = 0;
 	list = notify_list;
 	while (list)
 	{
 		notify = list->data;
 
-		if (notify_do_network (notify, serv))
+		servnot = notify_find_server_entry (notify, serv);
+		if (servnot)
 		{
-			send_list = g_slist_append (send_list, notify);
+			servnot->watched = notify_can_watch (serv);
+			if (servnot->watched)
+			{
+				serv->watch_count++;
+				send_list = g_slist_prepend (send_list, notify);
+			}
 		}
 
 		list = list->next;
 	}
+	send_list = g_slist_reverse (send_list);
 
 	/* Now send that list in batches */
 	point = list = send_list;
@@ -444,86 +561,142 @@ notify_send_watches (server * serv)
 	g_slist_free (send_list);
 }
 
-/* called when receiving a ISON 303 - should this func go? */
+/* ISON's reply doesn't say which nicks it answers, so every ISON sent
+   queues its names and each 303 is matched to the oldest of them */
 
-void
-notify_markonline (server *serv, char *word[], const message_tags_data *tags_data)
+static void
+notify_ison_batch_free (gpointer batch)
 {
-	struct notify *notify;
+	g_hash_table_destroy (batch);
+}
+
+/* called when receiving a ISON 303, FALSE if it wasn't ours */
+
+gboolean
+notify_markonline (server *serv, char *nicks, const message_tags_data *tags_data)
+{
+	GHashTable *batch, *seen;
+	GHashTableIter iter;
 	struct notify_per_server *servnot;
-	GSList *list = notify_list;
-	int i, seen;
+	char folded[NICKLEN];
+	char **names;
+	gpointer name;
+	int i;
 
-	while (list)
+	if (!serv->ison_queue || g_queue_is_empty (serv->ison_queue))
+		return FALSE;
+
+	batch = g_queue_peek_head (serv->ison_queue);
+	names = g_strsplit (nicks, " ", 0);
+
+	/* somebody's /quote ISON, answered in between ours */
+	for (i = 0; names[i]; i++)
 	{
-		notify = (struct notify *) list->data;
-		servnot = notify_find_server_entry (notify, serv);
-		if (!servnot)
-		{
-			list = list->next;
+		if (!names[i][0])
 			continue;
-		}
-		i = 4;
-		seen = FALSE;
-		while (*word[i])
-		{
-			if (!serv->p_cmp (notify->name, word[i]))
-			{
-				seen = TRUE;
-				notify_announce_online (serv, servnot, notify->name, tags_data);
-				break;
-			}
-			i++;
-			/* FIXME: word[] is only a 32 element array, limits notify list to
-			   about 27 people */
-			if (i > PDIWORDS - 5)
-			{
-				/*fprintf (stderr, _("*** HEXCHAT WARNING: notify list too large.\n"));*/
-				break;
-			}
-		}
-		if (!seen && servnot->ison)
+		if (strlen (names[i]) >= NICKLEN)
+			break;
+		notify_fold (folded, names[i]);
+		if (!g_hash_table_contains (batch, folded))
+			break;
+	}
+	if (names[i])
+	{
+		g_strfreev (names);
+		return FALSE;
+	}
+
+	g_queue_pop_head (serv->ison_queue);
+	seen = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+	for (i = 0; names[i]; i++)
+	{
+		servnot = notify_find (serv, names[i]);
+		if (servnot)
 		{
-			notify_announce_offline (serv, servnot, notify->name, FALSE, tags_data);
+			g_hash_table_add (seen, servnot);
+			notify_announce_online (serv, servnot, servnot->notify->name, tags_data);
 		}
-		list = list->next;
 	}
+
+	g_hash_table_iter_init (&iter, batch);
+	while (g_hash_table_iter_next (&iter, NULL, &name))
+	{
+		servnot = notify_find (serv, name);
+		if (servnot && servnot->ison && !g_hash_table_contains (seen, servnot))
+			notify_announce_offline (serv, servnot, servnot->notify->name, FALSE, tags_data);
+	}
+
+	g_hash_table_destroy (seen);
+	g_hash_table_destroy (batch);
+	g_strfreev (names);
 	fe_notify_update (0);
+	return TRUE;
+}
+
+static void
+notify_ison_send (server *serv, GString *outbuf, GHashTable *batch)
+{
+	serv->p_raw (serv, outbuf->str);
+	g_queue_push_tail (serv->ison_queue, batch);
 }
 
-/* yuck! Old routine for ISON notify */
+/* everyone that isn't on the server's MONITOR or WATCH list, in as many
+   ISONs as it takes */
 
 static void
 notify_checklist_for_server (server *serv)
 {
-	char outbuf[512];
+	GString *outbuf;
+	GHashTable *batch = NULL;
 	struct notify *notify;
-	GSList *list = notify_list;
-	int i = 0;
+	struct notify_per_server *servnot;
+	GSList *list;
+	char *folded;
 
-	strcpy (outbuf, "ISON ");
-	while (list)
+	if (!serv->ison_queue)
+		serv->ison_queue = g_queue_new ();
+
+	/* the last round hasn't been answered yet, don't pile up more, unless
+		a reply got lost and it never will be */
+	if (!g_queue_is_empty (serv->ison_queue))
+	{
+		if (time (NULL) - serv->ison_sent < 2 * prefs.hex_notify_timeout)
+			return;
+		while (!g_queue_is_empty (serv->ison_queue))
+			notify_ison_batch_free (g_queue_pop_head (serv->ison_queue));
+	}
+	serv->ison_sent = time (NULL);
+
+	outbuf = g_string_sized_new (512);
+	for (list = notify_list; list; list = list->next)
 	{
 		notify = list->data;
-		if (notify_do_network (notify, serv))
+		servnot = notify_find_server_entry (notify, serv);
+		if (!servnot || servnot->watched)
+			continue;
+
+		if (batch && outbuf->len + strlen (notify->name) > ISON_NAMES_MAX)
 		{
-			i++;
-			strcat (outbuf, notify->name);
-			strcat (outbuf, " ");
-			if (strlen (outbuf) > 460)
-			{
-				/* LAME: we can't send more than 512 bytes to the server, but     *
-				 * if we split it in two packets, our offline detection wouldn't  *
-				 work                                                           */
-				/*fprintf (stderr, _("*** HEXCHAT WARNING: notify list too large.\n"));*/
-				break;
-			}
+			notify_ison_send (serv, outbuf, batch);
+			batch = NULL;
 		}
-		list = list->next;
+		if (!batch)
+		{
+			g_string_assign (outbuf, "ISON");
+			batch = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+		}
+
+		folded = g_strdup (notify->name);
+		notify_fold (folded, notify->name);
+		g_hash_table_insert (batch, folded, g_strdup (notify->name));
+		g_string_append_c (outbuf, ' ');
+		g_string_append (outbuf, notify->name);
 	}
 
-	if (i)
-		serv->p_raw (serv, outbuf);
+	if (batch)
+		notify_ison_send (serv, outbuf, batch);
+	g_string_free (outbuf, TRUE);
 }
 
 int
@@ -535,7 +708,7 @@ notify_checklist (void)	/* check ISON list */
 	while (list)
 	{
 		serv = list->data;
-		if (serv->connected && serv->end_of_motd && !serv->supports_watch && !serv->supports_monitor)
+		if (serv->connected && serv->end_of_motd)
 		{
 			notify_checklist_for_server (serv);
 		}
@@ -544,6 +717,19 @@ notify_checklist (void)	/* check ISON list */
 	return 1;
 }
 
+/* serv disconnected or is going away */
+
+void
+notify_server_cleanup (server *serv)
+{
+	if (serv->ison_queue)
+	{
+		g_queue_free_full (serv->ison_queue, notify_ison_batch_free);
+		serv->ison_queue = NULL;
+	}
+	serv->watch_count = 0;
+}
+
 void
 notify_showlist (struct session *sess, const message_tags_data *tags_data)
 {
@@ -582,67 +768,64 @@ notify_deluser (char *name)
 {
 	struct notify *notify;
 	struct notify_per_server *servnot;
-	GSList *list = notify_list;
+	char folded[NICKLEN];
 
-	while (list)
+	notify = notify_lookup (NULL, name);
+	if (!notify)
+		return 0;
+
+	fe_notify_update (notify->name);
+	notify_list = g_slist_remove (notify_list, notify);
+	notify_fold (folded, notify->name);
+	g_hash_table_remove (notify_index, folded);
+	notify_watch_all (notify, FALSE);
+	/* Remove the records for each server */
+	while (notify->server_list)
 	{
-		notify = (struct notify *) list->data;
-		if (!rfc_casecmp (notify->name, name))
-		{
-			fe_notify_update (notify->name);
-			/* Remove the records for each server */
-			while (notify->server_list)
-			{
-				servnot = (struct notify_per_server *) notify->server_list->data;
-				notify->server_list =
-					g_slist_remove (notify->server_list, servnot);
-				g_free (servnot);
-			}
-			notify_list = g_slist_remove (notify_list, notify);
-			notify_watch_all (notify, FALSE);
-			g_free (notify->networks);
-			g_free (notify->name);
-			g_free (notify);
-			fe_notify_update (0);
-			return 1;
-		}
-		list = list->next;
+		servnot = (struct notify_per_server *) notify->server_list->data;
+		notify->server_list =
+			g_slist_remove (notify->server_list, servnot);
+		g_free (servnot);
 	}
-	return 0;
+	g_free (notify->networks);
+	g_free (notify->name);
+	g_free (notify);
+	fe_notify_update (0);
+	return 1;
 }
 
 void
 notify_adduser (char *name, char *networks)
 {
-	struct notify *notify = g_new0 (struct notify, 1);
+	struct notify *notify;
+	char *folded;
 
+	if (!notify_index)
+		notify_index = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+	notify = g_new0 (struct notify, 1);
 	notify->name = g_strndup (name, NICKLEN - 1);
 
+	/* already there, it just gets the new networks */
+	notify_deluser (notify->name);
+	notify_list = g_slist_prepend (notify_list, notify);
+
+	folded = g_strdup (notify->name);
+	notify_fold (folded, notify->name);
+	g_hash_table_insert (notify_index, folded, notify);
+
 	if (networks != NULL)
 		notify->networks = despacify_dup (networks);
-	notify->server_list = 0;
-	notify_list = g_slist_prepend (notify_list, notify);
+	notify_watch_all (notify, TRUE);
 	notify_checklist ();
 	fe_notify_update (notify->name);
 	fe_notify_update (0);
-	notify_watch_all (notify, TRUE);
 }
 
 gboolean
 notify_is_in_list (server *serv, char *name)
 {
-	struct notify *notify;
-	GSList *list = notify_list;
-
-	while (list)
-	{
-		notify = (struct notify *) list->data;
-		if (!serv->p_cmp (notify->name, name))
-			return TRUE;
-		list = list->next;
-	}
-
-	return FALSE;
+	return notify_lookup (serv, name) != NULL;
 }
 
 int
@@ -650,21 +833,13 @@ notify_isnotify (struct session *sess, char *name)
 {
 	struct notify *notify;
 	struct notify_per_server *servnot;
-	GSList *list = notify_list;
 
-	while (list)
-	{
-		notify = (struct notify *) list->data;
-		if (!sess->server->p_cmp (notify->name, name))
-		{
-			servnot = notify_find_server_entry (notify, sess->server);
-			if (servnot && servnot->ison)
-				return TRUE;
-		}
-		list = list->next;
-	}
+	notify = notify_lookup (sess->server, name);
+	if (!notify)
+		return FALSE;
 
-	return FALSE;
+	servnot = notify_find_server_entry (notify, sess->server);
+	return servnot && servnot->ison;
 }
 
 void
@@ -37,6 +37,7 @@ struct notify_per_server
 	time_t lastseen;
 	time_t lastoff;
 	unsigned int ison:1;
+	unsigned int watched:1;	/* on the server's MONITOR/WATCH list, else ISON */
 };
 
 extern GSList *notify_list;
@@ -53,21 +54,25 @@ void notify_set_online_list (server * serv, char *users,
 void notify_set_offline_list (server * serv, char *users, int quiet,
 								 const message_tags_data *tags_data);
 void notify_send_watches (server * serv);
+void notify_watch_full (server *serv, const char *nicks);
 
 /* the general stuff */
 void notify_adduser (char *name, char *networks);
 int notify_deluser (char *name);
 void notify_cleanup (void);
+void notify_server_cleanup (server *serv);
 void notify_load (void);
 void notify_save (void);
 void notify_showlist (session *sess, const message_tags_data *tags_data);
 gboolean notify_is_in_list (server *serv, char *name);
 int notify_isnotify (session *sess, char *name);
+/* the entry for name, casemapped like serv does. NULL serv for rfc1459 */
+struct notify *notify_lookup (server *serv, const char *name);
 struct notify_per_server *notify_find_server_entry (struct notify *notify, struct server *serv);
 
-/* the old ISON stuff - remove me? */
-void notify_markonline (server *serv, char *word[], 
-								const message_tags_data *tags_data);
+/* ISON, for servers without MONITOR/WATCH and whatever doesn't fit on them */
+gboolean notify_markonline (server *serv, char *nicks,
+									 const message_tags_data *tags_data);
 int notify_checklist (void);
 
 #endif
@@ -531,9 +531,19 @@ ban (session * sess, char *tbuf, char *mask, char *bantypestr, int deop)
 {
 	char *banmask = create_mask (sess, mask, deop ? "-o+b" : "+b", bantypestr, deop);
 	server *serv = sess->server;
+	GSList *covered;
 	
 	if (banmask)
 	{
+		/* say so if a ban we know of already does the job */
+		covered = chanmodes_list_find (sess, 'b', strrchr (banmask, ' ') + 1);
+		if (covered)
+		{
+			PrintTextf (sess, _("%s is already covered by the ban %s\n"),
+							strrchr (banmask, ' ') + 1, ((chanmode_entry *)covered->data)->mask);
+			g_slist_free (covered);
+		}
+
 		serv->p_mode (serv, sess->channel, banmask);
 		g_free (banmask);
 	}
@@ -23,6 +23,7 @@
 #include <string.h>
 #include <glib.h>
 #include "hexchat-plugin.h"
+#include "timerwheel.h"
 
 #ifdef WIN32
 #define g_ascii_strcasecmp stricmp
@@ -36,7 +37,8 @@ static GSList *timer_list = NULL;
 #define STATIC
 #define HELP \
 "Usage: TIMER [-refnum <num>] [-repeat <num>] <seconds> <command>\n" \
-"       TIMER [-quiet] -delete <num>"
+"       TIMER [-quiet] -delete <num>\n" \
+"       TIMER -stats"
 
 typedef struct
 {
@@ -158,6 +160,25 @@ timer_showlist (void)
 	}
 }
 
+/* rates are since the last time this was asked for */
+static void
+timer_showstats (void)
+{
+	static timer_wheel_stats last;
+	timer_wheel_stats stats;
+	double seconds;
+
+	timer_wheel_get_stats (&stats);
+	seconds = (stats.elapsed - last.elapsed) / (double) G_USEC_PER_SEC;
+	if (seconds <= 0)
+		seconds = 1;
+
+	hexchat_printf (ph, _("%d timers armed, %.2f wakeups/s and %.2f callbacks/s over the last %.0f seconds.\n"),
+					  stats.timers, (stats.wakeups - last.wakeups) / seconds,
+					  (stats.fired - last.fired) / seconds, seconds);
+	last = stats;
+}
+
 static int
 timer_cb (char *word[], char *word_eol[], void *userdata)
 {
@@ -174,6 +195,12 @@ timer_cb (char *word[], char *word_eol[], void *userdata)
 		return HEXCHAT_EAT_HEXCHAT;
 	}
 
+	if (g_ascii_strcasecmp (word[2], "-stats") == 0)
+	{
+		timer_showstats ();
+		return HEXCHAT_EAT_HEXCHAT;
+	}
+
 	if (g_ascii_strcasecmp (word[2], "-quiet") == 0)
 	{
 		quiet = TRUE;
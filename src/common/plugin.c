@@ -40,6 +40,7 @@
 #include "modes.h"
 #include "notify.h"
 #include "text.h"
+#include "timerwheel.h"
 #define PLUGIN_C
 typedef struct session hexchat_context;
 #include "hexchat-plugin.h"
@@ -73,10 +74,38 @@ struct _hexchat_hook
 struct _hexchat_list
 {
 	int type;			/* LIST_* */
-	GSList *pos;		/* current pos */
+	gpointer data;		/* current entry */
 	GSList *next;		/* next pos */
-	GSList *head;		/* for LIST_USERS only */
+	GSList *head;		/* freed with the list, if owns_head */
+	session *sess;		/* the context it was got in */
+	void **users;		/* LIST_USERS: sess->usertree when it was opened */
+	int nusers;
+	int index;
+	unsigned int users_left;	/* sess->users_left when alive was last made */
+	GHashTable *alive;	/* users still there, NULL while nobody left */
+	unsigned int owns_head:1;
 	struct notify_per_server *notifyps;	/* notify_per_server * */
+	guint32 *fields;	/* hashed names, from hexchat_list_cursor() */
+	int nfields;
+};
+
+enum
+{
+	JOB_QUEUED,
+	JOB_RUNNING,
+	JOB_FINISHED
+};
+
+struct _hexchat_job
+{
+	hexchat_plugin *pl;	/* NULL once the plugin is gone */
+	session *sess;		/* the context it was submitted in */
+	void *(*work) (hexchat_job *job, void *user_data);
+	void (*done) (void *result, void *user_data);
+	void *userdata;
+	void *result;
+	gint cancelled;		/* atomic, read by the work function */
+	int state;			/* JOB_*, under job_lock */
 };
 
 typedef int (hexchat_cmd_cb) (char *word[], char *word_eol[], void *user_data);
@@ -95,7 +124,8 @@ enum
 	LIST_DCC,
 	LIST_IGNORE,
 	LIST_NOTIFY,
-	LIST_USERS
+	LIST_USERS,
+	LIST_BANLIST
 };
 
 /* We use binary flags here because it makes it possible for plugin_hook_find()
@@ -146,9 +176,21 @@ enum
 GSList *plugin_list = NULL;	/* export for plugingui.c */
 static GSList *hook_list = NULL;
 
+/* hexchat_job_submit(): one pool for every plugin */
+#define JOB_THREADS_MAX 4
+#define JOB_PENDING_MAX 256
+static GThreadPool *job_pool = NULL;
+static GSList *job_list = NULL;	/* submitted and not yet done, main thread only */
+static GMutex job_lock;
+static GCond job_cond;
+
 extern const struct prefs vars[];	/* cfgfiles.c */
 
 
+static void plugin_cancel_jobs (hexchat_plugin *pl);
+static void pluginpref_close (hexchat_plugin *pl);
+static void pluginpref_close_all (void);
+
 /* unload a plugin and remove it from our linked list */
 
 static int
@@ -162,6 +204,9 @@ plugin_free (hexchat_plugin *pl, int do_deinit, int allow_refuse)
 	if (pl->fake)
 		goto xit;
 
+	/* no work may still be running when deinit frees what it uses */
+	plugin_cancel_jobs (pl);
+
 	/* run the plugin's deinit routine, if any */
 	if (do_deinit && pl->deinit_callback != NULL)
 	{
@@ -187,6 +232,8 @@ plugin_free (hexchat_plugin *pl, int do_deinit, int allow_refuse)
 #endif
 
 xit:
+	pluginpref_close (pl);
+
 	if (pl->free_strings)
 	{
 		g_free (pl->name);
@@ -319,6 +366,17 @@ plugin_add (session *sess, char *filename, void *handle, void *init_func,
 		pl->hexchat_emit_print_attrs = hexchat_emit_print_attrs;
 		pl->hexchat_event_attrs_create = hexchat_event_attrs_create;
 		pl->hexchat_event_attrs_free = hexchat_event_attrs_free;
+		pl->hexchat_list_find = hexchat_list_find;
+		pl->hexchat_list_cursor = hexchat_list_cursor;
+		pl->hexchat_list_str_at = hexchat_list_str_at;
+		pl->hexchat_list_int_at = hexchat_list_int_at;
+		pl->hexchat_list_time_at = hexchat_list_time_at;
+		pl->hexchat_job_submit = hexchat_job_submit;
+		pl->hexchat_job_cancel = hexchat_job_cancel;
+		pl->hexchat_job_cancelled = hexchat_job_cancelled;
+		pl->hexchat_pluginpref_get_many = hexchat_pluginpref_get_many;
+		pl->hexchat_pluginpref_set_many = hexchat_pluginpref_set_many;
+		pl->hexchat_pluginpref_list_all = hexchat_pluginpref_list_all;
 
 		/* run hexchat_plugin_init, if it returns 0, close the plugin */
 		if (((hexchat_init_func *)init_func) (pl, &pl->name, &pl->desc, &pl->version, arg) == 0)
@@ -381,6 +439,8 @@ plugin_kill_all (void)
 			plugin_free (list->data, TRUE, FALSE);
 		list = next;
 	}
+
+	pluginpref_close_all ();
 }
 
 #if defined(USE_PLUGIN) || defined(WIN32)
@@ -749,7 +809,7 @@ plugin_timeout_cb (hexchat_hook *hook)
 
 	if (ret == 0)
 	{
-		hook->tag = 0;	/* avoid fe_timeout_remove, returning 0 is enough! */
+		hook->tag = 0;	/* avoid timer_wheel_remove, returning 0 is enough! */
 		hexchat_unhook (hook->pl, hook);
 	}
 
@@ -843,11 +903,128 @@ plugin_add_hook (hexchat_plugin *pl, int type, int pri, const char *name,
 	plugin_insert_hook (hook);
 
 	if (type == HOOK_TIMER)
-		hook->tag = fe_timeout_add (timeout, plugin_timeout_cb, hook);
+		hook->tag = timer_wheel_add (timeout, (GSourceFunc) plugin_timeout_cb, hook);
 
 	return hook;
 }
 
+static gboolean
+plugin_job_done (gpointer data)
+{
+	hexchat_job *job = data;
+	hexchat_plugin *pl = job->pl;
+
+	if (pl)
+	{
+		job_list = g_slist_remove (job_list, job);
+
+		/* deliver it where it was asked for, if that's still open */
+		pl->context = is_session (job->sess) ? job->sess : current_sess;
+		if (job->done)
+			job->done (job->result, job->userdata);
+	}
+
+	g_free (job);
+	return FALSE;
+}
+
+/* runs in a thread of job_pool */
+
+static void
+plugin_job_thread (gpointer data, gpointer unused)
+{
+	hexchat_job *job = data;
+	gboolean run;
+
+	g_mutex_lock (&job_lock);
+	run = !g_atomic_int_get (&job->cancelled);
+	job->state = run ? JOB_RUNNING : JOB_FINISHED;
+	g_mutex_unlock (&job_lock);
+
+	if (run)
+	{
+		job->result = job->work (job, job->userdata);
+
+		g_mutex_lock (&job_lock);
+		job->state = JOB_FINISHED;
+		g_cond_broadcast (&job_cond);
+		g_mutex_unlock (&job_lock);
+	}
+
+	g_idle_add (plugin_job_done, job);
+}
+
+hexchat_job *
+hexchat_job_submit (hexchat_plugin *ph, void *(*work) (hexchat_job *job, void *user_data),
+						  void (*done) (void *result, void *user_data), void *userdata)
+{
+	hexchat_job *job;
+
+	if (g_slist_length (job_list) >= JOB_PENDING_MAX)
+		return NULL;
+
+	if (!job_pool)
+	{
+		job_pool = g_thread_pool_new (plugin_job_thread, NULL,
+												CLAMP (g_get_num_processors (), 2, JOB_THREADS_MAX),
+												FALSE, NULL);
+		if (!job_pool)
+			return NULL;
+	}
+
+	job = g_new0 (hexchat_job, 1);
+	job->pl = ph;
+	job->sess = ph->context;
+	job->work = work;
+	job->done = done;
+	job->userdata = userdata;
+	job->state = JOB_QUEUED;
+
+	job_list = g_slist_prepend (job_list, job);
+	g_thread_pool_push (job_pool, job, NULL);
+
+	return job;
+}
+
+void
+hexchat_job_cancel (hexchat_plugin *ph, hexchat_job *job)
+{
+	g_atomic_int_set (&job->cancelled, TRUE);
+}
+
+int
+hexchat_job_cancelled (hexchat_plugin *ph, hexchat_job *job)
+{
+	return g_atomic_int_get (&job->cancelled);
+}
+
+/* The plugin's code is about to go away: its queued jobs are dropped and
+   the running ones waited for, without calling back into the plugin. */
+
+static void
+plugin_cancel_jobs (hexchat_plugin *pl)
+{
+	GSList *list, *next;
+	hexchat_job *job;
+
+	for (list = job_list; list; list = next)
+	{
+		job = list->data;
+		next = list->next;
+		if (job->pl != pl)
+			continue;
+
+		g_atomic_int_set (&job->cancelled, TRUE);
+		job->pl = NULL;
+		job_list = g_slist_delete_link (job_list, list);
+
+		g_mutex_lock (&job_lock);
+		while (job->state == JOB_RUNNING)
+			g_cond_wait (&job_cond, &job_lock);
+		g_mutex_unlock (&job_lock);
+	}
+}
+
 GList *
 plugin_command_list(GList *tmp_list)
 {
@@ -976,7 +1153,7 @@ hexchat_unhook (hexchat_plugin *ph, hexchat_hook *hook)
 		return NULL;
 
 	if (hook->type == HOOK_TIMER && hook->tag != 0)
-		fe_timeout_remove (hook->tag);
+		timer_wheel_remove (hook->tag);
 
 	if (hook->type == HOOK_FD && hook->tag != 0)
 		fe_input_remove (hook->tag);
@@ -1204,7 +1381,7 @@ hexchat_get_info (hexchat_plugin *ph, const char *id)
 		return fe_get_inputbox_contents (sess);
 
 	case 0x633fb30:	/* modes */
-		return sess->current_modes;
+		return chanmodes_string (sess);
 
 	case 0x6de15a2e:	/* network */
 		return server_get_network (sess->server, FALSE);
@@ -1292,12 +1469,13 @@ hexchat_get_prefs (hexchat_plugin *ph, const char *name, const char **string, in
 	return 0;
 }
 
-hexchat_list *
-hexchat_list_get (hexchat_plugin *ph, const char *name)
+static hexchat_list *
+plugin_list_new (hexchat_plugin *ph, const char *name, gboolean want_selected)
 {
 	hexchat_list *list;
 
 	list = g_new0 (hexchat_list, 1);
+	list->sess = ph->context;
 
 	switch (str_hash (name))
 	{
@@ -1319,15 +1497,30 @@ hexchat_list_get (hexchat_plugin *ph, const char *name)
 	case 0xc2079749:	/* notify */
 		list->type = LIST_NOTIFY;
 		list->next = notify_list;
-		list->head = (void *)ph->context;	/* reuse this pointer */
 		break;
 
+	case 0xebe98d2d:	/* banlist */
+		if (is_session (ph->context))
+		{
+			list->type = LIST_BANLIST;
+			list->head = list->next = chanmodes_list_flat (ph->context);
+			list->owns_head = TRUE;
+			break;
+		}
+		g_free (list);
+		return NULL;
+
 	case 0x6a68e08: /* users */
 		if (is_session (ph->context))
 		{
+			/* only the tree's array is copied, joins and parts while a
+				script holds on to the list don't shift it, and those who
+				left meanwhile are skipped */
 			list->type = LIST_USERS;
-			list->head = list->next = userlist_flat_list (ph->context);
-			fe_userlist_set_selected (ph->context);
+			list->users = tree_dup_array (ph->context->usertree, &list->nusers);
+			list->users_left = ph->context->users_left;
+			if (want_selected)
+				fe_userlist_set_selected (ph->context);
 			break;
 		}	/* fall through */
 
@@ -1339,29 +1532,175 @@ hexchat_list_get (hexchat_plugin *ph, const char *name)
 	return list;
 }
 
+hexchat_list *
+hexchat_list_get (hexchat_plugin *ph, const char *name)
+{
+	return plugin_list_new (ph, name, TRUE);
+}
+
+/* hashes the field names for hexchat_list_*_at(). Returns whether
+   "selected" is among them, which is costly to keep up to date. */
+
+static gboolean
+plugin_list_set_fields (hexchat_list *list, const char * const *fields)
+{
+	gboolean want_selected = FALSE;
+	int i;
+
+	for (i = 0; fields[i]; i++)
+		;
+
+	list->nfields = i;
+	list->fields = g_new (guint32, i);
+	for (i = 0; i < list->nfields; i++)
+	{
+		list->fields[i] = str_hash (fields[i]);
+		if (list->fields[i] == 0x4705f29b) /* selected */
+			want_selected = TRUE;
+	}
+
+	return want_selected;
+}
+
+hexchat_list *
+hexchat_list_cursor (hexchat_plugin *ph, const char *name, const char * const *fields)
+{
+	hexchat_list *list;
+	gboolean want_selected = TRUE;
+
+	list = plugin_list_new (ph, name, FALSE);
+	if (!list)
+		return NULL;
+
+	if (fields)
+		want_selected = plugin_list_set_fields (list, fields);
+
+	if (want_selected && list->type == LIST_USERS)
+		fe_userlist_set_selected (list->sess);
+
+	return list;
+}
+
+hexchat_list *
+hexchat_list_find (hexchat_plugin *ph, const char *name, const char *key,
+						 const char * const *fields)
+{
+	hexchat_list *list;
+	gpointer found = NULL;
+	gboolean want_selected;
+	int type;
+
+	switch (str_hash (name))
+	{
+	case 0x556423d0: /* channels */
+		type = LIST_CHANNELS;
+		if (is_session (ph->context))
+			found = find_channel (ph->context->server, (char *) key);
+		break;
+
+	case 0xb90bfdd2:	/* ignore */
+		type = LIST_IGNORE;
+		found = ignore_exists ((char *) key);
+		break;
+
+	case 0xc2079749:	/* notify */
+		type = LIST_NOTIFY;
+		if (is_session (ph->context))
+			found = notify_lookup (ph->context->server, key);
+		break;
+
+	case 0x6a68e08: /* users */
+		type = LIST_USERS;
+		if (is_session (ph->context))
+			found = userlist_find (ph->context, key);
+		break;
+
+	default:
+		return NULL;
+	}
+
+	if (!found)
+		return NULL;
+
+	list = g_new0 (hexchat_list, 1);
+	list->type = type;
+	list->sess = ph->context;
+	list->head = list->next = g_slist_prepend (NULL, found);
+	list->owns_head = TRUE;
+
+	want_selected = TRUE;
+	if (fields)
+		want_selected = plugin_list_set_fields (list, fields);
+
+	if (want_selected && type == LIST_USERS)
+		fe_userlist_set_selected (list->sess);
+
+	return list;
+}
+
 void
 hexchat_list_free (hexchat_plugin *ph, hexchat_list *xlist)
 {
-	if (xlist->type == LIST_USERS)
+	if (xlist->owns_head)
 		g_slist_free (xlist->head);
+	g_free (xlist->users);
+	if (xlist->alive)
+		g_hash_table_destroy (xlist->alive);
+	g_free (xlist->fields);
 	g_free (xlist);
 }
 
+static int
+list_add_alive (const void *user, void *alive)
+{
+	g_hash_table_add (alive, (gpointer) user);
+	return TRUE;
+}
+
 int
 hexchat_list_next (hexchat_plugin *ph, hexchat_list *xlist)
 {
+	if (xlist->type == LIST_USERS && !xlist->owns_head)
+	{
+		/* the channel may have been closed meanwhile */
+		if (!is_session (xlist->sess))
+			return 0;
+
+		/* somebody left since, the snapshot may point at freed users.
+			Only look up who's still there again when that happens. */
+		if (xlist->users_left != xlist->sess->users_left)
+		{
+			if (xlist->alive)
+				g_hash_table_remove_all (xlist->alive);
+			else
+				xlist->alive = g_hash_table_new (g_direct_hash, g_direct_equal);
+			tree_foreach (xlist->sess->usertree, list_add_alive, xlist->alive);
+			xlist->users_left = xlist->sess->users_left;
+		}
+
+		while (xlist->index < xlist->nusers)
+		{
+			xlist->data = xlist->users[xlist->index++];
+			if (!xlist->alive || g_hash_table_contains (xlist->alive, xlist->data))
+				return 1;
+		}
+		return 0;
+	}
+
 	if (xlist->next == NULL)
 		return 0;
 
-	xlist->pos = xlist->next;
-	xlist->next = xlist->pos->next;
+	xlist->data = xlist->next->data;
+	xlist->next = xlist->next->next;
 
 	/* NOTIFY LIST: Find the entry which matches the context
 		of the plugin when list_get was originally called. */
 	if (xlist->type == LIST_NOTIFY)
 	{
-		xlist->notifyps = notify_find_server_entry (xlist->pos->data,
-													((session *)xlist->head)->server);
+		if (!is_session (xlist->sess))
+			return 0;
+		xlist->notifyps = notify_find_server_entry (xlist->data,
+													xlist->sess->server);
 		if (!xlist->notifyps)
 			return 0;
 	}
@@ -1395,13 +1734,19 @@ hexchat_list_fields (hexchat_plugin *ph, const char *name)
 	{
 		"saccount", "iaway", "shost", "tlasttalk", "snick", "sprefix", "srealname", "iselected", NULL
 	};
+	static const char * const banlist_fields[] =
+	{
+		"sfrom", "smask", "smode", "ttime", NULL
+	};
 	static const char * const list_of_lists[] =
 	{
-		"channels",	"dcc", "ignore", "notify", "users", NULL
+		"banlist", "channels",	"dcc", "ignore", "notify", "users", NULL
 	};
 
 	switch (str_hash (name))
 	{
+	case 0xebe98d2d:	/* banlist */
+		return banlist_fields;
 	case 0x556423d0:	/* channels */
 		return channels_fields;
 	case 0x183c4:		/* dcc */
@@ -1419,10 +1764,9 @@ hexchat_list_fields (hexchat_plugin *ph, const char *name)
 	return NULL;
 }
 
-time_t
-hexchat_list_time (hexchat_plugin *ph, hexchat_list *xlist, const char *name)
+static time_t
+plugin_list_time (hexchat_plugin *ph, hexchat_list *xlist, guint32 hash)
 {
-	guint32 hash = str_hash (name);
 	gpointer data;
 
 	switch (xlist->type)
@@ -1442,28 +1786,42 @@ hexchat_list_time (hexchat_plugin *ph, hexchat_list *xlist, const char *name)
 		break;
 
 	case LIST_USERS:
-		data = xlist->pos->data;
+		data = xlist->data;
 		switch (hash)
 		{
 		case 0xa9118c42:	/* lasttalk */
 			return ((struct User *)data)->lasttalk;
 		}
+		break;
+
+	case LIST_BANLIST:
+		data = xlist->data;
+		switch (hash)
+		{
+		case 0x3652cd:	/* time */
+			return ((chanmode_entry *)data)->stamp;
+		}
 	}
 
 	return (time_t) -1;
 }
 
-const char *
-hexchat_list_str (hexchat_plugin *ph, hexchat_list *xlist, const char *name)
+time_t
+hexchat_list_time (hexchat_plugin *ph, hexchat_list *xlist, const char *name)
+{
+	return plugin_list_time (ph, xlist, str_hash (name));
+}
+
+static const char *
+plugin_list_str (hexchat_plugin *ph, hexchat_list *xlist, guint32 hash)
 {
-	guint32 hash = str_hash (name);
 	gpointer data = ph->context;
 	int type = LIST_CHANNELS;
 
 	/* a NULL xlist is a shortcut to current "channels" context */
 	if (xlist)
 	{
-		data = xlist->pos->data;
+		data = xlist->data;
 		type = xlist->type;
 	}
 
@@ -1538,15 +1896,32 @@ hexchat_list_str (hexchat_plugin *ph, hexchat_list *xlist, const char *name)
 			return ((struct User *)data)->realname;
 		}
 		break;
+
+	case LIST_BANLIST:
+		switch (hash)
+		{
+		case 0x3017aa:	/* from */
+			return ((chanmode_entry *)data)->from;
+		case 0x3306ec:	/* mask */
+			return ((chanmode_entry *)data)->mask;
+		case 0x3339a3:	/* mode */
+			return ((chanmode_entry *)data)->mode;
+		}
+		break;
 	}
 
 	return NULL;
 }
 
-int
-hexchat_list_int (hexchat_plugin *ph, hexchat_list *xlist, const char *name)
+const char *
+hexchat_list_str (hexchat_plugin *ph, hexchat_list *xlist, const char *name)
+{
+	return plugin_list_str (ph, xlist, str_hash (name));
+}
+
+static int
+plugin_list_int (hexchat_plugin *ph, hexchat_list *xlist, guint32 hash)
 {
-	guint32 hash = str_hash (name);
 	gpointer data = ph->context;
 
 	int channel_flag;
@@ -1558,7 +1933,7 @@ hexchat_list_int (hexchat_plugin *ph, hexchat_list *xlist, const char *name)
 	/* a NULL xlist is a shortcut to current "channels" context */
 	if (xlist)
 	{
-		data = xlist->pos->data;
+		data = xlist->data;
 		type = xlist->type;
 	}
 
@@ -1682,6 +2057,41 @@ hexchat_list_int (hexchat_plugin *ph, hexchat_list *xlist, const char *name)
 	return -1;
 }
 
+int
+hexchat_list_int (hexchat_plugin *ph, hexchat_list *xlist, const char *name)
+{
+	return plugin_list_int (ph, xlist, str_hash (name));
+}
+
+/* the nth of the fields given to hexchat_list_cursor() */
+
+const char *
+hexchat_list_str_at (hexchat_plugin *ph, hexchat_list *xlist, int n)
+{
+	if (n < 0 || n >= xlist->nfields)
+		return NULL;
+
+	return plugin_list_str (ph, xlist, xlist->fields[n]);
+}
+
+int
+hexchat_list_int_at (hexchat_plugin *ph, hexchat_list *xlist, int n)
+{
+	if (n < 0 || n >= xlist->nfields)
+		return -1;
+
+	return plugin_list_int (ph, xlist, xlist->fields[n]);
+}
+
+time_t
+hexchat_list_time_at (hexchat_plugin *ph, hexchat_list *xlist, int n)
+{
+	if (n < 0 || n >= xlist->nfields)
+		return (time_t) -1;
+
+	return plugin_list_time (ph, xlist, xlist->fields[n]);
+}
+
 void *
 hexchat_plugingui_add (hexchat_plugin *ph, const char *filename,
 							const char *name, const char *desc,
@@ -1787,186 +2197,304 @@ hexchat_free (hexchat_plugin *ph, void *ptr)
 	g_free (ptr);
 }
 
-static int
-hexchat_pluginpref_set_str_real (hexchat_plugin *pl, const char *var, const char *value, int mode) /* mode: 0 = delete, 1 = save */
-{
-	FILE *fpIn;
-	int fhOut;
-	int prevSetting;
-	char *confname;
-	char *confname_tmp;
-	char *escaped_value;
-	char *buffer;
-	char *buffer_tmp;
-	char line_buffer[512];		/* the same as in cfg_put_str */
-	char *line_bufp = line_buffer;
-	char *canon;
+/* Plugin prefs are read into memory once per addon_<name>.conf and served
+   from there. Setting one only marks the store dirty, it is written out in
+   one go PREF_FLUSH_DELAY seconds later, or when the plugin is unloaded. */
 
-	canon = g_strdup (pl->name);
-	canonalize_key (canon);
-	confname = g_strdup_printf ("addon_%s.conf", canon);
-	g_free (canon);
-	confname_tmp = g_strdup_printf ("%s.new", confname);
+#define PREF_FLUSH_DELAY 5
+
+typedef struct
+{
+	char *name;			/* as it was set */
+	char *value;		/* unescaped */
+} pref_entry;
+
+typedef struct
+{
+	char *file;				/* relative to the config dir */
+	GHashTable *index;	/* casefolded name -> pref_entry */
+	GPtrArray *entries;	/* in file order */
+	guint flush_tag;
+} pref_store;
 
-	fhOut = hexchat_open_file (confname_tmp, O_TRUNC | O_WRONLY | O_CREAT, 0600, XOF_DOMODE);
-	fpIn = hexchat_fopen_file (confname, "r", 0);
+static GHashTable *pref_stores = NULL;	/* file -> pref_store */
 
-	if (fhOut == -1)		/* unable to save, abort */
+static void
+pref_entry_free (pref_entry *entry)
+{
+	g_free (entry->name);
+	g_free (entry->value);
+	g_free (entry);
+}
+
+static void
+pref_store_free (pref_store *store)
+{
+	if (store->flush_tag)
+		timer_wheel_remove (store->flush_tag);
+	g_ptr_array_free (store->entries, TRUE);
+	g_hash_table_destroy (store->index);
+	g_free (store->file);
+	g_free (store);
+}
+
+static void
+pref_store_put (pref_store *store, const char *name, const char *value)
+{
+	pref_entry *entry;
+	char *key = g_ascii_strdown (name, -1);
+
+	entry = g_hash_table_lookup (store->index, key);
+	if (entry)
 	{
-		g_free (confname);
-		g_free (confname_tmp);
-		if (fpIn)
-			fclose (fpIn);
-		return 0;
+		g_free (key);
+		g_free (entry->value);
+		entry->value = g_strdup (value);
+		return;
 	}
-	else if (fpIn == NULL)	/* no previous config file, no parsing */
+
+	entry = g_new (pref_entry, 1);
+	entry->name = g_strdup (name);
+	entry->value = g_strdup (value);
+	g_hash_table_insert (store->index, key, entry);
+	g_ptr_array_add (store->entries, entry);
+}
+
+static pref_entry *
+pref_store_lookup (pref_store *store, const char *name)
+{
+	pref_entry *entry;
+	char *key = g_ascii_strdown (name, -1);
+
+	entry = g_hash_table_lookup (store->index, key);
+	g_free (key);
+	return entry;
+}
+
+static void
+pref_store_remove (pref_store *store, const char *name)
+{
+	pref_entry *entry;
+	char *key = g_ascii_strdown (name, -1);
+
+	entry = g_hash_table_lookup (store->index, key);
+	if (entry)
 	{
-		if (mode)
-		{
-			escaped_value = g_strescape (value, NULL);
-			buffer = g_strdup_printf ("%s = %s\n", var, escaped_value);
-			g_free (escaped_value);
-			write (fhOut, buffer, strlen (buffer));
-			g_free (buffer);
-			close (fhOut);
-
-			buffer = g_build_filename (get_xdir (), confname, NULL);
-			g_free (confname);
-			buffer_tmp = g_build_filename (get_xdir (), confname_tmp, NULL);
-			g_free (confname_tmp);
+		g_ptr_array_remove (store->entries, entry);
+		g_hash_table_remove (store->index, key);
+	}
+	g_free (key);
+}
 
-#ifdef WIN32
-			g_unlink (buffer);
-#endif
+static void
+pref_store_load (pref_store *store)
+{
+	cfg_index *cfg;
+	char *path, *data, *value;
+	int i;
 
-			if (g_rename (buffer_tmp, buffer) == 0)
-			{
-				g_free (buffer);
-				g_free (buffer_tmp);
-				return 1;
-			}
-			else
-			{
-				g_free (buffer);
-				g_free (buffer_tmp);
-				return 0;
-			}
-		}
-		else
+	path = g_build_filename (get_xdir (), store->file, NULL);
+	if (!g_file_get_contents (path, &data, NULL, NULL))
+	{
+		g_free (path);
+		return;
+	}
+	g_free (path);
+
+	cfg = cfg_index_new (data);
+	for (i = 0; i < cfg->count; i++)
+	{
+		/* only the first of a name counts, like it did before */
+		if (!pref_store_lookup (store, cfg->entries[i].name))
 		{
-			/* mode = 0, we want to delete but the config file and thus the given setting does not exist, we're ready */
-			close (fhOut);
-			g_free (confname);
-			g_free (confname_tmp);
-			return 1;
+			value = g_strcompress (cfg->entries[i].value);
+			pref_store_put (store, cfg->entries[i].name, value);
+			g_free (value);
 		}
 	}
-	else	/* existing config file, preserve settings and find & replace current var value if any */
-	{
-		prevSetting = 0;
+	cfg_index_free (cfg);
+}
 
-		while (fscanf (fpIn, " %511[^\n]", line_bufp) != EOF)	/* read whole lines including whitespaces */
-		{
-			buffer_tmp = g_strdup_printf ("%s ", var);	/* add one space, this way it works against var - var2 checks too */
+static char *
+pref_store_file (hexchat_plugin *pl)
+{
+	char *canon, *file;
 
-			if (strncmp (buffer_tmp, line_buffer, strlen (var) + 1) == 0)	/* given setting already exists */
-			{
-				if (mode)									/* overwrite the existing matching setting if we are in save mode */
-				{
-					escaped_value = g_strescape (value, NULL);
-					buffer = g_strdup_printf ("%s = %s\n", var, escaped_value);
-					g_free (escaped_value);
-				}
-				else										/* erase the setting in delete mode */
-				{
-					buffer = g_strdup ("");
-				}
+	canon = g_strdup (pl->name);
+	canonalize_key (canon);
+	file = g_strdup_printf ("addon_%s.conf", canon);
+	g_free (canon);
+	return file;
+}
 
-				prevSetting = 1;
-			}
-			else
-			{
-				buffer = g_strdup_printf ("%s\n", line_buffer);	/* preserve the existing different settings */
-			}
+static pref_store *
+pref_store_get (hexchat_plugin *pl)
+{
+	pref_store *store;
+	char *file = pref_store_file (pl);
 
-			write (fhOut, buffer, strlen (buffer));
+	if (!pref_stores)
+		pref_stores = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+														 (GDestroyNotify) pref_store_free);
 
-			g_free (buffer);
-			g_free (buffer_tmp);
-		}
+	store = g_hash_table_lookup (pref_stores, file);
+	if (store)
+	{
+		g_free (file);
+		return store;
+	}
 
-		fclose (fpIn);
+	store = g_new0 (pref_store, 1);
+	store->file = file;
+	store->index = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+													  (GDestroyNotify) pref_entry_free);
+	store->entries = g_ptr_array_new ();
+	pref_store_load (store);
+	g_hash_table_insert (pref_stores, store->file, store);
 
-		if (!prevSetting && mode)	/* var doesn't exist currently, append if we're in save mode */
-		{
-			escaped_value = g_strescape (value, NULL);
-			buffer = g_strdup_printf ("%s = %s\n", var, escaped_value);
-			g_free (escaped_value);
-			write (fhOut, buffer, strlen (buffer));
-			g_free (buffer);
-		}
+	return store;
+}
 
-		close (fhOut);
+/* writes the whole store to a new file and renames it over the old one */
+static gboolean
+pref_store_flush (pref_store *store)
+{
+	GString *out;
+	pref_entry *entry;
+	char *escaped, *path, *path_tmp, *file_tmp;
+	gboolean ok;
+	guint i;
+	int fh;
 
-		buffer = g_build_filename (get_xdir (), confname, NULL);
-		g_free (confname);
-		buffer_tmp = g_build_filename (get_xdir (), confname_tmp, NULL);
-		g_free (confname_tmp);
+	if (store->flush_tag)
+	{
+		timer_wheel_remove (store->flush_tag);
+		store->flush_tag = 0;
+	}
+
+	out = g_string_sized_new (256);
+	for (i = 0; i < store->entries->len; i++)
+	{
+		entry = g_ptr_array_index (store->entries, i);
+		escaped = g_strescape (entry->value, NULL);
+		g_string_append_printf (out, "%s = %s\n", entry->name, escaped);
+		g_free (escaped);
+	}
+
+	file_tmp = g_strdup_printf ("%s.new", store->file);
+	fh = hexchat_open_file (file_tmp, O_TRUNC | O_WRONLY | O_CREAT, 0600, XOF_DOMODE);
+	ok = fh != -1 && write (fh, out->str, out->len) == (int) out->len;
+	if (fh != -1)
+		close (fh);
+	g_string_free (out, TRUE);
+
+	path = g_build_filename (get_xdir (), store->file, NULL);
+	path_tmp = g_build_filename (get_xdir (), file_tmp, NULL);
+	g_free (file_tmp);
 
+	if (ok)
+	{
 #ifdef WIN32
-		g_unlink (buffer);
+		g_unlink (path);
 #endif
-
-		if (g_rename (buffer_tmp, buffer) == 0)
-		{
-			g_free (buffer);
-			g_free (buffer_tmp);
-			return 1;
-		}
-		else
-		{
-			g_free (buffer);
-			g_free (buffer_tmp);
-			return 0;
-		}
+		ok = g_rename (path_tmp, path) == 0;
 	}
+	else if (fh != -1)
+	{
+		g_unlink (path_tmp);
+	}
+
+	g_free (path);
+	g_free (path_tmp);
+	return ok;
 }
 
-int
-hexchat_pluginpref_set_str (hexchat_plugin *pl, const char *var, const char *value)
+static gboolean
+pref_store_flush_cb (pref_store *store)
 {
-	return hexchat_pluginpref_set_str_real (pl, var, value, 1);
+	store->flush_tag = 0;
+
+	/* try again later, e.g. if the disk was full */
+	if (!pref_store_flush (store))
+		store->flush_tag = timer_wheel_add_seconds (PREF_FLUSH_DELAY * 6,
+																  (GSourceFunc) pref_store_flush_cb, store);
+	return FALSE;
 }
 
-static int
-hexchat_pluginpref_get_str_real (hexchat_plugin *pl, const char *var, char *dest, int dest_len)
+static void
+pref_store_changed (pref_store *store)
 {
-	char *confname, *canon, *cfg, *unescaped_value;
-	char buf[512];
+	if (!store->flush_tag)
+		store->flush_tag = timer_wheel_add_seconds (PREF_FLUSH_DELAY,
+																  (GSourceFunc) pref_store_flush_cb, store);
+}
 
-	canon = g_strdup (pl->name);
-	canonalize_key (canon);
-	confname = g_strdup_printf ("%s%caddon_%s.conf", get_xdir(), G_DIR_SEPARATOR, canon);
-	g_free (canon);
+/* the last chance to write out what is pending, nothing retries after it */
+static void
+pref_store_flush_final (pref_store *store)
+{
+	if (store->flush_tag && !pref_store_flush (store))
+		PrintTextf (current_sess, _("Plugin settings could not be saved to %s" G_DIR_SEPARATOR_S "%s\n"),
+						get_xdir (), store->file);
+}
+
+/* writes out what is pending and forgets the store, on unload */
+static void
+pluginpref_close (hexchat_plugin *pl)
+{
+	pref_store *store;
+	char *file;
 
-	if (!g_file_get_contents (confname, &cfg, NULL, NULL))
+	if (!pref_stores || !pl->name)
+		return;
+
+	file = pref_store_file (pl);
+
+	store = g_hash_table_lookup (pref_stores, file);
+	if (store)
 	{
-		g_free (confname);
-		return 0;
+		pref_store_flush_final (store);
+		g_hash_table_remove (pref_stores, file);
 	}
-	g_free (confname);
+	g_free (file);
+}
+
+static void
+pluginpref_close_all (void)
+{
+	GHashTableIter iter;
+	pref_store *store;
+
+	if (!pref_stores)
+		return;
 
-	if (!cfg_get_str (cfg, var, buf, sizeof(buf)))
+	g_hash_table_iter_init (&iter, pref_stores);
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &store))
 	{
-		g_free (cfg);
-		return 0;
+		pref_store_flush_final (store);
 	}
+	g_hash_table_remove_all (pref_stores);
+}
 
-	unescaped_value = g_strcompress (buf);
-	g_strlcpy (dest, unescaped_value, dest_len);
+int
+hexchat_pluginpref_set_str (hexchat_plugin *pl, const char *var, const char *value)
+{
+	pref_store *store = pref_store_get (pl);
+
+	pref_store_put (store, var, value);
+	pref_store_changed (store);
+	return 1;
+}
+
+static int
+hexchat_pluginpref_get_str_real (hexchat_plugin *pl, const char *var, char *dest, int dest_len)
+{
+	pref_entry *entry = pref_store_lookup (pref_store_get (pl), var);
+
+	if (!entry)
+		return 0;
 
-	g_free (unescaped_value);
-	g_free (cfg);
+	g_strlcpy (dest, entry->value, dest_len);
 	return 1;
 }
 
@@ -1983,7 +2511,7 @@ hexchat_pluginpref_set_int (hexchat_plugin *pl, const char *var, int value)
 	char buffer[12];
 
 	g_snprintf (buffer, sizeof (buffer), "%d", value);
-	return hexchat_pluginpref_set_str_real (pl, var, buffer, 1);
+	return hexchat_pluginpref_set_str (pl, var, buffer);
 }
 
 int
@@ -2010,41 +2538,100 @@ hexchat_pluginpref_get_int (hexchat_plugin *pl, const char *var)
 int
 hexchat_pluginpref_delete (hexchat_plugin *pl, const char *var)
 {
-	return hexchat_pluginpref_set_str_real (pl, var, 0, 0);
+	pref_store *store = pref_store_get (pl);
+
+	if (pref_store_lookup (store, var))
+	{
+		pref_store_remove (store, var);
+		pref_store_changed (store);
+	}
+	return 1;
 }
 
 int
 hexchat_pluginpref_list (hexchat_plugin *pl, char* dest)
 {
-	FILE *fpIn;
-	char confname[64];
-	char buffer[512];										/* the same as in cfg_put_str */
-	char *bufp = buffer;
-	char *token;
-
-	token = g_strdup (pl->name);
-	canonalize_key (token);
-	sprintf (confname, "addon_%s.conf", token);
-	g_free (token);
+	pref_store *store = pref_store_get (pl);
+	pref_entry *entry;
+	guint i;
 
-	fpIn = hexchat_fopen_file (confname, "r", 0);
+	if (!store->entries->len)
+		return 0;
 
-	if (fpIn == NULL)										/* no existing config file, no parsing */
+	strcpy (dest, "");									/* clean up garbage */
+	for (i = 0; i < store->entries->len; i++)
 	{
-		return 0;
+		entry = g_ptr_array_index (store->entries, i);
+		g_strlcat (dest, entry->name, 4096); /* Dest must not be smaller than this */
+		g_strlcat (dest, ",", 4096);
 	}
-	else													/* existing config file, get list of settings */
+
+	return 1;
+}
+
+int
+hexchat_pluginpref_get_many (hexchat_plugin *pl, const char * const *vars, char **values, int count)
+{
+	pref_store *store = pref_store_get (pl);
+	pref_entry *entry;
+	int i, found = 0;
+
+	for (i = 0; i < count; i++)
 	{
-		strcpy (dest, "");									/* clean up garbage */
-		while (fscanf (fpIn, " %511[^\n]", bufp) != EOF)	/* read whole lines including whitespaces */
-		{
-			token = strtok (buffer, "=");
-			g_strlcat (dest, g_strchomp (token), 4096); /* Dest must not be smaller than this */
-			g_strlcat (dest, ",", 4096);
-		}
+		entry = pref_store_lookup (store, vars[i]);
+		values[i] = entry ? g_strdup (entry->value) : NULL;
+		if (entry)
+			found++;
+	}
+
+	return found;
+}
+
+int
+hexchat_pluginpref_set_many (hexchat_plugin *pl, const char * const *vars, const char * const *values, int count)
+{
+	pref_store *store = pref_store_get (pl);
+	int i;
 
-		fclose (fpIn);
+	for (i = 0; i < count; i++)
+	{
+		if (values[i])
+			pref_store_put (store, vars[i], values[i]);
+		else
+			pref_store_remove (store, vars[i]);
 	}
 
+	if (count > 0)
+		pref_store_changed (store);
 	return 1;
 }
+
+char **
+hexchat_pluginpref_list_all (hexchat_plugin *pl)
+{
+	pref_store *store = pref_store_get (pl);
+	pref_entry *entry;
+	char **names, *p;
+	gsize size;
+	guint i;
+
+	/* one block, so hexchat_free () frees it all */
+	size = (store->entries->len + 1) * sizeof (char *);
+	for (i = 0; i < store->entries->len; i++)
+	{
+		entry = g_ptr_array_index (store->entries, i);
+		size += strlen (entry->name) + 1;
+	}
+
+	names = g_malloc (size);
+	p = (char *) (names + store->entries->len + 1);
+	for (i = 0; i < store->entries->len; i++)
+	{
+		entry = g_ptr_array_index (store->entries, i);
+		names[i] = p;
+		p = g_stpcpy (p, entry->name) + 1;
+	}
+	names[i] = NULL;
+
+	return names;
+}
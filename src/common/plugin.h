@@ -149,6 +149,39 @@ struct _hexchat_plugin
 	hexchat_event_attrs *(*hexchat_event_attrs_create) (hexchat_plugin *ph);
 	void (*hexchat_event_attrs_free) (hexchat_plugin *ph,
 									  hexchat_event_attrs *attrs);
+	hexchat_list * (*hexchat_list_find) (hexchat_plugin *ph,
+		const char *name,
+		const char *key,
+		const char * const *fields);
+	hexchat_list * (*hexchat_list_cursor) (hexchat_plugin *ph,
+		const char *name,
+		const char * const *fields);
+	const char * (*hexchat_list_str_at) (hexchat_plugin *ph,
+		hexchat_list *xlist,
+		int n);
+	int (*hexchat_list_int_at) (hexchat_plugin *ph,
+		hexchat_list *xlist,
+		int n);
+	time_t (*hexchat_list_time_at) (hexchat_plugin *ph,
+		hexchat_list *xlist,
+		int n);
+	hexchat_job *(*hexchat_job_submit) (hexchat_plugin *ph,
+		void *(*work) (hexchat_job *job, void *user_data),
+		void (*done) (void *result, void *user_data),
+		void *userdata);
+	void (*hexchat_job_cancel) (hexchat_plugin *ph,
+		hexchat_job *job);
+	int (*hexchat_job_cancelled) (hexchat_plugin *ph,
+		hexchat_job *job);
+	int (*hexchat_pluginpref_get_many) (hexchat_plugin *ph,
+		const char * const *vars,
+		char **values,
+		int count);
+	int (*hexchat_pluginpref_set_many) (hexchat_plugin *ph,
+		const char * const *vars,
+		const char * const *values,
+		int count);
+	char **(*hexchat_pluginpref_list_all) (hexchat_plugin *ph);
 
 	/* PRIVATE FIELDS! */
 	void *handle;		/* from dlopen */
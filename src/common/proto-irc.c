@@ -542,8 +542,9 @@ process_numeric (session * sess, int n,
 		else goto def;
 
 	case 303:
-		word[4]++;
-		notify_markonline (serv, word, tags_data);
+		if (!notify_markonline (serv, word_eol[4][0] == ':' ? word_eol[4] + 1 : word_eol[4],
+										tags_data))
+			goto def;
 		break;
 
 	case 305:
@@ -803,7 +804,7 @@ process_numeric (session * sess, int n,
 		break;
 
 	case 347:	/* end of invite list */
-		if (!fe_ban_list_end (sess, 347))
+		if (!inbound_banlist_end (serv, word[4], 347))
 			goto def;
 		break;
 
@@ -814,10 +815,7 @@ process_numeric (session * sess, int n,
 		break;
 
 	case 349:	/* end of exemption list */
-		sess = find_channel (serv, word[4]);
-		if (!sess)
-			goto def;
-		if (!fe_ban_list_end (sess, 349))
+		if (!inbound_banlist_end (serv, word[4], 349))
 			goto def;
 		break;
 
@@ -839,10 +837,7 @@ process_numeric (session * sess, int n,
 		break;
 
 	case 368:
-		sess = find_channel (serv, word[4]);
-		if (!sess)
-			goto def;
-		if (!fe_ban_list_end (sess, 368))
+		if (!inbound_banlist_end (serv, word[4], 368))
 			goto def;
 		break;
 
@@ -907,6 +902,11 @@ process_numeric (session * sess, int n,
 									  tags_data->timestamp);
 		break;
 
+	case 512:	/* WATCH list is full */
+		if (serv->supports_watch)
+			notify_watch_full (serv, word[4]);
+		goto def;
+
 	case 601:
 		notify_set_offline (serv, word[4], FALSE, tags_data);
 		break;
@@ -937,7 +937,7 @@ process_numeric (session * sess, int n,
 		break;
 
 	case 729:	/* end of quiet list */
-		if (!fe_ban_list_end (sess, 729))
+		if (!inbound_banlist_end (serv, word[4], 729))
 			goto def;
 		break;
 
@@ -949,6 +949,10 @@ process_numeric (session * sess, int n,
 		notify_set_offline_list (serv, word[4] + 1, FALSE, tags_data);
 		break;
 
+	case 734: /* ERR_MONLISTFULL */
+		notify_watch_full (serv, word[5]);
+		goto def;
+
 	case 900:	/* successful SASL 'logged in as ' */
 		EMIT_SIGNAL_TIMESTAMP (XP_TE_SERVTEXT, serv->server_session, 
 									  word_eol[6]+1, word[1], word[2], NULL, 0,
@@ -1596,7 +1600,7 @@ irc_inline (server *serv, char *buf, int len)
 		handle_message_tags(serv, tags, &tags_data);
 	}
 
-	url_check_line (buf);
+	url_check_line (serv, buf);
 
 	/* split line into words and words_to_end_of_line */
 	process_data_init (pdibuf, buf, word, word_eol, FALSE, FALSE);
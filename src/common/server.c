@@ -47,6 +47,7 @@
 #include "notify.h"
 #include "hexchatc.h"
 #include "inbound.h"
+#include "modes.h"
 #include "outbound.h"
 #include "text.h"
 #include "util.h"
@@ -112,7 +113,7 @@ server_send_real (server *serv, char *buf, int len)
 {
 	fe_add_rawlog (serv, buf, len, TRUE);
 
-	url_check_line (buf);
+	url_check_line (serv, buf);
 
 	return tcp_send_real (serv->ssl, serv->sok, serv->write_converter, buf, len);
 }
@@ -537,6 +538,8 @@ ssl_do_connect (server * serv)
 			if (ERR_GET_REASON (err) == SSL_R_WRONG_VERSION_NUMBER)
 				PrintText (serv->server_session, _("Are you sure this is a SSL capable server and port?\n"));
 
+			/* don't offer the same session again, it may be what failed */
+			_SSL_session_forget (serv->ssl);
 			server_cleanup (serv);
 
 			if (prefs.hex_net_auto_reconnectonfail)
@@ -612,6 +615,11 @@ ssl_do_connect (server * serv)
 					 chiper_info->chiper_bits);
 		EMIT_SIGNAL (XP_TE_SSLMESSAGE, serv->server_session, buf, NULL, NULL, NULL,
 						 0);
+		g_snprintf (buf, sizeof (buf), "  %s, handshake took %d ms",
+					 SSL_session_reused (serv->ssl) ? "Session resumed" : "New session",
+					 (int) ((g_get_monotonic_time () - serv->ssl_handshake_start) / 1000));
+		EMIT_SIGNAL (XP_TE_SSLMESSAGE, serv->server_session, buf, NULL, NULL, NULL,
+						 0);
 
 		verify_error = SSL_get_verify_result (serv->ssl);
 		switch (verify_error)
@@ -655,6 +663,7 @@ conn_fail:
 			EMIT_SIGNAL (XP_TE_CONNFAIL, serv->server_session, buf, NULL, NULL,
 							 NULL, 0);
 
+			_SSL_session_forget (serv->ssl);
 			server_cleanup (serv);
 
 			return (0);
@@ -780,6 +789,11 @@ server_connect_success (server *serv)
 			return;
 		}
 		serv->ssl = _SSL_socket (serv->ctx, serv->sok);
+		/* skips most of the handshake if we were connected here before */
+		_SSL_session_attach (serv->ssl,
+									serv->network ? ((ircnet *)serv->network)->name : NULL,
+									serv->hostname, serv->port);
+		serv->ssl_handshake_start = g_get_monotonic_time ();
 		/* FIXME: it'll be needed by new servers */
 		/* send(serv->sok, "STLS\r\n", 6, 0); sleep(1); */
 		set_nonblocking (serv->sok);
@@ -1031,6 +1045,7 @@ server_disconnect (session * sess, int sendquit, int err)
 	serv->servername[0] = 0;
 	serv->lag_sent = 0;
 
+	notify_server_cleanup (serv);
 	notify_cleanup ();
 }
 
@@ -1607,6 +1622,8 @@ server_connect (server *serv, char *hostname, int port, int no_login)
 			}
 		}
 		g_free (cert_file);
+
+		server_ssl_session_file_update ();
 	}
 #endif
 
@@ -1772,6 +1789,7 @@ server_set_defaults (server *serv)
 	serv->chanmodes = g_strdup ("beI,k,l");
 	serv->nick_prefixes = g_strdup ("@%+");
 	serv->nick_modes = g_strdup ("ohv");
+	mode_update_types (serv);
 	serv->modes_per_line = 3; /* https://datatracker.ietf.org/doc/html/rfc1459#section-4.2.3.1 */
 	serv->sasl_mech = MECH_PLAIN;
 
@@ -1785,6 +1803,8 @@ server_set_defaults (server *serv)
 	serv->is_away = FALSE;
 	serv->supports_watch = FALSE;
 	serv->supports_monitor = FALSE;
+	serv->monitor_limit = 0;
+	serv->watch_limit = 0;
 	serv->bad_prefix = FALSE;
 	serv->use_who = TRUE;
 	serv->have_namesx = FALSE;
@@ -1801,6 +1821,26 @@ server_set_defaults (server *serv)
 	serv->have_invite = FALSE;
 }
 
+/* keeps the TLS sessions on disk, or deletes them, as net_ssl_session_save says */
+void
+server_ssl_session_file_update (void)
+{
+#ifdef USE_OPENSSL
+	char *session_file;
+
+	session_file = g_build_filename (get_xdir (), "sslsessions.pem", NULL);
+	if (prefs.hex_net_ssl_session_save)
+		_SSL_session_cache_set_file (session_file);
+	else
+	{
+		_SSL_session_cache_set_file (NULL);
+		/* also one left from before this run */
+		g_unlink (session_file);
+	}
+	g_free (session_file);
+#endif
+}
+
 char *
 server_get_network (server *serv, gboolean fallback)
 {
@@ -1852,6 +1892,8 @@ server_set_name (server *serv, char *name)
 		}
 		fe_set_channel (serv->server_session);
 	}
+
+	log_update_server (serv);
 }
 
 struct away_msg *
@@ -1943,6 +1985,7 @@ server_free (server *serv)
         g_clear_pointer (&serv->scram_session, scram_session_free);
 #endif
 
+	notify_server_cleanup (serv);
 	fe_server_callback (serv);
 
 	g_free (serv);
@@ -873,6 +873,7 @@ servlist_net_remove (ircnet *net)
 		if (serv->network == net)
 		{
 			serv->network = NULL;
+			log_update_server (serv);
 		}
 		list = list->next;
 	}
@@ -26,16 +26,24 @@
 #include <openssl/ssl.h>		  /* SSL_() */
 #include <openssl/err.h>		  /* ERR_() */
 #include <openssl/x509v3.h>
+#include <openssl/pem.h>		  /* PEM_read_bio_SSL_SESSION() */
 #ifdef WIN32
 #include <openssl/rand.h>		  /* RAND_seed() */
 #endif
 #include "config.h"
 #include <time.h>				  /* asctime() */
 #include <string.h>				  /* strncpy() */
+#include <fcntl.h>				  /* O_CREAT */
+#ifdef WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
 #include "ssl.h"				  /* struct cert_info */
 
 #include <glib.h>
 #include <glib/gprintf.h>
+#include <glib/gstdio.h>
 #include <gio/gio.h>
 #include "util.h"
 
@@ -52,6 +60,14 @@
 static struct chiper_info chiper_info;		/* static buffer for _SSL_get_cipher_info() */
 static char err_buf[256];			/* generic error buffer */
 
+/* client sessions to resume, "host:port certfp network" -> SSL_SESSION */
+static GHashTable *session_cache;
+static char *session_file;			/* where they're kept, NULL if only in memory */
+static guint session_save_tag;
+static int session_key_index = -1;	/* ex_data of SSL, its cache key */
+
+static int __SSL_new_session (SSL *ssl, SSL_SESSION *session);
+
 
 /* +++++ Internal functions +++++ */
 
@@ -88,12 +104,15 @@ _SSL_context_init (void (*info_cb_func))
 	SSL_load_error_strings ();
 	ctx = SSL_CTX_new (SSLv23_client_method ());
 
-	SSL_CTX_set_session_cache_mode (ctx, SSL_SESS_CACHE_BOTH);
-	SSL_CTX_set_timeout (ctx, 300);
+	/* sessions are kept in session_cache by server and identity, which also
+	   picks up TLS 1.3 tickets arriving after the handshake */
+	SSL_CTX_set_session_cache_mode (ctx, SSL_SESS_CACHE_CLIENT
+										  |SSL_SESS_CACHE_NO_INTERNAL_STORE);
+	SSL_CTX_sess_set_new_cb (ctx, __SSL_new_session);
+	SSL_CTX_set_timeout (ctx, 3600);
 	SSL_CTX_set_options (ctx, SSL_OP_NO_SSLv2|SSL_OP_NO_SSLv3
 							  |SSL_OP_NO_COMPRESSION
 							  |SSL_OP_SINGLE_DH_USE|SSL_OP_SINGLE_ECDH_USE
-							  |SSL_OP_NO_TICKET
 							  |SSL_OP_CIPHER_SERVER_PREFERENCE);
 
 #if OPENSSL_VERSION_NUMBER >= 0x00908000L && !defined (OPENSSL_NO_COMP) /* workaround for OpenSSL 0.9.8 */
@@ -358,6 +377,258 @@ _SSL_close (SSL * ssl)
 #endif
 }
 
+
+/* +++++ Session cache +++++ */
+
+static gboolean
+__SSL_session_usable (SSL_SESSION *session)
+{
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+	if (!SSL_SESSION_is_resumable (session))
+		return FALSE;
+#endif
+	return SSL_SESSION_get_time (session) + SSL_SESSION_get_timeout (session) > time (NULL);
+}
+
+static void
+__SSL_session_key_free (void *parent, void *ptr, CRYPTO_EX_DATA *ad, int idx,
+						long argl, void *argp)
+{
+	g_free (ptr);
+}
+
+static void
+__SSL_session_cache_create (void)
+{
+	if (session_cache)
+		return;
+
+	session_cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+														(GDestroyNotify) SSL_SESSION_free);
+	session_key_index = SSL_get_ex_new_index (0, NULL, NULL, NULL,
+															__SSL_session_key_free);
+}
+
+static gboolean
+__SSL_session_save_cb (gpointer unused)
+{
+	session_save_tag = 0;
+	_SSL_session_cache_save ();
+	return G_SOURCE_REMOVE;
+}
+
+/* a few sessions tend to come in at once, write them out together */
+static void
+__SSL_session_changed (void)
+{
+	if (session_file && !session_save_tag)
+		session_save_tag = g_timeout_add_seconds (2, __SSL_session_save_cb, NULL);
+}
+
+static int
+__SSL_new_session (SSL *ssl, SSL_SESSION *session)
+{
+	char *key;
+
+	if (session_key_index == -1 || !(key = SSL_get_ex_data (ssl, session_key_index)))
+		return 0;
+
+	/* the table now holds the reference we're given */
+	g_hash_table_replace (session_cache, g_strdup (key), session);
+	__SSL_session_changed ();
+
+	return 1;
+}
+
+/* A session carries the client certificate it was made with, so networks
+   sharing a bouncer's address, or one that changed its certificate, must
+   not pick up each other's: the key has the network and certificate too. */
+static char *
+__SSL_session_key (SSL *ssl, const char *network, const char *host, int port)
+{
+	unsigned char digest[EVP_MAX_MD_SIZE];
+	char fingerprint[EVP_MAX_MD_SIZE * 2 + 1];
+	unsigned int len, i;
+	X509 *cert;
+
+	strcpy (fingerprint, "-");
+	cert = SSL_get_certificate (ssl);
+	if (cert && X509_digest (cert, EVP_sha256 (), digest, &len))
+	{
+		for (i = 0; i < len; i++)
+			g_snprintf (fingerprint + i * 2, 3, "%02x", digest[i]);
+	}
+
+	return g_strdup_printf ("%s:%d %s %s", host, port, fingerprint,
+									network ? network : "");
+}
+
+void
+_SSL_session_attach (SSL *ssl, const char *network, const char *host, int port)
+{
+	SSL_SESSION *session;
+	char *key;
+
+	__SSL_session_cache_create ();
+
+	key = __SSL_session_key (ssl, network, host, port);
+	SSL_set_ex_data (ssl, session_key_index, key);
+
+	session = g_hash_table_lookup (session_cache, key);
+	if (!session)
+		return;
+
+	if (!__SSL_session_usable (session) || !SSL_set_session (ssl, session))
+	{
+		g_hash_table_remove (session_cache, key);
+		__SSL_session_changed ();
+	}
+}
+
+void
+_SSL_session_forget (SSL *ssl)
+{
+	char *key;
+
+	if (session_key_index == -1 || !(key = SSL_get_ex_data (ssl, session_key_index)))
+		return;
+
+	if (g_hash_table_remove (session_cache, key))
+		__SSL_session_changed ();
+}
+
+static void
+__SSL_session_cache_load (void)
+{
+	SSL_SESSION *session;
+	GString *key;
+	char *data;
+	char buf[256];
+	gsize len;
+	BIO *bio;
+
+	if (!g_file_get_contents (session_file, &data, &len, NULL))
+		return;
+
+	bio = BIO_new_mem_buf (data, len);
+	key = g_string_new (NULL);
+
+	/* a key line, then the session in PEM */
+	while (1)
+	{
+		/* keys can be longer than buf, BIO_gets () stops at its size */
+		g_string_truncate (key, 0);
+		while (BIO_gets (bio, buf, sizeof (buf)) > 0)
+		{
+			g_string_append (key, buf);
+			if (key->str[key->len - 1] == '\n')
+			{
+				g_string_truncate (key, key->len - 1);
+				break;
+			}
+		}
+		if (BIO_eof (bio) && key->len == 0)
+			break;
+
+		session = PEM_read_bio_SSL_SESSION (bio, NULL, NULL, NULL);
+		if (!session)
+			break;
+
+		if (key->len && __SSL_session_usable (session))
+			g_hash_table_replace (session_cache, g_strdup (key->str), session);
+		else
+			SSL_SESSION_free (session);
+	}
+
+	ERR_clear_error ();
+	g_string_free (key, TRUE);
+	BIO_free (bio);
+	g_free (data);
+}
+
+void
+_SSL_session_cache_set_file (const char *filename)
+{
+	__SSL_session_cache_create ();
+
+	if (g_strcmp0 (filename, session_file) == 0)
+		return;
+
+	if (session_file && !filename)
+	{
+		/* no longer wanted on disk */
+		g_unlink (session_file);
+	}
+
+	g_free (session_file);
+	session_file = g_strdup (filename);
+
+	if (session_file)
+	{
+		__SSL_session_cache_load ();
+		__SSL_session_changed ();
+	}
+}
+
+int
+_SSL_session_cache_save (void)
+{
+	GHashTableIter iter;
+	gpointer key, session;
+	char *tmp, *data;
+	gboolean ret = TRUE;
+	long len;
+	BIO *bio;
+	int fd;
+
+	if (!session_file || !session_cache)
+		return TRUE;
+
+	bio = BIO_new (BIO_s_mem ());
+	g_hash_table_iter_init (&iter, session_cache);
+	while (g_hash_table_iter_next (&iter, &key, &session))
+	{
+		if (!__SSL_session_usable (session))
+			continue;
+
+		BIO_printf (bio, "%s\n", (char *) key);
+		PEM_write_bio_SSL_SESSION (bio, session);
+	}
+	len = BIO_get_mem_data (bio, &data);
+
+	/* they hold the keys to these connections, only we may read them */
+	tmp = g_strconcat (session_file, ".tmp", NULL);
+	fd = g_open (tmp, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	if (fd == -1 || write (fd, data, len) != len)
+		ret = FALSE;
+	if (fd != -1)
+		close (fd);
+
+	if (ret && g_rename (tmp, session_file) != 0)
+		ret = FALSE;
+	if (!ret)
+		g_unlink (tmp);
+
+	g_free (tmp);
+	BIO_free (bio);
+	return ret;
+}
+
+void
+_SSL_session_cache_free (void)
+{
+	if (session_save_tag)
+	{
+		g_source_remove (session_save_tag);
+		session_save_tag = 0;
+	}
+
+	_SSL_session_cache_save ();
+
+	g_clear_pointer (&session_cache, g_hash_table_destroy);
+	g_clear_pointer (&session_file, g_free);
+}
+
 /* Hostname validation code based on OpenBSD's libtls. */
 
 static int
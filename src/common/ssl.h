@@ -52,6 +52,14 @@ char *_SSL_set_verify (SSL_CTX *ctx, void *(verify_callback));
     int SSL_get_fd(SSL *);
 */
 void _SSL_close (SSL * ssl);
+
+/* resuming sessions, by host, port, network and client certificate */
+void _SSL_session_attach (SSL *ssl, const char *network, const char *host, int port);
+void _SSL_session_forget (SSL *ssl);
+void _SSL_session_cache_set_file (const char *filename);	/* NULL to keep them in memory */
+int _SSL_session_cache_save (void);
+void _SSL_session_cache_free (void);
+
 int _SSL_check_hostname(X509 *cert, const char *host);
 int _SSL_get_cert_info (struct cert_info *cert_info, SSL * ssl);
 struct chiper_info *_SSL_get_cipher_info (SSL * ssl);
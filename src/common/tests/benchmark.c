@@ -0,0 +1,130 @@
+/* HexChat
+ * Copyright (C) 1998-2010 Peter Zelezny.
+ * Copyright (C) 2009-2013 Berke Viktor.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/* Loads generated configs from the size of a hexchat.conf up: once looking
+   every setting up by scanning the file from the top, the way load_config
+   did, and once through a cfg_index. */
+
+#include <string.h>
+#include <glib.h>
+
+#include "cfgindex.h"
+
+#define SECONDS 0.5
+
+static const int sizes[] = { 400, 2000, 10000 };
+
+static char *
+make_config (int settings, char ***names)
+{
+	GString *cfg = g_string_new (NULL);
+	int i;
+
+	*names = g_new0 (char *, settings + 1);
+	for (i = 0; i < settings; i++)
+	{
+		(*names)[i] = g_strdup_printf ("setting_%05d", i);
+		g_string_append_printf (cfg, "%s = value of setting %d\n", (*names)[i], i);
+	}
+
+	return g_string_free (cfg, FALSE);
+}
+
+/* cfg_get_str () as load_config used it */
+static gboolean
+scan_get (const char *cfg, const char *var, char *dest, int dest_len)
+{
+	size_t len = strlen (var);
+	const char *value;
+
+	while (1)
+	{
+		if (!g_ascii_strncasecmp (var, cfg, len) && cfg[len] == ' ')
+		{
+			cfg += len;
+			while (*cfg == ' ' || *cfg == '=')
+				cfg++;
+			value = cfg;
+			while (*cfg != 0 && *cfg != '\n')
+				cfg++;
+			g_strlcpy (dest, value, MIN (dest_len, cfg - value + 1));
+			return TRUE;
+		}
+		while (*cfg != 0 && *cfg != '\n')
+			cfg++;
+		if (*cfg == 0 || *++cfg == 0)
+			return FALSE;
+	}
+}
+
+static void
+report (int settings, const char *what, int loads, GTimer *timer)
+{
+	g_print ("%6d settings  %-6s %10.1f loads/s\n", settings, what,
+				loads / g_timer_elapsed (timer, NULL));
+}
+
+static void
+run (int settings)
+{
+	GTimer *timer = g_timer_new ();
+	cfg_index *index;
+	char **names, *cfg, value[256];
+	int i, loads;
+
+	cfg = make_config (settings, &names);
+
+	g_timer_start (timer);
+	for (loads = 0; g_timer_elapsed (timer, NULL) < SECONDS; loads++)
+	{
+		for (i = 0; i < settings; i++)
+			g_assert (scan_get (cfg, names[i], value, sizeof value));
+	}
+	g_timer_stop (timer);
+	report (settings, "scan", loads, timer);
+
+	g_timer_start (timer);
+	for (loads = 0; g_timer_elapsed (timer, NULL) < SECONDS; loads++)
+	{
+		index = cfg_index_new (g_strdup (cfg));
+		for (i = 0; i < settings; i++)
+		{
+			g_assert (cfg_index_get (index, names[i]));
+			g_strlcpy (value, cfg_index_get (index, names[i]), sizeof value);
+		}
+		cfg_index_free (index);
+	}
+	g_timer_stop (timer);
+	report (settings, "index", loads, timer);
+
+	g_strfreev (names);
+	g_free (cfg);
+	g_timer_destroy (timer);
+}
+
+int
+main (int argc, char *argv[])
+{
+	guint i;
+
+	for (i = 0; i < G_N_ELEMENTS (sizes); i++)
+		run (sizes[i]);
+
+	return 0;
+}
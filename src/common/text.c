@@ -42,6 +42,7 @@
 #include "outbound.h"
 #include "hexchatc.h"
 #include "text.h"
+#include "logwriter.h"
 #include "typedef.h"
 #ifdef WIN32
 #include <windows.h>
@@ -358,14 +359,19 @@ log_close (session *sess)
 	char obuf[512];
 	time_t currenttime;
 
-	if (sess->logfd != -1)
+	if (sess->logfile)
 	{
 		currenttime = time (NULL);
-		write (sess->logfd, obuf,
-			 g_snprintf (obuf, sizeof (obuf) - 1, _("**** ENDING LOGGING AT %s\n"),
-						  ctime (&currenttime)));
-		close (sess->logfd);
-		sess->logfd = -1;
+		g_snprintf (obuf, sizeof (obuf) - 1, _("**** ENDING LOGGING AT %s\n"),
+						ctime (&currenttime));
+		logwriter_write_raw (sess->logfile, obuf);
+		logwriter_close (sess->logfile);
+		sess->logfile = NULL;
+
+		g_free (sess->logmask);
+		sess->logmask = NULL;
+		g_free (sess->logpath);
+		sess->logpath = NULL;
 	}
 }
 
@@ -500,12 +506,12 @@ log_insert_vars (char *buf, int bufsize, char *fmt, char *c, char *n, char *s)
 	}
 }
 
+/* fills in %c %n %s of irc_logmask, the date is done by log_expand_mask () */
+
 static char *
-log_create_pathname (char *servname, char *channame, char *netname)
+log_create_mask (char *servname, char *channame, char *netname)
 {
 	char fname[384];
-	char fnametime[384];
-	time_t now;
 
 	if (!netname)
 	{
@@ -533,9 +539,17 @@ log_create_pathname (char *servname, char *channame, char *netname)
 	g_free (netname);
 	g_free (servname);
 
+	return g_strdup (fname);
+}
+
+static char *
+log_expand_mask (const char *logmask, time_t now)
+{
+	char fname[384];
+	char fnametime[384];
+
 	/* insert time/date */
-	now = time (NULL);
-	strftime_utf8 (fnametime, sizeof (fnametime), fname, now);
+	strftime_utf8 (fnametime, sizeof (fnametime), logmask, now);
 
 	/* If one uses log mask variables, such as "%c/...", %c will be empty upon
 	 * connecting since there's no channel name yet, so we have to make sure
@@ -555,55 +569,204 @@ log_create_pathname (char *servname, char *channame, char *netname)
 	return g_strdup (fname);
 }
 
-static int
-log_open_file (char *servname, char *channame, char *netname)
+/* strftime_utf8 () only knows about dates, so the expanded path can change
+   at local midnight at most. Returns 0 if it never changes. */
+
+static time_t
+log_next_rotation (const char *logmask, time_t now)
 {
-	char buf[512];
-	int fd;
-	char *file;
-	time_t currenttime;
+	struct tm midnight;
 
-	file = log_create_pathname (servname, channame, netname);
-	if (!file)
-		return -1;
+	if (!strchr (logmask, '%'))
+		return 0;
 
-	fd = g_open (file, O_CREAT | O_APPEND | O_WRONLY | OFLAGS, 0644);
-	g_free (file);
+	midnight = *localtime (&now);
+	midnight.tm_sec = 0;
+	midnight.tm_min = 0;
+	midnight.tm_hour = 0;
+	midnight.tm_mday++;
+	midnight.tm_isdst = -1;
 
-	if (fd == -1)
-		return -1;
-	currenttime = time (NULL);
-	write (fd, buf,
-			 g_snprintf (buf, sizeof (buf), _("**** BEGIN LOGGING AT %s\n"),
-						  ctime (&currenttime)));
+	return mktime (&midnight);
+}
+
+static time_t log_compress_next;	/* when another period may have ended */
+
+static void
+log_pattern_append (GString *pattern, const char *text, int len)
+{
+	char *escaped;
+
+	escaped = g_regex_escape_string (text, len);
+	g_string_append (pattern, escaped);
+	g_free (escaped);
+}
 
-	return fd;
+/* Turns logmask into regexes matching the paths of its logs of any period
+   and of the current one. The date is filled in by strftime_utf8 () just
+   like log_expand_mask () does. Returns FALSE if the mask has no date. */
+
+static gboolean
+log_mask_patterns (const char *logmask, time_t now, char **any_period, char **this_period)
+{
+	/* what log_create_filename () leaves of a name */
+	static const char name_pattern[] = "[^/\\\\]*";
+	GString *any, *cur;
+	gboolean dated = FALSE;
+	char conv[4], expanded[128];
+	const char *p;
+	gsize len;
+
+	any = g_string_new ("^");
+	cur = g_string_new ("^");
+
+	for (p = logmask; *p; p++)
+	{
+		if (p[0] != '%' || !p[1])
+		{
+			log_pattern_append (any, p, 1);
+			log_pattern_append (cur, p, 1);
+			continue;
+		}
+
+		p++;
+		switch (p[0])
+		{
+		case 'c':
+		case 'n':
+		case 's':
+			g_string_append (any, name_pattern);
+			g_string_append (cur, name_pattern);
+			break;
+		case '%':
+			log_pattern_append (any, "%", 1);
+			log_pattern_append (cur, "%", 1);
+			break;
+		default:
+			/* a date conversion, maybe with an E or O modifier */
+			conv[0] = '%';
+			conv[1] = p[0];
+			conv[2] = 0;
+			if ((p[0] == 'E' || p[0] == 'O') && p[1])
+			{
+				p++;
+				conv[2] = p[0];
+				conv[3] = 0;
+			}
+			len = strftime_utf8 (expanded, sizeof (expanded), conv, now);
+			g_string_append (any, ".*");
+			log_pattern_append (cur, expanded, len);
+			dated = TRUE;
+		}
+	}
+
+	g_string_append_c (any, '$');
+	g_string_append_c (cur, '$');
+
+	*any_period = g_string_free (any, FALSE);
+	*this_period = g_string_free (cur, FALSE);
+
+	return dated;
+}
+
+/* has the logging thread gzip logs of past periods, including those of
+   sessions that were closed before their period ended. Only files named
+   like the logmask are touched, whatever else is in logs/ is left alone. */
+
+static void
+log_compress_old (time_t now)
+{
+	char *dir, *any_period, *this_period;
+
+	if (!prefs.hex_irc_logging_compress || now < log_compress_next)
+		return;
+
+	/* an absolute logmask could point anywhere, only our own dir is swept */
+	if (g_path_is_absolute (prefs.hex_irc_logmask))
+		return;
+
+	if (log_mask_patterns (prefs.hex_irc_logmask, now, &any_period, &this_period))
+	{
+		dir = g_build_filename (get_xdir (), "logs", NULL);
+		logwriter_compress_old (dir, any_period, this_period);
+		g_free (dir);
+	}
+	g_free (any_period);
+	g_free (this_period);
+
+	log_compress_next = log_next_rotation (prefs.hex_irc_logmask, now);
+}
+
+static void
+log_write_begin (session *sess)
+{
+	char buf[512];
+	time_t currenttime;
+
+	currenttime = time (NULL);
+	g_snprintf (buf, sizeof (buf), _("**** BEGIN LOGGING AT %s\n"),
+					ctime (&currenttime));
+	logwriter_write_raw (sess->logfile, buf);
 }
 
 static void
 log_open (session *sess)
 {
-	static gboolean log_error = FALSE;
+	time_t now;
 
 	log_close (sess);
-	sess->logfd = log_open_file (sess->server->servername, sess->channel,
-										  server_get_network (sess->server, FALSE));
 
-	if (!log_error && sess->logfd == -1)
-	{
-		char *filename = log_create_pathname (sess->server->servername, sess->channel, server_get_network (sess->server, FALSE));
-		char *message = g_strdup_printf (_("* Can't open log file(s) for writing. Check the\npermissions on %s"), filename);
+	now = time (NULL);
+	sess->logmask = log_create_mask (sess->server->servername, sess->channel,
+												server_get_network (sess->server, FALSE));
+	sess->logpath = log_expand_mask (sess->logmask, now);
+	sess->logrotate = log_next_rotation (sess->logmask, now);
+
+	/* errors opening it are reported by the logging thread */
+	sess->logfile = logwriter_open (sess->logpath);
+	log_write_begin (sess);
+	log_compress_old (now);
+}
+
+/* The channel, server or network name of sess changed, or irc_logmask
+   did. Move the log over if that changed which file it belongs in. */
 
-		g_free (filename);
+void
+log_update_path (session *sess)
+{
+	char *mask;
 
-		fe_message (message, FE_MSG_WAIT | FE_MSG_ERROR);
+	if (!sess->logfile)
+		return;
 
-		g_free (message);
+	mask = log_create_mask (sess->server->servername, sess->channel,
+									server_get_network (sess->server, FALSE));
+	if (strcmp (mask, sess->logmask) != 0)
+		log_open (sess);
+	g_free (mask);
+}
 
-		log_error = TRUE;
+void
+log_update_server (server *serv)
+{
+	GSList *list;
+	session *sess;
+
+	for (list = sess_list; list; list = list->next)
+	{
+		sess = list->data;
+		if (!serv || sess->server == serv)
+			log_update_path (sess);
 	}
 }
 
+/* after_update hook of irc_logmask */
+void
+log_update_mask (void)
+{
+	log_update_server (NULL);
+}
+
 void
 log_open_or_close (session *sess)
 {
@@ -654,10 +817,8 @@ get_stamp_str (char *fmt, time_t tim, char **ret)
 static void
 log_write (session *sess, char *text, time_t ts)
 {
-	char *temp;
-	char *stamp;
+	time_t now;
 	char *file;
-	int len;
 
 	if (sess->text_logging == SET_DEFAULT)
 	{
@@ -670,51 +831,40 @@ log_write (session *sess, char *text, time_t ts)
 			return;
 	}
 
-	if (sess->logfd == -1)
+	if (!sess->logfile)
 	{
 		log_open (sess);
 	}
 
 	/* change to a different log file? */
-	file = log_create_pathname (sess->server->servername, sess->channel, server_get_network (sess->server, FALSE));
-	if (file)
+	now = time (NULL);
+	if (sess->logrotate && now >= sess->logrotate)
 	{
-		if (g_access (file, F_OK) != 0)
+		file = log_expand_mask (sess->logmask, now);
+		if (strcmp (file, sess->logpath) != 0)
 		{
-			if (sess->logfd != -1)
-			{
-				close (sess->logfd);
-			}
-
-			sess->logfd = log_open_file (sess->server->servername, sess->channel, server_get_network (sess->server, FALSE));
+			g_free (sess->logpath);
+			sess->logpath = file;
+			logwriter_reopen (sess->logfile, file);
+			log_write_begin (sess);
+			log_compress_old (now);
 		}
-
-		g_free (file);
+		else
+		{
+			g_free (file);
+		}
+		sess->logrotate = log_next_rotation (sess->logmask, now);
 	}
 
-	if (sess->logfd == -1)
+	if (prefs.hex_stamp_log)
 	{
-		return;
+		if (!ts) ts = now;
+		logwriter_write (sess->logfile, text, prefs.hex_stamp_log_format, ts);
 	}
-
-	if (prefs.hex_stamp_log)
+	else
 	{
-		if (!ts) ts = time(0);
-		len = get_stamp_str (prefs.hex_stamp_log_format, ts, &stamp);
-		if (len)
-		{
-			write (sess->logfd, stamp, len);
-			g_free (stamp);
-		}
+		logwriter_write (sess->logfile, text, NULL, 0);
 	}
-
-	temp = strip_color (text, -1, STRIP_ALL);
-	len = strlen (temp);
-	write (sess->logfd, temp, len);
-	/* lots of scripts/plugins print without a \n at the end */
-	if (temp[len - 1] != '\n')
-		write (sess->logfd, "\n", 1);	/* emulate what xtext would display */
-	g_free (temp);
 }
 
 /**
@@ -1384,6 +1534,13 @@ static char * const pevt_dccrecvcomp_help[] = {
 	N_("CPS"),
 };
 
+static char * const pevt_dcchash_help[] = {
+	N_("Filename"),
+	N_("Nickname"),
+	N_("SHA-256"),
+	N_("XXH64"),
+};
+
 static char * const pevt_dccconfail_help[] = {
 	N_("DCC Type"),
 	N_("Nickname"),
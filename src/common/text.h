@@ -47,6 +47,9 @@ void PrintTextf (session *sess, const char *format, ...) G_GNUC_PRINTF (2, 3);
 void PrintTextTimeStampf (session *sess, time_t timestamp, const char *format, ...) G_GNUC_PRINTF (3, 4);
 void log_close (session *sess);
 void log_open_or_close (session *sess);
+void log_update_path (session *sess);
+void log_update_server (server *serv);
+void log_update_mask (void);
 void load_text_events (void);
 void pevent_save (char *fn);
 int pevt_build_string (const char *input, char **output, int *max_arg);
@@ -0,0 +1,382 @@
+/* HexChat
+ * Copyright (C) 1998-2010 Peter Zelezny.
+ * Copyright (C) 2009-2013 Berke Viktor.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/* Every timer in the core and in plugins lives in one hierarchical timer
+   wheel driven by a single GSource, instead of a GSource each. Time is
+   counted in ticks of TICK_US. Level 0 has one slot per tick for the next
+   WHEEL_SIZE ticks, every further level has slots WHEEL_SIZE times as wide;
+   when the ticks reach a slot of a higher level its timers are cascaded
+   down. Adding and removing are O(1). The source sleeps until the earliest
+   timer is due, or without a timeout if there is none, so no wakeup
+   happens when nothing is due. */
+
+#include "timerwheel.h"
+
+#define WHEEL_BITS 6
+#define WHEEL_SIZE (1 << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SIZE - 1)
+#define WHEEL_LEVELS 4
+#define WHEEL_RANGE ((guint64) 1 << (WHEEL_BITS * WHEEL_LEVELS))	/* ~46 hours */
+#define TICK_US 10000
+#define TICKS_PER_SECOND (G_USEC_PER_SEC / TICK_US)
+
+typedef struct wheel_timer
+{
+	struct wheel_timer *next;
+	struct wheel_timer *prev;
+	struct wheel_timer **slot;	/* NULL while not in the wheel */
+	guint64 expires;				/* tick it is due at */
+	GSourceFunc callback;
+	gpointer userdata;
+	guint tag;
+	int interval;
+	int level;
+	unsigned int seconds:1;
+	unsigned int removed:1;		/* while its callback runs */
+} wheel_timer;
+
+static struct
+{
+	wheel_timer *slots[WHEEL_LEVELS][WHEEL_SIZE];
+	int count[WHEEL_LEVELS];
+	guint64 tick;					/* next tick to process */
+	guint64 next;					/* earliest expiry, if !dirty */
+	gboolean dirty;
+	gint64 start;					/* monotonic time of tick 0 */
+	GSource *source;
+	GHashTable *tags;
+	guint last_tag;
+	guint64 wakeups;
+	guint64 fired;
+} wheel;
+
+static guint64
+wheel_now (gint64 now)
+{
+	return (now - wheel.start) / TICK_US;
+}
+
+static void
+wheel_insert (wheel_timer *t)
+{
+	guint64 delta, at;
+	int level = 0;
+
+	if (t->expires < wheel.tick)
+		t->expires = wheel.tick;
+
+	delta = t->expires - wheel.tick;
+	while (level < WHEEL_LEVELS - 1 && delta >= (guint64) 1 << (WHEEL_BITS * (level + 1)))
+		level++;
+
+	/* too far out for the top level, it is cascaded again until it fits */
+	at = delta >= WHEEL_RANGE ? wheel.tick + WHEEL_RANGE - 1 : t->expires;
+
+	t->level = level;
+	t->slot = &wheel.slots[level][(at >> (WHEEL_BITS * level)) & WHEEL_MASK];
+	t->prev = NULL;
+	t->next = *t->slot;
+	if (t->next)
+		t->next->prev = t;
+	*t->slot = t;
+	wheel.count[level]++;
+
+	if (!wheel.dirty && t->expires < wheel.next)
+		wheel.next = t->expires;
+}
+
+static void
+wheel_detach (wheel_timer *t)
+{
+	if (!t->slot)
+		return;
+
+	if (t->prev)
+		t->prev->next = t->next;
+	else
+		*t->slot = t->next;
+	if (t->next)
+		t->next->prev = t->prev;
+
+	t->slot = NULL;
+	wheel.count[t->level]--;
+
+	if (t->expires == wheel.next)
+		wheel.dirty = TRUE;
+}
+
+static void
+wheel_cascade (int level, int index)
+{
+	wheel_timer *t;
+
+	while ((t = wheel.slots[level][index]))
+	{
+		wheel_detach (t);
+		wheel_insert (t);
+	}
+}
+
+/* earliest expiry of all timers, G_MAXUINT64 if there are none */
+static guint64
+wheel_next (void)
+{
+	guint64 next = G_MAXUINT64;
+	guint64 block;
+	wheel_timer *t;
+	int level, shift, i;
+
+	if (!wheel.dirty)
+		return wheel.next;
+
+	for (level = 0; level < WHEEL_LEVELS; level++)
+	{
+		if (!wheel.count[level])
+			continue;
+
+		/* the current slot of a level was cascaded already, unless the
+		   ticks are right at its start */
+		shift = WHEEL_BITS * level;
+		block = wheel.tick >> shift;
+		if (level && (wheel.tick & (((guint64) 1 << shift) - 1)))
+			block++;
+
+		/* a slot only holds timers due within its block, and those too far
+		   out for the wheel, so the first one due in its block ends it */
+		for (i = 0; i < WHEEL_SIZE; i++, block++)
+		{
+			for (t = wheel.slots[level][block & WHEEL_MASK]; t; t = t->next)
+				next = MIN (next, t->expires);
+			if (next < (block + 1) << shift)
+				break;
+		}
+	}
+
+	wheel.next = next;
+	wheel.dirty = FALSE;
+	return next;
+}
+
+static guint64
+wheel_expires (int interval, gboolean seconds, gint64 now)
+{
+	guint64 expires;
+
+	if (seconds)
+	{
+		expires = wheel_now (now) + (guint64) interval * TICKS_PER_SECOND;
+		return expires - expires % TICKS_PER_SECOND + TICKS_PER_SECOND;
+	}
+
+	/* round up, it must never fire early */
+	return (now - wheel.start + (gint64) interval * 1000 + TICK_US - 1) / TICK_US;
+}
+
+static void
+wheel_fire (wheel_timer *t)
+{
+	gboolean again;
+
+	wheel_detach (t);
+	wheel.fired++;
+
+	again = t->callback (t->userdata);
+
+	if (again && !t->removed)
+	{
+		t->expires = wheel_expires (t->interval, t->seconds, g_get_monotonic_time ());
+		wheel_insert (t);
+	}
+	else
+	{
+		g_hash_table_remove (wheel.tags, GUINT_TO_POINTER (t->tag));
+		g_free (t);
+	}
+}
+
+/* moves wheel.tick past now, firing everything due on the way */
+static void
+wheel_advance (guint64 now)
+{
+	guint64 step;
+	int level, index;
+
+	for (;;)
+	{
+		/* jump over ticks that cannot have anything to do */
+		for (level = 0; level < WHEEL_LEVELS && !wheel.count[level]; level++)
+			;
+		if (level == WHEEL_LEVELS)
+		{
+			wheel.tick = MAX (wheel.tick, now + 1);
+			break;
+		}
+		step = (guint64) 1 << (WHEEL_BITS * level);
+		if (wheel.tick & (step - 1))
+			wheel.tick = MIN ((wheel.tick | (step - 1)) + 1, now + 1);
+
+		if (wheel.tick > now)
+			break;
+
+		index = wheel.tick & WHEEL_MASK;
+		if (index == 0)
+		{
+			for (level = 1; level < WHEEL_LEVELS; level++)
+			{
+				index = (wheel.tick >> (WHEEL_BITS * level)) & WHEEL_MASK;
+				wheel_cascade (level, index);
+				if (index)
+					break;
+			}
+		}
+
+		/* timers added by the callbacks are never due in this tick */
+		while (wheel.slots[0][wheel.tick & WHEEL_MASK])
+			wheel_fire (wheel.slots[0][wheel.tick & WHEEL_MASK]);
+
+		wheel.tick++;
+	}
+
+	wheel.dirty = TRUE;
+}
+
+static gboolean
+wheel_prepare (GSource *source, gint *timeout)
+{
+	guint64 next = wheel_next ();
+	gint64 now, due;
+
+	if (next == G_MAXUINT64)
+	{
+		*timeout = -1;
+		return FALSE;
+	}
+
+	now = g_source_get_time (source);
+	due = wheel.start + (gint64) next * TICK_US;
+	if (due <= now)
+	{
+		*timeout = 0;
+		return TRUE;
+	}
+
+	*timeout = (int) MIN ((due - now + 999) / 1000, G_MAXINT);
+	return FALSE;
+}
+
+static gboolean
+wheel_check (GSource *source)
+{
+	guint64 next = wheel_next ();
+
+	return next != G_MAXUINT64 && wheel_now (g_source_get_time (source)) >= next;
+}
+
+static gboolean
+wheel_dispatch (GSource *source, GSourceFunc callback, gpointer userdata)
+{
+	wheel.wakeups++;
+	wheel_advance (wheel_now (g_source_get_time (source)));
+	return TRUE;
+}
+
+static GSourceFuncs wheel_funcs =
+{
+	wheel_prepare,
+	wheel_check,
+	wheel_dispatch,
+	NULL
+};
+
+static guint
+wheel_add (int interval, gboolean seconds, GSourceFunc callback, gpointer userdata)
+{
+	wheel_timer *t;
+	gint64 now = g_get_monotonic_time ();
+
+	if (!wheel.source)
+	{
+		wheel.start = now;
+		wheel.next = G_MAXUINT64;
+		wheel.tags = g_hash_table_new (NULL, NULL);
+		wheel.source = g_source_new (&wheel_funcs, sizeof (GSource));
+		g_source_set_name (wheel.source, "timer wheel");
+		g_source_attach (wheel.source, NULL);
+	}
+
+	t = g_new0 (wheel_timer, 1);
+	t->callback = callback;
+	t->userdata = userdata;
+	t->interval = MAX (interval, 0);
+	t->seconds = seconds;
+	do
+		t->tag = ++wheel.last_tag;
+	while (t->tag == 0 || g_hash_table_lookup (wheel.tags, GUINT_TO_POINTER (t->tag)));
+	g_hash_table_insert (wheel.tags, GUINT_TO_POINTER (t->tag), t);
+
+	t->expires = wheel_expires (t->interval, seconds, now);
+	wheel_insert (t);
+
+	return t->tag;
+}
+
+guint
+timer_wheel_add (int interval, GSourceFunc callback, gpointer userdata)
+{
+	return wheel_add (interval, FALSE, callback, userdata);
+}
+
+guint
+timer_wheel_add_seconds (int interval, GSourceFunc callback, gpointer userdata)
+{
+	return wheel_add (interval, TRUE, callback, userdata);
+}
+
+void
+timer_wheel_remove (guint tag)
+{
+	wheel_timer *t;
+
+	if (!wheel.tags || !(t = g_hash_table_lookup (wheel.tags, GUINT_TO_POINTER (tag))))
+		return;
+
+	if (!t->slot)
+	{
+		/* its callback is running, wheel_fire frees it */
+		t->removed = TRUE;
+		return;
+	}
+
+	wheel_detach (t);
+	g_hash_table_remove (wheel.tags, GUINT_TO_POINTER (tag));
+	g_free (t);
+}
+
+void
+timer_wheel_get_stats (timer_wheel_stats *stats)
+{
+	int level;
+
+	stats->timers = 0;
+	for (level = 0; level < WHEEL_LEVELS; level++)
+		stats->timers += wheel.count[level];
+	stats->wakeups = wheel.wakeups;
+	stats->fired = wheel.fired;
+	stats->elapsed = wheel.source ? g_get_monotonic_time () - wheel.start : 0;
+}
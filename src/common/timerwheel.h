@@ -0,0 +1,47 @@
+/* HexChat
+ * Copyright (C) 1998-2010 Peter Zelezny.
+ * Copyright (C) 2009-2013 Berke Viktor.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#ifndef HEXCHAT_TIMERWHEEL_H
+#define HEXCHAT_TIMERWHEEL_H
+
+#include <glib.h>
+
+/* Timers that all share one main loop source. Like g_timeout_add () the
+   callback returns TRUE to run again after another interval; tags are
+   never 0 and are not GSource ids. */
+
+/* fires no earlier than interval ms from now, rounded up to 10 ms */
+guint timer_wheel_add (int interval, GSourceFunc callback, gpointer userdata);
+/* like g_timeout_add_seconds (): all of these fire together on whole
+   seconds, so they share their wakeups */
+guint timer_wheel_add_seconds (int interval, GSourceFunc callback, gpointer userdata);
+/* safe to call from the timer's own callback */
+void timer_wheel_remove (guint tag);
+
+typedef struct
+{
+	int timers;			/* armed right now */
+	guint64 wakeups;	/* times the main loop woke up for timers */
+	guint64 fired;		/* callbacks run */
+	gint64 elapsed;	/* microseconds the counters cover */
+} timer_wheel_stats;
+
+void timer_wheel_get_stats (timer_wheel_stats *stats);
+
+#endif
@@ -196,6 +196,22 @@ tree_remove (tree *t, void *key, int *pos)
 	return 1;
 }
 
+/* the elements in order, to go through while t may change */
+
+void **
+tree_dup_array (tree *t, int *elements)
+{
+	void **array;
+
+	*elements = t ? t->elements : 0;
+	if (!*elements)
+		return NULL;
+
+	array = g_new (void *, *elements);
+	memcpy (array, t->array, *elements * sizeof (void *));
+	return array;
+}
+
 void
 tree_foreach (tree *t, tree_traverse_func *func, void *data)
 {
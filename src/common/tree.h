@@ -32,6 +32,7 @@ void tree_destroy (tree *t);
 void *tree_find (tree *t, const void *key, tree_cmp_func *cmp, void *data, int *pos);
 int tree_remove (tree *t, void *key, int *pos);
 void *tree_remove_at_pos (tree *t, int pos);
+void **tree_dup_array (tree *t, int *elements);
 void tree_foreach (tree *t, tree_traverse_func *func, void *data);
 int tree_insert (tree *t, void *key);
 void tree_append (tree* t, void *key);
@@ -25,17 +25,35 @@
 #include "cfgfiles.h"
 #include "fe.h"
 #include "tree.h"
+#include "server.h"
+#include "modes.h"
+#include "util.h"
 #include "url.h"
 #ifdef HAVE_STRINGS_H
 #include <strings.h>
 #endif
 
-void *url_tree = NULL;
-GTree *url_btree = NULL;
+/* The URL grabber keeps its URLs in a queue, oldest first, with a hash table
+   (keyed by the lowercased URL) pointing at each queue link. Lookups,
+   hits and evictions are all O(1). With url_logging on, every change is
+   appended to urlgrab.dat, which is read back the first time the grabber
+   is used and compacted when it has grown well beyond what is kept in
+   memory. Nothing is written to disk without it. */
+
+#define URL_STORE_FILE "urlgrab.dat"
+
+static GQueue url_queue = G_QUEUE_INIT;
+static GHashTable *url_index = NULL;
+static gboolean url_loaded = FALSE;
+static FILE *url_store_fd = NULL;
+static int url_store_records = 0;	/* lines in URL_STORE_FILE */
+static FILE *url_log_fd = NULL;
+
 static gboolean regex_match (const GRegex *re, const char *word,
 							 int *start, int *end);
 static const GRegex *re_url (void);
 static const GRegex *re_url_no_scheme (void);
+static const GRegex *re_url_www (void);
 static const GRegex *re_host (void);
 static const GRegex *re_host6 (void);
 static const GRegex *re_email (void);
@@ -50,34 +68,267 @@ static gboolean match_host (const char *word, int *start, int *end);
 static gboolean match_host6 (const char *word, int *start, int *end);
 static gboolean match_path (const char *word, int *start, int *end);
 
-static int
-url_free (char *url, void *data)
+static void
+url_entry_free (struct url_entry *entry)
 {
-	g_free (url);
-	return TRUE;
+	g_free (entry->url);
+	g_free (entry->network);
+	g_free (entry->channel);
+	g_free (entry->nick);
+	g_free (entry);
+}
+
+static void
+url_store_close (void)
+{
+	if (url_store_fd)
+	{
+		fclose (url_store_fd);
+		url_store_fd = NULL;
+	}
+}
+
+static void
+url_store_write (FILE *fd, struct url_entry *entry)
+{
+	fprintf (fd, "%" G_GINT64_FORMAT "\t%" G_GINT64_FORMAT "\t%d\t%s\t%s\t%s\t%s\n",
+				(gint64) entry->first_seen, (gint64) entry->last_seen, entry->hits,
+				entry->network ? entry->network : "",
+				entry->channel ? entry->channel : "",
+				entry->nick ? entry->nick : "", entry->url);
+}
+
+static void
+url_store_append (struct url_entry *entry)
+{
+	if (!prefs.hex_url_logging)
+	{
+		url_store_close ();
+		return;
+	}
+
+	if (!url_store_fd)
+	{
+		url_store_fd = hexchat_fopen_file (URL_STORE_FILE, "a", 0);
+		if (!url_store_fd)
+			return;
+	}
+
+	url_store_write (url_store_fd, entry);
+	fflush (url_store_fd);
+	url_store_records++;
+}
+
+/* rewrite URL_STORE_FILE with only what we still have in memory */
+static void
+url_store_compact (void)
+{
+	char *path, *new_path;
+	FILE *fd;
+	GList *list;
+
+	url_store_close ();
+	if (!prefs.hex_url_logging)
+		return;
+
+	path = g_build_filename (get_xdir (), URL_STORE_FILE, NULL);
+	new_path = g_strconcat (path, ".new", NULL);
+
+	fd = hexchat_fopen_file (new_path, "w", XOF_FULLPATH);
+	if (fd)
+	{
+		for (list = url_queue.head; list; list = list->next)
+			url_store_write (fd, list->data);
+
+		if (fclose (fd) == 0)
+		{
+#ifdef WIN32
+			g_unlink (path);	/* win32 can't rename to an existing file */
+#endif
+			if (g_rename (new_path, path) == 0)
+				url_store_records = url_queue.length;
+		}
+	}
+
+	g_free (new_path);
+	g_free (path);
+}
+
+static void
+url_evict (void)
+{
+	struct url_entry *entry;
+
+	/* 0 is unlimited. The loop is necessary to handle having the limit
+	   lowered while HexChat is running */
+	while (prefs.hex_url_grabber_limit > 0 &&
+			 url_queue.length > (guint) prefs.hex_url_grabber_limit)
+	{
+		entry = g_queue_pop_head (&url_queue);
+		g_hash_table_remove (url_index, entry->url);
+		url_entry_free (entry);
+	}
+
+	if (url_store_records > 2 * (int) url_queue.length + 256)
+		url_store_compact ();
+}
+
+static GList *
+url_find_link (const char *url)
+{
+	GList *link;
+	char *key;
+
+	key = g_ascii_strdown (url, -1);
+	link = g_hash_table_lookup (url_index, key);
+	g_free (key);
+
+	return link;
+}
+
+static void
+url_entry_set_source (struct url_entry *entry, server *serv, char *nick, char *channel)
+{
+	g_free (entry->network);
+	g_free (entry->channel);
+	g_free (entry->nick);
+	entry->network = serv ? g_strdup (server_get_network (serv, TRUE)) : NULL;
+	entry->channel = g_strdup (channel);
+	entry->nick = g_strdup (nick);
+}
+
+/* inserts an entry or replaces an older record of the same URL, returns
+   TRUE if it wasn't known before */
+static gboolean
+url_store_insert (struct url_entry *entry)
+{
+	struct url_entry *old;
+	GList *link;
+
+	link = url_find_link (entry->url);
+	if (!link)
+	{
+		g_queue_push_tail (&url_queue, entry);
+		g_hash_table_insert (url_index, g_ascii_strdown (entry->url, -1), url_queue.tail);
+		return TRUE;
+	}
+
+	/* most recently seen goes last */
+	old = link->data;
+	link->data = entry;
+	g_queue_unlink (&url_queue, link);
+	g_queue_push_tail_link (&url_queue, link);
+
+	entry->first_seen = MIN (old->first_seen, entry->first_seen);
+	url_entry_free (old);
+	return FALSE;
+}
+
+static struct url_entry *
+url_store_parse (char *line)
+{
+	struct url_entry *entry;
+	char **fields;
+
+	fields = g_strsplit (line, "\t", 7);
+	if (g_strv_length (fields) != 7 || !fields[6][0])
+	{
+		g_strfreev (fields);
+		return NULL;
+	}
+
+	entry = g_new0 (struct url_entry, 1);
+	entry->first_seen = (time_t) g_ascii_strtoll (fields[0], NULL, 10);
+	entry->last_seen = (time_t) g_ascii_strtoll (fields[1], NULL, 10);
+	entry->hits = atoi (fields[2]);
+	entry->network = fields[3][0] ? g_strdup (fields[3]) : NULL;
+	entry->channel = fields[4][0] ? g_strdup (fields[4]) : NULL;
+	entry->nick = fields[5][0] ? g_strdup (fields[5]) : NULL;
+	entry->url = g_strdup (fields[6]);
+
+	g_strfreev (fields);
+	return entry;
+}
+
+static void
+url_store_load (void)
+{
+	struct url_entry *entry;
+	char *path, *contents, *line, *next;
+
+	if (url_loaded)
+		return;
+	url_loaded = TRUE;
+
+	url_index = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+	path = g_build_filename (get_xdir (), URL_STORE_FILE, NULL);
+	if (prefs.hex_url_logging && g_file_get_contents (path, &contents, NULL, NULL))
+	{
+		for (line = contents; line && *line; line = next)
+		{
+			next = strchr (line, '\n');
+			if (next)
+				*next++ = 0;
+
+			url_store_records++;
+			entry = url_store_parse (line);
+			if (entry)
+				url_store_insert (entry);
+		}
+		g_free (contents);
+	}
+	g_free (path);
+
+	url_evict ();
 }
 
 void
 url_clear (void)
 {
-	tree_foreach (url_tree, (tree_traverse_func *)url_free, NULL);
-	tree_destroy (url_tree);
-	url_tree = NULL;
-	g_tree_destroy (url_btree);
-	url_btree = NULL;
+	struct url_entry *entry;
+	FILE *fd;
+
+	while ((entry = g_queue_pop_head (&url_queue)))
+		url_entry_free (entry);
+	if (url_index)
+		g_hash_table_remove_all (url_index);
+
+	/* the user asked for it, so forget the history too */
+	url_store_close ();
+	fd = hexchat_fopen_file (URL_STORE_FILE, "w", 0);
+	if (fd)
+		fclose (fd);
+	url_store_records = 0;
 }
 
-static int
-url_save_cb (char *url, FILE *fd)
+void
+url_cleanup (void)
 {
-	fprintf (fd, "%s\n", url);
-	return TRUE;
+	struct url_entry *entry;
+
+	url_store_close ();
+	if (url_log_fd)
+	{
+		fclose (url_log_fd);
+		url_log_fd = NULL;
+	}
+
+	while ((entry = g_queue_pop_head (&url_queue)))
+		url_entry_free (entry);
+	if (url_index)
+	{
+		g_hash_table_destroy (url_index);
+		url_index = NULL;
+	}
+	url_loaded = FALSE;
 }
 
 void
 url_save_tree (const char *fname, const char *mode, gboolean fullpath)
 {
 	FILE *fd;
+	GList *list;
 
 	if (fullpath)
 		fd = hexchat_fopen_file (fname, mode, XOF_FULLPATH);
@@ -86,37 +337,54 @@ url_save_tree (const char *fname, const char *mode, gboolean fullpath)
 	if (fd == NULL)
 		return;
 
-	tree_foreach (url_tree, (tree_traverse_func *)url_save_cb, fd);
+	url_store_load ();
+	for (list = url_queue.head; list; list = list->next)
+		fprintf (fd, "%s\n", ((struct url_entry *) list->data)->url);
 	fclose (fd);
 }
 
-static void
-url_save_node (char* url)
+void
+url_foreach (void (*func) (struct url_entry *entry, void *data), void *data)
 {
-	FILE *fd;
+	GList *list;
 
-	/* open <config>/url.log in append mode */
-	fd = hexchat_fopen_file ("url.log", "a", 0);
-	if (fd == NULL)
-	{
-		return;
-	}
+	url_store_load ();
+	for (list = url_queue.head; list; list = list->next)
+		func (list->data, data);
+}
+
+struct url_entry *
+url_lookup (const char *url)
+{
+	GList *link;
 
-	fprintf (fd, "%s\n", url);
-	fclose (fd);	
+	url_store_load ();
+	link = url_find_link (url);
+
+	return link ? link->data : NULL;
 }
 
-static int
-url_find (char *urltext)
+static void
+url_save_node (char* url)
 {
-	return (g_tree_lookup_extended (url_btree, urltext, NULL, NULL));
+	/* keep <config>/url.log open in append mode */
+	if (!url_log_fd)
+	{
+		url_log_fd = hexchat_fopen_file ("url.log", "a", 0);
+		if (url_log_fd == NULL)
+			return;
+	}
+
+	fprintf (url_log_fd, "%s\n", url);
+	fflush (url_log_fd);
 }
 
 static void
-url_add (char *urltext, int len)
+url_add (server *serv, char *nick, char *channel, char *urltext, int len)
 {
+	struct url_entry *entry;
+	GList *link;
 	char *data;
-	int size;
 
 	/* we don't need any URLs if we have neither URL grabbing nor URL logging enabled */
 	if (!prefs.hex_url_grabber && !prefs.hex_url_logging)
@@ -124,19 +392,9 @@ url_add (char *urltext, int len)
 		return;
 	}
 
+	/* trailing dots and unbalanced parens were chopped by url_scan () */
 	data = g_strndup (urltext, len);
 
-	if (data[len - 1] == '.')	/* chop trailing dot */
-	{
-		len--;
-		data[len] = 0;
-	}
-	/* chop trailing ) but only if there's no counterpart */
-	if (data[len - 1] == ')' && strchr (data, '(') == NULL)
-	{
-		data[len - 1] = 0;
-	}
-
 	if (prefs.hex_url_logging)
 	{
 		url_save_node (data);
@@ -149,38 +407,35 @@ url_add (char *urltext, int len)
 		return;
 	}
 
-	if (!url_tree)
-	{
-		url_tree = tree_new ((tree_cmp_func *)strcasecmp, NULL);
-		url_btree = g_tree_new ((GCompareFunc)strcasecmp);
-	}
+	url_store_load ();
 
-	if (url_find (data))
+	link = url_find_link (data);
+	if (link)
 	{
+		entry = link->data;
+		entry->last_seen = time (NULL);
+		entry->hits++;
+		url_entry_set_source (entry, serv, nick, channel);
 		g_free (data);
-		return;
-	}
 
-	size = tree_size (url_tree);
-	/* 0 is unlimited */
-	if (prefs.hex_url_grabber_limit > 0 && size >= prefs.hex_url_grabber_limit)
-	{
-		/* the loop is necessary to handle having the limit lowered while
-		   HexChat is running */
-		size -= prefs.hex_url_grabber_limit;
-		for(; size > 0; size--)
-		{
-			char *pos;
+		/* most recently seen goes last */
+		g_queue_unlink (&url_queue, link);
+		g_queue_push_tail_link (&url_queue, link);
 
-			pos = tree_remove_at_pos (url_tree, 0);
-			g_tree_remove (url_btree, pos);
-			g_free (pos);
-		}
+		url_store_append (entry);
+		return;
 	}
 
-	tree_append (url_tree, data);
-	g_tree_insert (url_btree, data, GINT_TO_POINTER (tree_size (url_tree) - 1));
-	fe_url_add (data);
+	entry = g_new0 (struct url_entry, 1);
+	entry->url = data;
+	entry->first_seen = entry->last_seen = time (NULL);
+	entry->hits = 1;
+	url_entry_set_source (entry, serv, nick, channel);
+
+	url_store_insert (entry);
+	url_store_append (entry);
+	url_evict ();
+	fe_url_add (entry->url);
 }
 
 /* check if a word is clickable. This is called on mouse motion events, so
@@ -326,21 +581,31 @@ static char *commands[] = {
 #define ARRAY_SIZE(a) (sizeof (a) / sizeof ((a)[0]))
 
 void
-url_check_line (char *buf)
+url_check_line (server *serv, char *buf)
 {
-	GRegex *re(void);
-	GMatchInfo *gmi;
-	char *po = buf;
+	GArray *spans;
+	char nick[NICKLEN];
+	char channel[CHANLEN];
+	char *po = buf, *end;
 	size_t i;
 
-	/* Skip over message prefix */
+	/* Skip over message prefix, it's who sent it */
+	nick[0] = 0;
 	if (*po == ':')
 	{
+		po++;
+		end = po + strcspn (po, "! ");
+		safe_strcpy (nick, po, MIN (sizeof (nick), (size_t) (end - po) + 1));
 		po = strchr (po, ' ');
 		if (!po)
 			return;
 		po++;
 	}
+	else if (serv)
+	{
+		/* one of ours */
+		safe_strcpy (nick, serv->nick, sizeof (nick));
+	}
 	/* Allow only commands from the above list */
 	for (i = 0; i < ARRAY_SIZE (commands); i++)
 	{
@@ -357,23 +622,151 @@ url_check_line (char *buf)
 		return;
 
 	/* Skip past the channel name or user nick */
-	po = strchr (po, ' ');
-	if (!po)
+	end = strchr (po, ' ');
+	if (!end)
+		return;
+	safe_strcpy (channel, po, MIN (sizeof (channel), (size_t) (end - po) + 1));
+	if (!serv || !is_channel (serv, channel))
+		channel[0] = 0;
+	po = end + 1;
+
+	spans = url_scan (po, -1, URL_SCAN_URL);
+	if (!spans)
 		return;
-	po++;
 
-	g_regex_match(re_url(), po, 0, &gmi);
-	while (g_match_info_matches(gmi))
+	for (i = 0; i < spans->len; i++)
+	{
+		url_span *span = &g_array_index (spans, url_span, i);
+
+		url_add (serv, nick[0] ? nick : NULL, channel[0] ? channel : NULL,
+					po + span->start, span->end - span->start);
+	}
+	g_array_free (spans, TRUE);
+}
+
+/* Characters that can only show up around something clickable. The line is
+   skipped through with this table and the (comparatively slow) regexes only
+   run on the word surrounding an anchor:
+     ':'  scheme separator, "http://" but also "mailto:" and "magnet:?"
+     '.'  "www." without a scheme
+     '@'  email addresses
+     '#'  channels */
+static const unsigned char url_anchor[256] = {
+	[':'] = 1, ['.'] = 1, ['@'] = 1, ['#'] = 1
+};
+
+#define url_is_space(c) ((c) == ' ' || (c) == '\t' || (c) == '\r' || (c) == '\n' || (c) == 0)
+
+static gboolean
+url_scan_word (const GRegex *re, const char *text, int ws, int we, int *start, int *end)
+{
+	GMatchInfo *gmi;
+	gboolean ret;
+
+	ret = g_regex_match_full (re, text, we, ws, 0, &gmi, NULL);
+	if (ret)
+		g_match_info_fetch_pos (gmi, 0, start, end);
+	g_match_info_free (gmi);
+
+	return ret;
+}
+
+/* Finds every URL, email address and channel (as selected by types) in a
+   line in one pass. Returns NULL if there's nothing, otherwise an array of
+   url_span in order of appearance, free it with g_array_free (). */
+
+GArray *
+url_scan (const char *text, int len, int types)
+{
+	const unsigned char *t = (const unsigned char *) text;
+	GArray *spans = NULL;
+	url_span span;
+	int pos, ws, we, prev_end = 0;
+	const GRegex *re;
+
+	if (len == -1)
+		len = strlen (text);
+
+	for (pos = 0; pos < len; pos++)
 	{
-		int start, end;
+		if (!url_anchor[t[pos]])
+			continue;
 
-		g_match_info_fetch_pos(gmi, 0, &start, &end);
-		while (end > start && (po[end - 1] == '\r' || po[end - 1] == '\n'))
-			end--;
-		url_add(po + start, end - start);
-		g_match_info_next(gmi, NULL);
+		re = NULL;
+		switch (t[pos])
+		{
+		case ':':
+			/* must be the end of a scheme name */
+			if ((types & URL_SCAN_URL) && pos > prev_end && g_ascii_isalnum (t[pos - 1]))
+			{
+				re = re_url ();
+				span.type = WORD_URL;
+			}
+			break;
+		case '.':
+			if ((types & URL_SCAN_URL) && pos - 3 >= prev_end &&
+				 g_ascii_strncasecmp (text + pos - 3, "www", 3) == 0 &&
+				 (pos - 3 == prev_end || url_is_space (t[pos - 4]) || t[pos - 4] == '('))
+			{
+				re = re_url_www ();
+				span.type = WORD_URL;
+			}
+			break;
+		case '@':
+			if ((types & URL_SCAN_EMAIL) && pos > prev_end && g_ascii_isalnum (t[pos - 1]) &&
+				 pos + 1 < len && g_ascii_isalnum (t[pos + 1]))
+			{
+				re = re_email ();
+				span.type = WORD_EMAIL;
+			}
+			break;
+		case '#':
+			/* at the start of a word, possibly with a nick prefix (+#channel) */
+			if ((types & URL_SCAN_CHANNEL) &&
+				 (pos == prev_end || url_is_space (t[pos - 1]) ||
+				  (strchr (NICKPRE, t[pos - 1]) && (pos - 1 == prev_end || url_is_space (t[pos - 2])))))
+			{
+				re = re_channel ();
+				span.type = WORD_CHANNEL;
+			}
+			break;
+		}
+
+		if (!re)
+			continue;
+
+		/* URLs never contain whitespace, only look at the current word */
+		for (ws = pos; ws > prev_end && !url_is_space (t[ws - 1]); ws--);
+		for (we = pos; we < len && !url_is_space (t[we]); we++);
+
+		if (span.type == WORD_CHANNEL)
+			ws = pos;
+
+		if (!url_scan_word (re, text, ws, we, &span.start, &span.end))
+			continue;
+
+		if (span.type == WORD_URL)
+		{
+			/* chop a trailing dot, and a ) without a counterpart */
+			if (span.end > span.start && t[span.end - 1] == '.')
+				span.end--;
+			if (span.end > span.start && t[span.end - 1] == ')' &&
+				 !memchr (text + span.start, '(', span.end - span.start))
+				span.end--;
+		}
+
+		if (span.end <= span.start)
+			continue;
+
+		if (!spans)
+			spans = g_array_new (FALSE, FALSE, sizeof (url_span));
+		g_array_append_val (spans, span);
+
+		prev_end = span.end;
+		pos = span.end - 1;
 	}
-	g_match_info_free(gmi);
+
+	return spans;
 }
 
 int
@@ -551,6 +944,18 @@ re_url_no_scheme (void)
 	return url_ret;
 }
 
+static const GRegex *
+re_url_www (void)
+{
+	static GRegex *url_ret = NULL;
+
+	if (url_ret) return url_ret;
+
+	url_ret = make_re ("(" "www\\." DOMAIN TLD OPT_PORT "(/" PATH ")?" ")");
+
+	return url_ret;
+}
+
 static const GRegex *
 re_url (void)
 {
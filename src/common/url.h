@@ -20,7 +20,16 @@
 #ifndef HEXCHAT_URL_H
 #define HEXCHAT_URL_H
 
-extern void *url_tree;
+struct url_entry
+{
+	char *url;
+	char *network;		/* where it was last seen, any of these may be NULL */
+	char *channel;
+	char *nick;
+	time_t first_seen;
+	time_t last_seen;
+	int hits;
+};
 
 #define WORD_URL     1
 #define WORD_CHANNEL 2
@@ -32,10 +41,27 @@ extern void *url_tree;
 #define WORD_DIALOG  -1
 #define WORD_PATH    -2
 
+/* a detected span in a line, byte offsets into the scanned text */
+typedef struct
+{
+	int start;
+	int end;
+	int type;	/* WORD_URL, WORD_EMAIL or WORD_CHANNEL */
+} url_span;
+
+#define URL_SCAN_URL     (1 << WORD_URL)
+#define URL_SCAN_CHANNEL (1 << WORD_CHANNEL)
+#define URL_SCAN_EMAIL   (1 << WORD_EMAIL)
+#define URL_SCAN_ALL     (URL_SCAN_URL | URL_SCAN_CHANNEL | URL_SCAN_EMAIL)
+
 void url_clear (void);
+void url_cleanup (void);
 void url_save_tree (const char *fname, const char *mode, gboolean fullpath);
+void url_foreach (void (*func) (struct url_entry *entry, void *data), void *data);
+struct url_entry *url_lookup (const char *url);
 int url_last (int *, int *);
 int url_check_word (const char *word);
-void url_check_line (char *buf);
+void url_check_line (struct server *serv, char *buf);
+GArray *url_scan (const char *text, int len, int types);
 
 #endif
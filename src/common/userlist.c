@@ -177,6 +177,7 @@ userlist_free (session *sess)
 
 	sess->usertree = NULL;
 	sess->me = NULL;
+	sess->users_left++;
 
 	sess->ops = 0;
 	sess->hops = 0;
@@ -355,6 +356,7 @@ userlist_remove_user (struct session *sess, struct User *user)
 		sess->me = NULL;
 
 	tree_remove (sess->usertree, user, &pos);
+	sess->users_left++;
 	free_user (user, NULL);
 }
 
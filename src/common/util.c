@@ -1162,7 +1162,7 @@ copy_file (char *dl_src, char *dl_dest, int permissions)
 }
 
 /* Takes care of moving a file from a temporary download location to a completed location. */
-void
+char *
 move_file (char *src_dir, char *dst_dir, char *fname, int dccpermissions)
 {
 	char *src;
@@ -1172,7 +1172,7 @@ move_file (char *src_dir, char *dst_dir, char *fname, int dccpermissions)
 	/* if dcc_dir and dcc_completed_dir are the same then we are done */
 	if (0 == strcmp (src_dir, dst_dir) ||
 		 0 == dst_dir[0])
-		return;			/* Already in "completed dir" */
+		return NULL;			/* Already in "completed dir" */
 
 	src = g_build_filename (src_dir, fname, NULL);
 	dst = g_build_filename (dst_dir, fname, NULL);
@@ -1198,11 +1198,19 @@ move_file (char *src_dir, char *dst_dir, char *fname, int dccpermissions)
 		/* same filesystem or the filesystem doesn't support hard */
 		/* links, so we have to do a copy. */
 		if (copy_file (src, dst, dccpermissions))
+		{
 			g_unlink (src);
+			res = 0;
+		}
 	}
 
-	g_free (dst);
 	g_free (src);
+	if (res == -1)
+	{
+		g_free (dst);
+		return NULL;
+	}
+	return dst;
 }
 
 /* separates a string according to a 'sep' char, then calls the callback
@@ -33,6 +33,7 @@
 #include "../common/modes.h"
 #include "../common/outbound.h"
 #include "../common/hexchatc.h"
+#include "../common/userlist.h"
 #include "gtkutil.h"
 #include "maingui.h"
 #include "banlist.h"
@@ -403,23 +404,133 @@ banlist_button_pressed (GtkWidget *wid, GdkEventButton *event, gpointer userdata
 	return FALSE;
 }
 
+/* lists who in the channel the mask of the selected entry hits */
+static void
+banlist_show_hits (banlist_info *banl, GtkTreeModel *model, GtkTreePath *path)
+{
+	GtkTreeIter iter;
+	GString *str;
+	GSList *hits, *list;
+	char *mask;
+
+	if (!path || !gtk_tree_model_get_iter (model, &iter, path))
+	{
+		gtk_label_set_text (GTK_LABEL (banl->hits_label), NULL);
+		return;
+	}
+
+	gtk_tree_model_get (model, &iter, MASK_COLUMN, &mask, -1);
+	hits = chanmodes_mask_hits (banl->sess, mask);
+	g_free (mask);
+
+	if (!hits)
+	{
+		gtk_label_set_text (GTK_LABEL (banl->hits_label), _("Affects nobody here"));
+		return;
+	}
+
+	str = g_string_new (_("Affects:"));
+	for (list = hits; list; list = list->next)
+		g_string_append_printf (str, " %s", ((struct User *)list->data)->nick);
+	gtk_label_set_text (GTK_LABEL (banl->hits_label), str->str);
+
+	g_string_free (str, TRUE);
+	g_slist_free (hits);
+}
+
 static void
 banlist_select_changed (GtkWidget *item, banlist_info *banl)
 {
+	GtkTreeModel *model;
 	GList *list;
 
 	if (banl->line_ct == 0)
+	{
 		banl->select_ct = 0;
+		banlist_show_hits (banl, NULL, NULL);
+	}
 	else
 	{
-		list = gtk_tree_selection_get_selected_rows (GTK_TREE_SELECTION (item), NULL);
+		list = gtk_tree_selection_get_selected_rows (GTK_TREE_SELECTION (item), &model);
 		banl->select_ct = g_list_length (list);
+		banlist_show_hits (banl, model, banl->select_ct == 1 ? list->data : NULL);
 		g_list_foreach (list, (GFunc) gtk_tree_path_free, NULL);
 		g_list_free (list);
 	}
 	banlist_sensitize (banl);
 }
 
+static const char *
+banlist_type (char letter)
+{
+	int i;
+
+	for (i = 0; i < MODE_CT; i++)
+		if (modes[i].letter == letter)
+			return _(modes[i].type);
+
+	return NULL;
+}
+
+/* selects the entries that affect a nick in the channel or a hostmask */
+static void
+banlist_find (GtkWidget *entry, banlist_info *banl)
+{
+	session *sess = banl->sess;
+	GtkTreeSelection *sel;
+	GtkTreeModel *model;
+	GtkTreeIter iter;
+	struct User *user;
+	chanmode_entry *hit;
+	GSList *hits = NULL, *list;
+	const char *text;
+	char *full, *mask, *type;
+	int i;
+
+	text = gtk_entry_get_text (GTK_ENTRY (entry));
+	if (!*text)
+		return;
+
+	user = userlist_find (sess, text);
+	if (user && user->hostname)
+		full = g_strdup_printf ("%s!%s", user->nick, user->hostname);
+	else
+		full = g_strdup (text);
+
+	for (i = 0; i < MODE_CT; i++)
+		hits = g_slist_concat (hits, chanmodes_list_find (sess, modes[i].letter, full));
+	g_free (full);
+
+	sel = gtk_tree_view_get_selection (get_view (sess));
+	gtk_tree_selection_unselect_all (sel);
+
+	model = GTK_TREE_MODEL (get_store (sess));
+	if (hits && gtk_tree_model_get_iter_first (model, &iter))
+	{
+		do
+		{
+			gtk_tree_model_get (model, &iter, TYPE_COLUMN, &type, MASK_COLUMN, &mask, -1);
+			for (list = hits; list; list = list->next)
+			{
+				hit = list->data;
+				if (g_strcmp0 (banlist_type (hit->mode[0]), type) == 0 &&
+					 strcmp (hit->mask, mask) == 0)
+				{
+					gtk_tree_selection_select_iter (sel, &iter);
+					break;
+				}
+			}
+			g_free (type);
+			g_free (mask);
+		}
+		while (gtk_tree_model_iter_next (model, &iter));
+	}
+
+	if (!hits)
+		fe_message (_("Nothing in the list affects that."), FE_MSG_INFO);
+	g_slist_free (hits);
+}
+
 /**
  *  * Performs the actual refresh operations.
  *  */
@@ -777,7 +888,7 @@ banlist_opengui (struct session *sess)
 {
 	banlist_info *banl;
 	int i;
-	GtkWidget *table, *vbox, *bbox;
+	GtkWidget *table, *vbox, *bbox, *findbox, *entry;
 	char tbuf[256];
 
 	if (sess->type != SESS_CHANNEL || sess->channel[0] == 0)
@@ -833,6 +944,20 @@ banlist_opengui (struct session *sess)
 		gtk_grid_attach (GTK_GRID (table), banl->checkboxes[i], i+1, 0, 1, 1);
 	}
 
+	findbox = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 6);
+	gtk_box_pack_start (GTK_BOX (vbox), findbox, 0, 0, 0);
+	gtk_box_pack_start (GTK_BOX (findbox), gtk_label_new (_("Find entries affecting:")), 0, 0, 0);
+	entry = gtk_entry_new ();
+	gtk_widget_set_tooltip_text (entry, _("A nickname in this channel or a nick!user@host"));
+	g_signal_connect (G_OBJECT (entry), "activate", G_CALLBACK (banlist_find), banl);
+	gtk_box_pack_start (GTK_BOX (findbox), entry, 1, 1, 0);
+
+	banl->hits_label = gtk_label_new (NULL);
+	gtk_label_set_selectable (GTK_LABEL (banl->hits_label), TRUE);
+	gtk_label_set_line_wrap (GTK_LABEL (banl->hits_label), TRUE);
+	gtk_widget_set_halign (banl->hits_label, GTK_ALIGN_START);
+	gtk_box_pack_start (GTK_BOX (vbox), banl->hits_label, 0, 0, 0);
+
 	bbox = gtk_button_box_new (GTK_ORIENTATION_HORIZONTAL);
 	gtk_button_box_set_layout (GTK_BUTTON_BOX (bbox), GTK_BUTTONBOX_SPREAD);
 	gtk_container_set_border_width (GTK_CONTAINER (bbox), 5);
@@ -60,6 +60,7 @@ typedef struct banlist_info_s {
 	GtkWidget *but_crop;
 	GtkWidget *but_clear;
 	GtkWidget *but_refresh;
+	GtkWidget *hits_label;	/* who the selected entry affects */
 } banlist_info;
 
 typedef struct mode_info_s {
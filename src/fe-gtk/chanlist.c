@@ -56,12 +56,14 @@ enum
 #ifndef CUSTOM_LIST
 typedef struct	/* this is now in custom-list.h */
 {
+	char *chan;
 	char *topic;
+	char *chan_folded;
+	char *topic_folded;
 	char *collation_key;
 	guint32	pos;
 	guint32 users;
-	/* channel string lives beyond "users" */
-#define GET_CHAN(row) (((char *)row)+sizeof(chanlistrow))
+#define GET_CHAN(row) ((row)->chan)
 }
 chanlistrow;
 #endif
@@ -69,23 +71,113 @@ chanlistrow;
 #define GET_MODEL(xserv) (gtk_tree_view_get_model(GTK_TREE_VIEW(xserv->gui->chanlist_list)))
 
 
+#define CHANLIST_BLOCK 1024		/* rows allocated at once */
+#define CHANLIST_CHUNK 4000		/* rows filtered per idle callback */
+
+
+static void
+chanlist_fold (char *str)
+{
+	for (; *str; str++)
+		*str = g_ascii_tolower (*str);
+}
+
 static gboolean
-chanlist_match (server *serv, const char *str)
+chanlist_match (server *serv, struct chanlist_filter *filter, const char *str,
+					 const char *folded)
 {
-	switch (serv->gui->chanlist_search_type)
+	switch (filter->type)
 	{
 	case 1:
-		return match (gtk_entry_get_text (GTK_ENTRY (serv->gui->chanlist_wild)), str);
+		return match (filter->text, str);
 	case 2:
 		if (!serv->gui->have_regex)
 			return 0;
 
 		return g_regex_match (serv->gui->chanlist_match_regex, str, 0, NULL);
 	default:	/* case 0: */
-		return nocasestrstr (str, gtk_entry_get_text (GTK_ENTRY (serv->gui->chanlist_wild))) ? 1 : 0;
+		return strstr (folded, filter->folded) ? 1 : 0;
 	}
 }
 
+/**
+ * Checks a row against the user and regex/search requirements.
+ */
+static gboolean
+chanlist_row_matches (server *serv, struct chanlist_filter *filter, chanlistrow *row)
+{
+	if (row->users < filter->minusers)
+		return FALSE;
+
+	if (row->users > filter->maxusers && filter->maxusers > 0)
+		return FALSE;
+
+	if (!filter->text[0])
+		return TRUE;
+
+	/* Check what the user wants to match. If both buttons or _neither_
+	 * button is checked, look for match in both by default. 
+	 */
+	if (filter->channel == filter->topic)
+		return chanlist_match (serv, filter, row->chan, row->chan_folded)
+				 || chanlist_match (serv, filter, row->topic, row->topic_folded);
+
+	if (filter->channel)
+		return chanlist_match (serv, filter, row->chan, row->chan_folded);
+
+	return chanlist_match (serv, filter, row->topic, row->topic_folded);
+}
+
+/* takes the filter as it's set up in the window */
+
+static void
+chanlist_filter_get (server *serv, struct chanlist_filter *filter)
+{
+	filter->text = g_strdup (gtk_entry_get_text (GTK_ENTRY (serv->gui->chanlist_wild)));
+	filter->folded = g_strdup (filter->text);
+	chanlist_fold (filter->folded);
+	filter->type = serv->gui->chanlist_search_type;
+	filter->channel = serv->gui->chanlist_match_wants_channel;
+	filter->topic = serv->gui->chanlist_match_wants_topic;
+	filter->minusers = serv->gui->chanlist_minusers;
+	filter->maxusers = serv->gui->chanlist_maxusers;
+}
+
+static void
+chanlist_filter_clear (struct chanlist_filter *filter)
+{
+	g_clear_pointer (&filter->text, g_free);
+	g_clear_pointer (&filter->folded, g_free);
+}
+
+/* is everything new lets through among what old let through? Then only
+   old's matches need to be looked at, e.g. when more is typed. */
+
+static gboolean
+chanlist_filter_narrows (struct chanlist_filter *new, struct chanlist_filter *old)
+{
+	if (!old->text)
+		return FALSE;
+
+	if (new->minusers < old->minusers)
+		return FALSE;
+
+	if (old->maxusers > 0 && (new->maxusers == 0 || new->maxusers > old->maxusers))
+		return FALSE;
+
+	if (!old->text[0])
+		return TRUE;
+
+	if (new->type != old->type || new->channel != old->channel
+		 || new->topic != old->topic)
+		return FALSE;
+
+	if (new->type == 0)
+		return strstr (new->folded, old->folded) != NULL;
+
+	return strcmp (new->text, old->text) == 0;
+}
+
 /**
  * Updates the caption to reflect the number of users and channels
  */
@@ -132,33 +224,83 @@ chanlist_reset_counters (server *serv)
 	chanlist_update_buttons (serv);
 }
 
-/* free up our entire linked list and all the nodes */
+static void
+chanlist_filter_stop (server *serv)
+{
+	if (serv->gui->chanlist_filter_tag)
+	{
+		g_source_remove (serv->gui->chanlist_filter_tag);
+		serv->gui->chanlist_filter_tag = 0;
+	}
+
+	g_clear_pointer (&serv->gui->chanlist_filter_source, g_ptr_array_unref);
+	g_clear_pointer (&serv->gui->chanlist_filter_results, g_ptr_array_unref);
+	chanlist_filter_clear (&serv->gui->chanlist_next_filter);
+}
+
+static void
+chanlist_data_init (server *serv)
+{
+	serv->gui->chanlist_rows = g_ptr_array_new ();
+	serv->gui->chanlist_matches = g_ptr_array_new ();
+	serv->gui->chanlist_strings = g_string_chunk_new (65536);
+
+	chanlist_filter_clear (&serv->gui->chanlist_filter);
+	chanlist_filter_get (serv, &serv->gui->chanlist_filter);
+}
+
+/* free up all the rows and their strings */
 
 static void
 chanlist_data_free (server *serv)
 {
-	GSList *rows;
+	GPtrArray *rows = serv->gui->chanlist_rows;
 	chanlistrow *data;
+	guint i;
+
+	chanlist_filter_stop (serv);
 
-	if (serv->gui->chanlist_data_stored_rows)
+	if (rows)
 	{
-		for (rows = serv->gui->chanlist_data_stored_rows; rows != NULL;
-			  rows = rows->next)
+		for (i = 0; i < rows->len; i++)
 		{
-			data = rows->data;
-			g_free (data->topic);
+			data = g_ptr_array_index (rows, i);
 			g_free (data->collation_key);
-			g_free (data);
 		}
 
-		g_slist_free (serv->gui->chanlist_data_stored_rows);
-		serv->gui->chanlist_data_stored_rows = NULL;
+		g_ptr_array_unref (rows);
+		serv->gui->chanlist_rows = NULL;
 	}
 
+	g_clear_pointer (&serv->gui->chanlist_matches, g_ptr_array_unref);
+
+	if (serv->gui->chanlist_strings)
+	{
+		g_string_chunk_free (serv->gui->chanlist_strings);
+		serv->gui->chanlist_strings = NULL;
+	}
+
+	g_slist_free_full (serv->gui->chanlist_blocks, g_free);
+	serv->gui->chanlist_blocks = NULL;
+	serv->gui->chanlist_block_used = 0;
+
 	g_slist_free (serv->gui->chanlist_pending_rows);
 	serv->gui->chanlist_pending_rows = NULL;
 }
 
+static chanlistrow *
+chanlist_row_new (server *serv)
+{
+	if (!serv->gui->chanlist_blocks || serv->gui->chanlist_block_used == CHANLIST_BLOCK)
+	{
+		serv->gui->chanlist_blocks = g_slist_prepend (serv->gui->chanlist_blocks,
+																	 g_new (chanlistrow, CHANLIST_BLOCK));
+		serv->gui->chanlist_block_used = 0;
+	}
+
+	return (chanlistrow *) serv->gui->chanlist_blocks->data + serv->gui->chanlist_block_used++;
+}
+
 /* add any rows we received from the server in the last 0.25s to the GUI */
 
 static void
@@ -200,67 +342,23 @@ chanlist_timeout (server *serv)
  * the user and regex/search requirements.
  */
 static void
-chanlist_place_row_in_gui (server *serv, chanlistrow *next_row, gboolean force)
+chanlist_place_row_in_gui (server *serv, chanlistrow *next_row)
 {
 	GtkTreeModel *model;
 
-	/* First, update the 'found' counter values */
-	serv->gui->chanlist_users_found_count += next_row->users;
-	serv->gui->chanlist_channels_found_count++;
-
 	if (serv->gui->chanlist_channels_shown_count == 1)
 		/* join & save buttons become live */
 		chanlist_update_buttons (serv);
 
-	if (next_row->users < serv->gui->chanlist_minusers)
-	{
-		serv->gui->chanlist_caption_is_stale = TRUE;
-		return;
-	}
-
-	if (next_row->users > serv->gui->chanlist_maxusers
-		 && serv->gui->chanlist_maxusers > 0)
+	if (!chanlist_row_matches (serv, &serv->gui->chanlist_filter, next_row))
 	{
 		serv->gui->chanlist_caption_is_stale = TRUE;
 		return;
 	}
 
-	if (gtk_entry_get_text (GTK_ENTRY (serv->gui->chanlist_wild))[0])
-	{
-		/* Check what the user wants to match. If both buttons or _neither_
-		 * button is checked, look for match in both by default. 
-		 */
-		if (serv->gui->chanlist_match_wants_channel ==
-			 serv->gui->chanlist_match_wants_topic)
-		{
-			if (!chanlist_match (serv, GET_CHAN (next_row))
-				 && !chanlist_match (serv, next_row->topic))
-			{
-				serv->gui->chanlist_caption_is_stale = TRUE;
-				return;
-			}
-		}
-
-		else if (serv->gui->chanlist_match_wants_channel)
-		{
-			if (!chanlist_match (serv, GET_CHAN (next_row)))
-			{
-				serv->gui->chanlist_caption_is_stale = TRUE;
-				return;
-			}
-		}
+	g_ptr_array_add (serv->gui->chanlist_matches, next_row);
 
-		else if (serv->gui->chanlist_match_wants_topic)
-		{
-			if (!chanlist_match (serv, next_row->topic))
-			{
-				serv->gui->chanlist_caption_is_stale = TRUE;
-				return;
-			}
-		}
-	}
-
-	if (force || serv->gui->chanlist_channels_shown_count < 20)
+	if (serv->gui->chanlist_channels_shown_count < 20)
 	{
 		model = GET_MODEL (serv);
 		/* makes it appear fast :) */
@@ -276,6 +374,98 @@ chanlist_place_row_in_gui (server *serv, chanlistrow *next_row, gboolean force)
 	serv->gui->chanlist_channels_shown_count++;
 }
 
+/**
+ * Replaces what the GtkTreeView shows. With the model taken off the view
+ * that's little more than filling an array, even for 60k rows.
+ */
+static void
+chanlist_show_rows (server *serv, GPtrArray *rows)
+{
+	GtkTreeView *view = GTK_TREE_VIEW (serv->gui->chanlist_list);
+	GtkTreeModel *model = GET_MODEL (serv);
+	chanlistrow *row;
+	guint i;
+
+	g_slist_free (serv->gui->chanlist_pending_rows);
+	serv->gui->chanlist_pending_rows = NULL;
+
+	g_object_ref (model);
+	gtk_tree_view_set_model (view, NULL);
+
+	custom_list_clear (CUSTOM_LIST (model));
+	serv->gui->chanlist_users_shown_count = 0;
+	for (i = 0; i < rows->len; i++)
+	{
+		row = g_ptr_array_index (rows, i);
+		custom_list_append (CUSTOM_LIST (model), row);
+		serv->gui->chanlist_users_shown_count += row->users;
+	}
+	serv->gui->chanlist_channels_shown_count = rows->len;
+	custom_list_resort (CUSTOM_LIST (model));
+
+	gtk_tree_view_set_model (view, model);
+	g_object_unref (model);
+
+	chanlist_update_caption (serv);
+	chanlist_update_buttons (serv);
+}
+
+static gboolean
+chanlist_filter_step (server *serv)
+{
+	GPtrArray *source = serv->gui->chanlist_filter_source;
+	guint end = MIN (source->len, serv->gui->chanlist_filter_pos + CHANLIST_CHUNK);
+	chanlistrow *row;
+
+	for (; serv->gui->chanlist_filter_pos < end; serv->gui->chanlist_filter_pos++)
+	{
+		row = g_ptr_array_index (source, serv->gui->chanlist_filter_pos);
+		if (chanlist_row_matches (serv, &serv->gui->chanlist_next_filter, row))
+			g_ptr_array_add (serv->gui->chanlist_filter_results, row);
+	}
+
+	/* rows may still be coming in if this runs over all of them */
+	if (serv->gui->chanlist_filter_pos < source->len)
+		return TRUE;
+
+	/* done, this is what the list shows now */
+	chanlist_filter_clear (&serv->gui->chanlist_filter);
+	serv->gui->chanlist_filter = serv->gui->chanlist_next_filter;
+	memset (&serv->gui->chanlist_next_filter, 0, sizeof (struct chanlist_filter));
+
+	g_ptr_array_unref (serv->gui->chanlist_matches);
+	serv->gui->chanlist_matches = serv->gui->chanlist_filter_results;
+	serv->gui->chanlist_filter_results = NULL;
+	g_clear_pointer (&serv->gui->chanlist_filter_source, g_ptr_array_unref);
+	serv->gui->chanlist_filter_tag = 0;
+
+	chanlist_show_rows (serv, serv->gui->chanlist_matches);
+	return FALSE;
+}
+
+/**
+ * Filters the stored rows again. When the new filter is narrower than the
+ * last one, only its matches are gone through. Large lists are done a
+ * chunk at a time so the window keeps responding.
+ */
+static void
+chanlist_filter_start (server *serv)
+{
+	chanlist_filter_stop (serv);
+	chanlist_filter_get (serv, &serv->gui->chanlist_next_filter);
+
+	if (chanlist_filter_narrows (&serv->gui->chanlist_next_filter, &serv->gui->chanlist_filter))
+		serv->gui->chanlist_filter_source = g_ptr_array_ref (serv->gui->chanlist_matches);
+	else
+		serv->gui->chanlist_filter_source = g_ptr_array_ref (serv->gui->chanlist_rows);
+
+	serv->gui->chanlist_filter_results = g_ptr_array_new ();
+	serv->gui->chanlist_filter_pos = 0;
+
+	if (chanlist_filter_step (serv))
+		serv->gui->chanlist_filter_tag = g_idle_add ((GSourceFunc)chanlist_filter_step, serv);
+}
+
 /* Performs the LIST download from the IRC server. */
 
 static void
@@ -297,6 +487,7 @@ chanlist_do_refresh (server *serv)
 	gtk_widget_set_sensitive (serv->gui->chanlist_refresh, FALSE);
 
 	chanlist_data_free (serv);
+	chanlist_data_init (serv);
 	chanlist_reset_counters (serv);
 
 	/* can we request a list with minusers arg? */
@@ -325,65 +516,69 @@ chanlist_refresh (GtkWidget * wid, server *serv)
 }
 
 /**
- * Fills the gui GtkTreeView with stored items from the GSList.
+ * Fills the gui GtkTreeView with the stored rows that match.
  */
 static void
 chanlist_build_gui_list (server *serv)
 {
-	GSList *rows;
-
 	/* first check if the list is present */
-	if (serv->gui->chanlist_data_stored_rows == NULL)
+	if (serv->gui->chanlist_rows == NULL)
 	{
 		/* start a download */
 		chanlist_do_refresh (serv);
 		return;
 	}
 
-	custom_list_clear ((CustomList *)GET_MODEL (serv));
-
-	/* discard pending rows FIXME: free the structs? */
-	g_slist_free (serv->gui->chanlist_pending_rows);
-	serv->gui->chanlist_pending_rows = NULL;
-
-	/* Reset the counters */
-	chanlist_reset_counters (serv);
-
-	/* Refill the list */
-	for (rows = serv->gui->chanlist_data_stored_rows; rows != NULL;
-		  rows = rows->next)
-	{
-		chanlist_place_row_in_gui (serv, rows->data, TRUE);
-	}
-
-	custom_list_resort ((CustomList *)GET_MODEL (serv));
+	chanlist_filter_start (serv);
 }
 
 /**
- * Accepts incoming channel data from inbound.c, allocates new space for a
- * chanlistrow, adds it to our linked list and calls chanlist_place_row_in_gui.
+ * Accepts incoming channel data from inbound.c, stores it as a chanlistrow
+ * and calls chanlist_place_row_in_gui.
  */
 void
 fe_add_chan_list (server *serv, char *chan, char *users, char *topic)
 {
 	chanlistrow *next_row;
-	int len = strlen (chan) + 1;
-
-	/* we allocate the struct and channel string in one go */
-	next_row = g_malloc (sizeof (chanlistrow) + len);
-	memcpy (((char *)next_row) + sizeof (chanlistrow), chan, len);
-	next_row->topic = strip_color (topic, -1, STRIP_ALL);
-	next_row->collation_key = g_utf8_collate_key (chan, len-1);
-	if (!(next_row->collation_key))
-		next_row->collation_key = g_strdup (chan);
+	GStringChunk *strings;
+	char *stripped;
+
+	if (!serv->gui->chanlist_rows)
+		chanlist_data_init (serv);
+	strings = serv->gui->chanlist_strings;
+
+	next_row = chanlist_row_new (serv);
+	next_row->chan = g_string_chunk_insert (strings, chan);
+	next_row->chan_folded = g_string_chunk_insert (strings, chan);
+	chanlist_fold (next_row->chan_folded);
+	stripped = strip_color (topic, -1, STRIP_ALL);
+	next_row->topic = g_string_chunk_insert (strings, stripped);
+	next_row->topic_folded = g_string_chunk_insert (strings, stripped);
+	chanlist_fold (next_row->topic_folded);
+	g_free (stripped);
+	next_row->collation_key = NULL;
+	next_row->pos = 0;
 	next_row->users = atoi (users);
 
 	/* add this row to the data */
-	serv->gui->chanlist_data_stored_rows =
-		g_slist_prepend (serv->gui->chanlist_data_stored_rows, next_row);
+	g_ptr_array_add (serv->gui->chanlist_rows, next_row);
+
+	/* First, update the 'found' counter values */
+	serv->gui->chanlist_users_found_count += next_row->users;
+	serv->gui->chanlist_channels_found_count++;
+
+	/* a filter is being applied, the list gets refilled when it's done */
+	if (serv->gui->chanlist_filter_tag)
+	{
+		if (serv->gui->chanlist_filter_source != serv->gui->chanlist_rows
+			 && chanlist_row_matches (serv, &serv->gui->chanlist_next_filter, next_row))
+			g_ptr_array_add (serv->gui->chanlist_filter_results, next_row);
+		serv->gui->chanlist_caption_is_stale = TRUE;
+		return;
+	}
 
 	/* _possibly_ add the row to the gui */
-	chanlist_place_row_in_gui (serv, next_row, FALSE);
+	chanlist_place_row_in_gui (serv, next_row);
 }
 
 void
@@ -418,6 +613,10 @@ chanlist_find_cb (GtkWidget * wid, server *serv)
 
 	if (serv->gui->chanlist_match_regex)
 		serv->gui->have_regex = 1;
+
+	/* filter as the user types */
+	if (serv->gui->chanlist_rows)
+		chanlist_filter_start (serv);
 }
 
 static void
@@ -642,6 +841,7 @@ chanlist_destroy_widget (GtkWidget *wid, server *serv)
 {
 	custom_list_clear ((CustomList *)GET_MODEL (serv));
 	chanlist_data_free (serv);
+	chanlist_filter_clear (&serv->gui->chanlist_filter);
 
 	if (serv->gui->chanlist_flash_tag)
 	{
@@ -723,7 +923,7 @@ chanlist_opengui (server *serv, int do_refresh)
 	serv->gui->chanlist_pending_rows = NULL;
 	serv->gui->chanlist_tag = 0;
 	serv->gui->chanlist_flash_tag = 0;
-	serv->gui->chanlist_data_stored_rows = NULL;
+	serv->gui->chanlist_rows = NULL;
 
 	if (!serv->gui->chanlist_minusers)
 	{
@@ -616,28 +616,8 @@ custom_list_sortable_has_default_sort_func (GtkTreeSortable * sortable)
 	return FALSE;
 }
 
-/* fast as possible compare func for sorting.
-   TODO: If fast enough, use a unicode collation key and strcmp. */
-
-#define TOSML(c) (((c) >= 'A' && (c) <= 'Z') ? (c) - 'A' + 'a' : (c))
-
-static inline int
-fast_ascii_stricmp (const char *s1, const char *s2)
-{
-	int c1, c2;
-
-	while (*s1 && *s2)
-	{
-		c1 = (int) (unsigned char) TOSML (*s1);
-		c2 = (int) (unsigned char) TOSML (*s2);
-		if (c1 != c2)
-			return (c1 - c2);
-		s1++;
-		s2++;
-	}
-
-	return (((int) (unsigned char) *s1) - ((int) (unsigned char) *s2));
-}
+/* fast as possible compare func for sorting: names by their collation
+   key, topics by their lowercase copy. */
 
 static gint
 custom_list_qsort_compare_func (chanlistrow ** a, chanlistrow ** b,
@@ -657,7 +637,7 @@ custom_list_qsort_compare_func (chanlistrow ** a, chanlistrow ** b,
 
 	if (custom_list->sort_id == SORT_ID_TOPIC)
 	{
-		return fast_ascii_stricmp ((*a)->topic, (*b)->topic);
+		return strcmp ((*a)->topic_folded, (*b)->topic_folded);
 	}
 
 	return strcmp ((*a)->collation_key, (*b)->collation_key);
@@ -686,7 +666,7 @@ custom_list_append (CustomList * custom_list, chanlistrow * newrecord)
 
 	if (custom_list->num_rows >= custom_list->num_alloc)
 	{
-		custom_list->num_alloc += 64;
+		custom_list->num_alloc = MAX (64, custom_list->num_alloc * 2);
 		newsize = custom_list->num_alloc * sizeof (chanlistrow *);
 		custom_list->rows = g_realloc (custom_list->rows, newsize);
 	}
@@ -719,6 +699,20 @@ custom_list_resort (CustomList * custom_list)
 	if (custom_list->num_rows < 2)
 		return;
 
+	/* names only get a collation key once they're sorted by */
+	if (custom_list->sort_id == SORT_ID_CHANNEL)
+	{
+		for (i = 0; i < (gint) custom_list->num_rows; i++)
+		{
+			chanlistrow *row = custom_list->rows[i];
+
+			if (!row->collation_key)
+				row->collation_key = g_utf8_collate_key (row->chan, -1);
+			if (!row->collation_key)
+				row->collation_key = g_strdup (row->chan);
+		}
+	}
+
 	/* resort */
 	g_qsort_with_data (custom_list->rows,
 							 custom_list->num_rows,
@@ -51,14 +51,17 @@ enum
 	SORT_ID_TOPIC
 };
 
+/* The strings live in the channel list's GStringChunk */
 typedef struct
 {
+	char *chan;
 	char *topic;
-	char *collation_key;
+	char *chan_folded;				  /* ascii lowercase, for searching */
+	char *topic_folded;
+	char *collation_key;				  /* made on the first sort by name */
 	guint32 pos;						  /* pos within the array */
 	guint32 users;
-	/* channel string lives beyond "users" */
-#define GET_CHAN(row) (((char *)row)+sizeof(chanlistrow))
+#define GET_CHAN(row) ((row)->chan)
 }
 chanlistrow;
 
@@ -33,12 +33,13 @@
 #include "../common/fe.h"
 #include "../common/util.h"
 #include "../common/network.h"
+#include "../common/dccgroup.h"
 #include "gtkutil.h"
 #include "palette.h"
 #include "maingui.h"
 
 
-enum	/* DCC SEND/RECV */
+enum	/* DCC SEND/RECV, the columns of the view */
 {
 	COL_TYPE,
 	COL_STATUS,
@@ -49,11 +50,11 @@ enum	/* DCC SEND/RECV */
 	COL_SPEED,
 	COL_ETA,
 	COL_NICK,
-	COL_DCC, /* struct DCC * */
-	COL_COLOR,	/* GdkColor */
 	N_COLUMNS
 };
 
+#define FCOL_DCC 0	/* the store only holds the struct DCC * */
+
 enum	/* DCC CHAT */
 {
 	CCOL_STATUS,
@@ -73,6 +74,9 @@ struct dccwindow
 	GtkWidget *list;
 	GtkListStore *store;
 	GtkTreeSelection *sel;
+	GHashTable *rows;		/* struct DCC * -> struct dcc_row */
+	GHashTable *dirty;	/* DCCs to refresh on the next frame */
+	guint tick;
 
 	GtkWidget *abort_button;
 	GtkWidget *accept_button;
@@ -84,6 +88,19 @@ struct dccwindow
 	GtkWidget *address_label;
 };
 
+/* What a transfer's row shows. The stats are copied from the DCC at most
+   once a frame, the strings are only made when the row is drawn and are
+   kept until the stats change again. */
+struct dcc_row
+{
+	GtkTreeIter iter;				/* list store iters persist */
+	int dccstat;
+	guint64 pos;
+	guint64 done;					/* ack'ed for sends */
+	gint64 cps;
+	char *text[N_COLUMNS];
+};
+
 struct my_dcc_send
 {
 	struct session *sess;
@@ -103,6 +120,7 @@ static short view_mode;	/* 1=download 2=upload 3=both */
 #define VIEW_UPLOAD 2
 #define VIEW_BOTH 3
 
+static void update_clear_button_sensitivity (void);
 
 static void
 proper_unit (guint64 size, char *buf, size_t buf_len)
@@ -178,216 +196,241 @@ dcc_prepare_row_chat (struct DCC *dcc, GtkListStore *store, GtkTreeIter *iter,
 							  -1);
 }
 
+static GdkPixbuf *
+dcc_load_icon (const char *name, const char *fallback)
+{
+	GtkIconTheme *theme = gtk_icon_theme_get_default ();
+	GdkPixbuf *pix;
+
+	pix = gtk_icon_theme_load_icon (theme, name, 16, GTK_ICON_LOOKUP_GENERIC_FALLBACK, NULL);
+	if (!pix)
+		pix = gtk_icon_theme_load_icon (theme, fallback, 16, GTK_ICON_LOOKUP_GENERIC_FALLBACK, NULL);
+
+	return pix;
+}
+
 static void
-dcc_prepare_row_send (struct DCC *dcc, GtkListStore *store, GtkTreeIter *iter,
-							 gboolean update_only)
+dcc_row_free (struct dcc_row *row)
 {
-	static char pos[16], size[16], kbs[14], perc[14], eta[14];
-	int to_go;
-	float per;
+	int i;
 
-	if (!pix_up)
-	{
-		GtkIconTheme *theme = gtk_icon_theme_get_default();
-		pix_up = gtk_icon_theme_load_icon(theme, "go-up", 
-		                                  gtk_icon_size_lookup(GTK_ICON_SIZE_MENU, NULL, NULL) ? 16 : 16,
-		                                  GTK_ICON_LOOKUP_GENERIC_FALLBACK, NULL);
-		if (!pix_up)
-			pix_up = gtk_icon_theme_load_icon(theme, "gtk-go-up", 16, GTK_ICON_LOOKUP_GENERIC_FALLBACK, NULL);
-	}
+	for (i = 0; i < N_COLUMNS; i++)
+		g_free (row->text[i]);
+	g_free (row);
+}
 
-	/* percentage ack'ed */
-	per = (float) ((dcc->ack * 100.00) / dcc->size);
-	proper_unit (dcc->size, size, sizeof (size));
-	proper_unit (dcc->pos, pos, sizeof (pos));
-	g_snprintf (kbs, sizeof (kbs), "%.1f", ((float)dcc->cps) / 1024);
-	g_snprintf (perc, sizeof (perc), "%.0f%%", per);
-	if (dcc->cps != 0)
+/* copies the stats the row shows, FALSE if none of them changed */
+static gboolean
+dcc_row_snapshot (struct DCC *dcc, struct dcc_row *row)
+{
+	guint64 pos, done;
+	gint64 cps;
+	int i;
+
+	if (dcc->type == TYPE_RECV)
 	{
-		to_go = (dcc->size - dcc->ack) / dcc->cps;
-		g_snprintf (eta, sizeof (eta), "%.2d:%.2d:%.2d",
-					 to_go / 3600, (to_go / 60) % 60, to_go % 60);
-	} else
-		strcpy (eta, "--:--:--");
-
-	if (update_only)
-		gtk_list_store_set (store, iter,
-								  COL_STATUS, _(dccstat[dcc->dccstat].name),
-								  COL_POS, pos,
-								  COL_PERC, perc,
-								  COL_SPEED, kbs,
-								  COL_ETA, eta,
-								  COL_COLOR,
-								  dccstat[dcc->dccstat].color == 1 ?
-									NULL :
-									colors + dccstat[dcc->dccstat].color,
-									-1);
+		/* a multi-source download shows all of its parts in one row */
+		if (dcc->group)
+		{
+			dcc_group_progress (dcc, &pos, &cps);
+		}
+		else
+		{
+			pos = dcc->dccstat == STAT_QUEUED ? dcc->resumable : dcc->pos;
+			cps = dcc->cps;
+		}
+		done = pos;
+	}
 	else
-		gtk_list_store_set (store, iter,
-								  COL_TYPE, pix_up,
-								  COL_STATUS, _(dccstat[dcc->dccstat].name),
-								  COL_FILE, file_part (dcc->file),
-								  COL_SIZE, size,
-								  COL_POS, pos,
-								  COL_PERC, perc,
-								  COL_SPEED, kbs,
-								  COL_ETA, eta,
-								  COL_NICK, dcc->nick,
-								  COL_DCC, dcc,
-								  COL_COLOR,
-								  dccstat[dcc->dccstat].color == 1 ?
-									NULL :
-									colors + dccstat[dcc->dccstat].color,
-									-1);
+	{
+		pos = dcc->pos;
+		done = dcc->ack;
+		cps = dcc->cps;
+	}
+
+	if (row->dccstat == dcc->dccstat && row->pos == pos &&
+		 row->done == done && row->cps == cps)
+		return FALSE;
+
+	row->dccstat = dcc->dccstat;
+	row->pos = pos;
+	row->done = done;
+	row->cps = cps;
+
+	for (i = 0; i < N_COLUMNS; i++)
+		g_clear_pointer (&row->text[i], g_free);
+
+	return TRUE;
 }
 
-static void
-dcc_prepare_row_recv (struct DCC *dcc, GtkListStore *store, GtkTreeIter *iter,
-							 gboolean update_only)
+static const char *
+dcc_row_text (struct DCC *dcc, struct dcc_row *row, int col)
 {
-	static char size[16], pos[16], kbs[16], perc[14], eta[16];
-	float per;
+	char buf[16];
 	int to_go;
 
-	if (!pix_dn)
+	if (row->text[col])
+		return row->text[col];
+
+	switch (col)
 	{
-		GtkIconTheme *theme = gtk_icon_theme_get_default();
-		pix_dn = gtk_icon_theme_load_icon(theme, "go-down", 
-		                                  gtk_icon_size_lookup(GTK_ICON_SIZE_MENU, NULL, NULL) ? 16 : 16,
-		                                  GTK_ICON_LOOKUP_GENERIC_FALLBACK, NULL);
-		if (!pix_dn)
-			pix_dn = gtk_icon_theme_load_icon(theme, "gtk-go-down", 16, GTK_ICON_LOOKUP_GENERIC_FALLBACK, NULL);
+	case COL_STATUS:
+		return _(dccstat[row->dccstat].name);
+	case COL_FILE:
+		return file_part (dcc->file);
+	case COL_NICK:
+		return dcc->nick;
+	case COL_SIZE:
+		proper_unit (dcc->size, buf, sizeof (buf));
+		row->text[col] = g_strdup (buf);
+		break;
+	case COL_POS:
+		proper_unit (row->pos, buf, sizeof (buf));
+		row->text[col] = g_strdup (buf);
+		break;
+	case COL_PERC:
+		row->text[col] = g_strdup_printf ("%.0f%%", (float) ((row->done * 100.00) / dcc->size));
+		break;
+	case COL_SPEED:
+		row->text[col] = g_strdup_printf ("%.1f", ((float)row->cps) / 1024);
+		break;
+	case COL_ETA:
+		if (row->cps == 0)
+			return "--:--:--";
+		to_go = (dcc->size - row->done) / row->cps;
+		row->text[col] = g_strdup_printf ("%.2d:%.2d:%.2d",
+													 to_go / 3600, (to_go / 60) % 60, to_go % 60);
+		break;
 	}
 
-	proper_unit (dcc->size, size, sizeof (size));
-	if (dcc->dccstat == STAT_QUEUED)
-		proper_unit (dcc->resumable, pos, sizeof (pos));
-	else
-		proper_unit (dcc->pos, pos, sizeof (pos));
-	g_snprintf (kbs, sizeof (kbs), "%.1f", ((float)dcc->cps) / 1024);
-	/* percentage recv'ed */
-	per = (float) ((dcc->pos * 100.00) / dcc->size);
-	g_snprintf (perc, sizeof (perc), "%.0f%%", per);
-	if (dcc->cps != 0)
-	{
-		to_go = (dcc->size - dcc->pos) / dcc->cps;
-		g_snprintf (eta, sizeof (eta), "%.2d:%.2d:%.2d",
-					 to_go / 3600, (to_go / 60) % 60, to_go % 60);
-	} else
-		strcpy (eta, "--:--:--");
-
-	if (update_only)
-		gtk_list_store_set (store, iter,
-								  COL_STATUS, _(dccstat[dcc->dccstat].name),
-								  COL_POS, pos,
-								  COL_PERC, perc,
-								  COL_SPEED, kbs,
-								  COL_ETA, eta,
-								  COL_COLOR,
-								  dccstat[dcc->dccstat].color == 1 ?
-									NULL :
-									colors + dccstat[dcc->dccstat].color,
-									-1);
-	else
-		gtk_list_store_set (store, iter,
-								  COL_TYPE, pix_dn,
-								  COL_STATUS, _(dccstat[dcc->dccstat].name),
-								  COL_FILE, file_part (dcc->file),
-								  COL_SIZE, size,
-								  COL_POS, pos,
-								  COL_PERC, perc,
-								  COL_SPEED, kbs,
-								  COL_ETA, eta,
-								  COL_NICK, dcc->nick,
-								  COL_DCC, dcc,
-								  COL_COLOR,
-								  dccstat[dcc->dccstat].color == 1 ?
-									NULL :
-									colors + dccstat[dcc->dccstat].color,
-									-1);
+	return row->text[col];
 }
 
-static gboolean
-dcc_find_row (struct DCC *find_dcc, GtkTreeModel *model, GtkTreeIter *iter, int col)
+static void
+dcc_cell_icon_cb (GtkTreeViewColumn *column, GtkCellRenderer *cell,
+						GtkTreeModel *model, GtkTreeIter *iter, gpointer data)
 {
 	struct DCC *dcc;
 
-	if (gtk_tree_model_get_iter_first (model, iter))
-	{
-		do
-		{
-			gtk_tree_model_get (model, iter, col, &dcc, -1);
-			if (dcc == find_dcc)
-				return TRUE;
-		}
-		while (gtk_tree_model_iter_next (model, iter));
-	}
+	if (!pix_up)
+		pix_up = dcc_load_icon ("go-up", "gtk-go-up");
+	if (!pix_dn)
+		pix_dn = dcc_load_icon ("go-down", "gtk-go-down");
 
-	return FALSE;
+	gtk_tree_model_get (model, iter, FCOL_DCC, &dcc, -1);
+	g_object_set (cell, "pixbuf", dcc->type == TYPE_RECV ? pix_dn : pix_up, NULL);
 }
 
 static void
-dcc_update_recv (struct DCC *dcc)
+dcc_cell_text_cb (GtkTreeViewColumn *column, GtkCellRenderer *cell,
+						GtkTreeModel *model, GtkTreeIter *iter, gpointer data)
 {
-	GtkTreeIter iter;
+	struct DCC *dcc;
+	struct dcc_row *row;
+	int color;
 
-	if (!dccfwin.window)
-		return;
+	gtk_tree_model_get (model, iter, FCOL_DCC, &dcc, -1);
+	row = g_hash_table_lookup (dccfwin.rows, dcc);
+	color = dccstat[row->dccstat].color;
 
-	if (!dcc_find_row (dcc, GTK_TREE_MODEL (dccfwin.store), &iter, COL_DCC))
-		return;
+	g_object_set (cell, "text", dcc_row_text (dcc, row, GPOINTER_TO_INT (data)),
+					  "foreground-rgba", color == 1 ? NULL : colors + color, NULL);
+}
 
-	dcc_prepare_row_recv (dcc, dccfwin.store, &iter, TRUE);
+static gboolean
+dcc_path_visible (GtkTreePath *path, GtkTreePath *start, GtkTreePath *end)
+{
+	return start && gtk_tree_path_compare (path, start) >= 0 &&
+			 gtk_tree_path_compare (path, end) <= 0;
 }
 
-static void
-dcc_update_chat (struct DCC *dcc)
+/* Refreshes the rows that were updated since the last frame. Rows that
+   aren't on screen just take the new stats, they're drawn with them once
+   they're scrolled to. */
+static gboolean
+dcc_flush_cb (GtkWidget *view, GdkFrameClock *clock, gpointer data)
 {
-	GtkTreeIter iter;
+	GtkTreeModel *model = GTK_TREE_MODEL (dccfwin.store);
+	GtkTreePath *path, *start = NULL, *end = NULL;
+	GHashTableIter it;
+	struct dcc_row *row;
+	gpointer dcc;
 
-	if (!dcccwin.window)
-		return;
+	gtk_tree_view_get_visible_range (GTK_TREE_VIEW (view), &start, &end);
 
-	if (!dcc_find_row (dcc, GTK_TREE_MODEL (dcccwin.store), &iter, CCOL_DCC))
-		return;
+	g_hash_table_iter_init (&it, dccfwin.dirty);
+	while (g_hash_table_iter_next (&it, &dcc, NULL))
+	{
+		row = g_hash_table_lookup (dccfwin.rows, dcc);
+		if (!row || !dcc_row_snapshot (dcc, row))
+			continue;
+
+		path = gtk_tree_model_get_path (model, &row->iter);
+		if (dcc_path_visible (path, start, end))
+			gtk_tree_model_row_changed (model, path, &row->iter);
+		gtk_tree_path_free (path);
+	}
+	g_hash_table_remove_all (dccfwin.dirty);
+	dccfwin.tick = 0;
 
-	dcc_prepare_row_chat (dcc, dcccwin.store, &iter, TRUE);
+	if (start)
+	{
+		gtk_tree_path_free (start);
+		gtk_tree_path_free (end);
+	}
+
+	update_clear_button_sensitivity ();
+	return G_SOURCE_REMOVE;
 }
 
 static void
-dcc_update_send (struct DCC *dcc)
+dcc_update_file (struct DCC *dcc)
 {
-	GtkTreeIter iter;
-
-	if (!dccfwin.window)
+	if (!dccfwin.window || !g_hash_table_contains (dccfwin.rows, dcc))
 		return;
 
-	if (!dcc_find_row (dcc, GTK_TREE_MODEL (dccfwin.store), &iter, COL_DCC))
+	/* a second's worth of updates is drawn once, on the next frame */
+	g_hash_table_add (dccfwin.dirty, dcc);
+	if (!dccfwin.tick)
+		dccfwin.tick = gtk_widget_add_tick_callback (dccfwin.list, dcc_flush_cb, NULL, NULL);
+}
+
+static void
+dcc_update_chat (struct DCC *dcc)
+{
+	struct dcc_row *row;
+
+	if (!dcccwin.window)
 		return;
 
-	dcc_prepare_row_send (dcc, dccfwin.store, &iter, TRUE);
+	row = g_hash_table_lookup (dcccwin.rows, dcc);
+	if (row)
+		dcc_prepare_row_chat (dcc, dcccwin.store, &row->iter, TRUE);
 }
 
 static void
 close_dcc_file_window (GtkWindow *win, gpointer data)
 {
+	if (dccfwin.tick)
+		gtk_widget_remove_tick_callback (dccfwin.list, dccfwin.tick);
+	dccfwin.tick = 0;
+	g_hash_table_destroy (dccfwin.dirty);
+	g_hash_table_destroy (dccfwin.rows);
 	dccfwin.window = NULL;
 }
 
 static void
-dcc_append (struct DCC *dcc, GtkListStore *store, gboolean prepend)
+dcc_append (struct DCC *dcc, gboolean prepend)
 {
-	GtkTreeIter iter;
+	struct dcc_row *row;
 
-	if (prepend)
-		gtk_list_store_prepend (store, &iter);
-	else
-		gtk_list_store_append (store, &iter);
+	row = g_new0 (struct dcc_row, 1);
+	row->dccstat = -1;
+	dcc_row_snapshot (dcc, row);
+	g_hash_table_insert (dccfwin.rows, dcc, row);
 
-	if (dcc->type == TYPE_RECV)
-		dcc_prepare_row_recv (dcc, store, &iter, FALSE);
-	else
-		dcc_prepare_row_send (dcc, store, &iter, FALSE);
+	gtk_list_store_insert_with_values (dccfwin.store, &row->iter, prepend ? 0 : -1,
+												  FCOL_DCC, dcc, -1);
 }
 
 /* Returns aborted and completed transfers. */
@@ -404,7 +447,7 @@ dcc_get_completed (void)
 	{
 		do
 		{
-			gtk_tree_model_get (model, &iter, COL_DCC, &dcc, -1);
+			gtk_tree_model_get (model, &iter, FCOL_DCC, &dcc, -1);
 			if (is_dcc_completed (dcc))
 				completed = g_slist_prepend (completed, dcc);
 				
@@ -443,6 +486,8 @@ dcc_fill_window (int flags)
 	int i = 0;
 
 	gtk_list_store_clear (GTK_LIST_STORE (dccfwin.store));
+	g_hash_table_remove_all (dccfwin.dirty);
+	g_hash_table_remove_all (dccfwin.rows);
 
 	if (flags & VIEW_UPLOAD)
 	{
@@ -452,7 +497,7 @@ dcc_fill_window (int flags)
 			dcc = list->data;
 			if (dcc->type == TYPE_SEND)
 			{
-				dcc_append (dcc, dccfwin.store, FALSE);
+				dcc_append (dcc, FALSE);
 				i++;
 			}
 			list = list->next;
@@ -465,9 +510,9 @@ dcc_fill_window (int flags)
 		while (list)
 		{
 			dcc = list->data;
-			if (dcc->type == TYPE_RECV)
+			if (dcc->type == TYPE_RECV && !dcc->hidden)
 			{
-				dcc_append (dcc, dccfwin.store, FALSE);
+				dcc_append (dcc, FALSE);
 				i++;
 			}
 			list = list->next;
@@ -513,7 +558,7 @@ static GSList *
 dcc_get_selected (void)
 {
 	return treeview_get_selected (GTK_TREE_MODEL (dccfwin.store),
-											dccfwin.sel, COL_DCC);
+											dccfwin.sel, FCOL_DCC);
 }
 
 static void
@@ -747,6 +792,19 @@ dcc_add_column (GtkWidget *tree, int textcol, int colorcol, char *title, gboolea
 	gtk_cell_renderer_text_set_fixed_height_from_font (GTK_CELL_RENDERER_TEXT (renderer), 1);
 }
 
+static void
+dcc_add_file_column (GtkWidget *tree, int col, char *title, gboolean right_justified)
+{
+	GtkCellRenderer *renderer;
+
+	renderer = gtk_cell_renderer_text_new ();
+	if (right_justified)
+		g_object_set (G_OBJECT (renderer), "xalign", (float) 1.0, NULL);
+	gtk_tree_view_insert_column_with_data_func (GTK_TREE_VIEW (tree), -1, title, renderer,
+															  dcc_cell_text_cb, GINT_TO_POINTER (col), NULL);
+	gtk_cell_renderer_text_set_fixed_height_from_font (GTK_CELL_RENDERER_TEXT (renderer), 1);
+}
+
 static GtkWidget *
 dcc_detail_label (char *text, GtkWidget *box, int num)
 {
@@ -821,29 +879,29 @@ fe_dcc_open_recv_win (int passive)
 	gtk_container_set_border_width (GTK_CONTAINER (dccfwin.window), 3);
 	gtk_box_set_spacing (GTK_BOX (vbox), 3);
 
-	store = gtk_list_store_new (N_COLUMNS, GDK_TYPE_PIXBUF, G_TYPE_STRING,
-										 G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING,
-										 G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING,
-										 G_TYPE_STRING, G_TYPE_POINTER, GDK_TYPE_RGBA);
+	store = gtk_list_store_new (1, G_TYPE_POINTER);
 	view = gtkutil_treeview_new (vbox, GTK_TREE_MODEL (store), NULL, -1);
 	/* Up/Down Icon column */
-	gtk_tree_view_insert_column_with_attributes (GTK_TREE_VIEW (view), -1, NULL,
-																gtk_cell_renderer_pixbuf_new (),
-																"pixbuf", COL_TYPE, NULL);
-	dcc_add_column (view, COL_STATUS, COL_COLOR, _("Status"), FALSE);
-	dcc_add_column (view, COL_FILE,   COL_COLOR, _("File"), FALSE);
-	dcc_add_column (view, COL_SIZE,   COL_COLOR, _("Size"), TRUE);
-	dcc_add_column (view, COL_POS,    COL_COLOR, _("Position"), TRUE);
-	dcc_add_column (view, COL_PERC,   COL_COLOR, "%", TRUE);
-	dcc_add_column (view, COL_SPEED,  COL_COLOR, "KB/s", TRUE);
-	dcc_add_column (view, COL_ETA,    COL_COLOR, _("ETA"), FALSE);
-	dcc_add_column (view, COL_NICK,   COL_COLOR, _("Nick"), FALSE);
+	gtk_tree_view_insert_column_with_data_func (GTK_TREE_VIEW (view), -1, NULL,
+															  gtk_cell_renderer_pixbuf_new (),
+															  dcc_cell_icon_cb, NULL, NULL);
+	dcc_add_file_column (view, COL_STATUS, _("Status"), FALSE);
+	dcc_add_file_column (view, COL_FILE,   _("File"), FALSE);
+	dcc_add_file_column (view, COL_SIZE,   _("Size"), TRUE);
+	dcc_add_file_column (view, COL_POS,    _("Position"), TRUE);
+	dcc_add_file_column (view, COL_PERC,   "%", TRUE);
+	dcc_add_file_column (view, COL_SPEED,  "KB/s", TRUE);
+	dcc_add_file_column (view, COL_ETA,    _("ETA"), FALSE);
+	dcc_add_file_column (view, COL_NICK,   _("Nick"), FALSE);
 
 	gtk_tree_view_column_set_expand (gtk_tree_view_get_column (GTK_TREE_VIEW (view), COL_FILE), TRUE);
 	gtk_tree_view_column_set_expand (gtk_tree_view_get_column (GTK_TREE_VIEW (view), COL_NICK), TRUE);
 
 	dccfwin.list = view;
 	dccfwin.store = store;
+	dccfwin.rows = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+													  NULL, (GDestroyNotify) dcc_row_free);
+	dccfwin.dirty = g_hash_table_new (g_direct_hash, g_direct_equal);
 	dccfwin.sel = gtk_tree_view_get_selection (GTK_TREE_VIEW (view));
 	view_mode = VIEW_BOTH;
 	gtk_tree_selection_set_mode (dccfwin.sel, GTK_SELECTION_MULTIPLE);
@@ -966,20 +1024,24 @@ abort_chat_clicked (GtkWidget * wid, gpointer none)
 static void
 dcc_chat_close_cb (void)
 {
+	g_hash_table_destroy (dcccwin.rows);
 	dcccwin.window = NULL;
 }
 
 static void
 dcc_chat_append (struct DCC *dcc, GtkListStore *store, gboolean prepend)
 {
-	GtkTreeIter iter;
+	struct dcc_row *row;
+
+	row = g_new0 (struct dcc_row, 1);
+	g_hash_table_insert (dcccwin.rows, dcc, row);
 
 	if (prepend)
-		gtk_list_store_prepend (store, &iter);
+		gtk_list_store_prepend (store, &row->iter);
 	else
-		gtk_list_store_append (store, &iter);
+		gtk_list_store_append (store, &row->iter);
 
-	dcc_prepare_row_chat (dcc, store, &iter, FALSE);
+	dcc_prepare_row_chat (dcc, store, &row->iter, FALSE);
 }
 
 static void
@@ -991,6 +1053,7 @@ dcc_chat_fill_win (void)
 	int i = 0;
 
 	gtk_list_store_clear (GTK_LIST_STORE (dcccwin.store));
+	g_hash_table_remove_all (dcccwin.rows);
 
 	list = dcc_list;
 	while (list)
@@ -1087,6 +1150,8 @@ fe_dcc_open_chat_win (int passive)
 
 	dcccwin.list = view;
 	dcccwin.store = store;
+	dcccwin.rows = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+													  NULL, (GDestroyNotify) dcc_row_free);
 	dcccwin.sel = gtk_tree_view_get_selection (GTK_TREE_VIEW (view));
 	gtk_tree_selection_set_mode (dcccwin.sel, GTK_SELECTION_MULTIPLE);
 
@@ -1117,13 +1182,13 @@ fe_dcc_add (struct DCC *dcc)
 	switch (dcc->type)
 	{
 	case TYPE_RECV:
-		if (dccfwin.window && (view_mode & VIEW_DOWNLOAD))
-			dcc_append (dcc, dccfwin.store, TRUE);
+		if (dccfwin.window && (view_mode & VIEW_DOWNLOAD) && !dcc->hidden)
+			dcc_append (dcc, TRUE);
 		break;
 
 	case TYPE_SEND:
 		if (dccfwin.window && (view_mode & VIEW_UPLOAD))
-			dcc_append (dcc, dccfwin.store, TRUE);
+			dcc_append (dcc, TRUE);
 		break;
 
 	default: /* chat */
@@ -1138,42 +1203,37 @@ fe_dcc_update (struct DCC *dcc)
 	switch (dcc->type)
 	{
 	case TYPE_SEND:
-		dcc_update_send (dcc);
-		break;
-
 	case TYPE_RECV:
-		dcc_update_recv (dcc);
+		dcc_update_file (dcc);
 		break;
 
 	default:
 		dcc_update_chat (dcc);
 	}
-
-	if (dccfwin.window)
-		update_clear_button_sensitivity();
 }
 
 void
 fe_dcc_remove (struct DCC *dcc)
 {
-	GtkTreeIter iter;
+	struct dcc_row *row;
 
 	switch (dcc->type)
 	{
 	case TYPE_SEND:
 	case TYPE_RECV:
-		if (dccfwin.window)
+		if (dccfwin.window && (row = g_hash_table_lookup (dccfwin.rows, dcc)))
 		{
-			if (dcc_find_row (dcc, GTK_TREE_MODEL (dccfwin.store), &iter, COL_DCC))
-				gtk_list_store_remove (dccfwin.store, &iter);
+			gtk_list_store_remove (dccfwin.store, &row->iter);
+			g_hash_table_remove (dccfwin.dirty, dcc);
+			g_hash_table_remove (dccfwin.rows, dcc);
 		}
 		break;
 
 	default:	/* chat */
-		if (dcccwin.window)
+		if (dcccwin.window && (row = g_hash_table_lookup (dcccwin.rows, dcc)))
 		{
-			if (dcc_find_row (dcc, GTK_TREE_MODEL (dcccwin.store), &iter, CCOL_DCC))
-				gtk_list_store_remove (dcccwin.store, &iter);
+			gtk_list_store_remove (dcccwin.store, &row->iter);
+			g_hash_table_remove (dcccwin.rows, dcc);
 		}
 		break;
 	}
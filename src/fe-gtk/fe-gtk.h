@@ -51,6 +51,18 @@
 extern GtkosxApplication *osx_app;
 #endif
 
+/* what the channel list is filtered by */
+struct chanlist_filter
+{
+	char *text;
+	char *folded;					/* text in ascii lowercase */
+	int type;						/* 0=simple 1=pattern/wildcard 2=regexp */
+	gboolean channel;				/* match in channel name */
+	gboolean topic;				/* match in topic */
+	guint32 minusers;
+	guint32 maxusers;
+};
+
 struct server_gui
 {
 	GtkWidget *rawlog_window;
@@ -74,8 +86,20 @@ struct server_gui
 	GtkWidget *chanlist_savelist;
 	GtkWidget *chanlist_search;
 
-	GSList *chanlist_data_stored_rows;	/* stored list so it can be resorted  */
+	GPtrArray *chanlist_rows;		/* every row LIST gave us */
+	GPtrArray *chanlist_matches;	/* the ones chanlist_filter lets through */
+	struct chanlist_filter chanlist_filter;
+	GStringChunk *chanlist_strings;	/* the rows' strings */
+	GSList *chanlist_blocks;		/* and the rows themselves */
+	guint chanlist_block_used;
 	GSList *chanlist_pending_rows;
+
+	/* a filter being applied a chunk at a time, from chanlist_filter_tag */
+	GPtrArray *chanlist_filter_source;
+	GPtrArray *chanlist_filter_results;
+	struct chanlist_filter chanlist_next_filter;
+	guint chanlist_filter_pos;
+	guint chanlist_filter_tag;
 	gint chanlist_tag;
 	gint chanlist_flash_tag;
 
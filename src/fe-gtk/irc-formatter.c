@@ -13,6 +13,7 @@
 #include <gtk/gtk.h>
 
 #include "../common/hexchat.h"
+#include "../common/url.h"
 #include "irc-formatter.h"
 #include "url-handler.h"
 #include "gtk-xtext-view.h"
@@ -120,6 +121,48 @@ irc_text_segment_free (IrcTextSegment *segment)
     }
 }
 
+/* Scan the visible text once for URLs, so they are found even when they
+   span several formatting segments. Spans are converted from bytes to
+   characters since that is what GtkTextIter counts in. */
+static GArray *
+irc_formatter_find_urls (GSList *segments)
+{
+    GString *visible = g_string_new(NULL);
+    GArray *spans;
+    GSList *iter;
+    const gchar *p;
+    glong chars = 0;
+    gint bytes = 0;
+    guint i;
+    
+    for (iter = segments; iter; iter = iter->next) {
+        IrcTextSegment *segment = (IrcTextSegment *)iter->data;
+        if (segment->length > 0 && segment->text && !segment->format.hidden)
+            g_string_append_len(visible, segment->text, segment->length);
+    }
+    
+    spans = url_scan(visible->str, visible->len, URL_SCAN_ALL);
+    if (spans) {
+        /* spans are in order, so walk the string only once */
+        p = visible->str;
+        for (i = 0; i < spans->len; i++) {
+            url_span *span = &g_array_index(spans, url_span, i);
+            
+            chars += g_utf8_pointer_to_offset(p, visible->str + span->start);
+            p = visible->str + span->start;
+            bytes = span->end - span->start;
+            span->start = chars;
+            
+            chars += g_utf8_pointer_to_offset(p, p + bytes);
+            p += bytes;
+            span->end = chars;
+        }
+    }
+    
+    g_string_free(visible, TRUE);
+    return spans;
+}
+
 /* Parse IRC formatted text into segments */
 IrcFormattedText *
 irc_formatter_parse (const unsigned char *text, int len, time_t stamp)
@@ -260,6 +303,8 @@ irc_formatter_parse (const unsigned char *text, int len, time_t stamp)
         result->segments = g_slist_append(result->segments, segment);
     }
     
+    result->urls = irc_formatter_find_urls(result->segments);
+    
     return result;
 }
 
@@ -275,6 +320,8 @@ irc_formatter_free (IrcFormattedText *formatted)
         iter = iter->next;
     }
     g_slist_free(formatted->segments);
+    if (formatted->urls)
+        g_array_free(formatted->urls, TRUE);
     g_free(formatted);
 }
 
@@ -312,6 +359,8 @@ irc_formatter_apply_to_buffer (GtkXTextView *xtext_view,
         }
     }
     
+    /* Remember where the text starts for the URL spans */
+    GtkTextMark *line_mark = gtk_text_buffer_create_mark(buffer, NULL, iter, TRUE);
     GSList *segment_iter = formatted->segments;
     
     while (segment_iter) {
@@ -327,9 +376,6 @@ irc_formatter_apply_to_buffer (GtkXTextView *xtext_view,
             gtk_text_buffer_get_iter_at_mark(buffer, &start_iter, start_mark);
             end_iter = *iter;
             
-            /* Apply URL tags first (they can overlap with other formatting) */
-            url_handler_apply_tags(xtext_view, buffer, segment->text, &start_iter, &end_iter);
-            
             /* Build list of tags to apply */
             GSList *tags_to_apply = NULL;
             
@@ -386,4 +432,12 @@ irc_formatter_apply_to_buffer (GtkXTextView *xtext_view,
         
         segment_iter = segment_iter->next;
     }
+    
+    /* URL tags can overlap with any other formatting */
+    if (formatted->urls) {
+        GtkTextIter line_start;
+        gtk_text_buffer_get_iter_at_mark(buffer, &line_start, line_mark);
+        url_handler_apply_tags(xtext_view, buffer, formatted->urls, &line_start);
+    }
+    gtk_text_buffer_delete_mark(buffer, line_mark);
 }
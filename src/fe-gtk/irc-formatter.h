@@ -39,6 +39,7 @@ typedef struct {
 typedef struct {
     GSList *segments;  /* List of IrcTextSegment */
     time_t timestamp;
+    GArray *urls;      /* url_span, in characters from the first visible segment */
 } IrcFormattedText;
 
 /* Public API */
@@ -383,6 +383,7 @@ void
 fe_set_title (session *sess)
 {
 	char tbuf[512];
+	const char *modes = NULL;
 	int type;
 
 	if (sess->gui->is_tab && sess != current_tab)
@@ -408,14 +409,16 @@ fe_set_title (session *sess)
 		break;
 	case SESS_CHANNEL:
 		/* don't display keys in the titlebar */
-			g_snprintf (tbuf, sizeof (tbuf),
+		if (prefs.hex_gui_win_modes)
+			modes = chanmodes_string (sess);
+		g_snprintf (tbuf, sizeof (tbuf),
 					 "%s%s%s / %s%s%s%s - %s",
 					 prefs.hex_gui_win_nick ? sess->server->nick : "",
 					 prefs.hex_gui_win_nick ? " @ " : "",
 					 server_get_network (sess->server, TRUE), sess->channel,
-					 prefs.hex_gui_win_modes && sess->current_modes ? " (" : "",
-					 prefs.hex_gui_win_modes && sess->current_modes ? sess->current_modes : "",
-					 prefs.hex_gui_win_modes && sess->current_modes ? ")" : "",
+					 modes ? " (" : "",
+					 modes ? modes : "",
+					 modes ? ")" : "",
 					 _(DISPLAY_NAME));
 		if (prefs.hex_gui_win_ucount)
 		{
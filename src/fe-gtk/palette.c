@@ -165,25 +165,27 @@ palette_load (void)
 	int i, j, fh;
 	char prefname[256];
 	struct stat st;
-	char *cfg;
+	cfg_index *cfg;
+	char *data;
 	guint16 red, green, blue;
 
 	fh = hexchat_open_file ("colors.conf", O_RDONLY, 0, 0);
 	if (fh != -1)
 	{
 		fstat (fh, &st);
-		cfg = g_malloc0 (st.st_size + 1);
-		read (fh, cfg, st.st_size);
+		data = g_malloc0 (st.st_size + 1);
+		read (fh, data, st.st_size);
+		cfg = cfg_index_new (data);
 
 		/* old theme format writes colors [0, THEME_MAX_MIRC_COLORS) and [256, ...) */
 		g_snprintf (prefname, sizeof prefname, "color_%d", THEME_MAX_MIRC_COLS);
-		if (!cfg_get_color (cfg, prefname, &red, &green, &blue))
+		if (!cfg_index_get_color (cfg, prefname, &red, &green, &blue))
 		{
 			/* old theme detected, migrate low local colors [0, 32) */
 			for (i = 0; i < THEME_MAX_MIRC_COLS; i++)
 			{
 				g_snprintf (prefname, sizeof prefname, "color_%d", i);
-				if (cfg_get_color (cfg, prefname, &red, &green, &blue))
+				if (cfg_index_get_color (cfg, prefname, &red, &green, &blue))
 				{
 					colors[i].red = red / 65535.0;
 					colors[i].green = green / 65535.0;
@@ -195,7 +197,7 @@ palette_load (void)
 			for (i = 256, j = COL_START_SYS; j < MAX_COL+1; i++, j++)
 			{
 				g_snprintf (prefname, sizeof prefname, "color_%d", i);
-				if (cfg_get_color (cfg, prefname, &red, &green, &blue))
+				if (cfg_index_get_color (cfg, prefname, &red, &green, &blue))
 				{
 					colors[j].red = red / 65535.0;
 					colors[j].green = green / 65535.0;
@@ -210,7 +212,7 @@ palette_load (void)
 			for (i = 0; i < MIRC_COLS; i++)
 			{
 				g_snprintf (prefname, sizeof prefname, "color_%d", i);
-				if (cfg_get_color (cfg, prefname, &red, &green, &blue))
+				if (cfg_index_get_color (cfg, prefname, &red, &green, &blue))
 				{
 					colors[i].red = red / 65535.0;
 					colors[i].green = green / 65535.0;
@@ -222,7 +224,7 @@ palette_load (void)
 			for (i = 256, j = COL_START_SYS; j < MAX_COL+1; i++, j++)
 			{
 				g_snprintf (prefname, sizeof prefname, "color_%d", i);
-				if (cfg_get_color (cfg, prefname, &red, &green, &blue))
+				if (cfg_index_get_color (cfg, prefname, &red, &green, &blue))
 				{
 					colors[j].red = red / 65535.0;
 					colors[j].green = green / 65535.0;
@@ -231,7 +233,7 @@ palette_load (void)
 				}
 			}
 		}
-		g_free (cfg);
+		cfg_index_free (cfg);
 		close (fh);
 	}
 }
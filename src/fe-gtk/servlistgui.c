@@ -29,6 +29,7 @@
 #include "../common/cfgfiles.h"
 #include "../common/fe.h"
 #include "../common/util.h"
+#include "../common/text.h"
 
 #include "fe-gtk.h"
 #include "gtkutil.h"
@@ -1217,6 +1218,7 @@ servlist_celledit_cb (GtkCellRendererText *cell, gchar *arg1, gchar *arg2,
 		net->name = g_strdup (arg2);
 		gtk_list_store_set (GTK_LIST_STORE (model), &iter, 0, net->name, -1);
 		g_free (netname);
+		log_update_server (NULL);
 	}
 
 	gtk_tree_path_free (path);
@@ -356,6 +356,12 @@ static const setting filexfer_settings[] =
 	{ST_EFOLDER,N_("Download files to:"), P_OFFSETNL(hex_dcc_dir), 0, 0, sizeof prefs.hex_dcc_dir},
 	{ST_EFOLDER,N_("Move completed files to:"), P_OFFSETNL(hex_dcc_completed_dir), 0, 0, sizeof prefs.hex_dcc_completed_dir},
 	{ST_TOGGLE, N_("Save nick name in filenames"), P_OFFINTNL(hex_dcc_save_nick), 0, 0, 0},
+	{ST_TOGGLE, N_("Show SHA-256 checksums of files"), P_OFFINTNL(hex_dcc_checksum),
+					N_("Of downloads once they complete and of files when they are offered"), 0, 0},
+	{ST_TOGGLE, N_("Download from several senders at once"), P_OFFINTNL(hex_dcc_multi_source),
+					N_("When someone else offers a file that is already being downloaded, fetch part of it from them"), 0, 0},
+	{ST_NUMBER,	N_("Simultaneous uploads:"), P_OFFINTNL(hex_dcc_max_sends),
+					N_("Further files are offered once an upload is done, 0 means no limit"), 0, 1000},
 
 	{ST_HEADER,	N_("Auto Open DCC Windows"),0,0,0},
 	{ST_TOGGLE, N_("Send window"), P_OFFINTNL(hex_gui_autoopen_send), 0, 0, 0},
@@ -367,6 +373,14 @@ static const setting filexfer_settings[] =
 					N_("Maximum speed for one transfer"), 0, 10000000},
 	{ST_NUMBER,	N_("One download:"), P_OFFINTNL(hex_dcc_max_get_cps),
 					N_("Maximum speed for one transfer"), 0, 10000000},
+	{ST_NUMBER,	N_("Uploads to one nick:"), P_OFFINTNL(hex_dcc_peer_max_send_cps),
+					N_("Maximum speed for all files sent to one nick"), 0, 10000000},
+	{ST_NUMBER,	N_("Downloads from one nick:"), P_OFFINTNL(hex_dcc_peer_max_get_cps),
+					N_("Maximum speed for all files received from one nick"), 0, 10000000},
+	{ST_NUMBER,	N_("Uploads on one network:"), P_OFFINTNL(hex_dcc_network_max_send_cps),
+					N_("Maximum speed for all files sent on one network"), 0, 10000000},
+	{ST_NUMBER,	N_("Downloads on one network:"), P_OFFINTNL(hex_dcc_network_max_get_cps),
+					N_("Maximum speed for all files received on one network"), 0, 10000000},
 	{ST_NUMBER,	N_("All uploads combined:"), P_OFFINTNL(hex_dcc_global_max_send_cps),
 					N_("Maximum speed for all files"), 0, 10000000},
 	{ST_NUMBER,	N_("All downloads combined:"), P_OFFINTNL(hex_dcc_global_max_get_cps),
@@ -591,6 +605,7 @@ static const setting logging_settings[] =
 	{ST_TOGGLE,	N_("Enable logging of conversations to disk"), P_OFFINTNL(hex_irc_logging), 0, 0, 0},
 	{ST_ENTRY,	N_("Log filename:"), P_OFFSETNL(hex_irc_logmask), 0, 0, sizeof prefs.hex_irc_logmask},
 	{ST_LABEL,	N_("%s=Server %c=Channel %n=Network.")},
+	{ST_TOGGLE,	N_("Compress logs of past days with gzip"), P_OFFINTNL(hex_irc_logging_compress), 0, 0, 0},
 
 	{ST_HEADER,	N_("Timestamps"),0,0,0},
 	{ST_TOGGLE,	N_("Insert timestamps in logs"), P_OFFINTNL(hex_stamp_log), 0, 0, 1},
@@ -90,10 +90,39 @@ struct _SexySpellEntryPriv
 	gchar               **words;
 	gint                 *word_starts;
 	gint                 *word_ends;
+	gint                  n_words;
+	gint                  text_len;
+	gboolean             *misspelled;	/* per word, NULL if not checked */
+	GHashTable           *word_caches;	/* dict -> struct word_cache */
+	GMutex                dict_lock;	/* enchant calls, dict_list */
 	gboolean              checked;
 	gboolean              parseattr;
 };
 
+/* Words recently looked up in one dictionary, most recent first */
+#define WORD_CACHE_SIZE 4096
+
+struct word_cache
+{
+	GHashTable *words;	/* word -> link in lru */
+	GQueue lru;			/* of struct cached_word */
+};
+
+struct cached_word
+{
+	gchar *word;
+	gboolean correct;
+};
+
+/* A suggestion lookup running on a worker thread */
+struct suggest_job
+{
+	GtkWidget *placeholder;	/* NULL once the menu is gone */
+	struct EnchantDict *dict;
+	gchar *word;
+	gchar **suggestions;
+};
+
 static void sexy_spell_entry_class_init(SexySpellEntryClass *klass);
 static void sexy_spell_entry_editable_init (GtkEditableClass *iface);
 static void sexy_spell_entry_init(SexySpellEntry *entry);
@@ -125,6 +154,8 @@ static void       entry_strsplit_utf8                         (GtkEntry
                                                                gchar              ***set,
                                                                gint                **starts,
                                                                gint                **ends);
+static void       sexy_spell_entry_update_words               (SexySpellEntry       *entry,
+                                                               gboolean              incremental);
 
 static GtkEntryClass *parent_class = NULL;
 
@@ -444,6 +475,85 @@ insert_reset (SexySpellEntry *entry, guint start)
 	insert_color (entry, start, -1, -1);
 }
 
+static void
+word_cache_free(struct word_cache *cache)
+{
+	struct cached_word *cached;
+
+	while ((cached = g_queue_pop_head(&cache->lru))) {
+		g_free(cached->word);
+		g_free(cached);
+	}
+	g_hash_table_destroy(cache->words);
+	g_free(cache);
+}
+
+static struct word_cache *
+word_cache_get(SexySpellEntry *entry, struct EnchantDict *dict)
+{
+	struct word_cache *cache;
+
+	cache = g_hash_table_lookup(entry->priv->word_caches, dict);
+	if (cache == NULL) {
+		cache = g_new0(struct word_cache, 1);
+		cache->words = g_hash_table_new(g_str_hash, g_str_equal);
+		g_queue_init(&cache->lru);
+		g_hash_table_insert(entry->priv->word_caches, dict, cache);
+	}
+	return cache;
+}
+
+/* Returns 1 if the word is correct, 0 if not and -1 if it isn't cached */
+static int
+word_cache_lookup(struct word_cache *cache, const gchar *word)
+{
+	GList *link;
+
+	link = g_hash_table_lookup(cache->words, word);
+	if (link == NULL)
+		return -1;
+
+	g_queue_unlink(&cache->lru, link);
+	g_queue_push_head_link(&cache->lru, link);
+	return ((struct cached_word *) link->data)->correct;
+}
+
+static void
+word_cache_store(struct word_cache *cache, const gchar *word, gboolean correct)
+{
+	struct cached_word *cached;
+
+	if (g_queue_get_length(&cache->lru) >= WORD_CACHE_SIZE) {
+		cached = g_queue_pop_tail(&cache->lru);
+		g_hash_table_remove(cache->words, cached->word);
+		g_free(cached->word);
+		g_free(cached);
+	}
+
+	cached = g_new(struct cached_word, 1);
+	cached->word = g_strdup(word);
+	cached->correct = correct;
+	g_queue_push_head(&cache->lru, cached);
+	g_hash_table_insert(cache->words, cached->word, cache->lru.head);
+}
+
+static void
+word_cache_forget(struct word_cache *cache, const gchar *word)
+{
+	struct cached_word *cached;
+	GList *link;
+
+	link = g_hash_table_lookup(cache->words, word);
+	if (link == NULL)
+		return;
+
+	cached = link->data;
+	g_hash_table_remove(cache->words, word);
+	g_queue_delete_link(&cache->lru, link);
+	g_free(cached->word);
+	g_free(cached);
+}
+
 static void
 get_word_extents_from_position(SexySpellEntry *entry, gint *start, gint *end, guint position)
 {
@@ -483,18 +593,16 @@ add_to_dictionary(GtkWidget *menuitem, SexySpellEntry *entry)
 	word = gtk_editable_get_chars(GTK_EDITABLE(entry), start, end);
 
 	dict = (struct EnchantDict *) g_object_get_data(G_OBJECT(menuitem), "enchant-dict");
-	if (dict)
+	if (dict) {
+		g_mutex_lock(&entry->priv->dict_lock);
 		enchant_dict_add_to_personal(dict, word, -1);
+		g_mutex_unlock(&entry->priv->dict_lock);
+		word_cache_forget(word_cache_get(entry, dict), word);
+	}
 
 	g_free(word);
 
-	if (entry->priv->words) {
-		g_strfreev(entry->priv->words);
-		g_free(entry->priv->word_starts);
-		g_free(entry->priv->word_ends);
-	}
-	entry_strsplit_utf8(GTK_ENTRY(entry), &entry->priv->words, &entry->priv->word_starts, &entry->priv->word_ends);
-	sexy_spell_entry_recheck_all (entry);
+	sexy_spell_entry_update_words(entry, FALSE);
 }
 
 static void
@@ -510,20 +618,17 @@ ignore_all(GtkWidget *menuitem, SexySpellEntry *entry)
 	get_word_extents_from_position(entry, &start, &end, entry->priv->mark_character);
 	word = gtk_editable_get_chars(GTK_EDITABLE(entry), start, end);
 
+	g_mutex_lock(&entry->priv->dict_lock);
 	for (li = entry->priv->dict_list; li; li = g_slist_next (li)) {
 		struct EnchantDict *dict = (struct EnchantDict *) li->data;
 		enchant_dict_add_to_session(dict, word, -1);
+		word_cache_forget(word_cache_get(entry, dict), word);
 	}
+	g_mutex_unlock(&entry->priv->dict_lock);
 
 	g_free(word);
 
-	if (entry->priv->words) {
-		g_strfreev(entry->priv->words);
-		g_free(entry->priv->word_starts);
-		g_free(entry->priv->word_ends);
-	}
-	entry_strsplit_utf8(GTK_ENTRY(entry), &entry->priv->words, &entry->priv->word_starts, &entry->priv->word_ends);
-	sexy_spell_entry_recheck_all(entry);
+	sexy_spell_entry_update_words(entry, FALSE);
 }
 
 static void
@@ -557,27 +662,71 @@ replace_word(GtkWidget *menuitem, SexySpellEntry *entry)
 
 	dict = (struct EnchantDict *) g_object_get_data(G_OBJECT(menuitem), "enchant-dict");
 
-        if (dict)
+	if (dict) {
+		g_mutex_lock(&entry->priv->dict_lock);
 		enchant_dict_store_replacement(dict,
 					       oldword, -1,
 					       newword, -1);
+		g_mutex_unlock(&entry->priv->dict_lock);
+	}
 
 	g_free(oldword);
 }
 
 static void
-build_suggestion_menu(SexySpellEntry *entry, GtkWidget *menu, struct EnchantDict *dict, const gchar *word)
+suggest_job_free(struct suggest_job *job)
+{
+	if (job->placeholder)
+		g_object_remove_weak_pointer(G_OBJECT(job->placeholder), (gpointer *) &job->placeholder);
+	g_free(job->word);
+	g_strfreev(job->suggestions);
+	g_free(job);
+}
+
+/* Runs on a worker thread, enchant can take a while to come up with
+ * suggestions and the menu is already showing */
+static void
+suggest_thread(GTask *task, gpointer source, gpointer data, GCancellable *cancellable)
 {
-	GtkWidget *mi;
+	SexySpellEntry *entry = SEXY_SPELL_ENTRY(source);
+	struct suggest_job *job = data;
 	gchar **suggestions;
-	size_t n_suggestions, i;
+	size_t n_suggestions = 0, i;
+
+	g_mutex_lock(&entry->priv->dict_lock);
+	/* the language may have been turned off meanwhile */
+	if (g_slist_find(entry->priv->dict_list, job->dict)) {
+		suggestions = enchant_dict_suggest(job->dict, job->word, -1, &n_suggestions);
+		if (suggestions) {
+			job->suggestions = g_new0(gchar *, n_suggestions + 1);
+			for (i = 0; i < n_suggestions; i++)
+				job->suggestions[i] = g_strdup(suggestions[i]);
+			enchant_dict_free_suggestions(job->dict, suggestions);
+		}
+	}
+	g_mutex_unlock(&entry->priv->dict_lock);
 
-	if (!have_enchant)
+	g_task_return_boolean(task, TRUE);
+}
+
+static void
+suggest_done(GObject *source, GAsyncResult *result, gpointer data)
+{
+	SexySpellEntry *entry = SEXY_SPELL_ENTRY(source);
+	struct suggest_job *job = g_task_get_task_data(G_TASK(result));
+	GtkWidget *menu, *mi;
+	GList *children;
+	gint pos, i;
+
+	if (job->placeholder == NULL)
 		return;
 
-	suggestions = enchant_dict_suggest(dict, word, -1, &n_suggestions);
+	menu = gtk_widget_get_parent(job->placeholder);
+	children = gtk_container_get_children(GTK_CONTAINER(menu));
+	pos = g_list_index(children, job->placeholder);
+	g_list_free(children);
 
-	if (suggestions == NULL || n_suggestions == 0) {
+	if (job->suggestions == NULL || job->suggestions[0] == NULL) {
 		/* no suggestions.  put something in the menu anyway... */
 		GtkWidget *label = gtk_label_new("");
 		gtk_label_set_markup(GTK_LABEL(label), _("<i>(no suggestions)</i>"));
@@ -585,32 +734,63 @@ build_suggestion_menu(SexySpellEntry *entry, GtkWidget *menu, struct EnchantDict
 		mi = gtk_separator_menu_item_new();
 		gtk_container_add(GTK_CONTAINER(mi), label);
 		gtk_widget_show_all(mi);
-		gtk_menu_shell_prepend(GTK_MENU_SHELL(menu), mi);
+		gtk_menu_shell_insert(GTK_MENU_SHELL(menu), mi, pos);
 	} else {
 		/* build a set of menus with suggestions */
-		for (i = 0; i < n_suggestions; i++) {
+		for (i = 0; job->suggestions[i]; i++) {
 			if ((i != 0) && (i % 10 == 0)) {
 				mi = gtk_separator_menu_item_new();
 				gtk_widget_show(mi);
-				gtk_menu_shell_append(GTK_MENU_SHELL(menu), mi);
+				gtk_menu_shell_insert(GTK_MENU_SHELL(menu), mi, pos++);
 
 				mi = gtk_menu_item_new_with_label(_("More..."));
 				gtk_widget_show(mi);
-				gtk_menu_shell_append(GTK_MENU_SHELL(menu), mi);
+				gtk_menu_shell_insert(GTK_MENU_SHELL(menu), mi, pos++);
 
 				menu = gtk_menu_new();
 				gtk_menu_item_set_submenu(GTK_MENU_ITEM(mi), menu);
+				pos = 0;
 			}
 
-			mi = gtk_menu_item_new_with_label(suggestions[i]);
-			g_object_set_data(G_OBJECT(mi), "enchant-dict", dict);
+			mi = gtk_menu_item_new_with_label(job->suggestions[i]);
+			g_object_set_data(G_OBJECT(mi), "enchant-dict", job->dict);
 			g_signal_connect(G_OBJECT(mi), "activate", G_CALLBACK(replace_word), entry);
 			gtk_widget_show(mi);
-			gtk_menu_shell_append(GTK_MENU_SHELL(menu), mi);
+			gtk_menu_shell_insert(GTK_MENU_SHELL(menu), mi, pos++);
 		}
 	}
 
-	enchant_dict_free_suggestions(dict, suggestions);
+	gtk_widget_destroy(job->placeholder);
+}
+
+static void
+build_suggestion_menu(SexySpellEntry *entry, GtkWidget *menu, struct EnchantDict *dict, const gchar *word)
+{
+	struct suggest_job *job;
+	GtkWidget *label;
+	GTask *task;
+
+	if (!have_enchant)
+		return;
+
+	/* stands in for the suggestions until they are looked up */
+	label = gtk_label_new("");
+	gtk_label_set_markup(GTK_LABEL(label), _("<i>(looking up suggestions)</i>"));
+
+	job = g_new0(struct suggest_job, 1);
+	job->placeholder = gtk_separator_menu_item_new();
+	gtk_container_add(GTK_CONTAINER(job->placeholder), label);
+	gtk_widget_show_all(job->placeholder);
+	gtk_menu_shell_append(GTK_MENU_SHELL(menu), job->placeholder);
+	g_object_add_weak_pointer(G_OBJECT(job->placeholder), (gpointer *) &job->placeholder);
+
+	job->dict = dict;
+	job->word = g_strdup(word);
+
+	task = g_task_new(entry, NULL, suggest_done, NULL);
+	g_task_set_task_data(task, job, (GDestroyNotify) suggest_job_free);
+	g_task_run_in_thread(task, suggest_thread);
+	g_object_unref(task);
 }
 
 static GtkWidget *
@@ -792,6 +972,9 @@ sexy_spell_entry_init(SexySpellEntry *entry)
 	entry->priv = g_new0(SexySpellEntryPriv, 1);
 
 	entry->priv->dict_hash = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	entry->priv->word_caches = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
+	                                                 (GDestroyNotify) word_cache_free);
+	g_mutex_init(&entry->priv->dict_lock);
 
 	if (have_enchant)
 	{
@@ -827,9 +1010,11 @@ sexy_spell_entry_finalize(GObject *obj)
 		pango_attr_list_unref(entry->priv->attr_list);
 	if (entry->priv->dict_hash)
 		g_hash_table_destroy(entry->priv->dict_hash);
+	g_hash_table_destroy(entry->priv->word_caches);
 	g_strfreev(entry->priv->words);
 	g_free(entry->priv->word_starts);
 	g_free(entry->priv->word_ends);
+	g_free(entry->priv->misspelled);
 
 	if (have_enchant) {
 		if (entry->priv->broker) {
@@ -844,6 +1029,7 @@ sexy_spell_entry_finalize(GObject *obj)
 		}
 	}
 
+	g_mutex_clear(&entry->priv->dict_lock);
 	g_free(entry->priv);
 #ifdef HAVE_ISO_CODES
 	codetable_ref--;
@@ -899,7 +1085,18 @@ default_word_check(SexySpellEntry *entry, const gchar *word)
 	}
 	for (li = entry->priv->dict_list; li; li = g_slist_next (li)) {
 		struct EnchantDict *dict = (struct EnchantDict *) li->data;
-		if (enchant_dict_check(dict, word, strlen(word)) == 0) {
+		struct word_cache *cache = word_cache_get(entry, dict);
+		int correct;
+
+		correct = word_cache_lookup(cache, word);
+		if (correct == -1) {
+			g_mutex_lock(&entry->priv->dict_lock);
+			correct = enchant_dict_check(dict, word, strlen(word)) == 0;
+			g_mutex_unlock(&entry->priv->dict_lock);
+			word_cache_store(cache, word, correct);
+		}
+
+		if (correct) {
 			result = FALSE;
 			break;
 		}
@@ -927,31 +1124,6 @@ word_misspelled(SexySpellEntry *entry, int start, int end)
 	return ret;
 }
 
-static void
-check_word(SexySpellEntry *entry, int start, int end)
-{
-	PangoAttrIterator *it;
-
-	/* Check to see if we've got any attributes at this position.
-	 * If so, free them, since we'll readd it if the word is misspelled */
-	it = pango_attr_list_get_iterator(entry->priv->attr_list);
-	if (it == NULL)
-		return;
-	do {
-		gint s, e;
-		pango_attr_iterator_range(it, &s, &e);
-		if (s == start) {
-			GSList *attrs = pango_attr_iterator_get_attrs(it);
-			g_slist_foreach(attrs, (GFunc) pango_attribute_destroy, NULL);
-			g_slist_free(attrs);
-		}
-	} while (pango_attr_iterator_next(it));
-	pango_attr_iterator_destroy(it);
-
-	if (word_misspelled(entry, start, end))
-		insert_underline_error(entry, start, end);
-}
-
 static void
 check_attributes (SexySpellEntry *entry, const char *text, int len)
 {
@@ -1101,7 +1273,7 @@ sexy_spell_entry_recheck_all(SexySpellEntry *entry)
 	GtkAllocation allocation;
 	GtkWidget *widget = GTK_WIDGET(entry);
 	PangoLayout *layout;
-	int length, i, text_len;
+	int i, text_len;
 	const char *text;
 
 	/* Remove all existing pango attributes.  These will get readded as we check */
@@ -1116,16 +1288,13 @@ sexy_spell_entry_recheck_all(SexySpellEntry *entry)
 		check_attributes (entry, text, text_len);
 	}
 
-	if (have_enchant && entry->priv->checked
-		&& g_slist_length (entry->priv->dict_list) != 0)
+	/* The words were checked when they were split up */
+	if (have_enchant && entry->priv->checked && entry->priv->misspelled)
 	{
-		/* Loop through words */
-		for (i = 0; entry->priv->words[i]; i++)
+		for (i = 0; i < entry->priv->n_words; i++)
 		{
-			length = strlen (entry->priv->words[i]);
-			if (length == 0)
-				continue;
-			check_word (entry, entry->priv->word_starts[i], entry->priv->word_ends[i]);
+			if (entry->priv->misspelled[i])
+				insert_underline_error (entry, entry->priv->word_starts[i], entry->priv->word_ends[i]);
 		}
 	}
 
@@ -1242,21 +1411,76 @@ entry_strsplit_utf8(GtkEntry *entry, gchar ***set, gint **starts, gint **ends)
 	}
 }
 
+/*
+ * Splits the text into words again and checks them. With incremental set,
+ * the words before and after the edited part are the ones seen last time,
+ * shifted by the length difference, and keep what they were checked as.
+ */
 static void
-sexy_spell_entry_changed(GtkEditable *editable, gpointer data)
+sexy_spell_entry_update_words(SexySpellEntry *entry, gboolean incremental)
 {
-	SexySpellEntry *entry = SEXY_SPELL_ENTRY(editable);
+	SexySpellEntryPriv *priv = entry->priv;
+	gchar **words;
+	gint *starts, *ends;
+	gboolean *misspelled = NULL;
+	gint n_words, text_len, delta, head = 0, tail = 0, i;
 
-	if (entry->priv->words)
+	entry_strsplit_utf8(GTK_ENTRY(entry), &words, &starts, &ends);
+	n_words = g_strv_length(words);
+	text_len = strlen(gtk_entry_get_text(GTK_ENTRY(entry)));
+
+	if (have_enchant && priv->checked && priv->dict_list != NULL)
 	{
-		g_strfreev(entry->priv->words);
-		g_free(entry->priv->word_starts);
-		g_free(entry->priv->word_ends);
+		misspelled = g_new0(gboolean, n_words);
+
+		if (incremental && priv->misspelled)
+		{
+			while (head < n_words && head < priv->n_words
+				&& starts[head] == priv->word_starts[head]
+				&& strcmp(words[head], priv->words[head]) == 0)
+			{
+				misspelled[head] = priv->misspelled[head];
+				head++;
+			}
+
+			delta = text_len - priv->text_len;
+			while (tail < n_words - head && tail < priv->n_words - head
+				&& starts[n_words - 1 - tail] == priv->word_starts[priv->n_words - 1 - tail] + delta
+				&& strcmp(words[n_words - 1 - tail], priv->words[priv->n_words - 1 - tail]) == 0)
+			{
+				misspelled[n_words - 1 - tail] = priv->misspelled[priv->n_words - 1 - tail];
+				tail++;
+			}
+		}
+
+		for (i = head; i < n_words - tail; i++)
+		{
+			if (words[i][0] != 0)
+				misspelled[i] = word_misspelled(entry, starts[i], ends[i]);
+		}
 	}
-	entry_strsplit_utf8(GTK_ENTRY(entry), &entry->priv->words, &entry->priv->word_starts, &entry->priv->word_ends);
+
+	g_strfreev(priv->words);
+	g_free(priv->word_starts);
+	g_free(priv->word_ends);
+	g_free(priv->misspelled);
+
+	priv->words = words;
+	priv->word_starts = starts;
+	priv->word_ends = ends;
+	priv->n_words = n_words;
+	priv->text_len = text_len;
+	priv->misspelled = misspelled;
+
 	sexy_spell_entry_recheck_all(entry);
 }
 
+static void
+sexy_spell_entry_changed(GtkEditable *editable, gpointer data)
+{
+	sexy_spell_entry_update_words(SEXY_SPELL_ENTRY(editable), TRUE);
+}
+
 static gboolean
 enchant_has_lang(const gchar *lang, GSList *langs) {
 	GSList *i;
@@ -1313,7 +1537,7 @@ sexy_spell_entry_activate_default_languages(SexySpellEntry *entry)
 	if (entry->priv->dict_list == NULL)
 		sexy_spell_entry_activate_language_internal(entry, "en", NULL);
 
-	sexy_spell_entry_recheck_all (entry);
+	sexy_spell_entry_update_words (entry, FALSE);
 }
 
 static void
@@ -1360,7 +1584,9 @@ sexy_spell_entry_activate_language_internal(SexySpellEntry *entry, const gchar *
 	}
 
 	enchant_dict_add_to_session (dict, "BirdChat", strlen("BirdChat"));
+	g_mutex_lock(&entry->priv->dict_lock);
 	entry->priv->dict_list = g_slist_append(entry->priv->dict_list, (gpointer) dict);
+	g_mutex_unlock(&entry->priv->dict_lock);
 	g_hash_table_insert(entry->priv->dict_hash, get_lang_from_dict(dict), (gpointer) dict);
 
 	return TRUE;
@@ -1485,15 +1711,8 @@ sexy_spell_entry_activate_language(SexySpellEntry *entry, const gchar *lang, GEr
 
 	ret = sexy_spell_entry_activate_language_internal(entry, lang, error);
 
-	if (ret) {
-		if (entry->priv->words) {
-			g_strfreev(entry->priv->words);
-			g_free(entry->priv->word_starts);
-			g_free(entry->priv->word_ends);
-		}
-		entry_strsplit_utf8(GTK_ENTRY(entry), &entry->priv->words, &entry->priv->word_starts, &entry->priv->word_ends);
-		sexy_spell_entry_recheck_all(entry);
-	}
+	if (ret)
+		sexy_spell_entry_update_words(entry, FALSE);
 
 	return ret;
 }
@@ -1524,32 +1743,32 @@ sexy_spell_entry_deactivate_language(SexySpellEntry *entry, const gchar *lang)
 		dict = g_hash_table_lookup(entry->priv->dict_hash, lang);
 		if (!dict)
 			return;
+		g_mutex_lock(&entry->priv->dict_lock);
 		enchant_broker_free_dict(entry->priv->broker, dict);
 		entry->priv->dict_list = g_slist_remove(entry->priv->dict_list, dict);
+		g_mutex_unlock(&entry->priv->dict_lock);
 		g_hash_table_remove (entry->priv->dict_hash, lang);
+		g_hash_table_remove (entry->priv->word_caches, dict);
 	} else {
 		/* deactivate all */
 		GSList *li;
 		struct EnchantDict *dict;
 
+		g_mutex_lock(&entry->priv->dict_lock);
 		for (li = entry->priv->dict_list; li; li = g_slist_next(li)) {
 			dict = (struct EnchantDict *)li->data;
 			enchant_broker_free_dict(entry->priv->broker, dict);
 		}
 
 		g_slist_free (entry->priv->dict_list);
+		entry->priv->dict_list = NULL;
+		g_mutex_unlock(&entry->priv->dict_lock);
 		g_hash_table_destroy (entry->priv->dict_hash);
 		entry->priv->dict_hash = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
-		entry->priv->dict_list = NULL;
+		g_hash_table_remove_all (entry->priv->word_caches);
 	}
 
-	if (entry->priv->words) {
-		g_strfreev(entry->priv->words);
-		g_free(entry->priv->word_starts);
-		g_free(entry->priv->word_ends);
-	}
-	entry_strsplit_utf8(GTK_ENTRY(entry), &entry->priv->words, &entry->priv->word_starts, &entry->priv->word_ends);
-	sexy_spell_entry_recheck_all(entry);
+	sexy_spell_entry_update_words(entry, FALSE);
 }
 
 /**
@@ -1584,13 +1803,7 @@ sexy_spell_entry_set_active_languages(SexySpellEntry *entry, GSList *langs, GErr
 		    (const gchar *) li->data, error) == FALSE)
 			return FALSE;
 	}
-	if (entry->priv->words) {
-		g_strfreev(entry->priv->words);
-		g_free(entry->priv->word_starts);
-		g_free(entry->priv->word_ends);
-	}
-	entry_strsplit_utf8(GTK_ENTRY(entry), &entry->priv->words, &entry->priv->word_starts, &entry->priv->word_ends);
-	sexy_spell_entry_recheck_all(entry);
+	sexy_spell_entry_update_words(entry, FALSE);
 	return TRUE;
 }
 
@@ -1663,14 +1876,7 @@ sexy_spell_entry_set_checked(SexySpellEntry *entry, gboolean checked)
 	}
 	else
 	{
-		if (entry->priv->words)
-		{
-			g_strfreev(entry->priv->words);
-			g_free(entry->priv->word_starts);
-			g_free(entry->priv->word_ends);
-		}
-		entry_strsplit_utf8(GTK_ENTRY(entry), &entry->priv->words, &entry->priv->word_starts, &entry->priv->word_ends);
-		sexy_spell_entry_recheck_all(entry);
+		sexy_spell_entry_update_words(entry, FALSE);
 	}
 }
 
@@ -1699,13 +1905,6 @@ sexy_spell_entry_set_parse_attributes (SexySpellEntry *entry, gboolean parse)
 	}
 	else
 	{
-		if (entry->priv->words)
-		{
-			g_strfreev (entry->priv->words);
-			g_free (entry->priv->word_starts);
-			g_free (entry->priv->word_ends);
-		}
-		entry_strsplit_utf8 (GTK_ENTRY (entry), &entry->priv->words, &entry->priv->word_starts, &entry->priv->word_ends);
-		sexy_spell_entry_recheck_all (entry);
+		sexy_spell_entry_update_words (entry, FALSE);
 	}
 }
@@ -19,160 +19,33 @@
 #include "gtk-xtext-view.h"
 #include "fe-gtk.h"
 
-/* URL patterns in order of priority */
-static UrlPattern url_patterns[] = {
-    /* HTTP/HTTPS URLs */
-    {"https?://[^\\s<>\"]+[^\\s<>\".,:;!?]", 1},
-    /* FTP URLs */
-    {"ftp://[^\\s<>\"]+[^\\s<>\".,:;!?]", 2},
-    /* Email addresses */
-    {"[a-zA-Z0-9._%+-]+@[a-zA-Z0-9.-]+\\.[a-zA-Z]{2,}", 3},
-    /* IRC channels */
-    {"#[a-zA-Z0-9_-]+", 4},
-    /* File paths (basic) */
-    {"file://[^\\s<>\"]+", 5},
-    /* Generic protocols */
-    {"[a-zA-Z][a-zA-Z0-9+.-]*://[^\\s<>\"]+[^\\s<>\".,:;!?]", 6},
-    {NULL, 0}
-};
-
-static GRegex **compiled_patterns = NULL;
-static gint num_patterns = 0;
-
-/* Initialize URL handler */
-void
-url_handler_init (void)
-{
-    if (compiled_patterns) return; /* Already initialized */
-    
-    /* Count patterns */
-    num_patterns = 0;
-    while (url_patterns[num_patterns].pattern) {
-        num_patterns++;
-    }
-    
-    /* Compile regex patterns */
-    compiled_patterns = g_malloc0(sizeof(GRegex*) * num_patterns);
-    
-    {
-        gint i;
-        for (i = 0; i < num_patterns; i++) {
-        GError *error = NULL;
-        compiled_patterns[i] = g_regex_new(url_patterns[i].pattern,
-                                          G_REGEX_CASELESS | G_REGEX_OPTIMIZE,
-                                          0, &error);
-        if (error) {
-            g_warning("Failed to compile URL pattern %s: %s", 
-                     url_patterns[i].pattern, error->message);
-            g_error_free(error);
-            compiled_patterns[i] = NULL;
-        }
-        }
-    }
-}
-
-/* Cleanup URL handler */
-void
-url_handler_cleanup (void)
-{
-    if (!compiled_patterns) return;
-    
-    {
-        gint i;
-        for (i = 0; i < num_patterns; i++) {
-        if (compiled_patterns[i]) {
-            g_regex_unref(compiled_patterns[i]);
-        }
-        }
-    }
-    g_free(compiled_patterns);
-    compiled_patterns = NULL;
-    num_patterns = 0;
-}
-
-/* Free URL match */
-static void
-url_match_free (UrlMatch *match)
-{
-    if (match) {
-        g_free(match->url);
-        g_free(match);
-    }
-}
-
-/* Comparison function for sorting matches */
-static gint
-url_match_compare (const UrlMatch *a, const UrlMatch *b)
-{
-    return a->start_pos - b->start_pos;
-}
-
 /* Find URLs in text */
 GSList *
 url_handler_find_urls (const gchar *text, gsize text_len)
 {
     GSList *matches = NULL;
-    gint pattern_idx;
+    GArray *spans;
+    guint i;
     
-    if (!text || !compiled_patterns) return NULL;
+    if (!text) return NULL;
     
-    for (pattern_idx = 0; pattern_idx < num_patterns; pattern_idx++) {
-        GMatchInfo *match_info;
-        
-        if (!compiled_patterns[pattern_idx]) continue;
+    spans = url_scan (text, text_len, URL_SCAN_ALL);
+    if (!spans) return NULL;
+    
+    for (i = 0; i < spans->len; i++) {
+        url_span *span = &g_array_index(spans, url_span, i);
+        UrlMatch *match = g_malloc0(sizeof(UrlMatch));
         
-        if (g_regex_match_full(compiled_patterns[pattern_idx], text, text_len,
-                              0, 0, &match_info, NULL)) {
-            
-            while (g_match_info_matches(match_info)) {
-                gchar *match_text = g_match_info_fetch(match_info, 0);
-                gint start_pos, end_pos;
-                
-                if (g_match_info_fetch_pos(match_info, 0, &start_pos, &end_pos)) {
-                    /* Check if this URL overlaps with existing matches */
-                    gboolean overlaps = FALSE;
-                    GSList *iter = matches;
-                    while (iter) {
-                        UrlMatch *existing = (UrlMatch *)iter->data;
-                        if ((start_pos < existing->end_pos && end_pos > existing->start_pos)) {
-                            /* Overlap detected - keep higher priority (lower number) */
-                            if (url_patterns[pattern_idx].priority < url_patterns[existing->pattern_id].priority) {
-                                /* Remove existing, add new */
-                                matches = g_slist_remove(matches, existing);
-                                url_match_free(existing);
-                            } else {
-                                /* Keep existing */
-                                overlaps = TRUE;
-                            }
-                            break;
-                        }
-                        iter = iter->next;
-                    }
-                    
-                    if (!overlaps) {
-                        UrlMatch *new_match = g_malloc0(sizeof(UrlMatch));
-                        new_match->url = match_text;
-                        new_match->start_pos = start_pos;
-                        new_match->end_pos = end_pos;
-                        new_match->pattern_id = pattern_idx;
-                        matches = g_slist_append(matches, new_match);
-                    } else {
-                        g_free(match_text);
-                    }
-                } else {
-                    g_free(match_text);
-                }
-                
-                g_match_info_next(match_info, NULL);
-            }
-        }
-        g_match_info_free(match_info);
+        match->url = g_strndup(text + span->start, span->end - span->start);
+        match->start_pos = span->start;
+        match->end_pos = span->end;
+        match->pattern_id = span->type;
+        matches = g_slist_prepend(matches, match);
     }
+    g_array_free(spans, TRUE);
     
-    /* Sort matches by position */
-    matches = g_slist_sort(matches, (GCompareFunc)url_match_compare);
-    
-    return matches;
+    /* url_scan () returns them in order already */
+    return g_slist_reverse(matches);
 }
 
 /* Free URL matches */
@@ -181,7 +54,9 @@ url_handler_free_matches (GSList *matches)
 {
     GSList *iter = matches;
     while (iter) {
-        url_match_free((UrlMatch *)iter->data);
+        UrlMatch *match = (UrlMatch *)iter->data;
+        g_free(match->url);
+        g_free(match);
         iter = iter->next;
     }
     g_slist_free(matches);
@@ -295,9 +170,6 @@ url_handler_setup_text_view (GtkXTextView *xtext_view)
 {
     if (!xtext_view || !xtext_view->text_view) return;
     
-    /* Initialize URL handler if needed */
-    url_handler_init();
-    
     /* Connect event handlers */
     g_signal_connect(xtext_view->text_view, "button-press-event",
                     G_CALLBACK(url_handler_button_press), xtext_view);
@@ -309,37 +181,28 @@ url_handler_setup_text_view (GtkXTextView *xtext_view)
                          GDK_BUTTON_PRESS_MASK | GDK_POINTER_MOTION_MASK);
 }
 
-/* Apply URL tags to text buffer */
+/* Apply URL tags to text buffer. The spans were found once per line by
+   irc_formatter_parse () and are already in characters from line_start. */
 void
 url_handler_apply_tags (GtkXTextView *xtext_view,
                        GtkTextBuffer *buffer,
-                       const gchar *text,
-                       GtkTextIter *start_iter,
-                       GtkTextIter *end_iter)
+                       GArray *spans,
+                       const GtkTextIter *line_start)
 {
-    if (!text || !xtext_view || !buffer) return;
+    guint i;
     
-    GSList *matches = url_handler_find_urls(text, strlen(text));
-    if (!matches) return;
+    if (!spans || !xtext_view || !buffer) return;
     
-    GSList *match_iter = matches;
-    while (match_iter) {
-        UrlMatch *match = (UrlMatch *)match_iter->data;
-        
-        /* Calculate iterators for this URL */
-        GtkTextIter url_start = *start_iter;
-        GtkTextIter url_end = *start_iter;
+    for (i = 0; i < spans->len; i++) {
+        url_span *span = &g_array_index(spans, url_span, i);
+        GtkTextIter url_start = *line_start;
+        GtkTextIter url_end = *line_start;
         
-        gtk_text_iter_forward_chars(&url_start, match->start_pos);
-        gtk_text_iter_forward_chars(&url_end, match->end_pos);
+        gtk_text_iter_forward_chars(&url_start, span->start);
+        gtk_text_iter_forward_chars(&url_end, span->end);
         
-        /* Apply URL tag */
         gtk_text_buffer_apply_tag(buffer, xtext_view->url_tag, &url_start, &url_end);
-        
-        match_iter = match_iter->next;
     }
-    
-    url_handler_free_matches(matches);
 }
 
 /* Open URL using system default handler */
@@ -15,35 +15,24 @@
 
 G_BEGIN_DECLS
 
-/* URL detection patterns */
-typedef struct {
-    const gchar *pattern;
-    gint priority;
-} UrlPattern;
-
 /* URL match result */
 typedef struct {
     gchar *url;
     gint start_pos;
     gint end_pos;
-    gint pattern_id;
+    gint pattern_id;    /* WORD_URL, WORD_EMAIL or WORD_CHANNEL */
 } UrlMatch;
 
-/* URL handler initialization and cleanup */
-void url_handler_init (void);
-void url_handler_cleanup (void);
-
-/* URL detection in text */
+/* URL detection in text, byte offsets (see url_scan () in common/url.c) */
 GSList *url_handler_find_urls (const gchar *text, gsize text_len);
 void url_handler_free_matches (GSList *matches);
 
 /* GTK integration */
 void url_handler_setup_text_view (GtkXTextView *xtext_view);
-void url_handler_apply_tags (GtkXTextView *xtext_view, 
+void url_handler_apply_tags (GtkXTextView *xtext_view,
                             GtkTextBuffer *buffer,
-                            const gchar *text,
-                            GtkTextIter *start_iter,
-                            GtkTextIter *end_iter);
+                            GArray *spans,
+                            const GtkTextIter *line_start);
 
 /* URL opening */
 void url_handler_open_url (const gchar *url);
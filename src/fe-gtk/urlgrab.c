@@ -27,7 +27,6 @@
 #include "../common/cfgfiles.h"
 #include "../common/fe.h"
 #include "../common/url.h"
-#include "../common/tree.h"
 #include "gtkutil.h"
 #include "menu.h"
 #include "maingui.h"
@@ -37,10 +36,15 @@
 enum
 {
 	URL_COLUMN,
+	NICK_COLUMN,
+	CHANNEL_COLUMN,
+	NETWORK_COLUMN,
+	FOLD_COLUMN,	/* lowercased text the filter searches in */
 	N_COLUMNS
 };
 
 static GtkWidget *urlgrabberwindow = 0;
+static char *url_filter_text = NULL;
 
 
 static gboolean
@@ -83,29 +87,67 @@ url_treeview_url_clicked_cb (GtkWidget *view, GdkEventButton *event,
 	return FALSE;
 }
 
+static gboolean
+url_treeview_visible_cb (GtkTreeModel *model, GtkTreeIter *iter, gpointer data)
+{
+	char *fold;
+	gboolean visible;
+
+	if (!url_filter_text || !url_filter_text[0])
+		return TRUE;
+
+	gtk_tree_model_get (model, iter, FOLD_COLUMN, &fold, -1);
+	visible = fold && strstr (fold, url_filter_text) != NULL;
+	g_free (fold);
+
+	return visible;
+}
+
 static GtkWidget *
-url_treeview_new (GtkWidget *box)
+url_treeview_new (GtkWidget *box, GtkListStore **store_ret)
 {
 	GtkListStore *store;
+	GtkTreeModel *filter;
 	GtkWidget *view;
 
-	store = gtk_list_store_new (N_COLUMNS, G_TYPE_STRING);
+	store = gtk_list_store_new (N_COLUMNS, G_TYPE_STRING, G_TYPE_STRING,
+										 G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING);
 	g_return_val_if_fail (store != NULL, NULL);
 
-	view = gtkutil_treeview_new (box, GTK_TREE_MODEL (store), NULL,
-	                             URL_COLUMN, _("URL"), -1);
+	filter = gtk_tree_model_filter_new (GTK_TREE_MODEL (store), NULL);
+	gtk_tree_model_filter_set_visible_func (GTK_TREE_MODEL_FILTER (filter),
+														 url_treeview_visible_cb, NULL, NULL);
+	/* the filter holds the store now */
+	g_object_unref (store);
+
+	view = gtkutil_treeview_new (box, filter, NULL,
+	                             URL_COLUMN, _("URL"),
+	                             NICK_COLUMN, _("Nick"),
+	                             CHANNEL_COLUMN, _("Channel"),
+	                             NETWORK_COLUMN, _("Network"), -1);
 	g_signal_connect (G_OBJECT (view), "button_press_event",
 	                  G_CALLBACK (url_treeview_url_clicked_cb), NULL);
-	/* don't want column headers */
-	gtk_tree_view_set_headers_visible (GTK_TREE_VIEW (view), FALSE);
 	gtk_widget_show (view);
+
+	*store_ret = store;
 	return view;
 }
 
+static void
+url_filter_changed_cb (GtkEntry *entry, GtkTreeView *view)
+{
+	g_free (url_filter_text);
+	url_filter_text = g_utf8_casefold (gtk_entry_get_text (entry), -1);
+
+	gtk_tree_model_filter_refilter (GTK_TREE_MODEL_FILTER (gtk_tree_view_get_model (view)));
+}
+
 static void
 url_closegui (GtkWidget *wid, gpointer userdata)
 {
 	urlgrabberwindow = 0;
+	g_free (url_filter_text);
+	url_filter_text = NULL;
 }
 
 static void
@@ -149,6 +191,29 @@ url_button_save (void)
 							url_save_callback, NULL, NULL, NULL, FRF_WRITE);
 }
 
+static void
+url_add_row (GtkListStore *store, const char *urltext, struct url_entry *entry)
+{
+	GtkTreeIter iter;
+	char *fold, *search;
+
+	search = g_strjoin (" ", urltext,
+							  entry && entry->nick ? entry->nick : "",
+							  entry && entry->channel ? entry->channel : "",
+							  entry && entry->network ? entry->network : "", NULL);
+	fold = g_utf8_casefold (search, -1);
+	g_free (search);
+
+	gtk_list_store_insert_with_values (store, &iter, 0,
+	                    URL_COLUMN, urltext,
+	                    NICK_COLUMN, entry ? entry->nick : NULL,
+	                    CHANNEL_COLUMN, entry ? entry->channel : NULL,
+	                    NETWORK_COLUMN, entry ? entry->network : NULL,
+	                    FOLD_COLUMN, fold,
+	                    -1);
+	g_free (fold);
+}
+
 void
 fe_url_add (const char *urltext)
 {
@@ -160,10 +225,7 @@ fe_url_add (const char *urltext)
 	{
 		store = GTK_LIST_STORE (g_object_get_data (G_OBJECT (urlgrabberwindow),
 		                                           "model"));
-		gtk_list_store_prepend (store, &iter);
-		gtk_list_store_set (store, &iter,
-		                    URL_COLUMN, urltext,
-		                    -1);
+		url_add_row (store, urltext, url_lookup (urltext));
 
 		/* remove any overflow */
 		if (prefs.hex_url_grabber_limit > 0)
@@ -176,17 +238,17 @@ fe_url_add (const char *urltext)
 	}
 }
 
-static int
-populate_cb (char *urltext, gpointer userdata)
+static void
+populate_cb (struct url_entry *entry, void *store)
 {
-	fe_url_add (urltext);
-	return TRUE;
+	url_add_row (store, entry->url, entry);
 }
 
 void
 url_opengui ()
 {
-	GtkWidget *vbox, *hbox, *view;
+	GtkWidget *vbox, *hbox, *view, *entry;
+	GtkListStore *store;
 	char buf[128];
 
 	if (urlgrabberwindow)
@@ -200,9 +262,15 @@ url_opengui ()
 		mg_create_generic_tab ("UrlGrabber", buf, FALSE, TRUE, url_closegui, NULL,
 							 400, 256, &vbox, 0);
 	gtkutil_destroy_on_esc (urlgrabberwindow);
-	view = url_treeview_new (vbox);
-	g_object_set_data (G_OBJECT (urlgrabberwindow), "model",
-	                   gtk_tree_view_get_model (GTK_TREE_VIEW (view)));
+	entry = gtk_search_entry_new ();
+	gtk_entry_set_placeholder_text (GTK_ENTRY (entry), _("Filter URLs, nicks, channels..."));
+	gtk_box_pack_start (GTK_BOX (vbox), entry, 0, 0, 0);
+	gtk_widget_show (entry);
+
+	view = url_treeview_new (vbox, &store);
+	g_object_set_data (G_OBJECT (urlgrabberwindow), "model", store);
+	g_signal_connect (G_OBJECT (entry), "changed",
+	                  G_CALLBACK (url_filter_changed_cb), view);
 
 	hbox = gtk_button_box_new (GTK_ORIENTATION_HORIZONTAL);
 	gtk_button_box_set_layout (GTK_BUTTON_BOX (hbox), GTK_BUTTONBOX_SPREAD);
@@ -220,10 +288,10 @@ url_opengui ()
 	gtk_widget_show (urlgrabberwindow);
 
 	if (prefs.hex_url_grabber)
-		tree_foreach (url_tree, (tree_traverse_func *)populate_cb, NULL);
+		url_foreach (populate_cb, store);
 	else
 	{
-		gtk_list_store_clear (GTK_LIST_STORE (gtk_tree_view_get_model (GTK_TREE_VIEW (view))));
+		gtk_list_store_clear (store);
 		fe_url_add ("URL Grabber is disabled.");
 	}
 }